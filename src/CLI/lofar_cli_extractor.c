@@ -7,14 +7,20 @@ void helpMessages() {
 
 	printf("\n\n");
 
-	printf("-i: <format>	Input file name format (default: './%%d')\n");
+	printf("-i: <format>	Input file name format (default: './%%d'), '-' reads a single port from stdin\n");
+	printf("		Wildcards (eg. './udp_1613%%d.*.zst') are expanded into a chain of files for each port, read in sorted order as one continuous input\n");
 	printf("-o: <format>	Output file name format (provide %%d, %%s and %%ld to fill in output ID, date/time string and the starting packet number) (default: './output%%d_%%s_%%ld')\n");
+	printf("		Use '-' to stream a single output to stdout (messages are moved to stderr); existing named pipes are streamed to rather than refused\n");
 	printf("-m: <numPack>	Number of packets to process in each read request (default: 65536)\n");
+	printf("-R: <MB>		Memory budget for the data buffers, the packets per iteration are reduced to fit within it (0 === unlimited) (default: %d%% of the available memory)\n", (int) (100 * TUNING_MEMORY_FRACTION));
 	printf("-u: <numPort>	Number of ports to combine (default: 4)\n");
 	printf("-n: <baseNum>	Base value to iterate when chosing ports (default: 0)\n");
+	printf("-k: <bytes>	Number of bytes before the CEP header of each packet, eg. a timestamp added by the recorder (default: %d)\n", UDPHDROFF);
 	printf("-b: <lo>,<hi>	Beamlets to extract from the input dataset. Lo is inclusive, hi is exclusive ( eg. 0,300 will return 300 beamlets, 0:299). (defualt: 0,0 === all)\n");
 	printf("-t: <timeStr>	String of the time of the first requested packet, format YYYY-MM-DDTHH:mm:ss (default: '')\n");
 	printf("-s: <numSec>	Maximum number of seconds of raw data to extract/process (default: all)\n");
+	printf("-j: <udpPort>	pcap / pcapng inputs: take port N's packets from UDP destination port udpPort + N, allowing all ports to be read from one capture (default: every UDP packet in each port's capture)\n");
+	printf("-w: <numSec>	Follow inputs that are still being written: on reaching the end of an input, wait up to numSec seconds for more data (default: 0 === disabled)\n");
 	printf("-e: <fileName>	Specify a file of events to extract; newline separated start time and durations in seconds. Events must not overlap.\n");
 	printf("-p: <mode>		Processing mode, options listed below (default: 0)\n");
 	printf("-r:		Replay the previous packet when a dropped packet is detected (default: pad with 0 values)\n");
@@ -22,40 +28,82 @@ void helpMessages() {
 	printf("-d:		Calibrate the data with the given pointing (default: disabled, eg '0.1,0.2,J2000'). Will not run without -c\n");
 	printf("-z:		Change to the alternative clock used for modes 4/6 (160MHz clock) (default: False)\n");
 	printf("-q:		Enable silent mode for the CLI, don't print any information outside of library error messes (default: False)\n");
-	printf("-a: <args>		Call mockHeader with the specific flags to prefix output files with a header (default: False)\n");
+	printf("-a: <args>		Prefix output files with a SIGPROC header, using mockHeader-style flags (eg '-fch1 150 -fo -0.19 -source Sun') (default: False)\n");
 	printf("-f:		Append files if they already exist (default: False, exit if exists)\n");
+	printf("-H:		Write HDF5 outputs, compressed with deflate when -Z is set (requires a build with HDF5=1) (default: False)\n");
+	printf("-F: <bits>[,<n>]	Write PSRFITS search-mode outputs with 8 or 4 bit samples and n samples per subint, described by the -a flags (Stokes modes only) (default: disabled, 2048 samples)\n");
+	printf("-P:		Count cycles, instructions and last level cache misses in the port read and kernel stages, reported in the summary (default: False)\n");
+	printf("-A:		Autotune the packets per iteration and thread counts with short trials on the input before processing (default: False)\n");
+	printf("-Y: <fileName>	Tuning cache; -A results are saved to it, otherwise a result for this host, mode and number of ports is loaded from it (default: disabled)\n");
+	printf("-M: <name>		Publish live metrics to a shared memory page, read with lofar_udp_metrics (eg. '/lofar_udp_metrics') (default: disabled)\n");
+	printf("-Z: <lvl>[,<n>]	Compress the outputs with zstd at the given level, using n worker threads per output (default: 0 === disabled, 4 workers)\n");
+	printf("-C:		Copy the data into output pipes rather than vmsplice'ing it, required if the consumer splices it onwards (eg. pv) (default: False)\n");
 	
 	VERBOSE(printf("-v:		Enable verbose output (default: False)\n");
 			printf("-V:		Enable highly verbose output (default: False)\n"));
+	TRACE(printf("-T: <fileName>	Write a Chrome trace (chrome://tracing, ui.perfetto.dev) of the read, processing and write stages to the given file (default: disabled)\n"));
 
 	processingModes();
 
 }
 
 
+/**
+ * @brief      Print a summary of a stage's hardware counters, these are
+ *             process-wide so they include the writer and compression threads
+ *             running alongside the stage
+ *
+ * @param[in]  stage     The stage name
+ * @param[in]  counters  The stage's counters
+ * @param[in]  seconds   The stage's wall time
+ * @param[in]  bytes     The bytes handled by the stage
+ */
+void printPerfCounters(const char *stage, const lofar_udp_perf_counters *counters, const double seconds, const double bytes) {
+	const long *count = counters->count;
+
+	printf("%s Counters (process-wide):\t", stage);
+	if (count[PERF_CYCLES] > 0 && count[PERF_INSTRUCTIONS] >= 0) printf("%.3e cycles, %.3e instructions (IPC %.2lf, %.2lf cycles/byte)\t", (double) count[PERF_CYCLES], (double) count[PERF_INSTRUCTIONS], (double) count[PERF_INSTRUCTIONS] / (double) count[PERF_CYCLES], bytes > 0 ? (double) count[PERF_CYCLES] / bytes : 0.);
+	if (count[PERF_LLC_REFERENCES] > 0 && count[PERF_LLC_MISSES] >= 0) printf("LLC misses %.3e (%.1lf%%, ~%.2lf GB/s from memory)\t", (double) count[PERF_LLC_MISSES], 100. * (double) count[PERF_LLC_MISSES] / (double) count[PERF_LLC_REFERENCES], seconds > 0 ? (double) count[PERF_LLC_MISSES] * PERF_CACHE_LINE / seconds / 1e9 : 0.);
+	if (count[PERF_TASK_CLOCK] >= 0) printf("CPU time %.2lfs (%.1lf threads busy)", (double) count[PERF_TASK_CLOCK] / 1e9, seconds > 0 ? (double) count[PERF_TASK_CLOCK] / 1e9 / seconds : 0.);
+	printf("\n");
+}
+
+
 int main(int argc, char  *argv[]) {
 
 	// Set up input local variables
 	int inputOpt, input = 0;
 	float seconds = 0.0;
-	double sampleTime = 0.0;
-	char inputFormat[256] = "./%d", outputFormat[256] = "./output%d_%s_%ld", inputTime[256] = "", eventsFile[256] = "", stringBuff[128], mockHdrArg[2048] = "", mockHdrCmd[4096] = "";
-	int silent = 0, appendMode = 0, eventCount = 0, returnCounter = 0, callMockHdr = 0, basePort = 0, calPoint = 0, calStrat = 0;
-	long maxPackets = -1, startingPacket = -1;
-	unsigned int clock200MHz = 1;
+	char inputFormat[256] = "./%d", outputFormat[256] = "./output%d_%s_%ld", metricsName[256] = "", tuningFile[256] = "", inputTime[256] = "", eventsFile[256] = "", stringBuff[128], mockHdrArg[2048] = "", hdrBuffer[SIGPROC_MAX_HDR_LENGTH];
+	int silent = 0, appendMode = 0, eventCount = 0, returnCounter = 0, callMockHdr = 0, hdf5Output = 0, psrfitsOutput = 0, basePort = 0, calPoint = 0, calStrat = 0;
+	int stdoutOutput = 0, stdoutFd = -1, fifoOutput[MAX_OUTPUT_DIMS] = { 0 }, autotune = 0, tuned = 0, numInputFiles, streamedInput = 0, pcapBasePort = 0;
+	long maxPackets = -1, startingPacket = -1, memoryBudget = -1;
+	unsigned int clock200MHz = 1, inputMagic;
 	FILE *eventsFilePtr;
 
 	lofar_udp_config config = lofar_udp_config_default;
 
 	// Set up reader loop variables
-	int loops = 0, localLoops = 0, returnVal, dummy;
+	int loops = 0, localLoops = 0, returnVal;
 	long packetsProcessed = 0, packetsWritten = 0, eventPacketsLost[MAX_NUM_PORTS], packetsToWrite;
 	double timing[2] = {0., 0.}, totalReadTime = 0, totalOpsTime = 0, totalWriteTime = 0;
 	struct timespec tick, tick0, tock, tock0;
 
 	// I/O variables
 	FILE *inputFiles[MAX_NUM_PORTS];
+	glob_t inputGlob;
 	FILE *outputFiles[MAX_OUTPUT_DIMS];
+	lofar_udp_writer *writer = NULL;
+	lofar_udp_writer_config writerConfig = lofar_udp_writer_config_default;
+	lofar_udp_reader_stats stats;
+	lofar_udp_metrics *metrics = NULL;
+	lofar_udp_tuning_config tuningConfig = lofar_udp_tuning_config_default;
+	lofar_udp_tuning_result tuningResult;
+	lofar_udp_memory_plan memoryPlan;
+	TRACE(char traceFile[256] = "");
+	lofar_udp_psrfits_config psrfitsConfig = lofar_udp_psrfits_config_default;
+	sigproc_hdr sigprocHdr;
+	long hdrLength = 0;
 	
 	// Malloc'd variables: need to be free'd later.
 	long *startingPackets, *multiMaxPackets;
@@ -63,7 +111,7 @@ int main(int argc, char  *argv[]) {
 	char **dateStr; // Sub elements need to be free'd too.
 
 	// Standard ugly input flags parser
-	while((inputOpt = getopt(argc, argv, "zrqfvVi:o:m:u:t:s:e:p:a:n:b:c:d:")) != -1) {
+	while((inputOpt = getopt(argc, argv, "zrqfHvVPACi:o:m:R:u:t:s:w:j:k:e:p:a:n:b:c:d:Z:F:M:T:Y:")) != -1) {
 		input = 1;
 		switch(inputOpt) {
 			
@@ -79,6 +127,10 @@ int main(int argc, char  *argv[]) {
 				config.packetsPerIteration = atol(optarg);
 				break;
 
+			case 'R':
+				memoryBudget = atol(optarg) * 1024 * 1024;
+				break;
+
 			case 'u':
 				config.numPorts = atoi(optarg);
 				break;
@@ -95,6 +147,18 @@ int main(int argc, char  *argv[]) {
 				seconds = atof(optarg);
 				break;
 
+			case 'w':
+				config.followTimeout = atoi(optarg);
+				break;
+
+			case 'j':
+				pcapBasePort = atoi(optarg);
+				break;
+
+			case 'k':
+				config.headerOffset = atoi(optarg);
+				break;
+
 			case 'e':
 				strcpy(eventsFile, optarg);
 				break;
@@ -131,6 +195,17 @@ int main(int argc, char  *argv[]) {
 				clock200MHz = 0;
 				break;
 
+			case 'Z':
+				if (parseIntPair(optarg, &(writerConfig.compressionLevel), &(writerConfig.compressionWorkers)) || writerConfig.compressionLevel < ZSTD_minCLevel() || writerConfig.compressionLevel > ZSTD_maxCLevel() || writerConfig.compressionWorkers < 1) {
+					fprintf(stderr, "ERROR: -Z expects <level>[,<workers>], with a level between %d and %d and at least 1 worker (got '%s'), exiting.\n", ZSTD_minCLevel(), ZSTD_maxCLevel(), optarg);
+					return 1;
+				}
+				break;
+
+			case 'C':
+				writerConfig.pipeCopy = 1;
+				break;
+
 			case 'q':
 				silent = 1;
 				break;
@@ -139,6 +214,42 @@ int main(int argc, char  *argv[]) {
 				appendMode = 1;
 				break;
 
+			case 'H':
+				hdf5Output = 1;
+				break;
+
+			case 'P':
+				config.perfCounters = 1;
+				break;
+
+			case 'F':
+				psrfitsOutput = 1;
+				if (parseIntPair(optarg, &(psrfitsConfig.nbits), &(psrfitsConfig.samplesPerSubint)) || (psrfitsConfig.nbits != 8 && psrfitsConfig.nbits != 4) || psrfitsConfig.samplesPerSubint < 2 || psrfitsConfig.samplesPerSubint % 2 != 0) {
+					fprintf(stderr, "ERROR: -F expects <bits>[,<samples per subint>], with 8 or 4 bits and an even number of samples (got '%s'), exiting.\n", optarg);
+					return 1;
+				}
+				break;
+
+			case 'A':
+				autotune = 1;
+				break;
+
+			case 'Y':
+				if (strlen(optarg) >= 255) {
+					fprintf(stderr, "ERROR: Tuning cache path %s is too long, exiting.\n", optarg);
+					return 1;
+				}
+				strcpy(tuningFile, optarg);
+				break;
+
+			case 'M':
+				if (strlen(optarg) >= 255) {
+					fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", optarg);
+					return 1;
+				}
+				strcpy(metricsName, optarg);
+				break;
+
 			case 'v': 
 				if (!config.verbose)
 					VERBOSE(config.verbose = 1;);
@@ -147,6 +258,10 @@ int main(int argc, char  *argv[]) {
 				VERBOSE(config.verbose = 2;);
 				break;
 
+			case 'T':
+				TRACE(snprintf(traceFile, 256, "%s", optarg));
+				break;
+
 
 
 
@@ -157,7 +272,7 @@ int main(int argc, char  *argv[]) {
 
 			// Handle edge/error cases
 			case '?':
-				if ((optopt == 'i') || (optopt == 'o') || (optopt == 'm') || (optopt == 'u') || (optopt == 't') || (optopt == 's') || (optopt == 'e') || (optopt == 'p') || (optopt == 'a') || (optopt == 'c') || (optopt == 'd')) {
+				if ((optopt == 'i') || (optopt == 'o') || (optopt == 'm') || (optopt == 'R') || (optopt == 'u') || (optopt == 't') || (optopt == 's') || (optopt == 'w') || (optopt == 'j') || (optopt == 'k') || (optopt == 'e') || (optopt == 'p') || (optopt == 'a') || (optopt == 'n') || (optopt == 'b') || (optopt == 'c') || (optopt == 'd') || (optopt == 'Z') || (optopt == 'F') || (optopt == 'M') || (optopt == 'T') || (optopt == 'Y')) {
 					fprintf(stderr, "Option '%c' requires an argument.\n", optopt);
 				} else {
 					fprintf(stderr, "Option '%c' is unknown or encountered an error.\n", optopt);
@@ -203,28 +318,79 @@ int main(int argc, char  *argv[]) {
 		return 1;
 	}
 
-	// Check if we have a compressed input file
+	// Check if we have a compressed input file, packet captures are detected once the inputs are opened
 	if (strstr(inputFormat, "zst") != NULL) {
 		config.readerType = ZSTDCOMPRESSED;
 	}
 
-	// Make sure mockHeader is on the path if we want to use it.
+	// Counters are only inherited by threads created after they are opened, but the tuning trials start the OpenMP threads first
+	if (autotune && config.perfCounters) {
+		fprintf(stderr, "ERROR: Performance counters (-P) would miss the threads started by autotuning (-A); tune with -A -Y first, then count with -P -Y. Exiting.\n");
+		return 1;
+	}
+
+	// HDF5 outputs are described by their attributes, and only accept deflate levels
+	if (hdf5Output && callMockHdr) {
+		fprintf(stderr, "WARNING: SIGPROC headers are not written to HDF5 outputs, ignoring -a. Continuing...\n");
+		callMockHdr = 0;
+	}
+
+	if (hdf5Output && writerConfig.compressionLevel > 9) {
+		fprintf(stderr, "ERROR: HDF5 outputs use deflate compression, which only supports levels 1 to 9 (%d requested), exiting.\n", writerConfig.compressionLevel);
+		return 1;
+	}
+
+	if (psrfitsOutput) {
+		if (hdf5Output) {
+			fprintf(stderr, "ERROR: HDF5 and PSRFITS outputs cannot be requested at the same time, exiting.\n");
+			return 1;
+		}
+
+		if (config.processingMode < 100) {
+			fprintf(stderr, "ERROR: PSRFITS outputs require a Stokes processing mode (>= 100, %d requested), exiting.\n", config.processingMode);
+			return 1;
+		}
+
+		if (writerConfig.compressionLevel > 0) {
+			fprintf(stderr, "WARNING: PSRFITS outputs are not compressed, ignoring -Z. Continuing...\n");
+		}
+
+		// The header flags describe the observation in the PSRFITS headers instead
+		if (callMockHdr) {
+			sigprocHdr = sigproc_hdr_default;
+			if (lofar_udp_sigproc_parse_args(&sigprocHdr, mockHdrArg) > 0) {
+				return 1;
+			}
+			lofar_udp_psrfits_config_from_sigproc(&psrfitsConfig, &sigprocHdr);
+			callMockHdr = 0;
+		}
+	}
+
+	// Validate the header arguments before we start reading data
 	if (callMockHdr) {
 		if (config.processingMode < 99 || config.processingMode > 199) {
 			fprintf(stderr, "WARNING: Processing mode %d may not confirm to the Sigproc spec, but you requested a header. Continuing with caution...\n", config.processingMode);
 		}
-		
-		printf("Checking for mockHeader on system path... ");
-		callMockHdr += system("which mockHeader > /tmp/udp_reader_mockheader.log 2>&1"); // Add the return code (multiplied by 256 from bash return) to the execution variable, ensure it doesn't change
-		printf("\n");
-		if (callMockHdr != 1) {
-			fprintf(stderr, "Error occured while attempting to find mockHeader, exiting.\n");
+
+		sigprocHdr = sigproc_hdr_default;
+		if (lofar_udp_sigproc_parse_args(&sigprocHdr, mockHdrArg) > 0) {
 			return 1;
 		}
+	}
 
-		sampleTime = clock160MHzSample * (1 - clock200MHz) + clock200MHzSample * clock200MHz;
-		if (config.processingMode > 100) {
-			sampleTime *= 1 << ((config.processingMode % 10));
+	// Stream to stdout: keep a handle on the real stdout for the data, and move everything we print to stderr
+	if (strcmp(outputFormat, "-") == 0) {
+		if (hdf5Output || psrfitsOutput) {
+			fprintf(stderr, "ERROR: HDF5 and PSRFITS outputs cannot be streamed to stdout, exiting.\n");
+			return 1;
+		}
+
+		stdoutOutput = 1;
+		fflush(stdout);
+		stdoutFd = dup(STDOUT_FILENO);
+		if (stdoutFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+			fprintf(stderr, "ERROR: Unable to redirect stdout for streaming (errno %d: %s), exiting.\n", errno, strerror(errno));
+			return 1;
 		}
 	}
 
@@ -343,21 +509,123 @@ int main(int argc, char  *argv[]) {
 	for (int port = basePort; port < config.numPorts + basePort; port++) {
 		sprintf(workingString, inputFormat, port);
 
-		if (strcmp(inputFormat, workingString) == 0 && config.numPorts > 1) {
+		// Every port can be taken from one capture when they are split by UDP port
+		if (strcmp(inputFormat, workingString) == 0 && config.numPorts > 1 && pcapBasePort == 0) {
 			fprintf(stderr, "ERROR: Input file was not iterated while trying to load raw data, please ensure it contains a '%%d' value. Exiting.\n");
 			return 1;
 		}
 
-		VERBOSE(if (config.verbose) printf("Opening file at %s\n", workingString));
+		// Read a single port from stdin, eg. when decompressing or receiving the capture in flight
+		if (strcmp(workingString, "-") == 0) {
+			inputFiles[port - basePort] = stdin;
+			continue;
+		}
 
-		inputFiles[port - basePort] = fopen(workingString, "r");
-		if (inputFiles[port - basePort] == NULL) {
-			fprintf(stderr, "Input file at %s does not exist, exiting.\n", workingString);
+		// Expand any wildcards into a chain of files for the port, read one after the other in sorted order
+		if ((returnVal = glob(workingString, 0, NULL, &inputGlob)) != 0 && returnVal != GLOB_NOMATCH) {
+			fprintf(stderr, "ERROR: Failed to expand input pattern %s (%d), exiting.\n", workingString, returnVal);
 			return 1;
 		}
+		numInputFiles = (returnVal == 0) ? (int) inputGlob.gl_pathc : 1;
+
+		if (numInputFiles > 1) {
+			if (silent == 0) printf("Port %d: chaining %d files, %s to %s\n", port, numInputFiles, inputGlob.gl_pathv[0], inputGlob.gl_pathv[numInputFiles - 1]);
+			config.inputFileChains[port - basePort] = calloc(numInputFiles - 1, sizeof(FILE*));
+			config.inputFileChainLengths[port - basePort] = numInputFiles - 1;
+		}
+
+		for (int file = 0; file < numInputFiles; file++) {
+			const char *inputPath = (returnVal == 0) ? inputGlob.gl_pathv[file] : workingString;
+			VERBOSE(if (config.verbose) printf("Opening file at %s\n", inputPath));
+
+			FILE *inputFile = fopen(inputPath, "r");
+			if (inputFile == NULL) {
+				fprintf(stderr, "Input file at %s does not exist, exiting.\n", inputPath);
+				return 1;
+			}
+
+			if (file == 0) inputFiles[port - basePort] = inputFile;
+			else config.inputFileChains[port - basePort][file - 1] = inputFile;
+		}
+		if (returnVal == 0) globfree(&inputGlob);
 		PAUSE;
 	}
 
+	config.inputFiles = &(inputFiles[0]);
+	for (int port = 0; port < config.numPorts; port++) streamedInput |= lofar_udp_input_streamed(inputFiles[port]);
+
+	// Check if the inputs are packet captures (these cannot be streamed, so the magic number can be read in place), or
+	// 	compressed inputs without 'zst' in their name, such as a compressed file redirected to stdin
+	if (config.readerType == NORMAL && !streamedInput && pread(fileno(inputFiles[0]), workingString, 4, 0) == 4) {
+		memcpy(&inputMagic, workingString, sizeof(inputMagic));
+		if (lofar_udp_pcap_detect(workingString, 4)) config.readerType = PCAP;
+		else if (inputMagic == ZSTD_MAGICNUMBER) config.readerType = ZSTDCOMPRESSED;
+	}
+
+	if (config.readerType == PCAP) {
+		if (pcapBasePort > 0) for (int port = 0; port < config.numPorts; port++) config.pcapPorts[port] = pcapBasePort + basePort + port;
+	} else if (pcapBasePort > 0) {
+		fprintf(stderr, "ERROR: -j was provided, but the inputs are not pcap / pcapng captures, exiting.\n");
+		return 1;
+	}
+	config.startingPacket = startingPackets[0];
+	config.packetsReadMax = multiMaxPackets[0];
+
+	// Pick the gulp size and thread counts, either from short trials on the input or a previous run on this host
+	if (autotune) {
+		if (silent == 0) printf("Autotuning the reader configuration...\n");
+		tuningConfig.verbose = !silent;
+		if ((returnVal = lofar_udp_tuning_run(&config, &tuningConfig, &tuningResult)) > 0) {
+			fprintf(stderr, "ERROR: Failed to autotune the reader, exiting.\n");
+			return 1;
+		} else if (returnVal < 0) {
+			fprintf(stderr, "WARNING: The input is too short to time any tuning candidate, continuing with the default configuration.\n");
+		} else {
+			if (strcmp(tuningFile, "") != 0 && lofar_udp_tuning_save(tuningFile, &config, &tuningResult) > 0) {
+				fprintf(stderr, "WARNING: Failed to save the tuning result to %s, continuing.\n", tuningFile);
+			}
+			tuned = 1;
+		}
+	} else if (strcmp(tuningFile, "") != 0) {
+		if ((returnVal = lofar_udp_tuning_load(tuningFile, &config, &tuningResult)) > 0) {
+			fprintf(stderr, "ERROR: Failed to load tuning cache %s, exiting.\n", tuningFile);
+			return 1;
+		} else if (returnVal < 0 && silent == 0) {
+			printf("No tuning result stored for this configuration in %s, using the defaults.\n", tuningFile);
+		}
+		tuned = (returnVal == 0);
+	}
+
+	if (tuned) {
+		if (tuningResult.ompThreads > OMP_THREADS || tuningResult.ompThreads < 1) {
+			fprintf(stderr, "ERROR: Tuned thread count %d is outside of the compiled limit (%d), exiting.\n", tuningResult.ompThreads, OMP_THREADS);
+			return 1;
+		}
+
+		lofar_udp_tuning_apply(&config, &tuningResult);
+		if (config.packetsPerIteration > maxPackets) config.packetsPerIteration = maxPackets;
+		if (silent == 0) printf("Tuned configuration:\t%ld packets per iteration, %d threads, %d read threads (%.3e packets/s)\n\n", config.packetsPerIteration, config.ompThreads, config.readThreads, tuningResult.packetsPerSecond);
+	}
+
+	// Make sure the reader and writer buffers fit in memory
+	if (memoryBudget < 0) memoryBudget = (long) (TUNING_MEMORY_FRACTION * lofar_udp_tuning_available_memory());
+	if (memoryBudget > 0 && streamedInput) {
+		if (silent == 0) printf("Streamed inputs cannot be rewound to plan memory usage, continuing without a plan.\n\n");
+	} else if (memoryBudget > 0) {
+		if ((returnVal = lofar_udp_tuning_plan_memory(&config, &writerConfig, memoryBudget, &memoryPlan)) > 0) {
+			fprintf(stderr, "ERROR: Failed to plan memory usage, exiting.\n");
+			return 1;
+		} else if (returnVal < 0) {
+			fprintf(stderr, "WARNING: The smallest gulp needs %.3lf GB, exceeding the memory budget of %.3lf GB. Continuing...\n", memoryPlan.peakBytes / 1e9, memoryBudget / 1e9);
+		}
+
+		if (memoryPlan.packetsPerIteration < config.packetsPerIteration) {
+			if (silent == 0) printf("Packet/Gulp would exceed the memory budget of %.3lf GB, reducing from %ld to %ld.\n", memoryBudget / 1e9, config.packetsPerIteration, memoryPlan.packetsPerIteration);
+			config.packetsPerIteration = memoryPlan.packetsPerIteration;
+		}
+		if (silent == 0) printf("Planned memory usage:\t%.3lf GB (%.3lf GB budget, %ld bytes per packet)\n\n", memoryPlan.peakBytes / 1e9, memoryBudget / 1e9, memoryPlan.bytesPerPacket);
+	}
+
 
 
 	if (silent == 0) printf("Starting data read/reform operations...\n");
@@ -367,9 +635,6 @@ int main(int argc, char  *argv[]) {
 	CLICK(tick0);
 
 	// Generate the lofar_udp_reader, this also does I/O to seeks to the required packet and gulps the first input
-	config.inputFiles = &(inputFiles[0]);
-	config.startingPacket = startingPackets[0];
-	config.packetsReadMax = multiMaxPackets[0];
 	lofar_udp_reader *reader =  lofar_udp_meta_file_reader_setup_struct(&(config));
 
 	// Returns null on error, check
@@ -384,10 +649,25 @@ int main(int argc, char  *argv[]) {
 		return 1;
 	}
 
+	// Expose the reader's counters to external monitors
+	if (strcmp(metricsName, "") != 0) {
+		if ((metrics = lofar_udp_metrics_create(metricsName)) == NULL) {
+			return 1;
+		}
+		lofar_udp_metrics_publish(metrics, reader);
+		if (silent == 0) printf("Publishing live metrics to %s\n", metricsName);
+	}
 
 
+
+	if (stdoutOutput && reader->meta->numOutputs > 1) {
+		fprintf(stderr, "ERROR: Processing mode %d has %d outputs, but only one can be streamed to stdout. Use named pipes instead, exiting.\n", reader->meta->processingMode, reader->meta->numOutputs);
+		return 1;
+	}
+
 	// Check that the output files don't already exist (no append mode), or that they can be written to (append mode)
 	for (int eventLoop = 0; eventLoop < eventCount; eventLoop++) {
+		if (stdoutOutput) break;
 		
 		if (strstr(outputFormat, "%ld") != NULL && silent == 0)  {
 			printf("WARNING: we cannot predict whether or not files following the prefix '%s' will exist due to the packet number being variable due to packet loss.\nContinuing with caution.\n\n", outputFormat);
@@ -398,6 +678,9 @@ int main(int argc, char  *argv[]) {
 			sprintf(workingString, outputFormat, out, dateStr[eventLoop]);
 
 			VERBOSE( if (config.verbose) printf("Checking if file at %s exists / can be written to\n", workingString));
+			// Named pipes are streamed to, opening them here would block until a consumer appears
+			if (isNamedPipe(workingString)) continue;
+
 			if (!appendMode) {
 				if (access(workingString, F_OK) != -1) {
 					fprintf(stderr, "Output file at %s already exists; exiting.\n", workingString);
@@ -473,6 +756,10 @@ int main(int argc, char  *argv[]) {
 		for (int out = 0; out < reader->meta->numOutputs; out++) {
 			sprintf(workingString, outputFormat, out, dateStr[eventLoop], startingPacket);
 			VERBOSE(if (config.verbose) printf("Testing output file for output %d @ %s\n", out, workingString));
+
+			// Streamed outputs are attached to the writer once it is ready
+			fifoOutput[out] = !hdf5Output && !psrfitsOutput && isNamedPipe(workingString);
+			if (stdoutOutput || fifoOutput[out]) continue;
 			
 			if (appendMode != 1 && access(workingString, F_OK) != -1) {
 				fprintf(stderr, "Output file at %s already exists; exiting.\n", workingString);
@@ -480,23 +767,78 @@ int main(int argc, char  *argv[]) {
 			}
 			
 
-			if (callMockHdr) {
-				// Call mockHeader, we can populate the starting time, number of channels, output bit size and sampling rate
-				sprintf(mockHdrCmd, "mockHeader -tstart %.9lf -nchans %d -nbits %d -tsamp %.9lf %s %s > /tmp/udp_reader_mockheader.log 2>&1", lofar_get_packet_time_mjd(reader->meta->inputData[0]), reader->meta->totalProcBeamlets, reader->meta->outputBitMode, sampleTime, mockHdrArg, workingString);
-				dummy = system(mockHdrCmd);
-
-				if (dummy != 0) fprintf(stderr, "Encountered error while calling mockHeader (%s), continuing with caution.\n", mockHdrCmd);
-			}
+			// HDF5 / PSRFITS outputs are created once the writer is ready
+			if (hdf5Output || psrfitsOutput) continue;
 
 			VERBOSE(if (config.verbose) printf("Opening file at %s\n", workingString));
 
-			outputFiles[out] = fopen(workingString, "a");
+			// Files with a header are replaced, rather than appended to
+			outputFiles[out] = fopen(workingString, callMockHdr ? "w" : "a");
 			if (outputFiles[out] == NULL) {
 				fprintf(stderr, "Output file at %s could not be created, exiting.\n", workingString);
 				return 1;
 			}
 		}
 
+		// Build the header for this event, we can populate the starting time, number of channels, output bit size and sampling rate
+		if (callMockHdr) {
+			sigprocHdr = sigproc_hdr_default;
+			lofar_udp_sigproc_setup(&sigprocHdr, reader->meta);
+			lofar_udp_sigproc_parse_args(&sigprocHdr, mockHdrArg);
+			if ((hdrLength = lofar_udp_sigproc_write_header(&sigprocHdr, hdrBuffer, SIGPROC_MAX_HDR_LENGTH)) < 0) {
+				return 1;
+			}
+		}
+
+		// Attach the asynchronous writer on the first event, the sinks are pointed at the new outputs below
+		if (writer == NULL) {
+			// Nothing else reads the processed data, so clean gulps in modes 0/1 can be written straight from the inputs
+			writerConfig.passthrough = 1;
+			writer = lofar_udp_writer_setup_struct(reader, NULL, &writerConfig);
+			if (writer == NULL) {
+				fprintf(stderr, "Failed to generate writer. Exiting.\n");
+				return 1;
+			}
+		}
+
+		// Replacing the HDF5 sinks closes the previous event's files
+		if (hdf5Output) {
+			for (int out = 0; out < reader->meta->numOutputs; out++) {
+				sprintf(workingString, outputFormat, out, dateStr[eventLoop], startingPacket);
+				VERBOSE(if (config.verbose) printf("Creating HDF5 file at %s\n", workingString));
+				if (lofar_udp_writer_sink_hdf5(writer, out, workingString, writerConfig.compressionLevel, writerConfig.compressionWorkers) > 0) {
+					fprintf(stderr, "Failed to create HDF5 output %d for event %d. Exiting.\n", out, eventLoop);
+					return 1;
+				}
+			}
+		} else if (psrfitsOutput) {
+			for (int out = 0; out < reader->meta->numOutputs; out++) {
+				sprintf(workingString, outputFormat, out, dateStr[eventLoop], startingPacket);
+				VERBOSE(if (config.verbose) printf("Creating PSRFITS file at %s\n", workingString));
+				if (lofar_udp_writer_sink_psrfits(writer, out, workingString, &psrfitsConfig) > 0) {
+					fprintf(stderr, "Failed to create PSRFITS output %d for event %d. Exiting.\n", out, eventLoop);
+					return 1;
+				}
+			}
+		} else {
+			for (int out = 0; out < reader->meta->numOutputs; out++) {
+				if (stdoutOutput) {
+					returnVal = lofar_udp_writer_sink_pipe(writer, out, stdoutFd);
+				} else if (fifoOutput[out]) {
+					sprintf(workingString, outputFormat, out, dateStr[eventLoop], startingPacket);
+					if (silent == 0) printf("Waiting for a consumer to open the named pipe at %s...\n", workingString);
+					returnVal = lofar_udp_writer_sink_fifo(writer, out, workingString);
+				} else {
+					returnVal = lofar_udp_writer_sink_file(writer, out, outputFiles[out]);
+				}
+
+				if (returnVal > 0) {
+					fprintf(stderr, "Failed to attach output %d for event %d. Exiting.\n", out, eventLoop);
+					return 1;
+				}
+			}
+		}
+
 		VERBOSE(if (config.verbose) printf("Begining data extraction loop for event %d\n", eventLoop));
 		// While we receive new data for the current event,
 		while ((returnVal = lofar_udp_reader_step_timed(reader, timing)) < 1) {
@@ -515,11 +857,15 @@ int main(int argc, char  *argv[]) {
 			CLICK(tick0);
 			
 			#ifndef BENCHMARKING
-			for (int out = 0; out < reader->meta->numOutputs; out++) {
-				VERBOSE(printf("Writing %ld bytes (%ld packets) to disk for output %d...\n", packetsToWrite * reader->meta->packetOutputLength[out], packetsToWrite, out));
-				fwrite(reader->meta->outputData[out], sizeof(char), packetsToWrite * reader->meta->packetOutputLength[out], outputFiles[out]);
+			// Hand the gulp to the writer thread; this only blocks while the previous gulp is still being written
+			VERBOSE(printf("Submitting %ld packets to the writer...\n", packetsToWrite));
+			// The header is written in front of the first gulp of each event
+			if (lofar_udp_writer_submit_prefixed(writer, packetsToWrite, hdrBuffer, (localLoops == 0 && callMockHdr) ? hdrLength : 0) > 0) {
+				fprintf(stderr, "Failed to write output for operation %d. Exiting.\n", loops);
+				return 1;
 			}
 			#endif
+			lofar_udp_metrics_publish(metrics, reader);
 
 			packetsWritten += packetsToWrite;
 			packetsProcessed += reader->meta->packetsPerIteration;
@@ -529,7 +875,7 @@ int main(int argc, char  *argv[]) {
 			if (silent == 0) {
 				timing[0] = 9.;
 				timing[1] = 0.;
-				printf("Disk writes completed for operation %d after %f seconds.\n", loops, TICKTOCK(tick0, tock0));
+				printf("Disk writes queued for operation %d after %f seconds (previous write took %f seconds).\n", loops, TICKTOCK(tick0, tock0), writer->lastWriteTime);
 				if (returnVal < 0) 
 					for(int port = 0; port < reader->meta->numPorts; port++)
 						if (reader->meta->portLastDroppedPackets[port] != 0)
@@ -551,8 +897,15 @@ int main(int argc, char  *argv[]) {
 			CLICK(tick0);
 		}
 
-		// Close the output files before we open new ones or exit
-		for (int out = 0; out < reader->meta->numOutputs; out++) fclose(outputFiles[out]);
+		// Wait for the last gulp to land, then close the output files before we open new ones or exit
+		if (lofar_udp_writer_finalise(writer) > 0) {
+			fprintf(stderr, "Failed to write output for event %d. Exiting.\n", eventLoop);
+			return 1;
+		}
+		lofar_udp_metrics_publish(metrics, reader);
+		if (!hdf5Output && !psrfitsOutput && !stdoutOutput) {
+			for (int out = 0; out < reader->meta->numOutputs; out++) if (!fifoOutput[out]) fclose(outputFiles[out]);
+		}
 
 	}
 
@@ -571,15 +924,31 @@ int main(int argc, char  *argv[]) {
 		printf("We processed %ld packets, representing %.03lf seconds of data", packetsProcessed, reader->meta->numPorts * packetsProcessed * UDPNTIMESLICE * 5.12e-6);
 		if (reader->meta->numPorts > 1) printf(" (%.03lf per port)\n", packetsProcessed * UDPNTIMESLICE * 5.12e-6);
 		else printf(".\n");
-		printf("Total Read Time:\t%3.02lf\t\tTotal CPU Ops Time:\t%3.02lf\tTotal Write Time:\t%3.02lf\n", totalReadTime, totalOpsTime, totalWriteTime);
+		printf("Total Read Time:\t%3.02lf\t\tTotal CPU Ops Time:\t%3.02lf\tTotal Write Time:\t%3.02lf (%3.02lf blocking)\n", totalReadTime, totalOpsTime, writer->totalWriteTime, totalWriteTime);
 		printf("Total Data Read:\t%3.03lfGB\t\t\t\tTotal Data Written:\t%3.03lfGB\n", (double) packetsProcessed * totalPacketLength / 1e+9, (double) packetsWritten* totalOutLength / 1e+9);
 		printf("A total of %d packets were missed during the observation.\n", droppedPackets);
+
+		lofar_udp_writer_flush(writer);
+		if (lofar_udp_reader_get_stats(reader, &stats) == 0) {
+			printf("Stage Times:\t\tRead %3.02lf (port reads %3.02lf, shifts %3.02lf, headers %3.02lf)\tKernel %3.02lf\tCalibration %3.02lf\tWrite %3.02lf (waited %3.02lf)\n", stats.readStep.totalTime, stats.portRead.totalTime, stats.shift.totalTime, stats.headers.totalTime, stats.kernel.totalTime, stats.calibration.totalTime, stats.write.totalTime, stats.writeWait.totalTime);
+			for (int port = 0; port < reader->meta->numPorts; port++) {
+				printf("Port %d:\t\t\t%ld packets padded (%ld replayed), %ld out of order\n", port, stats.portPacketsDropped[port], stats.portPacketsReplayed[port], stats.portPacketsOutOfOrder[port]);
+			}
+			if (reader->perf != NULL) {
+				printPerfCounters("Port Read", &(stats.portReadCounters), stats.portRead.totalTime, stats.bytesDecompressed);
+				printPerfCounters("Kernel", &(stats.kernelCounters), stats.kernel.totalTime, (double) packetsProcessed * totalPacketLength);
+			}
+		}
 		printf("\n\nData processing finished. Cleaning up file and memory objects...\n");
 	}
 
 
 
-	// Clean-up the reader object, also closes the input files for us
+	// Stop the writer, returning the reader's buffers, then clean-up the reader object, also closes the input files for us
+	if (writer != NULL) lofar_udp_writer_cleanup(writer);
+	if (stdoutFd >= 0) close(stdoutFd);
+	TRACE(if (strcmp(traceFile, "") != 0 && lofar_udp_trace_dump(traceFile) == 0 && silent == 0) printf("Trace written to %s\n", traceFile));
+	lofar_udp_metrics_detach(metrics);
 	lofar_udp_reader_cleanup(reader);
 	if (silent == 0) printf("Reader cleanup performed successfully.\n");
 
@@ -589,6 +958,7 @@ int main(int argc, char  *argv[]) {
 	free(multiMaxPackets);
 	free(startingPackets);
 	free(eventSeconds);
+	for (int port = 0; port < MAX_NUM_PORTS; port++) free(config.inputFileChains[port]);
 
 	if (silent == 0) printf("CLI memory cleaned up successfully. Exiting.\n");
 	return 0;
@@ -0,0 +1,218 @@
+#include <unistd.h>
+#include <time.h>
+
+#include "lofar_udp_generator.h"
+
+void helpMessages() {
+	printf("LOFAR UDP Packet generator (v%.1f)\n\n", VERSIONCLI);
+	printf("Usage: ./lofar_udp_generator <flags>");
+
+	printf("\n\n");
+
+	printf("-o: <format>	Output file name format (provide %%d to fill in the port number) (default: './udp_%%d')\n");
+	printf("-u: <numPort>	Number of ports to generate (default: 4)\n");
+	printf("-n: <numPack>	Number of packets to generate on each port, before loss (default: 65536)\n");
+	printf("-l: <bits>		Bit mode of the generated data (4, 8, 16) (default: 8)\n");
+	printf("-b: <beamlets>	Beamlets per port (default: 0 === 244/122/61 for 4/8/16 bit)\n");
+	printf("-c:		Generate 160MHz clock data (default: 200MHz)\n");
+	printf("-t: <unixTime>	Unix time of the second the data starts in (default: 1609459200)\n");
+	printf("-s: <offset>	Packet offset of the first packet from the start of that second, negative values start in the previous second (default: 0)\n");
+	printf("-S: <seed>		Seed for the noise, loss and reorder generators (default: 1)\n");
+	printf("-a: <sigma>		Standard deviation of the samples, in input units (default: 2/16/1024 for 4/8/16 bit)\n");
+	printf("-d: <rate>		Probability that a packet is dropped (default: 0)\n");
+	printf("-g: <rate>,<n>	Probability that a burst of up to n packets is dropped (default: 0,1)\n");
+	printf("-r: <rate>,<n>	Probability that a packet is delayed by up to n packets (default: 0,1)\n");
+	printf("-Z: <lvl>		Compress the outputs with zstd at the given level (default: 0 === disabled)\n");
+	printf("-k: <bytes>		Pad each packet with this many bytes before its CEP header (default: 0)\n");
+	printf("-P: <udpPort>	Write pcap captures of UDP datagrams to udpPort + port, rather than raw packets (default: 0 === disabled)\n");
+	printf("-f:		Overwrite files if they already exist (default: False, exit if exists)\n");
+	printf("-q:		Enable silent mode for the CLI, only print errors (default: False)\n");
+
+}
+
+
+int main(int argc, char *argv[]) {
+
+	// Set up input local variables
+	int inputOpt, input = 0, silent = 0, overwrite = 0, returnVal = 0;
+	char outputFormat[256] = "./udp_%d", workingString[1024];
+
+	lofar_udp_generator_config config = lofar_udp_generator_config_default;
+	lofar_udp_generator *generator;
+	FILE *outputFiles[MAX_NUM_PORTS] = { NULL };
+	struct timespec tick, tock;
+	double timing;
+	long totalWritten = 0, totalDropped = 0, totalReordered = 0, totalBytes = 0;
+
+
+	// Standard ugly input flags parser
+	while((inputOpt = getopt(argc, argv, "cfqho:u:n:l:b:t:s:S:a:d:g:r:Z:k:P:")) != -1) {
+		input = 1;
+		switch(inputOpt) {
+
+			case 'o':
+				strcpy(outputFormat, optarg);
+				break;
+
+			case 'u':
+				config.numPorts = atoi(optarg);
+				break;
+
+			case 'n':
+				config.numPackets = atol(optarg);
+				break;
+
+			case 'l':
+				config.bitMode = atoi(optarg);
+				break;
+
+			case 'b':
+				config.beamlets = atoi(optarg);
+				break;
+
+			case 'c':
+				config.clock200MHz = 0;
+				break;
+
+			case 't':
+				config.startTime = (unsigned int) strtoul(optarg, NULL, 10);
+				break;
+
+			case 's':
+				config.startOffset = atol(optarg);
+				break;
+
+			case 'S':
+				config.seed = strtoul(optarg, NULL, 10);
+				break;
+
+			case 'a':
+				config.sigma = atof(optarg);
+				break;
+
+			case 'd':
+				config.lossRate = atof(optarg);
+				break;
+
+			case 'g':
+				sscanf(optarg, "%lf,%d", &(config.burstRate), &(config.burstLength));
+				break;
+
+			case 'r':
+				sscanf(optarg, "%lf,%d", &(config.reorderRate), &(config.reorderDistance));
+				break;
+
+			case 'Z':
+				config.compressionLevel = atoi(optarg);
+				break;
+
+			case 'k':
+				config.headerOffset = atoi(optarg);
+				break;
+
+			case 'P':
+				config.pcapPort = atoi(optarg);
+				break;
+
+			case 'f':
+				overwrite = 1;
+				break;
+
+			case 'q':
+				silent = 1;
+				break;
+
+
+			// Silence GCC warnings, fall-through is the desired behaviour
+			#pragma GCC diagnostic push
+			#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+			#pragma GCC diagnostic push
+
+			// Handle edge/error cases
+			case '?':
+				if ((optopt == 'o') || (optopt == 'u') || (optopt == 'n') || (optopt == 'l') || (optopt == 'b') || (optopt == 't') || (optopt == 's') || (optopt == 'S') || (optopt == 'a') || (optopt == 'd') || (optopt == 'g') || (optopt == 'r') || (optopt == 'Z') || (optopt == 'k') || (optopt == 'P')) {
+					fprintf(stderr, "Option '%c' requires an argument.\n", optopt);
+				} else {
+					fprintf(stderr, "Option '%c' is unknown or encountered an error.\n", optopt);
+				}
+
+			case 'h':
+			default:
+
+			#pragma GCC diagnostic pop
+
+				helpMessages();
+				return 1;
+
+		}
+	}
+
+	if (input == 0) {
+		helpMessages();
+		return 1;
+	}
+
+	if (strcmp(outputFormat, "") == 0) {
+		fprintf(stderr, "One or more inputs invalid or not fully initialised, exiting.\n");
+		helpMessages();
+		return 1;
+	}
+
+	// Validates the configuration and builds the noise table
+	if ((generator = lofar_udp_generator_setup(&config)) == NULL) {
+		return 1;
+	}
+
+	for (int port = 0; port < config.numPorts; port++) {
+		sprintf(workingString, outputFormat, port);
+
+		if (!overwrite && access(workingString, F_OK) != -1) {
+			fprintf(stderr, "Output file at %s already exists; exiting.\n", workingString);
+			returnVal = 1;
+			break;
+		}
+
+		if ((outputFiles[port] = fopen(workingString, "wb")) == NULL) {
+			fprintf(stderr, "Output file at %s could not be created; exiting.\n", workingString);
+			returnVal = 1;
+			break;
+		}
+
+		if (!silent) printf("Port %d: %s\n", port, workingString);
+	}
+
+	if (!returnVal) {
+		if (!silent) {
+			printf("Generating %ld %d-bit packets (%d beamlets, %d bytes) on %d ports, starting at packet %ld\n", config.numPackets, config.bitMode, generator->config.beamlets, generator->packetLength, config.numPorts, lofar_udp_generator_first_packet(&config));
+		}
+
+		clock_gettime(CLOCK_MONOTONIC_RAW, &tick);
+		returnVal = lofar_udp_generator_write(generator, outputFiles);
+		clock_gettime(CLOCK_MONOTONIC_RAW, &tock);
+		timing = (double) (tock.tv_sec - tick.tv_sec) + (double) (tock.tv_nsec - tick.tv_nsec) / 1e9;
+
+		if (!silent) {
+			for (int port = 0; port < config.numPorts; port++) {
+				const lofar_udp_generator_port *state = &(generator->ports[port]);
+				printf("Port %d: %ld packets written, %ld dropped, %ld reordered, %ld bytes\n", port, state->packetsWritten, state->packetsDropped, state->packetsReordered, state->bytesWritten);
+				totalWritten += state->packetsWritten;
+				totalDropped += state->packetsDropped;
+				totalReordered += state->packetsReordered;
+				totalBytes += state->bytesWritten;
+			}
+
+			printf("Total: %ld packets written, %ld dropped, %ld reordered, %.3lf MB in %.3lfs (%.2lf Mpackets/s, %.2lf MB/s)\n", totalWritten, totalDropped, totalReordered, (double) totalBytes / 1e6, timing, (double) totalWritten / timing / 1e6, (double) totalBytes / timing / 1e6);
+		}
+	}
+
+	for (int port = 0; port < config.numPorts; port++) {
+		if (outputFiles[port] != NULL && fclose(outputFiles[port]) != 0) {
+			fprintf(stderr, "ERROR: Failed to close output for port %d.\n", port);
+			returnVal = 1;
+		}
+	}
+
+	lofar_udp_generator_cleanup(generator);
+
+	return returnVal;
+}
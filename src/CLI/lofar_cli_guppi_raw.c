@@ -1,8 +1,5 @@
 #include "lofar_cli_meta.h"
-#include "ascii_hdr_manager.h"
-
-// Unique prototype to this CLI
-void getStartTimeStringDAQ(lofar_udp_reader *reader, char stringBuff[]);
+#include "lofar_udp_guppi.h"
 
 void helpMessages() {
 	printf("LOFAR UDP Data extractor (v%.1f)\n\n", VERSIONCLI);
@@ -15,6 +12,7 @@ void helpMessages() {
 	printf("-m: <numPack>	Number of packets to process in each read request (default: 65536)\n");
 	printf("-u: <numPort>	Number of ports to combine (default: 4)\n");
 	printf("-n: <baseNum>	Base value to iterate when chosing ports (default: 0)\n");
+	printf("-k: <bytes>	Number of bytes before the CEP header of each packet, eg. a timestamp added by the recorder (default: %d)\n", UDPHDROFF);
 	printf("-b: <lo>,<hi>	Beamlets to extract from the input dataset. Lo is inclusive, hi is exclusive ( eg. 0,300 will return 300 beamlets, 0:299). (defualt: 0,0 === all)\n");
 	printf("-t: <timeStr>	String of the time of the first requested packet, format YYYY-MM-DDTHH:mm:ss (default: '')\n");
 	printf("-s: <numSec>	Maximum number of seconds to process (default: all)\n");
@@ -24,6 +22,8 @@ void helpMessages() {
 	printf("-q:		Enable silent mode for the CLI, don't print any information outside of library error messes (default: False)\n");
 	printf("-a: <file>		File to open with parameters for the ASCII headers\n");
 	printf("-f:		Append files if they already exist (default: False, exit if exists)\n");
+	printf("-O: <samples>	Number of samples from the previous block to repeat at the start of each channel (OVERLAP) (default: 0)\n");
+	printf("-Z: <lvl>[,<n>]	Compress the outputs with zstd at the given level, using n worker threads per output (default: 0 === disabled, 4 workers)\n");
 	
 	VERBOSE(printf("-v:		Enable verbose output (default: False)\n");
 			printf("-V:		Enable highly verbose output (default: False)\n"));
@@ -36,7 +36,6 @@ int main(int argc, char  *argv[]) {
 	// Set up input local variables
 	int inputOpt, outputFilesCount, input = 0;
 	float seconds = 0.0;
-	double sampleTime = 0.0;
 	char inputFormat[256] = "./%d", outputFormat[256] = "./output_%d", inputTime[256] = "", stringBuff[128], hdrFile[2048] = "", timeStr[28] = "";
 	int silent = 0, appendMode = 0, itersPerFile = INT_MAX, basePort = 0;
 	unsigned int clock200MHz = 1;
@@ -53,12 +52,15 @@ int main(int argc, char  *argv[]) {
 	// I/O variables
 	FILE *inputFiles[MAX_NUM_PORTS];
 	FILE *outputFiles[MAX_OUTPUT_DIMS];
+	lofar_udp_writer *writer = NULL;
+	lofar_udp_writer_config writerConfig = lofar_udp_writer_config_default;
+	lofar_udp_guppi_header guppiHdr;
 	
 	// Malloc'd variables: need to be free'd later.
 	char **dateStr; // Sub elements need to be free'd too.
 
 	// Standard ugly input flags parser
-	while((inputOpt = getopt(argc, argv, "rcqfvVi:o:m:u:t:s:e:a:n:b:")) != -1) {
+	while((inputOpt = getopt(argc, argv, "rcqfvVi:o:m:u:t:s:e:a:n:b:k:O:Z:")) != -1) {
 		input = 1;
 		switch(inputOpt) {
 			
@@ -82,6 +84,10 @@ int main(int argc, char  *argv[]) {
 				basePort = atoi(optarg);
 				break;
 
+			case 'k':
+				config.headerOffset = atoi(optarg);
+				break;
+
 			case 't':
 				strcpy(inputTime, optarg);
 				break;
@@ -111,6 +117,17 @@ int main(int argc, char  *argv[]) {
 				clock200MHz = 0;
 				break;
 
+			case 'O':
+				config.timeMajorOverlap = atoi(optarg);
+				break;
+
+			case 'Z':
+				if (parseIntPair(optarg, &(writerConfig.compressionLevel), &(writerConfig.compressionWorkers)) || writerConfig.compressionLevel < ZSTD_minCLevel() || writerConfig.compressionLevel > ZSTD_maxCLevel() || writerConfig.compressionWorkers < 1) {
+					fprintf(stderr, "ERROR: -Z expects <level>[,<workers>], with a level between %d and %d and at least 1 worker (got '%s'), exiting.\n", ZSTD_minCLevel(), ZSTD_maxCLevel(), optarg);
+					return 1;
+				}
+				break;
+
 			case 'q':
 				silent = 1;
 				break;
@@ -137,7 +154,7 @@ int main(int argc, char  *argv[]) {
 
 			// Handle edge/error cases
 			case '?':
-				if ((optopt == 'i') || (optopt == 'o') || (optopt == 'm') || (optopt == 'u') || (optopt == 't') || (optopt == 's') || (optopt == 'e') || (optopt == 'a')) {
+				if ((optopt == 'i') || (optopt == 'o') || (optopt == 'm') || (optopt == 'u') || (optopt == 't') || (optopt == 's') || (optopt == 'e') || (optopt == 'a') || (optopt == 'n') || (optopt == 'b') || (optopt == 'k') || (optopt == 'O') || (optopt == 'Z')) {
 					fprintf(stderr, "Option '%c' requires an argument.\n", optopt);
 				} else {
 					fprintf(stderr, "Option '%c' is unknown or encountered an error.\n", optopt);
@@ -179,14 +196,14 @@ int main(int argc, char  *argv[]) {
 		return 1;
 	}
 
-	// Check if we have a compressed input file
+	// GUPPI RAW is a time-major voltage format
+	config.processingMode = 30;
+
+	// Check if we have a compressed input file, packet captures are detected once the inputs are opened
 	if (strstr(inputFormat, "zst") != NULL) {
 		config.readerType = ZSTDCOMPRESSED;
 	}
 
-	// Determine the clock time
-	sampleTime = clock160MHzSample * (1 - clock200MHz) + clock200MHzSample * clock200MHz;
-
 
 	if (silent == 0) {
 		printf("LOFAR UDP Data extractor (CLI v%.1f, Backend v%.1f)\n\n", VERSIONCLI, VERSION);
@@ -279,6 +296,11 @@ int main(int argc, char  *argv[]) {
 
 	// Generate the lofar_udp_reader, this also does I/O for the first input or seeks to the required packet
 	config.inputFiles = &(inputFiles[0]);
+
+	// Check if the inputs are packet captures
+	if (config.readerType == NORMAL && !lofar_udp_input_streamed(inputFiles[0]) && pread(fileno(inputFiles[0]), workingString, 4, 0) == 4 && lofar_udp_pcap_detect(workingString, 4)) {
+		config.readerType = PCAP;
+	}
 	lofar_udp_reader *reader =  lofar_udp_meta_file_reader_setup_struct(&(config));
 
 	// Returns null on error, check
@@ -300,25 +322,11 @@ int main(int argc, char  *argv[]) {
 		}
 	}
 
-	// Pull the reader parameters into the ASCII header
-	// Frequency indo
-	header.obsnchan = reader->meta->totalProcBeamlets;
-	header.chan_bw = (CLOCK160MHZ / 1e6) * (1 - clock200MHz) + (CLOCK200MHZ / 1e6) * clock200MHz;
-	header.obsbw = header.obsnchan * header.chan_bw;
-
-	// Data format into
-	header.nbits = reader->meta->inputBitMode;
-	header.npol = 2;
-	header.overlap = 0;
-	strcpy(header.pktfmt, "1SFA");
-	header.pktsize = reader->meta->packetOutputLength[0];
-
-	// Timing info
-	double mjdTime = lofar_get_packet_time_mjd(reader->meta->inputData[0]);
-	header.stt_imjd = (int) mjdTime;
-	header.stt_smjd = (int) ((mjdTime - (int) mjdTime) * 86400);
-	header.stt_offs = ((mjdTime - (int) mjdTime) * 86400) - header.stt_smjd;
-	header.tbin = sampleTime;
+	// Pull the reader parameters into the ASCII header and render it, only the per-block values change after this
+	if (lofar_udp_guppi_header_setup(&guppiHdr, &header, reader->meta) > 0) {
+		fprintf(stderr, "Failed to generate the GUPPI RAW header. Exiting.\n");
+		return 1;
+	}
 
 
 	if (silent == 0) {
@@ -337,7 +345,6 @@ int main(int argc, char  *argv[]) {
 
 	// Start iterating
 	int endCondition = 0;
-	int totalDropped = 0, blockDropped = 0;
 	while (!endCondition) {
 		// Reset the local values for each file
 		localLoops = 0;
@@ -369,6 +376,18 @@ int main(int argc, char  *argv[]) {
 			}
 		}
 
+		// Attach the asynchronous writer on the first file, point it at the new files afterwards
+		if (writer == NULL) {
+			writer = lofar_udp_writer_setup_struct(reader, outputFiles, &writerConfig);
+			if (writer == NULL) {
+				fprintf(stderr, "Failed to generate writer. Exiting.\n");
+				return 1;
+			}
+		} else if (lofar_udp_writer_update_files(writer, outputFiles) > 0) {
+			fprintf(stderr, "Failed to update the writer's output files. Exiting.\n");
+			return 1;
+		}
+
 		VERBOSE(if (config.verbose) printf("Begining data extraction loop for event %d\n", loops));
 		// While we receive new data for the current event,
 		while ((returnVal = lofar_udp_reader_step_timed(reader, timing)) < 1) {
@@ -380,38 +399,17 @@ int main(int argc, char  *argv[]) {
 			totalReadTime += timing[0];
 			totalOpsTime += timing[1];
 
-			// Write out the desired amount of packets; cap if needed.
-			packetsToWrite = reader->packetsPerIteration;
-
-			// Get the number of dropped packets for the ASCII header
-			for(int port = 0; port < reader->meta->numPorts; port++)
-				if (reader->meta->portLastDroppedPackets[port] != 0) {
-					blockDropped += reader->meta->portLastDroppedPackets[port];
-					totalDropped += blockDropped;
-				}
+			// Each gulp is written as a single block
+			packetsToWrite = reader->meta->packetsPerIteration;
 
 			CLICK(tick0);
 			
 			#ifndef BENCHMARKING
-			for (int out = 0; out < reader->meta->numOutputs; out++) {
-				// Update header parameters, then write it to disk before we write the next block of data
-				header.blocsize = packetsToWrite * reader->meta->packetOutputLength[out];
-				
-				// Should this be processing time, rather than the recording time?
-				getStartTimeStringDAQ(reader, timeStr);
-				strcpy(header.daqpulse, timeStr);
-
-				header.dropblk = blockDropped / packetsToWrite;
-				header.droptot = totalDropped / (packetsWritten + packetsToWrite);
-
-				if (loops > 0) {
-					header.pktidx = packetsWritten;
-				}
-
-				writeHdr(outputFiles[out], &header);
-				
-				VERBOSE(printf("Writing %ld bytes (%ld packets) to disk for output %d...\n", packetsToWrite * reader->meta->packetOutputLength[out], packetsToWrite, out));
-				fwrite(reader->meta->outputData[out], sizeof(char), packetsToWrite * reader->meta->packetOutputLength[out], outputFiles[out]);
+			// Patch the per-block header values in place and hand the block to the writer
+			VERBOSE(printf("Submitting %ld packets to the writer...\n", packetsToWrite));
+			if (lofar_udp_guppi_submit(writer, &guppiHdr) > 0) {
+				fprintf(stderr, "Failed to write output for operation %d. Exiting.\n", loops);
+				return 1;
 			}
 			#endif
 
@@ -424,7 +422,7 @@ int main(int argc, char  *argv[]) {
 			if (silent == 0) {
 				timing[0] = 9.;
 				timing[1] = 0.;
-				printf("Disk writes completed for operation %d after %f seconds.\n", loops, TICKTOCK(tick0, tock0));
+				printf("Disk writes queued for operation %d after %f seconds (previous write took %f seconds).\n", loops, TICKTOCK(tick0, tock0), writer->lastWriteTime);
 				if (returnVal < 0) 
 					for(int port = 0; port < reader->meta->numPorts; port++)
 						if (reader->meta->portLastDroppedPackets[port] != 0)
@@ -433,7 +431,6 @@ int main(int argc, char  *argv[]) {
 			}
 
 			loops++; localLoops++;
-			blockDropped = 0;
 			// returnVal below 0 indicates we will not be given data on the next iteration, so gracefully exit with the known reason
 			if (returnVal < -1) {
 				printf("We've hit a termination return value (%d, %s), exiting.\n", returnVal, exitReasons[abs(returnVal)]);
@@ -451,7 +448,11 @@ int main(int argc, char  *argv[]) {
 			}
 		}
 
-		// Close the output files before we open new ones or exit
+		// Wait for the last block to land, then close the output files before we open new ones or exit
+		if (lofar_udp_writer_finalise(writer) > 0) {
+			fprintf(stderr, "Failed to write output. Exiting.\n");
+			return 1;
+		}
 		for (int out = 0; out < outputFilesCount; out++) fclose(outputFiles[out]);
 
 	}
@@ -471,7 +472,7 @@ int main(int argc, char  *argv[]) {
 		printf("We processed %ld packets, representing %.03lf seconds of data", packetsProcessed, reader->meta->numPorts * packetsProcessed * UDPNTIMESLICE * 5.12e-6);
 		if (reader->meta->numPorts > 1) printf(" (%.03lf per port)\n", packetsProcessed * UDPNTIMESLICE * 5.12e-6);
 		else printf(".\n");
-		printf("Total Read Time:\t%3.02lf\t\tTotal CPU Ops Time:\t%3.02lf\tTotal Write Time:\t%3.02lf\n", totalReadTime, totalOpsTime, totalWriteTime);
+		printf("Total Read Time:\t%3.02lf\t\tTotal CPU Ops Time:\t%3.02lf\tTotal Write Time:\t%3.02lf (%3.02lf blocking)\n", totalReadTime, totalOpsTime, writer->totalWriteTime, totalWriteTime);
 		printf("Total Data Read:\t%3.03lfGB\t\t\t\tTotal Data Written:\t%3.03lfGB\n", (double) packetsProcessed * totalPacketLength / 1e+9, (double) packetsWritten* totalOutLength / 1e+9);
 		printf("A total of %d packets were missed during the observation.\n", droppedPackets);
 		printf("\n\nData processing finished. Cleaning up file and memory objects...\n");
@@ -479,7 +480,8 @@ int main(int argc, char  *argv[]) {
 
 
 
-	// Clean-up the reader object, also closes the input files for us
+	// Stop the writer, returning the reader's buffers, then clean-up the reader object, also closes the input files for us
+	if (writer != NULL) lofar_udp_writer_cleanup(writer);
 	lofar_udp_reader_cleanup(reader);
 	if (silent == 0) printf("Reader cleanup performed successfully.\n");
 
@@ -490,22 +492,3 @@ int main(int argc, char  *argv[]) {
 	if (silent == 0) printf("CLI memory cleaned up successfully. Exiting.\n");
 	return 0;
 }
-
-
-/**
- * @brief      Emulate the DAQ time string from the current data timestamp
- *
- * @param      reader      The lofar_udp_reader
- * @param      stringBuff  The output time string buffer
- */
-void getStartTimeStringDAQ(lofar_udp_reader *reader, char stringBuff[24]) {
-	double startTime;
-	time_t startTimeUnix;
-	struct tm *startTimeStruct;
-
-	startTime = lofar_get_packet_time(reader->meta->inputData[0]);
-	startTimeUnix = (unsigned int) startTime;
-	startTimeStruct = gmtime(&startTimeUnix);
-
-	strftime(stringBuff, 24, "%a %b %e %H:%M:%S %Y", startTimeStruct);
-}
\ No newline at end of file
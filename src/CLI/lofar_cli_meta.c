@@ -20,6 +20,10 @@ void processingModes(void) {
 	printf("31: Raw UDP to Time Major, Split Pols Output: Time-continuous output: combine (2) and (30)\n");
 	printf("32: Raw UDP to Time Major, Dual Pols Output: Time-continuous output, to antenna polarisation output (X/Y Split, FFTW format)\n\n");
 
+	printf("40: Raw UDP to VDIF, 2-bit: Requantise to 2-bit complex VDIF frames, one thread per port and polarisation\n");
+	printf("41: Raw UDP to VDIF, 4-bit: combine (40) with 4-bit samples (passed through for 4-bit inputs)\n");
+	printf("42: Raw UDP to VDIF, 8-bit: combine (40) with 8-bit samples (passed through for 4/8-bit inputs)\n\n");
+
 	printf("100: Raw UDP to Stokes I: Form a 32-bit float Stokes I for the input.\n");
 	printf("110: Raw UDP to Stokes Q: Form a 32-bit float Stokes Q for the input.\n");
 	printf("120: Raw UDP to Stokes U: Form a 32-bit float Stokes U for the input.\n");
@@ -105,4 +109,42 @@ void getStartTimeString(lofar_udp_reader *reader, char stringBuff[]) {
 	char localBuff[32];
 	strftime(localBuff, sizeof(localBuff), "%Y-%m-%dT%H:%M:%S", startTimeStruct);
 	sprintf(stringBuff, "%s.%06d", localBuff, (int) ((startTime - startTimeUnix) * 1e6));
-}
\ No newline at end of file
+}
+
+/**
+ * @brief      Check whether an output path is an existing named pipe
+ *
+ * @param[in]  path  The path
+ *
+ * @return     1: The path is a named pipe, 0: It is not (or does not exist)
+ */
+int isNamedPipe(const char *path) {
+	struct stat st;
+
+	if (stat(path, &st) != 0) return 0;
+	return S_ISFIFO(st.st_mode);
+}
+
+/**
+ * @brief      Parse an "(int)[,(int)]" option argument; the second value is
+ *             optional, and is left unchanged if it is not provided
+ *
+ * @param[in]  arg     The option argument
+ * @param[out] first   The first value
+ * @param[out] second  The second value
+ *
+ * @return     0: Success, 1: Malformed argument
+ */
+int parseIntPair(const char *arg, int *first, int *second) {
+	int consumed = 0;
+
+	if (sscanf(arg, "%d%n", first, &consumed) != 1) return 1;
+	if (arg[consumed] == '\0') return 0;
+	if (arg[consumed] != ',') return 1;
+
+	arg += consumed + 1;
+	consumed = 0;
+	if (sscanf(arg, "%d%n", second, &consumed) != 1 || arg[consumed] != '\0') return 1;
+
+	return 0;
+}
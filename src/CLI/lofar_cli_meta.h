@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <glob.h>
 
 // XOPEN -> strptime requirement
 #define __USE_XOPEN
@@ -8,6 +9,10 @@
 
 #include "lofar_udp_reader.h"
 #include "lofar_udp_misc.h"
+#include "lofar_udp_writer.h"
+#include "lofar_udp_metrics.h"
+#include "lofar_udp_tuning.h"
+#include "lofar_udp_sigproc.h"
 
 #ifndef __LOFAR_CLI_META
 #define __LOFAR_CLI_META
@@ -18,6 +23,8 @@ void processingModes(void);
 long getStartingPacket(char inputTime[], const int clock200MHz);
 long getSecondsToPacket(float seconds, const int clock200MHz);
 void getStartTimeString(lofar_udp_reader *reader, char stringBuff[]);
+int isNamedPipe(const char *path);
+int parseIntPair(const char *arg, int *first, int *second);
 
 // Exit reasons, 0, 1 aren't handled, only defined up to 3
 extern const char exitReasons[4][1024];
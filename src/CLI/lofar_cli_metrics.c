@@ -0,0 +1,177 @@
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+
+#include "lofar_udp_metrics.h"
+
+// Buffer for the Prometheus text output
+#define METRICS_TEXT_LENGTH 65536
+
+void helpMessages() {
+	printf("LOFAR UDP Live metrics printer (v%.1f)\n\n", VERSIONCLI);
+	printf("Usage: ./lofar_udp_metrics <flags>");
+
+	printf("\n\n");
+
+	printf("-n: <name>		Shared memory name the extractor was given with -M (default: '/lofar_udp_metrics')\n");
+	printf("-i: <seconds>	Interval between updates (default: 1.0)\n");
+	printf("-c: <count>		Number of updates to print before exiting (default: 0 === until the extractor exits)\n");
+	printf("-p:		Print the metrics in the Prometheus text format rather than as a table of rates (default: False)\n");
+
+}
+
+
+/**
+ * @brief      Print a line of rates between two metrics snapshots
+ *
+ * @param[in]  prev  The previous snapshot
+ * @param[in]  curr  The current snapshot
+ */
+void printRates(const lofar_udp_metrics_page *prev, const lofar_udp_metrics_page *curr) {
+	const lofar_udp_reader_stats *p = &(prev->stats), *c = &(curr->stats);
+	const double wall = curr->updateTime - prev->updateTime;
+	long dropped = 0, droppedPrev = 0;
+
+	if (wall <= 0.) return;
+
+	for (int port = 0; port < curr->numPorts && port < MAX_NUM_PORTS; port++) {
+		dropped += c->portPacketsDropped[port];
+		droppedPrev += p->portPacketsDropped[port];
+	}
+
+	#define STAGE_UTIL(stage) (100. * (c->stage.totalTime - p->stage.totalTime) / wall)
+	printf("%10ld\t%8.3lf\t%8.3lf\t%8.3lf\t%10.0lf\t%8.4lf\t%6.1lf\t%6.1lf\t%6.1lf\t%6.1lf\t%6.1lf\t%6.1lf\t%6ld\n",
+		c->gulpsProcessed,
+		(double) (c->bytesRead - p->bytesRead) / wall / 1e9,
+		(double) (c->bytesDecompressed - p->bytesDecompressed) / wall / 1e9,
+		(double) (c->bytesWritten - p->bytesWritten) / wall / 1e9,
+		(double) (curr->packetsRead - prev->packetsRead) * curr->numPorts / wall,
+		(curr->packetsRead - prev->packetsRead) > 0 ? 100. * (double) (dropped - droppedPrev) / (double) ((curr->packetsRead - prev->packetsRead) * curr->numPorts) : 0.,
+		STAGE_UTIL(readStep), STAGE_UTIL(portRead), STAGE_UTIL(kernel), STAGE_UTIL(calibration), STAGE_UTIL(write), STAGE_UTIL(writeWait),
+		c->gulpsProcessed - c->write.calls);
+	#undef STAGE_UTIL
+	fflush(stdout);
+}
+
+
+int main(int argc, char *argv[]) {
+
+	// Set up input local variables
+	int inputOpt, prometheus = 0, returnVal = 0;
+	char name[256] = "/lofar_udp_metrics";
+	double interval = 1.0;
+	long count = 0, printed = 0;
+
+	lofar_udp_metrics *metrics;
+	lofar_udp_metrics_page prev, curr;
+	char *text;
+
+
+	// Standard ugly input flags parser
+	while((inputOpt = getopt(argc, argv, "phn:i:c:")) != -1) {
+		switch(inputOpt) {
+
+			case 'n':
+				if (strlen(optarg) >= 255) {
+					fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", optarg);
+					return 1;
+				}
+				strcpy(name, optarg);
+				break;
+
+			case 'i':
+				interval = atof(optarg);
+				break;
+
+			case 'c':
+				count = atol(optarg);
+				break;
+
+			case 'p':
+				prometheus = 1;
+				break;
+
+
+			// Silence GCC warnings, fall-through is the desired behaviour
+			#pragma GCC diagnostic push
+			#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+			#pragma GCC diagnostic push
+
+			// Handle edge/error cases
+			case '?':
+				if ((optopt == 'n') || (optopt == 'i') || (optopt == 'c')) {
+					fprintf(stderr, "Option '%c' requires an argument.\n", optopt);
+				} else {
+					fprintf(stderr, "Option '%c' is unknown or encountered an error.\n", optopt);
+				}
+
+			case 'h':
+			default:
+
+			#pragma GCC diagnostic pop
+
+				helpMessages();
+				return 1;
+
+		}
+	}
+
+	if (interval <= 0. || count < 0) {
+		fprintf(stderr, "One or more inputs invalid or not fully initialised, exiting.\n");
+		helpMessages();
+		return 1;
+	}
+
+	if ((metrics = lofar_udp_metrics_attach(name)) == NULL) {
+		return 1;
+	}
+
+	text = calloc(METRICS_TEXT_LENGTH, sizeof(char));
+	if (text == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for metrics output, exiting.\n");
+		lofar_udp_metrics_detach(metrics);
+		return 1;
+	}
+
+	if (lofar_udp_metrics_read(metrics, &prev) < 0) {
+		fprintf(stderr, "ERROR: Unable to take a consistent snapshot of %s, exiting.\n", name);
+		returnVal = 1;
+	} else if (!prometheus) {
+		printf("Process %d: %d ports, mode %d, %d threads, %ld packets per gulp\n", prev.pid, prev.numPorts, prev.processingMode, prev.ompThreads, prev.packetsPerIteration);
+		printf("#    gulps\tread GB/s\tdcmp GB/s\twrit GB/s\t  packets/s\t  loss %%\tread%%\tport%%\tkern%%\tcal%%\twrit%%\twait%%\tbacklog\n");
+	}
+
+	while (!returnVal && (count == 0 || printed < count)) {
+		usleep((useconds_t) (interval * 1e6));
+
+		if (lofar_udp_metrics_read(metrics, &curr) < 0) {
+			fprintf(stderr, "ERROR: Unable to take a consistent snapshot of %s, exiting.\n", name);
+			returnVal = 1;
+			break;
+		}
+
+		if (prometheus) {
+			if (lofar_udp_metrics_prometheus(&curr, text, METRICS_TEXT_LENGTH) < 0) {
+				fprintf(stderr, "ERROR: Metrics output exceeded %d characters, exiting.\n", METRICS_TEXT_LENGTH);
+				returnVal = 1;
+				break;
+			}
+			printf("%s\n", text);
+			fflush(stdout);
+		} else if (curr.sequence != prev.sequence) {
+			printRates(&prev, &curr);
+		}
+		printed++;
+
+		// The page is unlinked when the extractor exits; stop once it stops updating and has gone away
+		if (curr.sequence == prev.sequence && kill(curr.pid, 0) != 0) {
+			break;
+		}
+		prev = curr;
+	}
+
+	free(text);
+	lofar_udp_metrics_detach(metrics);
+
+	return returnVal;
+}
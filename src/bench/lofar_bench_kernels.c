@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <omp.h>
+
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+#include "lofar_udp_vdif.h"
+
+// lofar_udp_backends.hpp defines its helpers in any C file that includes it, so only lofar_udp_reader.c may; take
+// 	what we need from it here
+int lofar_udp_cpp_loop_interface(lofar_udp_meta *meta);
+
+// Every processing mode the kernels support
+static const int benchModes[] = { 0, 1, 2, 10, 11, 20, 21, 30, 31, 32, 40, 41, 42,
+								 100, 101, 102, 103, 104, 110, 111, 112, 113, 114,
+								 120, 121, 122, 123, 124, 130, 131, 132, 133, 134,
+								 150, 151, 152, 153, 154, 160, 161, 162, 163, 164 };
+#define NUM_BENCH_MODES ((int) (sizeof(benchModes) / sizeof(benchModes[0])))
+
+// Synthetic observation parameters: a 200MHz clock observation from IE613, starting at 2021-01-01T00:00:00
+#define BENCH_TIMESTAMP 1609459200u
+#define BENCH_STATION_RSP (214 * 32)
+
+// Maximum number of values accepted in each list argument
+#define BENCH_MAX_LIST 16
+
+
+void helpMessages() {
+	printf("LOFAR UDP kernel benchmark (v%.1f)\n\n", VERSIONCLI);
+	printf("Usage: ./lofar_bench_kernels <flags>");
+
+	printf("\n\n");
+
+	printf("-p: <modes>		Comma separated processing modes to benchmark (default: all)\n");
+	printf("-b: <bits>		Comma separated input bit modes to benchmark (default: 4,8,16)\n");
+	printf("-n: <beamlets>	Comma separated beamlets per port (default: 0 === the standard count for each bit mode, 244/122/61)\n");
+	printf("-c: <cal>		Calibration: 0 disabled, 1 enabled, 2 both (default: 2)\n");
+	printf("-t: <threads>	Comma separated OpenMP thread counts (default: 1,2,4,...,%d)\n", OMP_THREADS);
+	printf("-u: <numPort>	Number of ports to synthesise (default: 4)\n");
+	printf("-m: <numPack>	Number of packets per port in each iteration (default: 4096)\n");
+	printf("-r: <repeats>	Number of timed iterations for each configuration, the fastest is reported (default: 5)\n");
+	printf("-P:		Add hardware counter columns, averaged over the timed iterations (cycles/packet, IPC, LLC miss %%, estimated memory GB/s; -1 when unavailable) (default: False)\n");
+	printf("\nResults are printed as tab separated columns on stdout (mode, bits, calibration, beamlets, threads, seconds, input GB/s, packets/s).\n");
+}
+
+
+/**
+ * @brief      Parse a comma separated list of integers
+ *
+ * @param[in]  str     The input string
+ * @param      values  The output array (BENCH_MAX_LIST elements)
+ *
+ * @return     The number of values parsed
+ */
+static int parseList(const char *str, int values[BENCH_MAX_LIST]) {
+	int count = 0;
+	const char *ptr = str;
+	char *end;
+
+	while (*ptr != '\0' && count < BENCH_MAX_LIST) {
+		values[count++] = (int) strtol(ptr, &end, 10);
+		if (end == ptr) return -1;
+		ptr = (*end == ',') ? end + 1 : end;
+	}
+
+	return count;
+}
+
+
+/**
+ * @brief      Fill a port's input buffer with sequential packets of
+ *             pseudo-random samples
+ *
+ * @param      packets   The packet buffer
+ * @param[in]  numPackets  The number of packets
+ * @param[in]  bitMode   The input bit mode
+ * @param[in]  beamlets  The number of beamlets per packet
+ * @param[in]  packetLength  The length of each packet
+ * @param[in]  seed      The random seed for the port
+ */
+static void synthesisePackets(char *packets, const long numPackets, const int bitMode, const int beamlets, const int packetLength, unsigned int seed) {
+	lofar_source_bytes source = { .rsp = 0, .padding0 = 0, .errorBit = 0, .clockBit = 1, .bitMode = (bitMode == 16) ? 0 : ((bitMode == 8) ? 1 : 2), .padding1 = 0 };
+	const short stationRsp = BENCH_STATION_RSP;
+	const unsigned int timestamp = BENCH_TIMESTAMP;
+
+	for (long packet = 0; packet < numPackets; packet++) {
+		char *header = &(packets[packet * packetLength]);
+		// Sequences advance by 16 samples per packet, so that packet numbers are sequential
+		const unsigned int sequence = 16 * (unsigned int) packet;
+
+		header[0] = UDPCURVER;
+		memcpy(&(header[1]), &source, sizeof(source));
+		header[3] = 0;
+		memcpy(&(header[4]), &stationRsp, sizeof(short));
+		header[6] = (char) beamlets;
+		header[7] = UDPNTIMESLICE;
+		memcpy(&(header[8]), &timestamp, sizeof(unsigned int));
+		memcpy(&(header[12]), &sequence, sizeof(unsigned int));
+
+		for (int idx = UDPHDRLEN; idx < packetLength; idx++) {
+			seed = seed * 1103515245u + 12345u;
+			header[idx] = (char) (seed >> 16);
+		}
+	}
+}
+
+
+/**
+ * @brief      Build a meta struct for a synthetic observation, using the same
+ *             header parsing and processing setup as the file reader
+ *
+ * @param      meta                 The lofar_udp_meta to initialise
+ * @param[in]  numPorts             The number of ports
+ * @param[in]  bitMode              The input bit mode
+ * @param[in]  beamlets             The beamlets per port
+ * @param[in]  processingMode       The processing mode
+ * @param[in]  calibrateData        Enable calibration (identity Jones
+ *                                  matrices)
+ * @param[in]  packetsPerIteration  The packets per iteration
+ *
+ * @return     0: Success, 1: Fatal error, -1: Unsupported configuration
+ */
+static int setupMeta(lofar_udp_meta *meta, const int numPorts, const int bitMode, const int beamlets, const int processingMode, const int calibrateData, const long packetsPerIteration) {
+	char headers[MAX_NUM_PORTS][UDPHDRLEN];
+	const int beamletLimits[2] = { 0, 0 };
+	const int packetLength = UDPHDRLEN + beamlets * UDPNTIMESLICE * UDPNPOL * bitMode / 8;
+
+	*meta = lofar_udp_meta_default;
+
+	// Modes 0, 1 and 40-42 cannot be calibrated
+	if (calibrateData && (processingMode < 2 || (processingMode >= 40 && processingMode <= 42))) return -1;
+
+	meta->numPorts = numPorts;
+	meta->processingMode = processingMode;
+	meta->calibrateData = calibrateData;
+	meta->packetsPerIteration = packetsPerIteration;
+	meta->packetsReadMax = LONG_MAX;
+
+	for (int port = 0; port < numPorts; port++) {
+		synthesisePackets(headers[port], 1, bitMode, beamlets, UDPHDRLEN, 0);
+	}
+
+	if (lofar_udp_parse_headers(meta, headers, beamletLimits) > 0) return 1;
+	if (lofar_udp_setup_processing(meta) > 0) return 1;
+
+	for (int port = 0; port < numPorts; port++) {
+		// As in the reader, leave space for 2 packets before the head pointer for padding
+		meta->inputData[port] = calloc(packetLength * (packetsPerIteration + 2), sizeof(char));
+		if (meta->inputData[port] == NULL) return 1;
+		meta->inputData[port] += 2 * packetLength;
+		synthesisePackets(meta->inputData[port], packetsPerIteration, bitMode, beamlets, packetLength, 0x5eed + port);
+	}
+	meta->lastPacket = lofar_get_packet_number(meta->inputData[0]) - 1;
+
+	for (int out = 0; out < meta->numOutputs; out++) {
+		meta->outputData[out] = calloc(meta->packetOutputLength[out] * packetsPerIteration, sizeof(char));
+		if (meta->outputData[out] == NULL) return 1;
+	}
+
+	if (calibrateData) {
+		meta->jonesMatrices = calloc(1, sizeof(float*));
+		if (meta->jonesMatrices == NULL) return 1;
+		meta->jonesMatrices[0] = calloc(meta->totalProcBeamlets * JONESMATSIZE, sizeof(float));
+		if (meta->jonesMatrices[0] == NULL) return 1;
+		for (int beamlet = 0; beamlet < meta->totalProcBeamlets; beamlet++) {
+			meta->jonesMatrices[0][beamlet * JONESMATSIZE + 0] = 1.0f;
+			meta->jonesMatrices[0][beamlet * JONESMATSIZE + 6] = 1.0f;
+		}
+	}
+
+	if (meta->vdifChannels > 0 && lofar_udp_vdif_setup(meta) > 0) return 1;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Free the buffers allocated by setupMeta
+ *
+ * @param      meta  The lofar_udp_meta
+ */
+static void cleanupMeta(lofar_udp_meta *meta) {
+	for (int port = 0; port < meta->numPorts; port++) {
+		if (meta->inputData[port] != NULL) free(meta->inputData[port] - 2 * meta->portPacketLength[port]);
+	}
+
+	for (int out = 0; out < meta->numOutputs; out++) {
+		free(meta->outputData[out]);
+	}
+
+	if (meta->jonesMatrices != NULL) {
+		free(meta->jonesMatrices[0]);
+		free(meta->jonesMatrices);
+	}
+
+	free(meta->vdifScales);
+	*meta = lofar_udp_meta_default;
+}
+
+
+/**
+ * @brief      Time the processing kernel on the synthesised gulp
+ *
+ * @param      meta      The lofar_udp_meta
+ * @param[in]  repeats   The number of timed iterations
+ * @param[in]  perf      Hardware counters to read around each timed iteration (may be NULL)
+ * @param[out] counters  The counters summed over the timed iterations
+ * @param[out] total     The summed time of the timed iterations
+ *
+ * @return     The fastest iteration in seconds, or -1 on error
+ */
+static double timeKernel(lofar_udp_meta *meta, const int repeats, const lofar_udp_perf *perf, lofar_udp_perf_counters *counters, double *total) {
+	struct timespec tick, tock;
+	double best = -1.0, current;
+	const long lastPacket = meta->lastPacket;
+	lofar_udp_perf_counters perfStart, perfEnd;
+
+	lofar_udp_perf_reset(perf, counters);
+	*total = 0.0;
+
+	// One untimed iteration to fault in the output buffers
+	for (int iter = -1; iter < repeats; iter++) {
+		meta->lastPacket = lastPacket;
+		meta->calibrationStep = 0;
+		meta->inputDataReady = 1;
+		meta->outputDataReady = 0;
+
+		if (perf != NULL) lofar_udp_perf_read(perf, &perfStart);
+		CLICK(tick);
+		if (lofar_udp_cpp_loop_interface(meta) != 0) {
+			fprintf(stderr, "ERROR: Processing mode %d did not process the synthetic data cleanly, exiting.\n", meta->processingMode);
+			return -1.0;
+		}
+		CLICK(tock);
+		if (perf != NULL) lofar_udp_perf_read(perf, &perfEnd);
+
+		current = TICKTOCK(tick, tock);
+		if (iter >= 0) {
+			if (best < 0.0 || current < best) best = current;
+			if (perf != NULL) lofar_udp_perf_accumulate(counters, &perfStart, &perfEnd);
+			*total += current;
+		}
+	}
+
+	// Leave the meta ready for the next thread count
+	meta->lastPacket = lastPacket;
+	return best;
+}
+
+
+int main(int argc, char *argv[]) {
+	int modes[BENCH_MAX_LIST * 4], bitModes[BENCH_MAX_LIST] = { 4, 8, 16 }, beamletCounts[BENCH_MAX_LIST] = { 0 }, threads[BENCH_MAX_LIST];
+	int numModes = NUM_BENCH_MODES, numBitModes = 3, numBeamletCounts = 1, numThreads = 0;
+	int calibration = 2, numPorts = 4, repeats = 5, inputOpt, returnVal, perfCounters = 0;
+	long packetsPerIteration = 4096;
+	lofar_udp_meta meta = lofar_udp_meta_default;
+	lofar_udp_perf *perf = NULL;
+	lofar_udp_perf_counters counters;
+	double totalSeconds;
+
+	memcpy(modes, benchModes, sizeof(benchModes));
+	for (int count = 1; count <= OMP_THREADS; count *= 2) threads[numThreads++] = count;
+
+	while ((inputOpt = getopt(argc, argv, "p:b:n:c:t:u:m:r:Ph")) != -1) {
+		switch (inputOpt) {
+			case 'p':
+				numModes = parseList(optarg, modes);
+				break;
+
+			case 'b':
+				numBitModes = parseList(optarg, bitModes);
+				break;
+
+			case 'n':
+				numBeamletCounts = parseList(optarg, beamletCounts);
+				break;
+
+			case 'c':
+				calibration = atoi(optarg);
+				break;
+
+			case 't':
+				numThreads = parseList(optarg, threads);
+				break;
+
+			case 'u':
+				numPorts = atoi(optarg);
+				break;
+
+			case 'm':
+				packetsPerIteration = atol(optarg);
+				break;
+
+			case 'r':
+				repeats = atoi(optarg);
+				break;
+
+			case 'P':
+				perfCounters = 1;
+				break;
+
+			case 'h':
+				helpMessages();
+				return 0;
+
+			default:
+				helpMessages();
+				return 1;
+		}
+	}
+
+	if (numModes < 1 || numBitModes < 1 || numBeamletCounts < 1 || numThreads < 1) {
+		fprintf(stderr, "ERROR: Unable to parse a list argument, exiting.\n");
+		return 1;
+	}
+
+	if (numPorts < 1 || numPorts > MAX_NUM_PORTS || packetsPerIteration < 1 || repeats < 1 || calibration < 0 || calibration > 2) {
+		fprintf(stderr, "ERROR: Invalid ports (%d), packets (%ld), repeats (%d) or calibration (%d) value, exiting.\n", numPorts, packetsPerIteration, repeats, calibration);
+		return 1;
+	}
+
+	for (int idx = 0; idx < numThreads; idx++) {
+		// The 4-bit kernels allocate a workspace per thread, up to the compile time limit
+		if (threads[idx] < 1 || threads[idx] > OMP_THREADS) {
+			fprintf(stderr, "ERROR: Thread counts must be between 1 and %d (%d requested), exiting.\n", OMP_THREADS, threads[idx]);
+			return 1;
+		}
+	}
+
+	// Open the counters before the first parallel region, so the OpenMP threads inherit them
+	if (perfCounters && (perf = lofar_udp_perf_setup()) == NULL) {
+		fprintf(stderr, "WARNING: No performance counters are available, their columns will be -1.\n");
+	}
+
+	printf("# mode\tbits\tcal\tbeamlets\tthreads\tseconds\tGB/s\tpackets/s%s\n", perfCounters ? "\tcycles/packet\tIPC\tLLC miss %\tmemory GB/s\tCPU s/s" : "");
+	for (int bitIdx = 0; bitIdx < numBitModes; bitIdx++) {
+		for (int beamletIdx = 0; beamletIdx < numBeamletCounts; beamletIdx++) {
+			const int beamlets = beamletCounts[beamletIdx] > 0 ? beamletCounts[beamletIdx] : (976 / bitModes[bitIdx]);
+
+			if (beamlets > UDPMAXBEAM || (bitModes[bitIdx] != 4 && bitModes[bitIdx] != 8 && bitModes[bitIdx] != 16)) {
+				fprintf(stderr, "ERROR: Unsupported bit mode (%d) or beamlet count (%d), exiting.\n", bitModes[bitIdx], beamlets);
+				return 1;
+			}
+
+			for (int modeIdx = 0; modeIdx < numModes; modeIdx++) {
+				for (int cal = (calibration == 1); cal <= (calibration > 0); cal++) {
+					returnVal = setupMeta(&meta, numPorts, bitModes[bitIdx], beamlets, modes[modeIdx], cal, packetsPerIteration);
+					if (returnVal != 0) {
+						cleanupMeta(&meta);
+						if (returnVal > 0) {
+							fprintf(stderr, "ERROR: Failed to set up processing mode %d, exiting.\n", modes[modeIdx]);
+							return 1;
+						}
+						continue;
+					}
+
+					const double inputBytes = (double) packetsPerIteration * meta.portPacketLength[0] * numPorts;
+					const double packets = (double) packetsPerIteration * numPorts;
+
+					for (int threadIdx = 0; threadIdx < numThreads; threadIdx++) {
+						omp_set_num_threads(threads[threadIdx]);
+
+						const double seconds = timeKernel(&meta, repeats, perf, &counters, &totalSeconds);
+						if (seconds < 0.0) {
+							cleanupMeta(&meta);
+							lofar_udp_perf_cleanup(perf);
+							return 1;
+						}
+
+						printf("%d\t%d\t%d\t%d\t%d\t%.6lf\t%.3lf\t%.0lf", modes[modeIdx], bitModes[bitIdx], cal, beamlets, threads[threadIdx], seconds, inputBytes / seconds / 1e9, packets / seconds);
+						if (perfCounters) {
+							const long *count = counters.count;
+							printf("\t%.1lf\t%.2lf\t%.2lf\t%.3lf\t%.2lf",
+								count[PERF_CYCLES] >= 0 ? (double) count[PERF_CYCLES] / (packets * repeats) : -1.,
+								count[PERF_CYCLES] > 0 && count[PERF_INSTRUCTIONS] >= 0 ? (double) count[PERF_INSTRUCTIONS] / (double) count[PERF_CYCLES] : -1.,
+								count[PERF_LLC_REFERENCES] > 0 && count[PERF_LLC_MISSES] >= 0 ? 100. * (double) count[PERF_LLC_MISSES] / (double) count[PERF_LLC_REFERENCES] : -1.,
+								count[PERF_LLC_MISSES] >= 0 ? (double) count[PERF_LLC_MISSES] * PERF_CACHE_LINE / totalSeconds / 1e9 : -1.,
+								count[PERF_TASK_CLOCK] >= 0 ? (double) count[PERF_TASK_CLOCK] / 1e9 / totalSeconds : -1.);
+						}
+						printf("\n");
+						fflush(stdout);
+					}
+
+					cleanupMeta(&meta);
+				}
+			}
+		}
+	}
+
+	lofar_udp_perf_cleanup(perf);
+	return 0;
+}
@@ -0,0 +1,426 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <omp.h>
+
+#include "lofar_udp_reader.h"
+#include "lofar_udp_generator.h"
+
+// Maximum number of values accepted in each list argument
+#define BENCH_MAX_LIST 16
+
+// Benchmark stages: the raw reads alone, or the full read step (reads + remainder shifts)
+#define BENCH_STAGE_NCHARS 0
+#define BENCH_STAGE_READ_STEP 1
+
+
+void helpMessages() {
+	printf("LOFAR UDP reader I/O benchmark (v%.1f)\n\n", VERSIONCLI);
+	printf("Usage: ./lofar_bench_reader <flags>");
+
+	printf("\n\n");
+
+	printf("-u: <numPorts>	Comma separated port counts to benchmark (default: 1,4)\n");
+	printf("-m: <numPack>	Comma separated packets per iteration (default: 512,2048,8192)\n");
+	printf("-z: <levels>	Comma separated zstd levels of the synthetic captures, 0 uses the uncompressed reader (default: 0,3)\n");
+	printf("-t: <threads>	Comma separated OpenMP thread counts (default: 1,2,4,...,%d)\n", OMP_THREADS);
+	printf("-s: <stage>		Stage to time: 0 lofar_udp_reader_nchars, 1 lofar_udp_reader_read_step, 2 both (default: 2)\n");
+	printf("-n: <numPack>	Number of packets per port in the synthetic captures (default: 16384)\n");
+	printf("-l: <bits>		Bit mode of the synthetic captures (default: 8)\n");
+	printf("-d: <dir>		Directory to write the synthetic captures to (default: /tmp)\n");
+	printf("-r: <repeats>	Number of timed runs for each configuration, the fastest is reported (default: 3)\n");
+	printf("-c:		Evict the captures from the page cache before each run, rather than timing warm reads (default: False)\n");
+	printf("-k:		Keep the synthetic captures after the benchmark (default: False)\n");
+	printf("\nResults are printed as tab separated columns on stdout (stage, zstd level, ports, packets per iteration, threads, gulps, seconds, decompressed GB/s, read syscalls per gulp, page faults per gulp, MB read from disk).\n");
+}
+
+
+/**
+ * @brief      Parse a comma separated list of integers
+ *
+ * @param[in]  str     The input string
+ * @param      values  The output array (BENCH_MAX_LIST elements)
+ *
+ * @return     The number of values parsed
+ */
+static int parseList(const char *str, int values[BENCH_MAX_LIST]) {
+	int count = 0;
+	const char *ptr = str;
+	char *end;
+
+	while (*ptr != '\0' && count < BENCH_MAX_LIST) {
+		values[count++] = (int) strtol(ptr, &end, 10);
+		if (end == ptr) return -1;
+		ptr = (*end == ',') ? end + 1 : end;
+	}
+
+	return count;
+}
+
+
+// I/O counters sampled around each run
+typedef struct bench_counters {
+	long syscr;
+	long readBytes;
+	long faults;
+} bench_counters;
+
+
+/**
+ * @brief      Sample the process' read syscall and disk read counters from
+ *             /proc/self/io, and its page fault counters
+ *
+ * @param      counters  The output counters (-1 if /proc/self/io is
+ *                       unavailable)
+ */
+static void sampleCounters(bench_counters *counters) {
+	char key[64];
+	long value;
+	struct rusage usage;
+	FILE *ioFile;
+
+	counters->syscr = -1;
+	counters->readBytes = -1;
+	if ((ioFile = fopen("/proc/self/io", "r")) != NULL) {
+		while (fscanf(ioFile, "%63s %ld", key, &value) == 2) {
+			if (strcmp(key, "syscr:") == 0) counters->syscr = value;
+			else if (strcmp(key, "read_bytes:") == 0) counters->readBytes = value;
+		}
+		fclose(ioFile);
+	}
+
+	getrusage(RUSAGE_SELF, &usage);
+	counters->faults = usage.ru_minflt + usage.ru_majflt;
+}
+
+
+/**
+ * @brief      Write a synthetic capture for the largest port count
+ *
+ * @param[in]  format            The output file name format
+ * @param[in]  numPorts          The number of ports
+ * @param[in]  numPackets        The number of packets per port
+ * @param[in]  bitMode           The bit mode
+ * @param[in]  compressionLevel  The zstd level (0: uncompressed)
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int writeCapture(const char *format, const int numPorts, const long numPackets, const int bitMode, const int compressionLevel) {
+	lofar_udp_generator_config config = lofar_udp_generator_config_default;
+	lofar_udp_generator *generator;
+	FILE *outputFiles[MAX_NUM_PORTS] = { NULL };
+	char workingString[2048];
+	int returnVal = 0;
+
+	config.numPorts = numPorts;
+	config.numPackets = numPackets;
+	config.bitMode = bitMode;
+	config.compressionLevel = compressionLevel;
+
+	if ((generator = lofar_udp_generator_setup(&config)) == NULL) return 1;
+
+	for (int port = 0; port < numPorts; port++) {
+		snprintf(workingString, sizeof(workingString), format, port);
+		if ((outputFiles[port] = fopen(workingString, "wb")) == NULL) {
+			fprintf(stderr, "ERROR: Unable to create synthetic capture at %s, exiting.\n", workingString);
+			returnVal = 1;
+			break;
+		}
+	}
+
+	if (!returnVal) returnVal = lofar_udp_generator_write(generator, outputFiles);
+
+	for (int port = 0; port < numPorts; port++) {
+		if (outputFiles[port] != NULL && fclose(outputFiles[port]) != 0) returnVal = 1;
+	}
+	lofar_udp_generator_cleanup(generator);
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Read gulps with lofar_udp_reader_nchars alone, carrying any
+ *             decompressed overshoot to the start of the next gulp
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  gulps   The number of gulps to read
+ *
+ * @return     The number of bytes read, -1 on a short read
+ */
+static long runNchars(lofar_udp_reader *reader, const long gulps) {
+	lofar_udp_meta *meta = reader->meta;
+	long bytesRead = 0;
+	int shortRead = 0;
+
+	for (long gulp = 0; gulp < gulps && !shortRead; gulp++) {
+		#pragma omp parallel for reduction(+: bytesRead, shortRead)
+		for (int port = 0; port < meta->numPorts; port++) {
+			const long gulpLength = meta->packetsPerIteration * meta->portPacketLength[port];
+			const long offset = meta->inputDataOffset[port];
+			const long charsRead = lofar_udp_reader_nchars(reader, port, &(meta->inputData[port][offset]), gulpLength - offset, offset);
+
+			if (charsRead < gulpLength - offset) {
+				shortRead += 1;
+				continue;
+			}
+			bytesRead += charsRead;
+
+			// zstd may decompress past the request, keep the excess as the start of the next gulp
+			meta->inputDataOffset[port] = offset + charsRead - gulpLength;
+			if (meta->inputDataOffset[port] > 0) {
+				memmove(meta->inputData[port], &(meta->inputData[port][gulpLength]), meta->inputDataOffset[port]);
+			}
+		}
+	}
+
+	return shortRead ? -1 : bytesRead;
+}
+
+
+/**
+ * @brief      Read gulps with lofar_udp_reader_read_step, without processing
+ *             them
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  gulps   The number of gulps to read
+ *
+ * @return     The number of bytes read, -1 on error
+ */
+static long runReadStep(lofar_udp_reader *reader, const long gulps) {
+	lofar_udp_meta *meta = reader->meta;
+	long bytesRead = 0;
+
+	for (long gulp = 0; gulp < gulps; gulp++) {
+		if (lofar_udp_reader_read_step(reader) != 0) return -1;
+
+		for (int port = 0; port < meta->numPorts; port++) {
+			bytesRead += meta->packetsPerIteration * meta->portPacketLength[port];
+		}
+
+		// Mark the gulp as consumed, as lofar_udp_reader_step would
+		meta->packetsRead += meta->packetsPerIteration;
+		meta->inputDataReady = 0;
+	}
+
+	return bytesRead;
+}
+
+
+/**
+ * @brief      Time one configuration: open the capture, set up a mode 0
+ *             reader (which reads the first gulp) and time the remaining gulps
+ *
+ * @param[in]  format               The capture file name format
+ * @param[in]  stage                The stage to time
+ * @param[in]  compressionLevel     The capture's zstd level
+ * @param[in]  numPorts             The number of ports
+ * @param[in]  packetsPerIteration  The packets per iteration
+ * @param[in]  threads              The number of OpenMP threads
+ * @param[in]  gulps                The number of gulps to time
+ * @param[in]  cold                 Evict the capture from the page cache first
+ * @param      counters             The counter deltas of the run
+ *
+ * @return     The run time in seconds, or -1 on error
+ */
+static double timeReader(const char *format, const int stage, const int compressionLevel, const int numPorts, const long packetsPerIteration, const int threads, const long gulps, const int cold, bench_counters *counters) {
+	lofar_udp_config config = lofar_udp_config_default;
+	lofar_udp_reader *reader;
+	FILE *inputFiles[MAX_NUM_PORTS] = { NULL };
+	char workingString[2048];
+	bench_counters before, after;
+	struct timespec tick, tock;
+	long bytesRead;
+
+	for (int port = 0; port < numPorts; port++) {
+		snprintf(workingString, sizeof(workingString), format, port);
+		if ((inputFiles[port] = fopen(workingString, "rb")) == NULL) {
+			fprintf(stderr, "ERROR: Unable to open synthetic capture at %s, exiting.\n", workingString);
+			for (int idx = 0; idx < port; idx++) fclose(inputFiles[idx]);
+			return -1.0;
+		}
+		if (cold) posix_fadvise(fileno(inputFiles[port]), 0, 0, POSIX_FADV_DONTNEED);
+	}
+
+	config.inputFiles = inputFiles;
+	config.numPorts = numPorts;
+	config.processingMode = 0;
+	config.packetsPerIteration = packetsPerIteration;
+	config.readerType = compressionLevel ? ZSTDCOMPRESSED : NORMAL;
+	config.ompThreads = threads;
+
+	if ((reader = lofar_udp_meta_file_reader_setup_struct(&config)) == NULL) {
+		fprintf(stderr, "ERROR: Failed to set up a reader for the synthetic capture, exiting.\n");
+		return -1.0;
+	}
+
+	sampleCounters(&before);
+	CLICK(tick);
+	bytesRead = (stage == BENCH_STAGE_NCHARS) ? runNchars(reader, gulps) : runReadStep(reader, gulps);
+	CLICK(tock);
+	sampleCounters(&after);
+
+	lofar_udp_reader_cleanup(reader);
+
+	if (bytesRead < 0) {
+		fprintf(stderr, "ERROR: The reader did not return %ld full gulps of the synthetic capture, exiting.\n", gulps);
+		return -1.0;
+	}
+
+	counters->syscr = (before.syscr < 0) ? -1 : after.syscr - before.syscr;
+	counters->readBytes = (before.readBytes < 0) ? -1 : after.readBytes - before.readBytes;
+	counters->faults = after.faults - before.faults;
+
+	return TICKTOCK(tick, tock);
+}
+
+
+int main(int argc, char *argv[]) {
+	int ports[BENCH_MAX_LIST] = { 1, 4 }, packets[BENCH_MAX_LIST] = { 512, 2048, 8192 }, levels[BENCH_MAX_LIST] = { 0, 3 }, threads[BENCH_MAX_LIST];
+	int numPortCounts = 2, numPacketCounts = 3, numLevels = 2, numThreads = 0;
+	int stages = 2, bitMode = 8, repeats = 3, cold = 0, keep = 0, maxPorts = 0, inputOpt, returnVal = 0;
+	long capturePackets = 16384;
+	char directory[1024] = "/tmp", formats[BENCH_MAX_LIST][2048], workingString[2048];
+	bench_counters counters, bestCounters = { 0, 0, 0 };
+
+	for (int count = 1; count <= OMP_THREADS; count *= 2) threads[numThreads++] = count;
+
+	while ((inputOpt = getopt(argc, argv, "u:m:z:t:s:n:l:d:r:ckh")) != -1) {
+		switch (inputOpt) {
+			case 'u':
+				numPortCounts = parseList(optarg, ports);
+				break;
+
+			case 'm':
+				numPacketCounts = parseList(optarg, packets);
+				break;
+
+			case 'z':
+				numLevels = parseList(optarg, levels);
+				break;
+
+			case 't':
+				numThreads = parseList(optarg, threads);
+				break;
+
+			case 's':
+				stages = atoi(optarg);
+				break;
+
+			case 'n':
+				capturePackets = atol(optarg);
+				break;
+
+			case 'l':
+				bitMode = atoi(optarg);
+				break;
+
+			case 'd':
+				strncpy(directory, optarg, sizeof(directory) - 1);
+				break;
+
+			case 'r':
+				repeats = atoi(optarg);
+				break;
+
+			case 'c':
+				cold = 1;
+				break;
+
+			case 'k':
+				keep = 1;
+				break;
+
+			case 'h':
+				helpMessages();
+				return 0;
+
+			default:
+				helpMessages();
+				return 1;
+		}
+	}
+
+	if (numPortCounts < 1 || numPacketCounts < 1 || numLevels < 1 || numThreads < 1) {
+		fprintf(stderr, "ERROR: Unable to parse a list argument, exiting.\n");
+		return 1;
+	}
+
+	if (stages < 0 || stages > 2 || repeats < 1 || capturePackets < 1) {
+		fprintf(stderr, "ERROR: Invalid stage (%d), repeats (%d) or capture length (%ld), exiting.\n", stages, repeats, capturePackets);
+		return 1;
+	}
+
+	for (int idx = 0; idx < numPortCounts; idx++) {
+		if (ports[idx] < 1 || ports[idx] > MAX_NUM_PORTS) {
+			fprintf(stderr, "ERROR: Port counts must be between 1 and %d (%d requested), exiting.\n", MAX_NUM_PORTS, ports[idx]);
+			return 1;
+		}
+		if (ports[idx] > maxPorts) maxPorts = ports[idx];
+	}
+
+	// Write one capture per compression level, for the largest number of ports
+	for (int levelIdx = 0; levelIdx < numLevels; levelIdx++) {
+		snprintf(formats[levelIdx], sizeof(formats[levelIdx]), "%s/lofar_bench_reader_z%d_%%d%s", directory, levels[levelIdx], levels[levelIdx] ? ".zst" : "");
+		fprintf(stderr, "Writing %d port synthetic capture to %s\n", maxPorts, formats[levelIdx]);
+		if (writeCapture(formats[levelIdx], maxPorts, capturePackets, bitMode, levels[levelIdx]) > 0) {
+			numLevels = levelIdx + 1;
+			returnVal = 1;
+			break;
+		}
+	}
+
+	if (!returnVal) printf("# stage\tzstd\tports\tpackets\tthreads\tgulps\tseconds\tGB/s\tsyscalls/gulp\tfaults/gulp\tdiskMB\n");
+	for (int levelIdx = 0; levelIdx < numLevels && !returnVal; levelIdx++) {
+		for (int portIdx = 0; portIdx < numPortCounts && !returnVal; portIdx++) {
+			for (int packetIdx = 0; packetIdx < numPacketCounts && !returnVal; packetIdx++) {
+				// The reader consumes the first gulp during setup, and may skip packets while aligning the ports
+				const long gulps = capturePackets / packets[packetIdx] - 2;
+				if (packets[packetIdx] < 2 || gulps < 1) {
+					fprintf(stderr, "WARNING: The capture is too short for %d packets per iteration, skipping.\n", packets[packetIdx]);
+					continue;
+				}
+
+				for (int threadIdx = 0; threadIdx < numThreads && !returnVal; threadIdx++) {
+					for (int stage = BENCH_STAGE_NCHARS; stage <= BENCH_STAGE_READ_STEP && !returnVal; stage++) {
+						if (stages != 2 && stage != stages) continue;
+
+						double best = -1.0, seconds;
+						for (int iter = 0; iter < repeats; iter++) {
+							seconds = timeReader(formats[levelIdx], stage, levels[levelIdx], ports[portIdx], packets[packetIdx], threads[threadIdx], gulps, cold, &counters);
+							if (seconds < 0.0) {
+								returnVal = 1;
+								break;
+							}
+							if (best < 0.0 || seconds < best) {
+								best = seconds;
+								bestCounters = counters;
+							}
+						}
+						if (returnVal) break;
+
+						const double bytes = (double) gulps * packets[packetIdx] * ports[portIdx] * (UDPHDRLEN + (976 / bitMode) * UDPNTIMESLICE * UDPNPOL * bitMode / 8);
+						printf("%s\t%d\t%d\t%d\t%d\t%ld\t%.6lf\t%.3lf\t%.2lf\t%.2lf\t%.1lf\n", (stage == BENCH_STAGE_NCHARS) ? "nchars" : "read_step", levels[levelIdx], ports[portIdx], packets[packetIdx], threads[threadIdx], gulps, best, bytes / best / 1e9,
+								(bestCounters.syscr < 0) ? -1.0 : (double) bestCounters.syscr / gulps, (double) bestCounters.faults / gulps, (bestCounters.readBytes < 0) ? -1.0 : (double) bestCounters.readBytes / 1e6);
+						fflush(stdout);
+					}
+				}
+			}
+		}
+	}
+
+	if (!keep) {
+		for (int levelIdx = 0; levelIdx < numLevels; levelIdx++) {
+			for (int port = 0; port < maxPorts; port++) {
+				snprintf(workingString, sizeof(workingString), formats[levelIdx], port);
+				remove(workingString);
+			}
+		}
+	}
+
+	return returnVal;
+}
@@ -433,6 +433,16 @@ int lofar_udp_cpp_loop_interface(lofar_udp_meta *meta) {
 			
 
 
+			// VDIF modes
+			} else if (processingMode == 40) {
+				return lofar_udp_raw_loop<signed char, char, 4040, 0>(meta);
+			} else if (processingMode == 41) {
+				return lofar_udp_raw_loop<signed char, char, 4041, 0>(meta);
+			} else if (processingMode == 42) {
+				return lofar_udp_raw_loop<signed char, char, 4042, 0>(meta);
+			
+
+
 			// Non-decimated Stokes
 			} else if (processingMode == 100) {
 				return lofar_udp_raw_loop<signed char, float, 4100, 0>(meta);
@@ -556,6 +566,16 @@ int lofar_udp_cpp_loop_interface(lofar_udp_meta *meta) {
 			
 
 
+			// VDIF modes
+			} else if (processingMode == 40) {
+				return lofar_udp_raw_loop<signed char, char, 40, 0>(meta);
+			} else if (processingMode == 41) {
+				return lofar_udp_raw_loop<signed char, char, 41, 0>(meta);
+			} else if (processingMode == 42) {
+				return lofar_udp_raw_loop<signed char, char, 42, 0>(meta);
+			
+
+
 			// Non-decimated Stokes
 			} else if (processingMode == 100) {
 				return lofar_udp_raw_loop<signed char, float, 100, 0>(meta);
@@ -680,6 +700,16 @@ int lofar_udp_cpp_loop_interface(lofar_udp_meta *meta) {
 			
 
 
+			// VDIF modes
+			} else if (processingMode == 40) {
+				return lofar_udp_raw_loop<signed short, char, 40, 0>(meta);
+			} else if (processingMode == 41) {
+				return lofar_udp_raw_loop<signed short, char, 41, 0>(meta);
+			} else if (processingMode == 42) {
+				return lofar_udp_raw_loop<signed short, char, 42, 0>(meta);
+			
+
+
 			// Non-decimated Stokes
 			} else if (processingMode == 100) {
 				return lofar_udp_raw_loop<signed short, float, 100, 0>(meta);
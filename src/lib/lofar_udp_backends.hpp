@@ -6,6 +6,7 @@ extern "C" {
 #endif
 	#include "lofar_udp_reader.h"
 	#include "lofar_udp_misc.h"
+	#include "lofar_udp_vdif.h"
 #ifdef __cplusplus
 }
 #endif
@@ -19,10 +20,6 @@ extern "C" {
 extern const char bitmodeConversion[256][2];
 #endif
 
-// Jones matrix size for calibration
-#define JONESMATSIZE 8
-
-
 #ifndef __LOFAR_UDP_VOLTAGE_MANIP
 #define __LOFAR_UDP_VOLTAGE_MANIP
 #ifdef __cplusplus
@@ -40,7 +37,8 @@ inline float stokesV(float Xr, float Xi, float Yr, float Yi);
 // Index calculation shorthands
 inline long input_offset_index(long lastInputPacketOffset, int beamlet, int timeStepSize);
 inline long frequency_major_index(long outputPacketOffset, int totalBeamlets, int beamlet, int baseBeamlet, int cumulativeBeamlets);
-inline long time_major_index(int beamlet, int baseBeamlet, int cumulativeBeamlets, long packetsPerIteration, long outputTimeIdx);
+inline long time_major_index(int beamlet, int baseBeamlet, int cumulativeBeamlets, long packetsPerIteration, long outputTimeIdx, int overlap);
+inline void vdif_packet_time(long packetNumber, int clockBit, long *second, long *frame);
 
 #ifdef __cplusplus
 }
@@ -135,11 +133,30 @@ inline long frequency_major_index(long outputPacketOffset, int totalBeamlets, in
  * @param[in]  cumulativeBeamlets   The cumulative beamlets
  * @param[in]  packetsPerIteration  The packets per iteration
  * @param[in]  outputTimeIdx        The output time index
+ * @param[in]  overlap              The number of samples carried over from the
+ *                                  previous gulp at the start of each channel
  *
  * @return     { description_of_the_return_value }
  */
-inline long time_major_index(int beamlet, int baseBeamlet, int cumulativeBeamlets, long packetsPerIteration, long outputTimeIdx) {
-	return (((beamlet - baseBeamlet + cumulativeBeamlets) * packetsPerIteration * UDPNTIMESLICE ) + outputTimeIdx);
+inline long time_major_index(int beamlet, int baseBeamlet, int cumulativeBeamlets, long packetsPerIteration, long outputTimeIdx, int overlap) {
+	return (((beamlet - baseBeamlet + cumulativeBeamlets) * (packetsPerIteration * UDPNTIMESLICE + overlap)) + overlap + outputTimeIdx);
+}
+
+/**
+ * @brief      Get the second and frame-within-second for a packet number, as
+ *             needed for VDIF headers. LOFAR does not have an integer number
+ *             of packets per second, frame 0 is the packet the given second
+ *             starts in.
+ *
+ * @param[in]  packetNumber  The packet number
+ * @param[in]  clockBit      The clock bit
+ * @param      second        The output Unix second
+ * @param      frame         The output frame number within the second
+ */
+inline void vdif_packet_time(long packetNumber, int clockBit, long *second, long *frame) {
+	// The second containing the packet's last sample
+	*second = lofar_get_sample_second((packetNumber + 1) * UDPNTIMESLICE - 1, (unsigned int) clockBit, NULL);
+	*frame = packetNumber - beamformed_packno((unsigned int) *second, 0, clockBit);
 }
 
 #endif
@@ -448,7 +465,7 @@ void inline udp_reversedChannelMajorSplitPols(long iLoop, char *inputPortData, O
 }
 
 template <typename I, typename O, const int calibrateData>
-void inline udp_timeMajor(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int baseBeamlet, float *jonesMatrix) {
+void inline udp_timeMajor(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int timeMajorOverlap, int baseBeamlet, float *jonesMatrix) {
 	long outputTimeIdx = iLoop * UDPNTIMESLICE / sizeof(O);
 	long tsInOffset, tsOutOffset;
 
@@ -468,7 +485,7 @@ void inline udp_timeMajor(long iLoop, char *inputPortData, O **outputData, long
 	#endif
 	for (int beamlet = baseBeamlet; beamlet < upperBeamlet; beamlet++) {
 		tsInOffset = input_offset_index(lastInputPacketOffset, beamlet, timeStepSize);
-		tsOutOffset = 4 * time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx);
+		tsOutOffset = 4 * time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx, timeMajorOverlap);
 
 		if constexpr (calibrateData) {
 			beamletJones = &(jonesMatrix[(beamlet - baseBeamlet) * JONESMATSIZE]);
@@ -496,7 +513,7 @@ void inline udp_timeMajor(long iLoop, char *inputPortData, O **outputData, long
 }
 
 template <typename I, typename O, const int calibrateData>
-void inline udp_timeMajorSplitPols(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int baseBeamlet, float *jonesMatrix) {
+void inline udp_timeMajorSplitPols(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int timeMajorOverlap, int baseBeamlet, float *jonesMatrix) {
 	long outputTimeIdx = iLoop * UDPNTIMESLICE / sizeof(O);
 	long tsInOffset, tsOutOffset;
 	
@@ -516,7 +533,7 @@ void inline udp_timeMajorSplitPols(long iLoop, char *inputPortData, O **outputDa
 	#endif
 	for (int beamlet = baseBeamlet; beamlet < upperBeamlet; beamlet++) {
 		tsInOffset = input_offset_index(lastInputPacketOffset, beamlet, timeStepSize);
-		tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx);
+		tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx, timeMajorOverlap);
 
 		if constexpr (calibrateData) {
 			beamletJones = &(jonesMatrix[(beamlet - baseBeamlet) * JONESMATSIZE]);
@@ -547,7 +564,7 @@ void inline udp_timeMajorSplitPols(long iLoop, char *inputPortData, O **outputDa
 
 // FFTW format
 template <typename I, typename O, const int calibrateData>
-void inline udp_timeMajorDualPols(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int baseBeamlet, float *jonesMatrix) {
+void inline udp_timeMajorDualPols(long iLoop, char *inputPortData, O **outputData, long lastInputPacketOffset, int timeStepSize, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int timeMajorOverlap, int baseBeamlet, float *jonesMatrix) {
 	long outputTimeIdx = iLoop * UDPNTIMESLICE / sizeof(O);
 	long tsInOffset, tsOutOffset;
 	
@@ -567,7 +584,7 @@ void inline udp_timeMajorDualPols(long iLoop, char *inputPortData, O **outputDat
 	#endif
 	for (int beamlet = baseBeamlet; beamlet < upperBeamlet; beamlet++) {
 		tsInOffset = input_offset_index(lastInputPacketOffset, beamlet, timeStepSize);
-		tsOutOffset = 2 * time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx);
+		tsOutOffset = 2 * time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputTimeIdx, timeMajorOverlap);
 	
 		if constexpr (calibrateData) {
 			beamletJones = &(jonesMatrix[(beamlet - baseBeamlet) * JONESMATSIZE]);
@@ -596,6 +613,81 @@ void inline udp_timeMajorDualPols(long iLoop, char *inputPortData, O **outputDat
 }
 
 
+// VDIF: Requantise a sample to an offset-binary code
+//	2-bit: thresholds at 0, +/- VDIF_2BIT_THRESHOLD sigma (scale = 1 / threshold)
+//	4/8-bit: uniform steps (scale = 1 when the input already fits)
+template <typename I, const int bits>
+inline unsigned int vdif_quantise(I sample, float scale) {
+	const float value = (float) sample * scale;
+
+	if constexpr (bits == 2) {
+		return (value >= -1.0f) + (value >= 0.0f) + (value >= 1.0f);
+	} else {
+		constexpr int offset = 1 << (bits - 1);
+		const int code = (int) floorf(value) + offset;
+		return (unsigned int) (code < 0 ? 0 : (code > (2 * offset - 1) ? (2 * offset - 1) : code));
+	}
+}
+
+// VDIF: Each packet becomes one frame per polarisation (thread port * 2 + pol), frames are grouped by packet.
+// 	Samples are packed from the least significant bit, time-major, channel, then real/imaginary, with the
+// 	port's channels padded to a power of 2.
+template <typename I, const int bits>
+void inline udp_vdif(long iLoop, char *inputPortData, char **outputData, long lastInputPacketOffset, long packetOutputLength, int timeStepSize, int port, int upperBeamlet, int cumulativeBeamlets, int baseBeamlet, long packetNumber, int packetPadded, const lofar_udp_meta *meta) {
+	constexpr int samplesPerByte = 8 / bits;
+	const int vdifChannels = meta->vdifChannels;
+	const int numChannels = upperBeamlet - baseBeamlet;
+	const long frameLength = lofar_udp_vdif_frame_length(meta);
+	const unsigned int padCode = vdif_quantise<I, bits>(0, 1.0f);
+	long second, frame;
+
+	vdif_packet_time(packetNumber, meta->clockBit, &second, &frame);
+
+	for (int pol = 0; pol < VDIF_THREADS_PER_PORT; pol++) {
+		char *frameData = &(outputData[0][iLoop * packetOutputLength + (port * VDIF_THREADS_PER_PORT + pol) * frameLength]);
+		unsigned int *header = (unsigned int*) frameData;
+		unsigned char *payload = (unsigned char*) &(frameData[VDIF_HEADER_LENGTH]);
+		const float *scales = &(meta->vdifScales[cumulativeBeamlets * VDIF_THREADS_PER_PORT + pol]);
+
+		header[0] = (packetPadded ? VDIF_INVALID_BIT : 0) | ((unsigned int) (second - meta->vdifEpochStart) & 0x3FFFFFFF);
+		header[1] = ((unsigned int) meta->vdifEpoch << 24) | ((unsigned int) frame & 0xFFFFFF);
+		header[2] = ((unsigned int) __builtin_ctz(vdifChannels) << 24) | ((unsigned int) (frameLength / 8) & 0xFFFFFF);
+		header[3] = VDIF_COMPLEX_BIT | ((unsigned int) (bits - 1) << 26) | ((unsigned int) (port * VDIF_THREADS_PER_PORT + pol) << 16) | (meta->vdifStationCode & 0xFFFF);
+		for (int word = 4; word < VDIF_HEADER_WORDS; word++) {
+			header[word] = 0;
+		}
+
+		long outIdx = 0;
+		unsigned int packed = 0;
+		int packedCount = 0;
+		for (int ts = 0; ts < UDPNTIMESLICE; ts++) {
+			for (int chan = 0; chan < vdifChannels; chan++) {
+				unsigned int re = padCode, im = padCode;
+
+				if (chan < numChannels) {
+					const long tsInOffset = input_offset_index(lastInputPacketOffset, baseBeamlet + chan, timeStepSize) + (ts * UDPNPOL + 2 * pol) * timeStepSize;
+					re = vdif_quantise<I, bits>(*((I*) &(inputPortData[tsInOffset])), scales[chan * VDIF_THREADS_PER_PORT]);
+					im = vdif_quantise<I, bits>(*((I*) &(inputPortData[tsInOffset + timeStepSize])), scales[chan * VDIF_THREADS_PER_PORT]);
+				}
+
+				if constexpr (bits == 8) {
+					payload[outIdx++] = (unsigned char) re;
+					payload[outIdx++] = (unsigned char) im;
+				} else {
+					packed |= (re | (im << bits)) << (packedCount * bits);
+					packedCount += 2;
+					if (packedCount == samplesPerByte) {
+						payload[outIdx++] = (unsigned char) packed;
+						packed = 0;
+						packedCount = 0;
+					}
+				}
+			}
+		}
+	}
+}
+
+
 template <typename I, typename O, StokesFuncType stokesFunc, const int order, const int calibrateData>
 void inline udp_stokes(long iLoop, char *inputPortData, O **outputData,  long lastInputPacketOffset, long packetOutputLength, int timeStepSize, int totalBeamlets, int upperBeamlet, int cumulativeBeamlets, long packetsPerIteration, int baseBeamlet, float *jonesMatrix) {
 	
@@ -628,7 +720,7 @@ void inline udp_stokes(long iLoop, char *inputPortData, O **outputData,  long la
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 	 	} else {
-	 		tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+	 		tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 	 	}
 
 		if constexpr (calibrateData) {
@@ -687,7 +779,7 @@ void inline udp_stokesDecimation(long iLoop, char *inputPortData, O **outputData
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 
 		if constexpr (calibrateData) {
@@ -752,7 +844,7 @@ void inline udp_fullStokes(long iLoop, char *inputPortData, O **outputData,  lon
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 
 		if constexpr (calibrateData) {
@@ -818,7 +910,7 @@ void inline udp_fullStokesDecimation(long iLoop, char *inputPortData, O **output
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 
 		if constexpr (calibrateData) {
@@ -863,7 +955,7 @@ void inline udp_fullStokesDecimation(long iLoop, char *inputPortData, O **output
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 		
 		tempValU = (float) 0.0;
@@ -930,7 +1022,7 @@ void inline udp_usefulStokes(long iLoop, char *inputPortData, O **outputData,  l
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 
 		if constexpr (calibrateData) {
@@ -991,7 +1083,7 @@ void inline udp_usefulStokesDecimation(long iLoop, char *inputPortData, O **outp
 		if constexpr (order == 0) {
 			tsOutOffset = frequency_major_index(outputPacketOffset, totalBeamlets, beamlet, baseBeamlet, cumulativeBeamlets);
 		} else {
-			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset);
+			tsOutOffset = time_major_index(beamlet, baseBeamlet, cumulativeBeamlets, packetsPerIteration, outputPacketOffset, 0);
 		}
 
 		if constexpr (calibrateData) {
@@ -1080,18 +1172,21 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 	
 	const int packetsPerIteration = meta->packetsPerIteration;
 	const int replayDroppedPackets = meta->replayDroppedPackets;
+	const int timeMajorOverlap = meta->timeMajorOverlap;
 
 	// For each port of data provided,
 	#pragma omp parallel for 
 	for (int port = 0; port < meta->numPorts; port++) {
 
 		VERBOSE(if (verbose) printf("Port: %d on thread %d\n", port, omp_get_thread_num()));
+		TRACE_BEGIN("raw_loop", port);
 
 		long lastPortPacket, currentPortPacket, inputPacketOffset, lastInputPacketOffset, iWork, iLoop;
 
 		// Reset the dropped packets counter
 		meta->portLastDroppedPackets[port] = 0;
 		int currentPacketsDropped = 0, nextSequence;
+		long currentPacketsPadded = 0, currentPacketsOutOfOrder = 0;
 
 		// Reset last packet, reference data on the current port
 		lastPortPacket = meta->lastPacket;
@@ -1130,6 +1225,7 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 		const int portPacketLength = meta->portPacketLength[port];
 		const int packetOutputLength = meta->packetOutputLength[0];
 		const int timeStepSize = sizeof(I) / sizeof(char);
+		int packetPadded = 0;
 		#pragma GCC diagnostic pop
 		#pragma GCC diagnostic pop
 
@@ -1162,6 +1258,7 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 					// Dropped packet -> index not processed -> effectively an 'added' packet, decrement the dropped packet count
 					// 	so that we don't include an extra packet in shift operations
 					currentPacketsDropped -= 1;
+					currentPacketsOutOfOrder += 1;
 
 					iWork++;
 					if (iWork != packetsPerIteration) {
@@ -1178,7 +1275,9 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 				//	Increment the last packet offset so it can be used again next time, including the new offset
 				packetLoss = -1;
 				currentPacketsDropped += 1;
+				currentPacketsPadded += 1;
 				lastPortPacket += 1;
+				packetPadded = 1;
 
 				if (replayDroppedPackets) {
 					// If we are replaying the last packet, change the array index to the last good packet index
@@ -1212,6 +1311,7 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 				//		Increment iWork (input data packet index) and determine the new input offset
 				
 				lastPortPacket = currentPortPacket;
+				packetPadded = 0;
 				
 				if constexpr (state == 0) {
 					lastInputPacketOffset = inputPacketOffset;
@@ -1238,6 +1338,7 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 			// Use firstprivate to lock 4-bit variables in a task, create a cache variable otherwise
 			#pragma omp task firstprivate(iLoop, lastInputPacketOffset, inputPortData) shared(byteWorkspace, outputData)
 			{
+			TRACE(if (iLoop % TRACE_TASK_STRIDE == 0) lofar_udp_trace_record("kernel_task", 'B', port));
 
 			// Unpacket 4-bit data into an array of chars, so it can be processed the same way we process 8-bit data
 			if constexpr (state >= 4010) {
@@ -1245,7 +1346,7 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 				inputPortData = byteWorkspace[omp_get_thread_num()];
 
 				// Determine the number of (byte-sized) samples to process
-				int numSamples = portPacketLength - UDPHDRLEN;
+				int numSamples = portPacketLength - meta->headerOffset - UDPHDRLEN;
 
 				// Use a LUT to extract the 4-bit signed ints from signed chars
 				#ifdef __INTEL_COMPILER
@@ -1300,15 +1401,17 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 
 
 			} else if constexpr (trueState == 30) {
-				udp_timeMajor<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, baseBeamlet, jonesMatrix);
+				udp_timeMajor<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, timeMajorOverlap, baseBeamlet, jonesMatrix);
 			} else if constexpr (trueState == 31) {
-				udp_timeMajorSplitPols<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, baseBeamlet, jonesMatrix);
+				udp_timeMajorSplitPols<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, timeMajorOverlap, baseBeamlet, jonesMatrix);
 			} else if constexpr (trueState == 32) {
-				udp_timeMajorDualPols<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, baseBeamlet, jonesMatrix);
+				udp_timeMajorDualPols<I, O, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, timeStepSize, upperBeamlet, cumulativeBeamlets, packetsPerIteration, timeMajorOverlap, baseBeamlet, jonesMatrix);
 			
 
 
 
+			} else if constexpr (trueState >= 40 && trueState <= 42) {
+				udp_vdif<I, (2 << (trueState - 40))>(iLoop, inputPortData, (char**) outputData, lastInputPacketOffset, packetOutputLength, timeStepSize, port, upperBeamlet, cumulativeBeamlets, baseBeamlet, lastPortPacket, packetPadded, meta);
 			} else if constexpr (trueState == 100) {
 				udp_stokes<I, O, stokesI, 0, calibrateData>(iLoop, inputPortData, outputData, lastInputPacketOffset, packetOutputLength, timeStepSize, totalBeamlets, upperBeamlet, cumulativeBeamlets, packetsPerIteration, baseBeamlet, jonesMatrix);
 			} else if constexpr (trueState == 110) {
@@ -1376,6 +1479,8 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 			}
 
 
+			TRACE(if (iLoop % TRACE_TASK_STRIDE == 0) lofar_udp_trace_record("kernel_task", 'E', port));
+
 			// End task block, update cached variables as needed
 			}
 		}
@@ -1388,10 +1493,13 @@ int lofar_udp_raw_loop(lofar_udp_meta *meta) {
 
 		meta->portLastDroppedPackets[port] = currentPacketsDropped;
 		meta->portTotalDroppedPackets[port] += currentPacketsDropped;
+		meta->portTotalPaddedPackets[port] += currentPacketsPadded;
+		meta->portTotalOutOfOrderPackets[port] += currentPacketsOutOfOrder;
 		VERBOSE(if (verbose) printf("Current dropped packet count on port %d: %d\n", port, meta->portLastDroppedPackets[port]));
 
 		#pragma omp taskwait
 
+		TRACE_END("raw_loop", port);
 		VERBOSE(if (verbose) printf("Port %d finished loop.\n", port););
 
 	}
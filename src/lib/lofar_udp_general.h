@@ -7,12 +7,17 @@
 
 // CEP packet reference values
 #define UDPHDRLEN 16
+// Bytes before the CEP header of each packet (eg. a recorder's timestamp), default for lofar_udp_config.headerOffset
 #define UDPHDROFF 0
+#define UDPHDROFFMAX 512
 #define UDPCURVER 3
 #define UDPMAXBEAM 244
 #define UDPNPOL 4
 #define UDPNTIMESLICE 16
 
+// Calibration: floats per beamlet Jones matrix (2x2 complex elements)
+#define JONESMATSIZE 8
+
 // Timing values
 #define LFREPOCH 1199145600 // 2008-01-01 Unix time, sanity check
 #define RSPMAXSEQ 195313
@@ -0,0 +1,591 @@
+#include "lofar_udp_generator.h"
+
+
+// Generator configuration default: 4 ports of 8-bit IE613 data, without any loss
+lofar_udp_generator_config lofar_udp_generator_config_default = {
+	.numPorts = 4,
+	.bitMode = 8,
+	.beamlets = 0,
+	.clock200MHz = 1,
+	.stationID = 214,
+	.startTime = 1609459200,
+	.startOffset = 0,
+	.numPackets = 65536,
+	.lossRate = 0.0,
+	.burstRate = 0.0,
+	.burstLength = 1,
+	.reorderRate = 0.0,
+	.reorderDistance = 1,
+	.seed = 1,
+	.sigma = 0.0,
+	.compressionLevel = 0,
+	.headerOffset = 0,
+	.pcapPort = 0
+};
+
+
+/**
+ * @brief      Advance a xorshift64* generator
+ *
+ * @param      state  The generator state (must not be 0)
+ *
+ * @return     The next 64-bit value
+ */
+static inline unsigned long generator_random(unsigned long *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1Dul;
+}
+
+
+/**
+ * @brief      Get a uniform value in [0, 1)
+ *
+ * @param      state  The generator state
+ *
+ * @return     The value
+ */
+static inline double generator_uniform(unsigned long *state) {
+	return (double) (generator_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/**
+ * @brief      Derive a non-zero generator state from a seed and a stream index
+ *             (splitmix64)
+ *
+ * @param[in]  seed    The seed
+ * @param[in]  stream  The stream index
+ *
+ * @return     The generator state
+ */
+static unsigned long generator_seed(const unsigned long seed, const unsigned long stream) {
+	unsigned long state = seed + 0x9E3779B97F4A7C15ul * (stream + 1);
+
+	state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ul;
+	state = (state ^ (state >> 27)) * 0x94D049BB133111EBul;
+	state ^= state >> 31;
+
+	return state ? state : 1;
+}
+
+
+/**
+ * @brief      Build the lookup table of a Gaussian distribution, rounded and
+ *             clipped to a signed integer of the given bit width. Entry i holds
+ *             the sample at the (i + 0.5) / GENERATOR_TABLE_LENGTH quantile, so
+ *             indexing the table with uniform random bits draws from the
+ *             quantised distribution.
+ *
+ * @param      table  The table (GENERATOR_TABLE_LENGTH entries)
+ * @param[in]  sigma  The standard deviation
+ * @param[in]  bits   The bit width
+ */
+static void generator_build_table(short *table, const double sigma, const int bits) {
+	const int maxVal = (1 << (bits - 1)) - 1;
+	int value = -maxVal - 1;
+
+	for (long idx = 0; idx < GENERATOR_TABLE_LENGTH; idx++) {
+		const double quantile = ((double) idx + 0.5) / GENERATOR_TABLE_LENGTH;
+
+		// Step up to the first value whose rounding interval ends above the quantile
+		while (value < maxVal && quantile >= 0.5 * erfc(-((double) value + 0.5) / (sigma * M_SQRT2))) {
+			value++;
+		}
+		table[idx] = (short) value;
+	}
+}
+
+
+/**
+ * @brief      Get the number of the first packet described by a configuration
+ *
+ * @param[in]  config  The lofar_udp_generator_config
+ *
+ * @return     The packet number
+ */
+long lofar_udp_generator_first_packet(const lofar_udp_generator_config *config) {
+	return beamformed_packno(config->startTime, 0, config->clock200MHz) + config->startOffset;
+}
+
+
+/**
+ * @brief      Write the CEP header for a packet. The timestamp and sequence are
+ *             derived from the packet number, so sequences roll over at the
+ *             (non-integer) number of samples per second exactly as the
+ *             stations do.
+ *
+ * @param[in]  config        The lofar_udp_generator_config
+ * @param[in]  port          The port (used as the RSP ID)
+ * @param[in]  packetNumber  The packet number
+ * @param      header        The output header (UDPHDRLEN bytes)
+ */
+void lofar_udp_generator_packet_header(const lofar_udp_generator_config *config, const int port, const long packetNumber, char *header) {
+	const short stationRsp = (short) (config->stationID * 32);
+	const int beamlets = config->beamlets > 0 ? config->beamlets : (976 / config->bitMode);
+	lofar_source_bytes source = { .rsp = (unsigned int) port, .padding0 = 0, .errorBit = 0, .clockBit = (unsigned int) config->clock200MHz, .bitMode = (config->bitMode == 16) ? 0 : ((config->bitMode == 8) ? 1 : 2), .padding1 = 0 };
+	long offset;
+
+	// The second the packet's first sample falls in, and the sample's offset into it
+	const unsigned int timestamp = (unsigned int) lofar_get_sample_second(packetNumber * UDPNTIMESLICE, (unsigned int) config->clock200MHz, &offset);
+	const unsigned int sequence = (unsigned int) offset;
+
+	header[0] = UDPCURVER;
+	memcpy(&(header[1]), &source, sizeof(source));
+	header[3] = 0;
+	memcpy(&(header[4]), &stationRsp, sizeof(short));
+	header[6] = (char) beamlets;
+	header[7] = UDPNTIMESLICE;
+	memcpy(&(header[8]), &timestamp, sizeof(unsigned int));
+	memcpy(&(header[12]), &sequence, sizeof(unsigned int));
+}
+
+
+/**
+ * @brief      Draw a packet's payload of Gaussian samples, packed in the
+ *             configured bit mode. Each payload has its own random stream,
+ *             seeded by its port and packet number, and each 64-bit draw
+ *             indexes the noise table for 4 samples.
+ *
+ * @param[in]  generator     The lofar_udp_generator
+ * @param[in]  port          The port
+ * @param[in]  packetNumber  The packet number
+ * @param      payload       The output payload (packetLength - UDPHDRLEN bytes)
+ */
+static void generator_payload(const lofar_udp_generator *generator, const int port, const long packetNumber, char *payload) {
+	const short *table = generator->noiseTable;
+	const long payloadLength = generator->packetLength - UDPHDRLEN;
+	// Streams 0 to MAX_NUM_PORTS - 1 are the ports' loss and reorder streams
+	unsigned long state = generator_seed(generator->config.seed, ((unsigned long) packetNumber + 1) * MAX_NUM_PORTS + port);
+	unsigned long bits;
+
+	// Payloads are a multiple of 8 bytes (16 time samples of 4 components), so every draw is used in full
+	if (generator->config.bitMode == 8) {
+		for (long idx = 0; idx < payloadLength; idx += 4) {
+			bits = generator_random(&state);
+			payload[idx] = (char) table[bits & 0xFFFF];
+			payload[idx + 1] = (char) table[(bits >> 16) & 0xFFFF];
+			payload[idx + 2] = (char) table[(bits >> 32) & 0xFFFF];
+			payload[idx + 3] = (char) table[bits >> 48];
+		}
+	} else if (generator->config.bitMode == 16) {
+		for (long idx = 0; idx < payloadLength; idx += 4 * sizeof(short)) {
+			bits = generator_random(&state);
+			const short values[4] = { table[bits & 0xFFFF], table[(bits >> 16) & 0xFFFF], table[(bits >> 32) & 0xFFFF], table[bits >> 48] };
+			memcpy(&(payload[idx]), values, sizeof(values));
+		}
+	} else {
+		// High nibble first, matching the reader's bitmodeConversion table
+		for (long idx = 0; idx < payloadLength; idx += 2) {
+			bits = generator_random(&state);
+			payload[idx] = (char) (((table[bits & 0xFFFF] & 0xF) << 4) | (table[(bits >> 16) & 0xFFFF] & 0xF));
+			payload[idx + 1] = (char) (((table[(bits >> 32) & 0xFFFF] & 0xF) << 4) | (table[bits >> 48] & 0xF));
+		}
+	}
+}
+
+
+/**
+ * @brief      Free a generator and any partially initialised port state
+ *
+ * @param      generator  The lofar_udp_generator
+ */
+void lofar_udp_generator_cleanup(lofar_udp_generator *generator) {
+	if (generator == NULL) return;
+
+	for (int port = 0; port < MAX_NUM_PORTS; port++) {
+		lofar_udp_generator_port *state = &(generator->ports[port]);
+		free(state->packetNumbers);
+		free(state->packetDelayed);
+		free(state->buffer);
+		free(state->framedBuffer);
+		free(state->compressionBuffer);
+		if (state->cctx != NULL) ZSTD_freeCCtx(state->cctx);
+	}
+
+	free(generator->noiseTable);
+	free(generator);
+}
+
+
+/**
+ * @brief      Validate a configuration and set up a generator
+ *
+ * @param[in]  config  The lofar_udp_generator_config
+ *
+ * @return     lofar_udp_generator ptr, or NULL on error
+ */
+lofar_udp_generator* lofar_udp_generator_setup(const lofar_udp_generator_config *config) {
+	lofar_udp_generator *generator;
+	const long firstPacket = lofar_udp_generator_first_packet(config);
+	int beamlets, returnVal = 0;
+
+	if (config->numPorts < 1 || config->numPorts > MAX_NUM_PORTS) {
+		fprintf(stderr, "ERROR: The generator supports 1 to %d ports (%d requested), exiting.\n", MAX_NUM_PORTS, config->numPorts);
+		return NULL;
+	}
+
+	if (config->bitMode != 4 && config->bitMode != 8 && config->bitMode != 16) {
+		fprintf(stderr, "ERROR: Unsupported bit mode %d (4, 8 or 16 expected), exiting.\n", config->bitMode);
+		return NULL;
+	}
+
+	beamlets = config->beamlets > 0 ? config->beamlets : (976 / config->bitMode);
+	if (beamlets < 1 || beamlets * config->bitMode > 976) {
+		fprintf(stderr, "ERROR: %d-bit packets can hold 1 to %d beamlets (%d requested), exiting.\n", config->bitMode, 976 / config->bitMode, beamlets);
+		return NULL;
+	}
+
+	if (config->startTime < LFREPOCH || config->numPackets < 1 || firstPacket < 0) {
+		fprintf(stderr, "ERROR: Invalid start time (%u), offset (%ld) or number of packets (%ld), exiting.\n", config->startTime, config->startOffset, config->numPackets);
+		return NULL;
+	}
+
+	if (config->lossRate < 0.0 || config->lossRate > 1.0 || config->burstRate < 0.0 || config->burstRate > 1.0 || config->reorderRate < 0.0 || config->reorderRate > 1.0) {
+		fprintf(stderr, "ERROR: Loss (%lf), burst (%lf) and reorder (%lf) rates must be between 0 and 1, exiting.\n", config->lossRate, config->burstRate, config->reorderRate);
+		return NULL;
+	}
+
+	if (config->headerOffset < 0 || config->headerOffset > UDPHDROFFMAX || config->pcapPort < 0 || config->pcapPort + config->numPorts > 65536 || (config->pcapPort && (config->headerOffset || config->compressionLevel))) {
+		fprintf(stderr, "ERROR: Header offsets must be between 0 and %d bytes (%d requested), and pcap outputs (port %d) cannot be prefixed or compressed, exiting.\n", UDPHDROFFMAX, config->headerOffset, config->pcapPort);
+		return NULL;
+	}
+
+	if (config->burstLength < 1 || config->reorderDistance < 1 || config->reorderDistance >= GENERATOR_CHUNK_PACKETS) {
+		fprintf(stderr, "ERROR: Burst lengths (%d) must be positive, and reorder distances (%d) between 1 and %d, exiting.\n", config->burstLength, config->reorderDistance, GENERATOR_CHUNK_PACKETS - 1);
+		return NULL;
+	}
+
+	generator = calloc(1, sizeof(lofar_udp_generator));
+	if (generator == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for generator struct, exiting.\n");
+		return NULL;
+	}
+
+	generator->config = *config;
+	generator->config.beamlets = beamlets;
+	generator->packetLength = UDPHDRLEN + beamlets * UDPNTIMESLICE * UDPNPOL * config->bitMode / 8;
+
+	// Every port draws its samples from the same distribution
+	generator->noiseTable = malloc(GENERATOR_TABLE_LENGTH * sizeof(short));
+	if (generator->noiseTable != NULL) {
+		generator_build_table(generator->noiseTable, config->sigma > 0.0 ? config->sigma : (config->bitMode == 4 ? 2.0 : (config->bitMode == 8 ? 16.0 : 1024.0)), config->bitMode);
+	} else {
+		returnVal += 1;
+	}
+
+	#pragma omp parallel for reduction(+: returnVal)
+	for (int port = 0; port < config->numPorts; port++) {
+		lofar_udp_generator_port *state = &(generator->ports[port]);
+
+		state->nextPacket = firstPacket;
+		state->endPacket = firstPacket + config->numPackets;
+		state->randomState = generator_seed(config->seed, port);
+
+		state->packetNumbers = malloc(GENERATOR_CHUNK_PACKETS * sizeof(long));
+		state->packetDelayed = malloc(GENERATOR_CHUNK_PACKETS * sizeof(char));
+		state->buffer = malloc((long) GENERATOR_CHUNK_PACKETS * generator->packetLength);
+		if (config->headerOffset || config->pcapPort) {
+			state->framedBuffer = calloc(GENERATOR_CHUNK_PACKETS, generator->packetLength + config->headerOffset + (config->pcapPort ? PCAP_RECORD_HDR_LEN + GENERATOR_PCAP_FRAME_HDR_LEN : 0));
+		}
+		if (state->packetNumbers == NULL || state->packetDelayed == NULL || state->buffer == NULL || ((config->headerOffset || config->pcapPort) && state->framedBuffer == NULL)) {
+			returnVal += 1;
+			continue;
+		}
+
+		if (config->compressionLevel) {
+			state->cctx = ZSTD_createCCtx();
+			state->compressionBufferSize = ZSTD_CStreamOutSize();
+			state->compressionBuffer = malloc(state->compressionBufferSize);
+			if (state->cctx == NULL || state->compressionBuffer == NULL) {
+				returnVal += 1;
+				continue;
+			}
+			ZSTD_CCtx_setParameter(state->cctx, ZSTD_c_compressionLevel, config->compressionLevel);
+			ZSTD_CCtx_setParameter(state->cctx, ZSTD_c_checksumFlag, 1);
+		}
+	}
+
+	if (returnVal) {
+		fprintf(stderr, "ERROR: Unable to allocate generator buffers, exiting.\n");
+		lofar_udp_generator_cleanup(generator);
+		return NULL;
+	}
+
+	return generator;
+}
+
+
+/**
+ * @brief      Generate up to GENERATOR_CHUNK_PACKETS packets for a port,
+ *             applying the configured loss, burst gaps and reordering
+ *
+ * @param      generator   The lofar_udp_generator
+ * @param[in]  port        The port
+ * @param      buffer      The output buffer (maxPackets * packetLength bytes)
+ * @param[in]  maxPackets  The maximum number of packets to generate
+ *
+ * @return     The number of packets generated
+ */
+static long generator_chunk(lofar_udp_generator *generator, const int port, char *buffer, const long maxPackets) {
+	const lofar_udp_generator_config *config = &(generator->config);
+	lofar_udp_generator_port *state = &(generator->ports[port]);
+	long *packetNumbers = state->packetNumbers;
+	char *packetDelayed = state->packetDelayed;
+	long count = 0, skip, delayed;
+	int distance;
+
+	// Choose the packets that survive
+	while (count < maxPackets && state->nextPacket < state->endPacket) {
+		const long packetNumber = state->nextPacket++;
+
+		if (config->burstRate > 0.0 && generator_uniform(&(state->randomState)) < config->burstRate) {
+			skip = 1 + (long) (generator_random(&(state->randomState)) % config->burstLength);
+			if (packetNumber + skip > state->endPacket) skip = state->endPacket - packetNumber;
+			state->nextPacket = packetNumber + skip;
+			state->packetsDropped += skip;
+			continue;
+		}
+
+		if (config->lossRate > 0.0 && generator_uniform(&(state->randomState)) < config->lossRate) {
+			state->packetsDropped += 1;
+			continue;
+		}
+
+		packetNumbers[count++] = packetNumber;
+	}
+
+	// Delay packets behind later packets in the chunk. Each packet is considered once: delayed packets are flagged so
+	// 	they are not moved again, and the packet shifted into a delayed packet's place is considered next.
+	if (config->reorderRate > 0.0) {
+		memset(packetDelayed, 0, count * sizeof(char));
+		for (long idx = 0; idx < count - 1;) {
+			if (packetDelayed[idx] || generator_uniform(&(state->randomState)) >= config->reorderRate) {
+				idx++;
+				continue;
+			}
+
+			// Packets near the end of the chunk are delayed as far as they can be
+			distance = 1 + (int) (generator_random(&(state->randomState)) % config->reorderDistance);
+			if (idx + distance >= count) distance = (int) (count - 1 - idx);
+
+			delayed = packetNumbers[idx];
+			memmove(&(packetNumbers[idx]), &(packetNumbers[idx + 1]), distance * sizeof(long));
+			memmove(&(packetDelayed[idx]), &(packetDelayed[idx + 1]), distance * sizeof(char));
+			packetNumbers[idx + distance] = delayed;
+			packetDelayed[idx + distance] = 1;
+			state->packetsReordered += 1;
+		}
+	}
+
+	// Build the packets, each payload is drawn from a random stream determined by its packet number
+	for (long idx = 0; idx < count; idx++) {
+		char *packet = &(buffer[idx * generator->packetLength]);
+
+		lofar_udp_generator_packet_header(config, port, packetNumbers[idx], packet);
+		generator_payload(generator, port, packetNumbers[idx], &(packet[UDPHDRLEN]));
+	}
+
+	state->packetsWritten += count;
+	return count;
+}
+
+
+/**
+ * @brief      Generate the next packets for a port into a buffer
+ *
+ * @param      generator   The lofar_udp_generator
+ * @param[in]  port        The port
+ * @param      buffer      The output buffer (maxPackets * packetLength bytes)
+ * @param[in]  maxPackets  The maximum number of packets to generate
+ *
+ * @return     The number of packets generated, 0 once the port is exhausted,
+ *             -1 on error
+ */
+long lofar_udp_generator_fill(lofar_udp_generator *generator, const int port, char *buffer, const long maxPackets) {
+	long generated = 0, chunk;
+
+	if (port < 0 || port >= generator->config.numPorts) {
+		fprintf(stderr, "ERROR: Port %d is out of range for the generator (%d ports), exiting.\n", port, generator->config.numPorts);
+		return -1;
+	}
+
+	while (generated < maxPackets) {
+		const long request = (maxPackets - generated) < GENERATOR_CHUNK_PACKETS ? (maxPackets - generated) : GENERATOR_CHUNK_PACKETS;
+
+		chunk = generator_chunk(generator, port, &(buffer[generated * generator->packetLength]), request);
+		if (chunk == 0) break;
+		generated += chunk;
+	}
+
+	return generated;
+}
+
+
+/**
+ * @brief      Write a buffer to a port's output, compressing it if configured
+ *
+ * @param      state       The lofar_udp_generator_port
+ * @param      outputFile  The output file
+ * @param[in]  data        The data
+ * @param[in]  dataLength  The data length
+ * @param[in]  mode        The zstd directive (ZSTD_e_end to finish the frame)
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int generator_output(lofar_udp_generator_port *state, FILE *outputFile, const char *data, const long dataLength, const ZSTD_EndDirective mode) {
+	ZSTD_inBuffer input = { data, dataLength, 0 };
+	ZSTD_outBuffer output;
+	size_t remaining;
+
+	if (state->cctx == NULL) {
+		if (dataLength > 0 && fwrite(data, sizeof(char), dataLength, outputFile) != (size_t) dataLength) return 1;
+		state->bytesWritten += dataLength;
+		return 0;
+	}
+
+	do {
+		output = (ZSTD_outBuffer) { state->compressionBuffer, state->compressionBufferSize, 0 };
+		remaining = ZSTD_compressStream2(state->cctx, &output, &input, mode);
+		if (ZSTD_isError(remaining)) {
+			fprintf(stderr, "ERROR: zstd failed to compress generated data (%s).\n", ZSTD_getErrorName(remaining));
+			return 1;
+		}
+
+		if (output.pos > 0 && fwrite(state->compressionBuffer, sizeof(char), output.pos, outputFile) != output.pos) return 1;
+		state->bytesWritten += output.pos;
+	} while (mode == ZSTD_e_end ? remaining != 0 : input.pos != input.size);
+
+	return 0;
+}
+
+
+/**
+ * @brief      Write the classic pcap global header for an output
+ *
+ * @param      buffer  The output buffer (PCAP_GLOBAL_HDR_LEN bytes)
+ */
+static void generator_pcap_global_header(char *buffer) {
+	const unsigned int magic = PCAP_MAGIC_USEC, snapLength = 65535, linkType = PCAP_LINKTYPE_ETHERNET;
+	const unsigned short version[2] = { 2, 4 };
+
+	memset(buffer, 0, PCAP_GLOBAL_HDR_LEN);
+	memcpy(&(buffer[0]), &magic, sizeof(unsigned int));
+	memcpy(&(buffer[4]), version, sizeof(version));
+	memcpy(&(buffer[16]), &snapLength, sizeof(unsigned int));
+	memcpy(&(buffer[20]), &linkType, sizeof(unsigned int));
+}
+
+
+/**
+ * @brief      Copy a chunk of packets into a port's framed buffer, either
+ *             behind headerOffset bytes of padding, or as pcap records of
+ *             Ethernet / IPv4 / UDP frames
+ *
+ * @param      generator  The lofar_udp_generator
+ * @param[in]  port       The port
+ * @param[in]  packets    The number of packets in the port's buffer
+ *
+ * @return     The length of the framed chunk
+ */
+static long generator_frame(lofar_udp_generator *generator, const int port, const long packets) {
+	const lofar_udp_generator_config *config = &(generator->config);
+	lofar_udp_generator_port *state = &(generator->ports[port]);
+	const int packetLength = generator->packetLength;
+	const unsigned short udpLength = (unsigned short) (8 + packetLength), ipLength = (unsigned short) (20 + udpLength);
+	const unsigned int frameLength = GENERATOR_PCAP_FRAME_HDR_LEN + packetLength;
+	const unsigned short dstPort = (unsigned short) (config->pcapPort + port);
+	long offset = 0;
+
+	for (long packet = 0; packet < packets; packet++) {
+		const char *source = &(state->buffer[packet * packetLength]);
+		char *record = &(state->framedBuffer[offset]);
+
+		if (!config->pcapPort) {
+			memset(record, 0, config->headerOffset);
+			memcpy(&(record[config->headerOffset]), source, packetLength);
+			offset += config->headerOffset + packetLength;
+			continue;
+		}
+
+		// Record header: the packet's RSP timestamp, captured and original lengths
+		unsigned int recordHeader[4] = { 0, 0, frameLength, frameLength };
+		memcpy(&(recordHeader[0]), &(source[8]), sizeof(unsigned int));
+		memcpy(record, recordHeader, PCAP_RECORD_HDR_LEN);
+
+		// Ethernet (locally administered addresses), IPv4 (no options or checksum) and UDP (no checksum) headers
+		unsigned char *frame = (unsigned char*) &(record[PCAP_RECORD_HDR_LEN]);
+		memset(frame, 0, GENERATOR_PCAP_FRAME_HDR_LEN);
+		frame[0] = 0x02; frame[5] = 0x02;
+		frame[6] = 0x02; frame[11] = 0x01;
+		frame[12] = 0x08;
+
+		unsigned char *ip = &(frame[14]);
+		ip[0] = 0x45;
+		ip[2] = (unsigned char) (ipLength >> 8); ip[3] = (unsigned char) ipLength;
+		ip[6] = 0x40;
+		ip[8] = 64;
+		ip[9] = 17;
+		ip[12] = 10; ip[15] = 1;
+		ip[16] = 10; ip[19] = 2;
+
+		unsigned char *udp = &(ip[20]);
+		udp[0] = udp[2] = (unsigned char) (dstPort >> 8);
+		udp[1] = udp[3] = (unsigned char) dstPort;
+		udp[4] = (unsigned char) (udpLength >> 8); udp[5] = (unsigned char) udpLength;
+
+		memcpy(&(frame[GENERATOR_PCAP_FRAME_HDR_LEN]), source, packetLength);
+
+		offset += PCAP_RECORD_HDR_LEN + frameLength;
+	}
+
+	return offset;
+}
+
+
+/**
+ * @brief      Generate every remaining packet, writing each port to its
+ *             output file in parallel
+ *
+ * @param      generator    The lofar_udp_generator
+ * @param      outputFiles  The output files, one per port (remain owned by
+ *                          the caller)
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_generator_write(lofar_udp_generator *generator, FILE **outputFiles) {
+	int returnVal = 0;
+
+	#pragma omp parallel for reduction(+: returnVal)
+	for (int port = 0; port < generator->config.numPorts; port++) {
+		lofar_udp_generator_port *state = &(generator->ports[port]);
+		char globalHeader[PCAP_GLOBAL_HDR_LEN];
+		long packets;
+
+		if (generator->config.pcapPort) {
+			generator_pcap_global_header(globalHeader);
+			if (generator_output(state, outputFiles[port], globalHeader, PCAP_GLOBAL_HDR_LEN, ZSTD_e_continue) > 0) returnVal += 1;
+		}
+
+		while (!returnVal && (packets = lofar_udp_generator_fill(generator, port, state->buffer, GENERATOR_CHUNK_PACKETS)) > 0) {
+			const int framed = state->framedBuffer != NULL;
+			const long length = framed ? generator_frame(generator, port, packets) : packets * generator->packetLength;
+
+			if (generator_output(state, outputFiles[port], framed ? state->framedBuffer : state->buffer, length, ZSTD_e_continue) > 0) {
+				returnVal += 1;
+				break;
+			}
+		}
+
+		if (!returnVal && state->cctx != NULL && generator_output(state, outputFiles[port], NULL, 0, ZSTD_e_end) > 0) {
+			returnVal += 1;
+		}
+
+		if (returnVal) {
+			fprintf(stderr, "ERROR: Failed to write generated data for port %d.\n", port);
+		}
+	}
+
+	return returnVal ? 1 : 0;
+}
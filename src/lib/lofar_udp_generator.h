@@ -0,0 +1,144 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <zstd.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_misc.h"
+#include "lofar_udp_pcap.h"
+
+#ifndef __LOFAR_UDP_GENERATOR_STRUCTS
+#define __LOFAR_UDP_GENERATOR_STRUCTS
+
+// Number of packets generated per port before they are written out
+#define GENERATOR_CHUNK_PACKETS 4096
+
+// Number of entries in the lookup table of the quantised noise distribution, indexed by 16 random bits per sample
+#define GENERATOR_TABLE_LENGTH 65536
+
+// Ethernet + IPv4 + UDP header lengths of the frames in pcap outputs
+#define GENERATOR_PCAP_FRAME_HDR_LEN (14 + 20 + 8)
+
+// Generator configuration struct
+typedef struct lofar_udp_generator_config {
+	// Number of ports to generate
+	int numPorts;
+
+	// Input bit mode (4, 8, 16) and beamlets per port (0 === the maximum for the bit mode, 244/122/61)
+	int bitMode;
+	int beamlets;
+
+	// 1: 200MHz clock, 0: 160MHz clock
+	int clock200MHz;
+
+	// Station ID written to the headers (eg. 214 for IE613)
+	int stationID;
+
+	// Unix time of the start of the first second, and the offset of the first packet from that second (negative
+	// 	offsets start before it, useful to test sequence rollover)
+	unsigned int startTime;
+	long startOffset;
+
+	// Number of packets to generate on each port (before any loss)
+	long numPackets;
+
+	// Probability that a packet is dropped
+	double lossRate;
+
+	// Probability that a burst gap starts on a packet, and the maximum number of packets it removes
+	double burstRate;
+	int burstLength;
+
+	// Probability that a packet is delayed, and the maximum number of packets it is delayed by
+	double reorderRate;
+	int reorderDistance;
+
+	// Seed for the noise and loss generators; the same configuration and seed produces the same capture
+	unsigned long seed;
+
+	// Standard deviation of the generated samples, in units of the input bit mode's least significant bit
+	double sigma;
+
+	// zstd compression level of the outputs, 0 disables compression
+	int compressionLevel;
+
+	// Bytes of padding written before each packet, mimicking recorders that prefix packets with their own headers
+	int headerOffset;
+
+	// Write each port as a classic pcap capture of Ethernet / IPv4 / UDP frames to this destination port (plus the
+	// 	port index), rather than as raw packets. 0 disables pcap outputs
+	int pcapPort;
+
+} lofar_udp_generator_config;
+extern lofar_udp_generator_config lofar_udp_generator_config_default;
+
+
+// Per-port generator state
+typedef struct lofar_udp_generator_port {
+	// Next packet number to consider and the final packet number (exclusive)
+	long nextPacket;
+	long endPacket;
+
+	// Random state for the loss and reorder decisions
+	unsigned long randomState;
+
+	// Working buffers for a chunk of packets (with a flag for the packets that have been delayed), and the chunk
+	// 	with its per-packet prefixes / pcap framing
+	long *packetNumbers;
+	char *packetDelayed;
+	char *buffer;
+	char *framedBuffer;
+
+	// zstd compression state
+	ZSTD_CCtx *cctx;
+	char *compressionBuffer;
+	size_t compressionBufferSize;
+
+	// Statistics
+	long packetsWritten;
+	long packetsDropped;
+	long packetsReordered;
+	long bytesWritten;
+
+} lofar_udp_generator_port;
+
+
+// Generator struct
+typedef struct lofar_udp_generator {
+	lofar_udp_generator_config config;
+
+	int packetLength;
+
+	// Lookup table of the quantised noise distribution that payloads are drawn from
+	short *noiseTable;
+
+	lofar_udp_generator_port ports[MAX_NUM_PORTS];
+
+} lofar_udp_generator;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_GENERATOR_H
+#define __LOFAR_UDP_GENERATOR_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+lofar_udp_generator* lofar_udp_generator_setup(const lofar_udp_generator_config *config);
+long lofar_udp_generator_fill(lofar_udp_generator *generator, const int port, char *buffer, const long maxPackets);
+int lofar_udp_generator_write(lofar_udp_generator *generator, FILE **outputFiles);
+void lofar_udp_generator_packet_header(const lofar_udp_generator_config *config, const int port, const long packetNumber, char *header);
+long lofar_udp_generator_first_packet(const lofar_udp_generator_config *config);
+void lofar_udp_generator_cleanup(lofar_udp_generator *generator);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,191 @@
+#include "lofar_udp_guppi.h"
+
+
+/**
+ * @brief      Find the offset of a card in a rendered header
+ *
+ * @param[in]  guppi  The lofar_udp_guppi_header
+ * @param[in]  key    The key
+ *
+ * @return     The offset, or -1 if the key is not present
+ */
+static long guppi_find_card(const lofar_udp_guppi_header *guppi, const char *key) {
+	char paddedKey[9];
+	snprintf(paddedKey, sizeof(paddedKey), "%-8s", key);
+
+	for (long offset = 0; offset + GUPPI_CARD_LENGTH <= guppi->length; offset += GUPPI_CARD_LENGTH) {
+		if (strncmp(&(guppi->buffer[offset]), paddedKey, 8) == 0) return offset;
+	}
+
+	return -1;
+}
+
+
+/**
+ * @brief      Re-format a card in place, matching the layout of
+ *             ascii_hdr_manager's writers
+ *
+ * @param      guppi   The lofar_udp_guppi_header
+ * @param[in]  offset  The card offset
+ * @param[in]  key     The key
+ * @param[in]  value   The formatted value
+ * @param[in]  quoted  Format the value as a string
+ */
+static void guppi_patch_card(lofar_udp_guppi_header *guppi, const long offset, const char *key, const char *value, const int quoted) {
+	char card[GUPPI_CARD_LENGTH + 1];
+	int length;
+
+	if (quoted) {
+		length = snprintf(card, sizeof(card), "%-8s= '%-8s'", key, value);
+	} else {
+		length = snprintf(card, sizeof(card), "%-8s= %20s", key, value);
+	}
+	if (length < GUPPI_CARD_LENGTH) memset(&(card[length]), ' ', GUPPI_CARD_LENGTH - length);
+
+	memcpy(&(guppi->buffer[offset]), card, GUPPI_CARD_LENGTH);
+}
+
+
+/**
+ * @brief      Emulate the DAQ time string from the current data timestamp
+ *
+ * @param[in]  meta        The lofar_udp_meta
+ * @param      stringBuff  The output time string buffer
+ */
+static void guppi_daq_time_string(const lofar_udp_meta *meta, char stringBuff[24]) {
+	time_t startTimeUnix = (unsigned int) lofar_get_packet_time(meta->inputData[0]);
+	struct tm *startTimeStruct = gmtime(&startTimeUnix);
+
+	strftime(stringBuff, 24, "%a %b %e %H:%M:%S %Y", startTimeStruct);
+}
+
+
+/**
+ * @brief      Initialise a GUPPI RAW header from an ASCII header template and
+ *             the reader's metadata, and render it to memory
+ *
+ * @param      guppi   The lofar_udp_guppi_header
+ * @param[in]  header  The ascii_hdr template (source, pointing, etc.)
+ * @param[in]  meta    The lofar_udp_meta, after the first step or reuse
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_guppi_header_setup(lofar_udp_guppi_header *guppi, const ascii_hdr *header, const lofar_udp_meta *meta) {
+	FILE *hdrStream;
+	double mjdTime;
+
+	if (meta->processingMode != 30) {
+		fprintf(stderr, "ERROR: GUPPI RAW blocks require processing mode 30 (%d requested), exiting.\n", meta->processingMode);
+		return 1;
+	}
+
+	guppi->header = *header;
+	guppi->packetsWritten = 0;
+	guppi->totalDropped = 0;
+
+	// Frequency info
+	guppi->header.obsnchan = meta->totalProcBeamlets;
+	guppi->header.chan_bw = (CLOCK160MHZ / 1e6) * (1 - meta->clockBit) + (CLOCK200MHZ / 1e6) * meta->clockBit;
+	guppi->header.obsbw = guppi->header.obsnchan * guppi->header.chan_bw;
+
+	// Data format info
+	guppi->header.nbits = meta->outputBitMode;
+	guppi->header.npol = 2;
+	guppi->header.overlap = meta->timeMajorOverlap;
+	guppi->header.blocsize = meta->packetsPerIteration * meta->packetOutputLength[0] + lofar_udp_time_major_overlap_length(meta, 0);
+	strcpy(guppi->header.pktfmt, "1SFA");
+	guppi->header.pktsize = meta->packetOutputLength[0];
+
+	// Timing info
+	mjdTime = lofar_get_packet_time_mjd(meta->inputData[0]);
+	guppi->header.stt_imjd = (int) mjdTime;
+	guppi->header.stt_smjd = (int) ((mjdTime - (int) mjdTime) * 86400);
+	guppi->header.stt_offs = ((mjdTime - (int) mjdTime) * 86400) - guppi->header.stt_smjd;
+	guppi->header.tbin = clock160MHzSample * (1 - meta->clockBit) + clock200MHzSample * meta->clockBit;
+	guppi->header.pktidx = 0;
+	guppi->header.dropblk = 0.;
+	guppi->header.droptot = 0.;
+	guppi_daq_time_string(meta, guppi->header.daqpulse);
+
+	// Render the template once
+	hdrStream = fmemopen(guppi->buffer, WRITER_MAX_HDR_LENGTH, "w");
+	if (hdrStream == NULL) {
+		fprintf(stderr, "ERROR: Failed to create the in-memory GUPPI header stream, exiting.\n");
+		return 1;
+	}
+	writeHdr(hdrStream, &(guppi->header));
+	guppi->length = ftell(hdrStream);
+	fclose(hdrStream);
+
+	guppi->pktidxOffset = guppi_find_card(guppi, "PKTIDX");
+	guppi->dropblkOffset = guppi_find_card(guppi, "DROPBLK");
+	guppi->droptotOffset = guppi_find_card(guppi, "DROPTOT");
+	guppi->blocsizeOffset = guppi_find_card(guppi, "BLOCSIZE");
+	guppi->daqpulseOffset = guppi_find_card(guppi, "DAQPULSE");
+
+	if (guppi->pktidxOffset < 0 || guppi->dropblkOffset < 0 || guppi->droptotOffset < 0 || guppi->blocsizeOffset < 0 || guppi->daqpulseOffset < 0) {
+		fprintf(stderr, "ERROR: Rendered GUPPI header is missing a per-block key, exiting.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Update the per-block cards of the header in place for the gulp
+ *             currently in the reader's output buffers
+ *
+ * @param      guppi    The lofar_udp_guppi_header
+ * @param[in]  meta     The lofar_udp_meta
+ * @param[in]  packets  The number of new packets in the block
+ *
+ * @return     0: Success
+ */
+int lofar_udp_guppi_header_update(lofar_udp_guppi_header *guppi, const lofar_udp_meta *meta, const long packets) {
+	char value[32];
+	long blockDropped = 0;
+
+	for (int port = 0; port < meta->numPorts; port++) {
+		if (meta->portLastDroppedPackets[port] > 0) blockDropped += meta->portLastDroppedPackets[port];
+	}
+	guppi->totalDropped += blockDropped;
+
+	guppi->header.pktidx = guppi->packetsWritten;
+	guppi->header.blocsize = packets * meta->packetOutputLength[0] + lofar_udp_time_major_overlap_length(meta, 0);
+	guppi->header.dropblk = (double) blockDropped / (packets * meta->numPorts);
+	guppi->header.droptot = (double) guppi->totalDropped / ((guppi->packetsWritten + packets) * meta->numPorts);
+	guppi_daq_time_string(meta, guppi->header.daqpulse);
+
+	snprintf(value, sizeof(value), "%ld", guppi->header.pktidx);
+	guppi_patch_card(guppi, guppi->pktidxOffset, "PKTIDX", value, 0);
+	snprintf(value, sizeof(value), "%d", (int) guppi->header.blocsize);
+	guppi_patch_card(guppi, guppi->blocsizeOffset, "BLOCSIZE", value, 0);
+	snprintf(value, sizeof(value), "%.9lf", guppi->header.dropblk);
+	guppi_patch_card(guppi, guppi->dropblkOffset, "DROPBLK", value, 0);
+	snprintf(value, sizeof(value), "%.9lf", guppi->header.droptot);
+	guppi_patch_card(guppi, guppi->droptotOffset, "DROPTOT", value, 0);
+	guppi_patch_card(guppi, guppi->daqpulseOffset, "DAQPULSE", guppi->header.daqpulse, 1);
+
+	guppi->packetsWritten += packets;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Submit the reader's current gulp to the writer as a GUPPI RAW
+ *             block. The time-major kernels have already written the payload
+ *             (including any overlap) in place, only the header is updated.
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param      guppi   The lofar_udp_guppi_header
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_guppi_submit(lofar_udp_writer *writer, lofar_udp_guppi_header *guppi) {
+	const long packets = writer->reader->meta->packetsPerIteration;
+
+	lofar_udp_guppi_header_update(guppi, writer->reader->meta, packets);
+	return lofar_udp_writer_submit_prefixed(writer, packets, guppi->buffer, guppi->length);
+}
@@ -0,0 +1,62 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+#include "lofar_udp_writer.h"
+#include "ascii_hdr_manager.h"
+
+#ifndef __LOFAR_UDP_GUPPI_STRUCTS
+#define __LOFAR_UDP_GUPPI_STRUCTS
+
+// GUPPI RAW header cards are 80 characters long
+#define GUPPI_CARD_LENGTH 80
+
+// GUPPI RAW block header
+//
+// The header is rendered once from an ascii_hdr, then only the cards that
+// change between blocks are re-formatted in place before each block is handed
+// to the writer, which prefixes it to the block with a single writev.
+typedef struct lofar_udp_guppi_header {
+	ascii_hdr header;
+
+	char buffer[WRITER_MAX_HDR_LENGTH];
+	long length;
+
+	// Offsets of the cards patched for each block
+	long pktidxOffset;
+	long dropblkOffset;
+	long droptotOffset;
+	long blocsizeOffset;
+	long daqpulseOffset;
+
+	// Running totals
+	long packetsWritten;
+	long totalDropped;
+
+} lofar_udp_guppi_header;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_GUPPI_H
+#define __LOFAR_UDP_GUPPI_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_guppi_header_setup(lofar_udp_guppi_header *guppi, const ascii_hdr *header, const lofar_udp_meta *meta);
+int lofar_udp_guppi_header_update(lofar_udp_guppi_header *guppi, const lofar_udp_meta *meta, const long packets);
+int lofar_udp_guppi_submit(lofar_udp_writer *writer, lofar_udp_guppi_header *guppi);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
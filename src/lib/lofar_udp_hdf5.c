@@ -0,0 +1,410 @@
+#include "lofar_udp_hdf5.h"
+
+#ifdef ALLOW_HDF5
+#include <hdf5.h>
+#include <zlib.h>
+
+// HDF5 output file
+struct lofar_udp_hdf5_file {
+	hid_t file;
+	hid_t dataset;
+	hid_t dtype;
+	int outp;
+
+	// Every gulp is written as a single chunk
+	long chunkLength;
+	hsize_t chunkElements;
+	int elementSize;
+	hsize_t currentElements;
+	int partialChunk;
+
+	// Deflate state, each thread compresses a block of the chunk into its own buffer
+	int compressionLevel;
+	int compressionThreads;
+	char *paddedChunk;
+	char *compressedChunk;
+	char **compressedBlocks;
+	long *compressedBlockLength;
+	unsigned long *compressedBlockChecksum;
+	long compressedBlockSize;
+};
+
+
+/**
+ * @brief      Get the HDF5 type that matches the output of a processing mode
+ *
+ * @param[in]  meta  The lofar_udp_meta
+ *
+ * @return     The HDF5 native type
+ */
+static hid_t lofar_udp_hdf5_get_type(const lofar_udp_meta *meta) {
+	// Copy modes include the CEP headers, 4-bit outputs remain packed
+	if (meta->processingMode < 10 || meta->outputBitMode == 4) return H5T_NATIVE_UCHAR;
+
+	switch (meta->outputBitMode) {
+		case 8:
+			return H5T_NATIVE_SCHAR;
+		case 16:
+			return H5T_NATIVE_SHORT;
+		default:
+			return H5T_NATIVE_FLOAT;
+	}
+}
+
+
+/**
+ * @brief      Attach a scalar attribute to an HDF5 object
+ *
+ * @param[in]  obj    The object
+ * @param[in]  name   The attribute name
+ * @param[in]  dtype  The attribute type
+ * @param[in]  value  The attribute value
+ * @param[in]  count  The number of elements (1 for a scalar)
+ *
+ * @return     0: Success, 1: Failure
+ */
+static int lofar_udp_hdf5_attr(hid_t obj, const char *name, hid_t dtype, const void *value, const hsize_t count) {
+	hid_t space = (count == 1) ? H5Screate(H5S_SCALAR) : H5Screate_simple(1, &count, NULL);
+	hid_t attr = H5Acreate2(obj, name, dtype, space, H5P_DEFAULT, H5P_DEFAULT);
+	herr_t returnVal = -1;
+
+	if (attr >= 0) {
+		returnVal = H5Awrite(attr, dtype, value);
+		H5Aclose(attr);
+	}
+	H5Sclose(space);
+
+	return returnVal < 0;
+}
+
+
+/**
+ * @brief      Attach a string attribute to an HDF5 object
+ *
+ * @param[in]  obj    The object
+ * @param[in]  name   The attribute name
+ * @param[in]  value  The string
+ *
+ * @return     0: Success, 1: Failure
+ */
+static int lofar_udp_hdf5_attr_str(hid_t obj, const char *name, const char *value) {
+	hid_t dtype = H5Tcopy(H5T_C_S1);
+	int returnVal;
+
+	H5Tset_size(dtype, strlen(value) + 1);
+	returnVal = lofar_udp_hdf5_attr(obj, name, dtype, value, 1);
+	H5Tclose(dtype);
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Describe the observation and output on the dataset
+ *
+ * @param      file  The lofar_udp_hdf5_file
+ * @param[in]  meta  The lofar_udp_meta
+ *
+ * @return     0: Success, >0: Failure
+ */
+static int lofar_udp_hdf5_write_attrs(lofar_udp_hdf5_file *file, const lofar_udp_meta *meta) {
+	char stationCode[16] = "";
+	const int clockMHz = meta->clockBit ? 200 : 160;
+	const double startMJD = lofar_get_packet_time_mjd(meta->inputData[0]);
+	double sampleTime = meta->clockBit ? clock200MHzSample : clock160MHzSample;
+	const long packetsPerChunk = file->chunkLength / meta->packetOutputLength[file->outp];
+	int returnVal = 0;
+
+	if (meta->processingMode > 100) sampleTime *= 1 << (meta->processingMode % 10);
+	lofar_get_station_name(meta->stationID, stationCode);
+
+	returnVal += lofar_udp_hdf5_attr_str(file->dataset, "STATION", stationCode);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "STATION_ID", H5T_NATIVE_INT, &(meta->stationID), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "CLOCK_MHZ", H5T_NATIVE_INT, &clockMHz, 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "START_MJD", H5T_NATIVE_DOUBLE, &startMJD, 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "SAMPLE_TIME", H5T_NATIVE_DOUBLE, &sampleTime, 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "PROCESSING_MODE", H5T_NATIVE_INT, &(meta->processingMode), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "INPUT_BITS", H5T_NATIVE_INT, &(meta->inputBitMode), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "OUTPUT_BITS", H5T_NATIVE_INT, &(meta->outputBitMode), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "OUTPUT_INDEX", H5T_NATIVE_INT, &(file->outp), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "NUM_OUTPUTS", H5T_NATIVE_INT, &(meta->numOutputs), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "NUM_PORTS", H5T_NATIVE_INT, &(meta->numPorts), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "NUM_BEAMLETS", H5T_NATIVE_INT, &(meta->totalProcBeamlets), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "BEAMLETS_LOWER", H5T_NATIVE_INT, meta->baseBeamlets, meta->numPorts);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "BEAMLETS_UPPER", H5T_NATIVE_INT, meta->upperBeamlets, meta->numPorts);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "PACKET_LENGTH", H5T_NATIVE_INT, &(meta->packetOutputLength[file->outp]), 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "PACKETS_PER_CHUNK", H5T_NATIVE_LONG, &packetsPerChunk, 1);
+	returnVal += lofar_udp_hdf5_attr(file->dataset, "START_PACKET", H5T_NATIVE_LONG, &(meta->leadingPacket), 1);
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Free an HDF5 file struct and anything it holds open
+ *
+ * @param      file  The lofar_udp_hdf5_file
+ */
+static void lofar_udp_hdf5_free(lofar_udp_hdf5_file *file) {
+	if (file->dataset >= 0) H5Dclose(file->dataset);
+	if (file->file >= 0) H5Fclose(file->file);
+
+	if (file->compressedBlocks != NULL) {
+		for (int block = 0; block < file->compressionThreads; block++) free(file->compressedBlocks[block]);
+		free(file->compressedBlocks);
+	}
+	free(file->compressedBlockLength);
+	free(file->compressedBlockChecksum);
+	free(file->compressedChunk);
+	free(file->paddedChunk);
+	free(file);
+}
+
+
+/**
+ * @brief      Create an HDF5 file for an output of the reader. Data is stored in
+ *             an extendable 1D dataset, with one chunk per gulp and an
+ *             optional deflate filter.
+ *
+ * @param[in]  path                The output file path (replaced if it exists)
+ * @param[in]  meta                The lofar_udp_meta, after the first step or
+ *                                 reuse
+ * @param[in]  outp                The output index
+ * @param[in]  chunkLength         The length of a gulp on this output in bytes
+ * @param[in]  compressionLevel    The deflate level (0 disables compression)
+ * @param[in]  compressionThreads  The number of threads used to compress each
+ *                                 chunk
+ *
+ * @return     lofar_udp_hdf5_file ptr, or NULL on error
+ */
+lofar_udp_hdf5_file* lofar_udp_hdf5_open(const char *path, const lofar_udp_meta *meta, const int outp, const long chunkLength, const int compressionLevel, const int compressionThreads) {
+	hsize_t dims = 0, maxDims = H5S_UNLIMITED;
+	hid_t space, dcpl;
+
+	if (compressionLevel < 0 || compressionLevel > 9) {
+		fprintf(stderr, "ERROR: Deflate compression level must be between 0 and 9 (%d requested), exiting.\n", compressionLevel);
+		return NULL;
+	}
+
+	lofar_udp_hdf5_file *file = calloc(1, sizeof(lofar_udp_hdf5_file));
+	if (file == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for HDF5 file struct, exiting.\n");
+		return NULL;
+	}
+
+	file->file = -1;
+	file->dataset = -1;
+	file->outp = outp;
+	file->dtype = lofar_udp_hdf5_get_type(meta);
+	file->elementSize = H5Tget_size(file->dtype);
+	file->chunkLength = chunkLength;
+	file->chunkElements = chunkLength / file->elementSize;
+	file->compressionLevel = compressionLevel;
+	file->compressionThreads = (compressionThreads > 0) ? compressionThreads : 1;
+
+	if (chunkLength % file->elementSize != 0) {
+		fprintf(stderr, "ERROR: Gulp length %ld is not a multiple of the output element size (%d), exiting.\n", chunkLength, file->elementSize);
+		lofar_udp_hdf5_free(file);
+		return NULL;
+	}
+
+	// Don't split chunks into blocks that are too small to compress well
+	if (chunkLength / file->compressionThreads < HDF5_MIN_COMPRESSION_BLOCK) {
+		file->compressionThreads = chunkLength / HDF5_MIN_COMPRESSION_BLOCK + 1;
+	}
+
+	file->paddedChunk = calloc(chunkLength, sizeof(char));
+	if (file->compressionLevel) {
+		file->compressedBlockSize = compressBound(chunkLength / file->compressionThreads + file->compressionThreads) + 16;
+		file->compressedChunk = calloc(file->compressedBlockSize * file->compressionThreads + 6, sizeof(char));
+		file->compressedBlockLength = calloc(file->compressionThreads, sizeof(long));
+		file->compressedBlockChecksum = calloc(file->compressionThreads, sizeof(unsigned long));
+		file->compressedBlocks = calloc(file->compressionThreads, sizeof(char*));
+		for (int block = 0; file->compressedBlocks != NULL && block < file->compressionThreads; block++) {
+			file->compressedBlocks[block] = calloc(file->compressedBlockSize, sizeof(char));
+		}
+	}
+
+	file->file = H5Fcreate(path, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+	if (file->file < 0 || file->paddedChunk == NULL || (file->compressionLevel && (file->compressedChunk == NULL || file->compressedBlockLength == NULL || file->compressedBlockChecksum == NULL || file->compressedBlocks == NULL || file->compressedBlocks[file->compressionThreads - 1] == NULL))) {
+		fprintf(stderr, "ERROR: Unable to create HDF5 output at %s, exiting.\n", path);
+		lofar_udp_hdf5_free(file);
+		return NULL;
+	}
+
+	// Extendable dataset, chunked on gulp boundaries
+	space = H5Screate_simple(1, &dims, &maxDims);
+	dcpl = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(dcpl, 1, &(file->chunkElements));
+	if (file->compressionLevel) H5Pset_deflate(dcpl, file->compressionLevel);
+
+	file->dataset = H5Dcreate2(file->file, HDF5_DATASET_NAME, file->dtype, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+	H5Pclose(dcpl);
+	H5Sclose(space);
+
+	if (file->dataset < 0 || lofar_udp_hdf5_write_attrs(file, meta) > 0) {
+		fprintf(stderr, "ERROR: Unable to create HDF5 dataset in %s, exiting.\n", path);
+		lofar_udp_hdf5_free(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+
+/**
+ * @brief      Compress a chunk into a zlib stream, in parallel. Each thread
+ *             deflates a block that ends on a full flush (byte aligned, with no
+ *             back references into the next block), so the blocks can be
+ *             concatenated and wrapped with a single zlib header and combined
+ *             checksum, as the HDF5 deflate filter expects.
+ *
+ * @param      file   The lofar_udp_hdf5_file
+ * @param[in]  chunk  The (padded) chunk
+ *
+ * @return     The compressed length, or -1 on error
+ */
+static long lofar_udp_hdf5_deflate(lofar_udp_hdf5_file *file, const char *chunk) {
+	const long blockLength = file->chunkLength / file->compressionThreads;
+	unsigned long checksum = adler32(0L, Z_NULL, 0);
+	long compressedLength = 2;
+	int returnVal = 0;
+
+	#pragma omp parallel for num_threads(file->compressionThreads) reduction(+:returnVal)
+	for (int block = 0; block < file->compressionThreads; block++) {
+		const int lastBlock = block == file->compressionThreads - 1;
+		const long blockInputLength = lastBlock ? file->chunkLength - block * blockLength : blockLength;
+		z_stream stream = { 0 };
+
+		file->compressedBlockChecksum[block] = adler32(adler32(0L, Z_NULL, 0), (const Bytef*) &(chunk[block * blockLength]), blockInputLength);
+
+		if (deflateInit2(&stream, file->compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			returnVal += 1;
+			continue;
+		}
+
+		stream.next_in = (Bytef*) &(chunk[block * blockLength]);
+		stream.avail_in = blockInputLength;
+		stream.next_out = (Bytef*) file->compressedBlocks[block];
+		stream.avail_out = file->compressedBlockSize;
+
+		if (deflate(&stream, lastBlock ? Z_FINISH : Z_FULL_FLUSH) != (lastBlock ? Z_STREAM_END : Z_OK) || stream.avail_in != 0) returnVal += 1;
+		file->compressedBlockLength[block] = file->compressedBlockSize - stream.avail_out;
+		deflateEnd(&stream);
+	}
+
+	if (returnVal) {
+		fprintf(stderr, "ERROR: Failed to deflate chunk for output %d.\n", file->outp);
+		return -1;
+	}
+
+	// zlib header: deflate with a 32k window, default compression, FCHECK so that the header is a multiple of 31
+	file->compressedChunk[0] = 0x78;
+	file->compressedChunk[1] = (char) 0x9c;
+
+	for (int block = 0; block < file->compressionThreads; block++) {
+		const long blockInputLength = (block == file->compressionThreads - 1) ? file->chunkLength - block * blockLength : blockLength;
+		memcpy(&(file->compressedChunk[compressedLength]), file->compressedBlocks[block], file->compressedBlockLength[block]);
+		compressedLength += file->compressedBlockLength[block];
+		checksum = adler32_combine(checksum, file->compressedBlockChecksum[block], blockInputLength);
+	}
+
+	// Big-endian adler32 trailer
+	for (int byte = 0; byte < 4; byte++) {
+		file->compressedChunk[compressedLength++] = (char) ((checksum >> (24 - 8 * byte)) & 0xff);
+	}
+
+	return compressedLength;
+}
+
+
+/**
+ * @brief      Append a gulp to the dataset as a single chunk. Only the final
+ *             gulp may be shorter than the chunk length.
+ *
+ * @param      file        The lofar_udp_hdf5_file
+ * @param[in]  data        The gulp
+ * @param[in]  dataLength  The gulp length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_hdf5_write(lofar_udp_hdf5_file *file, const char *data, const long dataLength) {
+	const char *chunk = data;
+	hsize_t offset = file->currentElements, newDims;
+	long compressedLength = file->chunkLength;
+
+	if (dataLength == 0) return 0;
+
+	if (file->partialChunk || dataLength > file->chunkLength || dataLength % file->elementSize != 0) {
+		fprintf(stderr, "ERROR: HDF5 output %d can only accept full gulps, followed by a single short gulp (%ld bytes for a %ld byte chunk), exiting.\n", file->outp, dataLength, file->chunkLength);
+		return 1;
+	}
+
+	// Chunks are always stored at their full length, pad out a short final gulp
+	if (dataLength < file->chunkLength) {
+		memcpy(file->paddedChunk, data, dataLength);
+		memset(&(file->paddedChunk[dataLength]), 0, file->chunkLength - dataLength);
+		chunk = file->paddedChunk;
+		file->partialChunk = 1;
+	}
+
+	newDims = file->currentElements + dataLength / file->elementSize;
+	if (H5Dset_extent(file->dataset, &newDims) < 0) {
+		fprintf(stderr, "ERROR: Unable to extend HDF5 dataset for output %d, exiting.\n", file->outp);
+		return 1;
+	}
+
+	if (file->compressionLevel) {
+		if ((compressedLength = lofar_udp_hdf5_deflate(file, chunk)) < 0) return 1;
+		chunk = file->compressedChunk;
+	}
+
+	// Pass the chunk straight through to the file, skipping the HDF5 filter pipeline
+	if (H5Dwrite_chunk(file->dataset, H5P_DEFAULT, 0, &offset, compressedLength, chunk) < 0) {
+		fprintf(stderr, "ERROR: Unable to write HDF5 chunk for output %d, exiting.\n", file->outp);
+		return 1;
+	}
+
+	file->currentElements = newDims;
+	return 0;
+}
+
+
+/**
+ * @brief      Close an HDF5 file
+ *
+ * @param      file  The lofar_udp_hdf5_file
+ *
+ * @return     0: Success, 1: Failure
+ */
+int lofar_udp_hdf5_close(lofar_udp_hdf5_file *file) {
+	int returnVal = 0;
+
+	if (file == NULL) return 0;
+
+	if (H5Fflush(file->file, H5F_SCOPE_LOCAL) < 0) {
+		fprintf(stderr, "ERROR: Failed to flush HDF5 output %d.\n", file->outp);
+		returnVal = 1;
+	}
+	lofar_udp_hdf5_free(file);
+
+	return returnVal;
+}
+
+
+#else
+// Stubs for builds without HDF5 support
+
+lofar_udp_hdf5_file* lofar_udp_hdf5_open(const char *path, __attribute__((unused)) const lofar_udp_meta *meta, __attribute__((unused)) const int outp, __attribute__((unused)) const long chunkLength, __attribute__((unused)) const int compressionLevel, __attribute__((unused)) const int compressionThreads) {
+	fprintf(stderr, "ERROR: Unable to create %s, the library was built without HDF5 support (make HDF5=1), exiting.\n", path);
+	return NULL;
+}
+
+int lofar_udp_hdf5_write(__attribute__((unused)) lofar_udp_hdf5_file *file, __attribute__((unused)) const char *data, __attribute__((unused)) const long dataLength) {
+	return 1;
+}
+
+int lofar_udp_hdf5_close(__attribute__((unused)) lofar_udp_hdf5_file *file) {
+	return 0;
+}
+#endif
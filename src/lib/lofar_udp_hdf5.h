@@ -0,0 +1,42 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+
+#ifndef __LOFAR_UDP_HDF5_STRUCTS
+#define __LOFAR_UDP_HDF5_STRUCTS
+
+// HDF5 output file, defined in lofar_udp_hdf5.c so that the HDF5 headers
+// are only required when building with ALLOW_HDF5 (make HDF5=1)
+typedef struct lofar_udp_hdf5_file lofar_udp_hdf5_file;
+
+// Name of the dataset that holds the output data
+#define HDF5_DATASET_NAME "/DATA"
+
+// Minimum amount of data each thread will compress when splitting a chunk
+#define HDF5_MIN_COMPRESSION_BLOCK 65536
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_HDF5_H
+#define __LOFAR_UDP_HDF5_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+lofar_udp_hdf5_file* lofar_udp_hdf5_open(const char *path, const lofar_udp_meta *meta, const int outp, const long chunkLength, const int compressionLevel, const int compressionThreads);
+int lofar_udp_hdf5_write(lofar_udp_hdf5_file *file, const char *data, const long dataLength);
+int lofar_udp_hdf5_close(lofar_udp_hdf5_file *file);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,305 @@
+#include "lofar_udp_metrics.h"
+
+
+/**
+ * @brief      Get the current Unix time
+ *
+ * @return     The time in seconds
+ */
+static double lofar_udp_metrics_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+/**
+ * @brief      Create a shared memory metrics page that a reader's state can be
+ *             published to
+ *
+ * @param[in]  name  The shm_open name (e.g. "/lofar_udp_metrics")
+ *
+ * @return     lofar_udp_metrics ptr, or NULL on error
+ */
+lofar_udp_metrics* lofar_udp_metrics_create(const char *name) {
+	lofar_udp_metrics *metrics;
+
+	if (strlen(name) >= 255) {
+		fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", name);
+		return NULL;
+	}
+
+	metrics = calloc(1, sizeof(lofar_udp_metrics));
+	if (metrics == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for metrics endpoint, exiting.\n");
+		return NULL;
+	}
+	strcpy(metrics->name, name);
+	metrics->owner = 1;
+
+	metrics->fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (metrics->fd < 0) {
+		fprintf(stderr, "ERROR: Unable to open shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		free(metrics);
+		return NULL;
+	}
+
+	if (ftruncate(metrics->fd, sizeof(lofar_udp_metrics_page)) != 0) {
+		fprintf(stderr, "ERROR: Unable to resize shared memory at %s to %ld bytes (errno %d: %s), exiting.\n", name, (long) sizeof(lofar_udp_metrics_page), errno, strerror(errno));
+		close(metrics->fd);
+		shm_unlink(name);
+		free(metrics);
+		return NULL;
+	}
+
+	metrics->page = mmap(NULL, sizeof(lofar_udp_metrics_page), PROT_READ | PROT_WRITE, MAP_SHARED, metrics->fd, 0);
+	if (metrics->page == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Unable to map shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		close(metrics->fd);
+		shm_unlink(name);
+		free(metrics);
+		return NULL;
+	}
+
+	metrics->page->pid = (int) getpid();
+	metrics->page->startTime = lofar_udp_metrics_now();
+	metrics->page->updateTime = metrics->page->startTime;
+	metrics->page->inputRemaining = -1;
+
+	// Publish the magic last, consumers use it to determine the page is ready
+	metrics->page->version = METRICS_SHM_VERSION;
+	__atomic_store_n(&(metrics->page->magic), METRICS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return metrics;
+}
+
+
+/**
+ * @brief      Publish a reader's current state to a metrics page. This only
+ *             copies a few kB, so it can be called after every gulp; it must
+ *             only be called from a single thread.
+ *
+ * @param      metrics  The lofar_udp_metrics endpoint
+ * @param[in]  reader   The lofar_udp_reader
+ */
+void lofar_udp_metrics_publish(lofar_udp_metrics *metrics, const lofar_udp_reader *reader) {
+	if (metrics == NULL || reader == NULL) return;
+
+	lofar_udp_metrics_page *page = metrics->page;
+	const unsigned long sequence = page->sequence;
+	long inputRemaining = -1;
+
+	if (reader->readerType == ZSTDCOMPRESSED) {
+		inputRemaining = 0;
+		for (int port = 0; port < reader->meta->numPorts; port++) {
+			// The length of a stream is unknown
+			if (reader->streaming[port]) {
+				inputRemaining = -1;
+				break;
+			}
+			inputRemaining += (long) (reader->readingTracker[port].size - reader->readingTracker[port].pos);
+		}
+	}
+
+	// Odd sequence: update in progress
+	__atomic_store_n(&(page->sequence), sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	page->numPorts = reader->meta->numPorts;
+	page->processingMode = reader->meta->processingMode;
+	page->ompThreads = reader->ompThreads;
+	page->packetsPerIteration = reader->meta->packetsPerIteration;
+	page->packetsRead = reader->meta->packetsRead;
+	page->lastPacket = reader->meta->lastPacket;
+	page->inputRemaining = inputRemaining;
+	page->updateTime = lofar_udp_metrics_now();
+	lofar_udp_reader_get_stats(reader, &(page->stats));
+
+	__atomic_store_n(&(page->sequence), sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief      Unmap a metrics page, and remove it if we created it
+ *
+ * @param      metrics  The lofar_udp_metrics endpoint
+ */
+void lofar_udp_metrics_detach(lofar_udp_metrics *metrics) {
+	if (metrics == NULL) return;
+
+	munmap(metrics->page, sizeof(lofar_udp_metrics_page));
+	close(metrics->fd);
+
+	// Attached consumers keep their mapping until they detach
+	if (metrics->owner) shm_unlink(metrics->name);
+
+	free(metrics);
+}
+
+
+/**
+ * @brief      Attach to a metrics page created by another process
+ *
+ * @param[in]  name  The shm_open name of the page
+ *
+ * @return     lofar_udp_metrics ptr, or NULL on error
+ */
+lofar_udp_metrics* lofar_udp_metrics_attach(const char *name) {
+	struct stat st;
+	lofar_udp_metrics *metrics;
+
+	if (strlen(name) >= 255) {
+		fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", name);
+		return NULL;
+	}
+
+	metrics = calloc(1, sizeof(lofar_udp_metrics));
+	if (metrics == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for metrics endpoint, exiting.\n");
+		return NULL;
+	}
+	strcpy(metrics->name, name);
+
+	// Consumers only need read access, the sequence is never modified on their side
+	metrics->fd = shm_open(name, O_RDONLY, 0);
+	if (metrics->fd < 0 || fstat(metrics->fd, &st) != 0 || st.st_size < (off_t) sizeof(lofar_udp_metrics_page)) {
+		fprintf(stderr, "ERROR: Unable to open shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		if (metrics->fd >= 0) close(metrics->fd);
+		free(metrics);
+		return NULL;
+	}
+
+	metrics->page = mmap(NULL, sizeof(lofar_udp_metrics_page), PROT_READ, MAP_SHARED, metrics->fd, 0);
+	if (metrics->page == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Unable to map shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		close(metrics->fd);
+		free(metrics);
+		return NULL;
+	}
+
+	if (__atomic_load_n(&(metrics->page->magic), __ATOMIC_ACQUIRE) != METRICS_SHM_MAGIC || metrics->page->version != METRICS_SHM_VERSION) {
+		fprintf(stderr, "ERROR: Shared memory at %s is not a lofar_udp metrics page (or is from an incompatible version), exiting.\n", name);
+		lofar_udp_metrics_detach(metrics);
+		return NULL;
+	}
+
+	return metrics;
+}
+
+
+/**
+ * @brief      Take a consistent snapshot of a metrics page
+ *
+ * @param[in]  metrics   The lofar_udp_metrics endpoint
+ * @param[out] snapshot  The copy of the page
+ *
+ * @return     0: Success, -1: The publisher was mid-update for every attempt
+ */
+int lofar_udp_metrics_read(const lofar_udp_metrics *metrics, lofar_udp_metrics_page *snapshot) {
+	const lofar_udp_metrics_page *page = metrics->page;
+	unsigned long before, after;
+
+	for (int attempt = 0; attempt < METRICS_READ_ATTEMPTS; attempt++) {
+		before = __atomic_load_n(&(page->sequence), __ATOMIC_ACQUIRE);
+		if (before & 1) {
+			usleep(10);
+			continue;
+		}
+
+		memcpy(snapshot, page, sizeof(lofar_udp_metrics_page));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		after = __atomic_load_n(&(page->sequence), __ATOMIC_RELAXED);
+		if (before == after) {
+			snapshot->sequence = before;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+ * @brief      Render a metrics snapshot in the Prometheus text exposition
+ *             format
+ *
+ * @param[in]  snapshot      The metrics snapshot
+ * @param      buffer        The output buffer
+ * @param[in]  bufferLength  The output buffer length
+ *
+ * @return     The number of characters written, or -1 if the buffer was too
+ *             small
+ */
+long lofar_udp_metrics_prometheus(const lofar_udp_metrics_page *snapshot, char *buffer, const long bufferLength) {
+	const lofar_udp_reader_stats *stats = &(snapshot->stats);
+	const struct {
+		const char *name;
+		const lofar_udp_stage_stats *stage;
+	} stages[] = {
+		{ "read_step", &(stats->readStep) },
+		{ "port_read", &(stats->portRead) },
+		{ "shift", &(stats->shift) },
+		{ "headers", &(stats->headers) },
+		{ "kernel", &(stats->kernel) },
+		{ "passthrough", &(stats->passthrough) },
+		{ "calibration", &(stats->calibration) },
+		{ "write", &(stats->write) },
+		{ "write_wait", &(stats->writeWait) }
+	};
+	const int numStages = sizeof(stages) / sizeof(stages[0]);
+	long offset = 0;
+
+	// Append to the buffer, bailing out if it is exhausted
+	#define METRICS_PRINTF(...) do { \
+		const int written = snprintf(buffer + offset, bufferLength - offset, __VA_ARGS__); \
+		if (written < 0 || written >= bufferLength - offset) return -1; \
+		offset += written; \
+	} while (0)
+
+	METRICS_PRINTF("# TYPE lofar_udp_info gauge\n");
+	METRICS_PRINTF("lofar_udp_info{pid=\"%d\",ports=\"%d\",mode=\"%d\",threads=\"%d\",packets_per_iteration=\"%ld\"} 1\n", snapshot->pid, snapshot->numPorts, snapshot->processingMode, snapshot->ompThreads, snapshot->packetsPerIteration);
+	METRICS_PRINTF("# TYPE lofar_udp_start_time_seconds gauge\nlofar_udp_start_time_seconds %.6f\n", snapshot->startTime);
+	METRICS_PRINTF("# TYPE lofar_udp_update_time_seconds gauge\nlofar_udp_update_time_seconds %.6f\n", snapshot->updateTime);
+	METRICS_PRINTF("# TYPE lofar_udp_last_packet gauge\nlofar_udp_last_packet %ld\n", snapshot->lastPacket);
+	METRICS_PRINTF("# TYPE lofar_udp_input_remaining_bytes gauge\nlofar_udp_input_remaining_bytes %ld\n", snapshot->inputRemaining);
+	METRICS_PRINTF("# TYPE lofar_udp_packets_read_total counter\nlofar_udp_packets_read_total %ld\n", snapshot->packetsRead);
+	METRICS_PRINTF("# TYPE lofar_udp_gulps_read_total counter\nlofar_udp_gulps_read_total %ld\n", stats->gulpsRead);
+	METRICS_PRINTF("# TYPE lofar_udp_gulps_processed_total counter\nlofar_udp_gulps_processed_total %ld\n", stats->gulpsProcessed);
+	METRICS_PRINTF("# TYPE lofar_udp_bytes_read_total counter\nlofar_udp_bytes_read_total %ld\n", stats->bytesRead);
+	METRICS_PRINTF("# TYPE lofar_udp_bytes_decompressed_total counter\nlofar_udp_bytes_decompressed_total %ld\n", stats->bytesDecompressed);
+	METRICS_PRINTF("# TYPE lofar_udp_bytes_shifted_total counter\nlofar_udp_bytes_shifted_total %ld\n", stats->bytesShifted);
+	METRICS_PRINTF("# TYPE lofar_udp_bytes_written_total counter\nlofar_udp_bytes_written_total %ld\n", stats->bytesWritten);
+
+	METRICS_PRINTF("# TYPE lofar_udp_stage_seconds_total counter\n");
+	for (int stage = 0; stage < numStages; stage++) {
+		METRICS_PRINTF("lofar_udp_stage_seconds_total{stage=\"%s\"} %.9f\n", stages[stage].name, stages[stage].stage->totalTime);
+	}
+	METRICS_PRINTF("# TYPE lofar_udp_stage_calls_total counter\n");
+	for (int stage = 0; stage < numStages; stage++) {
+		METRICS_PRINTF("lofar_udp_stage_calls_total{stage=\"%s\"} %ld\n", stages[stage].name, stages[stage].stage->calls);
+	}
+
+	METRICS_PRINTF("# TYPE lofar_udp_perf_events_total counter\n");
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		if (stats->portReadCounters.count[counter] >= 0) METRICS_PRINTF("lofar_udp_perf_events_total{stage=\"port_read\",event=\"%s\"} %ld\n", lofar_udp_perf_name(counter), stats->portReadCounters.count[counter]);
+		if (stats->kernelCounters.count[counter] >= 0) METRICS_PRINTF("lofar_udp_perf_events_total{stage=\"kernel\",event=\"%s\"} %ld\n", lofar_udp_perf_name(counter), stats->kernelCounters.count[counter]);
+	}
+
+	METRICS_PRINTF("# TYPE lofar_udp_port_packets_dropped_total counter\n");
+	for (int port = 0; port < snapshot->numPorts && port < MAX_NUM_PORTS; port++) {
+		METRICS_PRINTF("lofar_udp_port_packets_dropped_total{port=\"%d\"} %ld\n", port, stats->portPacketsDropped[port]);
+	}
+	METRICS_PRINTF("# TYPE lofar_udp_port_packets_replayed_total counter\n");
+	for (int port = 0; port < snapshot->numPorts && port < MAX_NUM_PORTS; port++) {
+		METRICS_PRINTF("lofar_udp_port_packets_replayed_total{port=\"%d\"} %ld\n", port, stats->portPacketsReplayed[port]);
+	}
+	METRICS_PRINTF("# TYPE lofar_udp_port_packets_out_of_order_total counter\n");
+	for (int port = 0; port < snapshot->numPorts && port < MAX_NUM_PORTS; port++) {
+		METRICS_PRINTF("lofar_udp_port_packets_out_of_order_total{port=\"%d\"} %ld\n", port, stats->portPacketsOutOfOrder[port]);
+	}
+
+	#undef METRICS_PRINTF
+
+	return offset;
+}
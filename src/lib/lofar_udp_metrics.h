@@ -0,0 +1,92 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+
+#ifndef __LOFAR_UDP_METRICS_STRUCTS
+#define __LOFAR_UDP_METRICS_STRUCTS
+
+// Shared memory metrics page constants
+#define METRICS_SHM_MAGIC 0x4c4f464d
+#define METRICS_SHM_VERSION 2
+
+// Number of attempts a consumer makes to take a consistent snapshot
+#define METRICS_READ_ATTEMPTS 1024
+
+// Shared memory metrics page, protected by a seqlock
+//
+// The reader's thread increments sequence to an odd value, updates the page,
+// then increments it to an even value. Consumers copy the page and retry if
+// the sequence was odd or changed while they were copying.
+typedef struct lofar_udp_metrics_page {
+	int magic;
+	int version;
+	unsigned long sequence;
+
+	// Process and reader configuration
+	int pid;
+	int numPorts;
+	int processingMode;
+	int ompThreads;
+	long packetsPerIteration;
+
+	// Unix time the page was created and last updated
+	double startTime;
+	double updateTime;
+
+	// Reader position, and the compressed input remaining (-1 for uncompressed or streamed inputs)
+	long packetsRead;
+	long lastPacket;
+	long inputRemaining;
+
+	// Snapshot of the reader's instrumentation counters
+	lofar_udp_reader_stats stats;
+
+} lofar_udp_metrics_page;
+
+
+// Metrics endpoint handle, for both the publisher and consumers
+typedef struct lofar_udp_metrics {
+	char name[256];
+	int fd;
+	int owner;
+	lofar_udp_metrics_page *page;
+} lofar_udp_metrics;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_METRICS_H
+#define __LOFAR_UDP_METRICS_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Publisher
+lofar_udp_metrics* lofar_udp_metrics_create(const char *name);
+void lofar_udp_metrics_publish(lofar_udp_metrics *metrics, const lofar_udp_reader *reader);
+
+// Consumers
+lofar_udp_metrics* lofar_udp_metrics_attach(const char *name);
+int lofar_udp_metrics_read(const lofar_udp_metrics *metrics, lofar_udp_metrics_page *snapshot);
+long lofar_udp_metrics_prometheus(const lofar_udp_metrics_page *snapshot, char *buffer, const long bufferLength);
+
+// Both
+void lofar_udp_metrics_detach(lofar_udp_metrics *metrics);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -8,16 +8,55 @@ const double clock200MHzSample = 1.0 / CLOCK200MHZ;
 const double clock160MHzSample = 1.0 / CLOCK160MHZ;
 
 
+/**
+ * @brief      Get the first sample of a Unix second, as counted by the packet
+ *             sequence values (the 200MHz clock does not have an integer
+ *             number of samples per second, so this is rounded)
+ *
+ * @param[in]  second       The Unix second
+ * @param[in]  clock200MHz  bool: 0 for 160MHz clock, 1 for 200MHz clock
+ *
+ * @return     The sample number
+ */
+static long lofar_get_second_sample(long second, unsigned int clock200MHz) {
+	return (second*1000000l*(160+40*clock200MHz)+512)/1024;
+}
+
 // Taken from Olaf Wucknitz' VBLI recorder, with modifiedcations for aribtrary input data
 long beamformed_packno(unsigned int timestamp, unsigned int sequence, unsigned int clock200MHz) {
  	//VERBOSE(printf("Packetno: %d, %d, %d\n", timestamp, sequence, clock200MHz););
-	return ((timestamp*1000000l*(160+40*clock200MHz)+512)/1024+sequence)/16;
+	return (lofar_get_second_sample(timestamp, clock200MHz)+sequence)/16;
+}
+
+/**
+ * @brief      Get the Unix second containing a sample (UDPNTIMESLICE per
+ *             packet number), and the sample's offset into that second (the
+ *             sequence value of a packet starting on the sample)
+ *
+ * @param[in]  sample       The sample number
+ * @param[in]  clock200MHz  bool: 0 for 160MHz clock, 1 for 200MHz clock
+ * @param[out] offset       The offset into the second (may be NULL)
+ *
+ * @return     The Unix second
+ */
+long lofar_get_sample_second(long sample, unsigned int clock200MHz, long *offset) {
+	long second = (sample * 1024) / (1000000l * (160 + 40 * clock200MHz));
+
+	// Correct for the rounding of the second's first sample near the boundary
+	if (lofar_get_second_sample(second, clock200MHz) > sample) {
+		second -= 1;
+	} else if (lofar_get_second_sample(second + 1, clock200MHz) <= sample) {
+		second += 1;
+	}
+
+	if (offset != NULL) *offset = sample - lofar_get_second_sample(second, clock200MHz);
+	return second;
 }
 
 
-// Shorthand note: 
-//*((unsigned int*) &(inputData[8])) == unsigned int at 8 bytes from the header offset (packet number)
-//*((unsigned int*) &(inputData[12])) == unsigned int at 12 bytes from the header offset (sequence ID)
+// Shorthand note: inputData points to the CEP header, after any per-packet header offset (lofar_udp_meta.headerOffset)
+//*((unsigned int*) &(inputData[8])) == unsigned int at 8 bytes from the CEP header (packet number)
+//*((unsigned int*) &(inputData[12])) == unsigned int at 12 bytes from the CEP header (sequence ID)
 
 
 /**
@@ -29,7 +68,7 @@ long beamformed_packno(unsigned int timestamp, unsigned int sequence, unsigned i
  * @return     The packet number
  */
 long lofar_get_packet_number(char *inputData) {
-	return beamformed_packno(*((unsigned int*) &(inputData[UDPHDROFF + 8])), *((unsigned int*) &(inputData[UDPHDROFF + 12])), ((lofar_source_bytes*) &(inputData[UDPHDROFF + 1]))->clockBit);
+	return beamformed_packno(*((unsigned int*) &(inputData[8])), *((unsigned int*) &(inputData[12])), ((lofar_source_bytes*) &(inputData[1]))->clockBit);
 }
 
 /**
@@ -43,8 +82,8 @@ long lofar_get_packet_number(char *inputData) {
  */
 unsigned int lofar_get_next_packet_sequence(char *inputData) {
 	return (unsigned int) ((16 * \
-			(beamformed_packno(*((unsigned int*) &(inputData[UDPHDROFF + 8])), *((unsigned int*) &(inputData[UDPHDROFF + 12])), ((lofar_source_bytes*) &(inputData[UDPHDROFF + 1]))->clockBit) + 1)) 
-			- (*((unsigned int*) &(inputData[UDPHDROFF + 8]))*1000000l*200+512)/1024);
+			(beamformed_packno(*((unsigned int*) &(inputData[8])), *((unsigned int*) &(inputData[12])), ((lofar_source_bytes*) &(inputData[1]))->clockBit) + 1)) 
+			- (*((unsigned int*) &(inputData[8]))*1000000l*200+512)/1024);
 }
 
 /**
@@ -69,7 +108,7 @@ long lofar_get_packet_difference(unsigned int ts, long packetNumber, unsigned in
  * @return     Unix time double
  */
 double lofar_get_packet_time(char *inputData) {
-	return (double) *((unsigned int*) &(inputData[UDPHDROFF + 8])) + ((double) *((unsigned int*) &(inputData[UDPHDROFF + 12])) / (clock160MHzSteps + clockStepsDelta * ((lofar_source_bytes*) &(inputData[UDPHDROFF + 1]))->clockBit));
+	return (double) *((unsigned int*) &(inputData[8])) + ((double) *((unsigned int*) &(inputData[12])) / (clock160MHzSteps + clockStepsDelta * ((lofar_source_bytes*) &(inputData[1]))->clockBit));
 }
 
 /**
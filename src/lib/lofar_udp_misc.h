@@ -23,6 +23,7 @@ extern "C" {
 #endif
 
 long beamformed_packno(unsigned int timestamp, unsigned int sequence, unsigned int clock200MHz);
+long lofar_get_sample_second(long sample, unsigned int clock200MHz, long *offset);
 long lofar_get_packet_number(char *inputData);
 unsigned int lofar_get_next_packet_sequence(char *inputData);
 double lofar_get_packet_time(char *inputData);
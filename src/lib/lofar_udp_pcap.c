@@ -0,0 +1,486 @@
+// mremap
+#define _GNU_SOURCE
+#include "lofar_udp_pcap.h"
+#include "lofar_udp_general.h"
+
+
+/**
+ * @brief      Read a field in the byte order of the capture
+ */
+static unsigned int lofar_udp_pcap_u32(const lofar_udp_pcap *pcap, const unsigned char *field) {
+	unsigned int value;
+	memcpy(&value, field, sizeof(value));
+	return pcap->swapped ? __builtin_bswap32(value) : value;
+}
+
+static unsigned int lofar_udp_pcap_u16(const lofar_udp_pcap *pcap, const unsigned char *field) {
+	unsigned short value;
+	memcpy(&value, field, sizeof(value));
+	return pcap->swapped ? __builtin_bswap16(value) : value;
+}
+
+/**
+ * @brief      Read a field in network byte order
+ */
+static unsigned int lofar_udp_pcap_be16(const unsigned char *field) {
+	return ((unsigned int) field[0] << 8) | field[1];
+}
+
+
+/**
+ * @brief      Check if a buffer starts with a pcap or pcapng header
+ *
+ * @param[in]  header  The first bytes of the input
+ * @param[in]  length  The length of header
+ *
+ * @return     1: pcap / pcapng, 0: Other
+ */
+int lofar_udp_pcap_detect(const void *header, const long length) {
+	unsigned int magic;
+
+	if (length < (long) sizeof(magic)) return 0;
+	memcpy(&magic, header, sizeof(magic));
+
+	return magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC || magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC) || magic == PCAPNG_SHB_TYPE;
+}
+
+
+/**
+ * @brief      Memory map a pcap / pcapng capture and parse its file header
+ *
+ * @param      inputFile  The input capture (must be seekable)
+ * @param[in]  udpPort       The UDP destination port to keep (0: keep every
+ *                           UDP datagram)
+ * @param[in]  headerOffset  The number of (zeroed) bytes to insert before
+ *                           each CEP packet
+ *
+ * @return     lofar_udp_pcap ptr, or NULL on error
+ */
+lofar_udp_pcap* lofar_udp_pcap_open(FILE *inputFile, const int udpPort, const int headerOffset) {
+	struct stat stat_s;
+	unsigned int magic;
+
+	if (fstat(fileno(inputFile), &stat_s) == -1 || !S_ISREG(stat_s.st_mode)) {
+		fprintf(stderr, "ERROR: pcap inputs must be regular files that can be memory mapped, exiting.\n");
+		return NULL;
+	}
+
+	if (stat_s.st_size < PCAP_GLOBAL_HDR_LEN) {
+		fprintf(stderr, "ERROR: Input is too short to be a pcap capture (%ld bytes), exiting.\n", (long) stat_s.st_size);
+		return NULL;
+	}
+
+	lofar_udp_pcap *pcap = calloc(1, sizeof(lofar_udp_pcap));
+	if (pcap == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for pcap reader, exiting.\n");
+		return NULL;
+	}
+
+	pcap->size = stat_s.st_size;
+	pcap->udpPort = udpPort;
+	pcap->headerOffset = headerOffset;
+	pcap->data = mmap(NULL, pcap->size, PROT_READ, MAP_PRIVATE, fileno(inputFile), 0);
+	if (pcap->data == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to create memory mapping for pcap capture. Errno: %d. Exiting.\n", errno);
+		free(pcap);
+		return NULL;
+	}
+	madvise((void*) pcap->data, pcap->size, MADV_SEQUENTIAL);
+
+	memcpy(&magic, pcap->data, sizeof(magic));
+	if (magic == PCAPNG_SHB_TYPE) {
+		// Section headers (and their byte order) are handled as blocks while walking the file
+		pcap->pcapng = 1;
+		pcap->offset = 0;
+	} else if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC || magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC)) {
+		pcap->swapped = (magic != PCAP_MAGIC_USEC && magic != PCAP_MAGIC_NSEC);
+		pcap->numInterfaces = 1;
+		// The upper 16 bits may hold FCS information
+		pcap->linkTypes[0] = (int) (lofar_udp_pcap_u32(pcap, &(pcap->data[20])) & 0xFFFF);
+		pcap->offset = PCAP_GLOBAL_HDR_LEN;
+	} else {
+		fprintf(stderr, "ERROR: Input is not a pcap or pcapng capture (magic 0x%08x), exiting.\n", magic);
+		lofar_udp_pcap_close(pcap);
+		return NULL;
+	}
+
+	return pcap;
+}
+
+
+/**
+ * @brief      Extend the memory mapping of a capture that is still being
+ *             written
+ *
+ * @param      pcap       The lofar_udp_pcap
+ * @param      inputFile  The input capture
+ *
+ * @return     0: Success (the capture may not have grown), 1: Fatal error
+ */
+int lofar_udp_pcap_extend(lofar_udp_pcap *pcap, FILE *inputFile) {
+	struct stat stat_s;
+	void *tmpPtr;
+
+	if (fstat(fileno(inputFile), &stat_s) == -1) {
+		fprintf(stderr, "ERROR: Unable to stat pcap capture. Errno: %d. Exiting.\n", errno);
+		return 1;
+	}
+
+	if (stat_s.st_size <= pcap->size) return 0;
+
+	tmpPtr = mremap((void*) pcap->data, pcap->size, stat_s.st_size, MREMAP_MAYMOVE);
+	if (tmpPtr == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to extend memory mapping for pcap capture. Errno: %d. Exiting.\n", errno);
+		return 1;
+	}
+
+	if (pcap->payload != NULL) pcap->payload = (const unsigned char*) tmpPtr + (pcap->payload - pcap->data);
+	pcap->data = tmpPtr;
+	pcap->size = stat_s.st_size;
+	madvise((void*) pcap->data, pcap->size, MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+
+/**
+ * @brief      Move to the next captured frame. A record that has not been
+ *             completely written is left in place, so that it can be retried
+ *             after the capture has grown.
+ *
+ * @param      pcap      The lofar_udp_pcap
+ * @param[out] linkType  The link layer of the frame
+ * @param[out] frame     The frame
+ * @param[out] length    The captured length of the frame
+ *
+ * @return     0: Success, -1: End of the capture
+ */
+static int lofar_udp_pcap_next_frame(lofar_udp_pcap *pcap, int *linkType, const unsigned char **frame, long *length) {
+	const unsigned char *block;
+	unsigned int type, blockLength, interface, magic;
+	long captured;
+
+	while (1) {
+		block = &(pcap->data[pcap->offset]);
+
+		if (!pcap->pcapng) {
+			if (pcap->offset + PCAP_RECORD_HDR_LEN > pcap->size) return -1;
+			captured = lofar_udp_pcap_u32(pcap, &(block[8]));
+			if (pcap->offset + PCAP_RECORD_HDR_LEN + captured > pcap->size) return -1;
+
+			pcap->offset += PCAP_RECORD_HDR_LEN + captured;
+			*linkType = pcap->linkTypes[0];
+			*frame = &(block[PCAP_RECORD_HDR_LEN]);
+			*length = captured;
+			return 0;
+		}
+
+		// pcapng: blocks are (type, length, body, length), each section header sets the byte order of its section
+		if (pcap->offset + 12 > pcap->size) return -1;
+		memcpy(&type, block, sizeof(type));
+		if (type == PCAPNG_SHB_TYPE) {
+			memcpy(&magic, &(block[8]), sizeof(magic));
+			if (magic != PCAPNG_BYTE_ORDER_MAGIC && magic != __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC)) {
+				fprintf(stderr, "ERROR: Corrupt pcapng section header at offset %ld, treating it as the end of the capture.\n", pcap->offset);
+				return -1;
+			}
+			pcap->swapped = (magic != PCAPNG_BYTE_ORDER_MAGIC);
+		}
+		type = lofar_udp_pcap_u32(pcap, block);
+
+		blockLength = lofar_udp_pcap_u32(pcap, &(block[4]));
+		if (blockLength < 12 || blockLength % 4) {
+			fprintf(stderr, "ERROR: Corrupt pcapng block at offset %ld, treating it as the end of the capture.\n", pcap->offset);
+			return -1;
+		}
+		if (pcap->offset + blockLength > pcap->size) return -1;
+		pcap->offset += blockLength;
+
+		switch (type) {
+			case PCAPNG_SHB_TYPE:
+				pcap->numInterfaces = 0;
+				break;
+
+			case PCAPNG_IDB_TYPE:
+				if (blockLength >= 20 && pcap->numInterfaces < PCAP_MAX_INTERFACES) {
+					pcap->linkTypes[pcap->numInterfaces] = (int) lofar_udp_pcap_u16(pcap, &(block[8]));
+				}
+				pcap->numInterfaces += 1;
+				break;
+
+			case PCAPNG_EPB_TYPE:
+				if (blockLength < 32) break;
+				interface = lofar_udp_pcap_u32(pcap, &(block[8]));
+				captured = lofar_udp_pcap_u32(pcap, &(block[20]));
+				// Block header, packet data and the trailing block length
+				if (28 + captured + 4 > blockLength || interface >= (unsigned int) pcap->numInterfaces || interface >= PCAP_MAX_INTERFACES) break;
+
+				*linkType = pcap->linkTypes[interface];
+				*frame = &(block[28]);
+				*length = captured;
+				return 0;
+
+			case PCAPNG_SPB_TYPE:
+				if (blockLength < 16 || pcap->numInterfaces < 1) break;
+				captured = lofar_udp_pcap_u32(pcap, &(block[8]));
+				if (captured > blockLength - 16) captured = blockLength - 16;
+
+				*linkType = pcap->linkTypes[0];
+				*frame = &(block[12]);
+				*length = captured;
+				return 0;
+
+			default:
+				break;
+		}
+	}
+}
+
+
+/**
+ * @brief      Find the UDP payload in a captured frame
+ *
+ * @param[in]  linkType  The link layer of the frame
+ * @param[in]  frame     The frame
+ * @param[in]  length    The captured length of the frame
+ * @param[in]  udpPort   The UDP destination port to keep (0: any)
+ * @param[out] payload   The UDP payload
+ *
+ * @return     >= 0: Payload length, -1: Not a wanted datagram, -2: IP
+ *             fragment, -3: Truncated datagram
+ */
+static long lofar_udp_pcap_udp_payload(const int linkType, const unsigned char *frame, const long length, const int udpPort, const unsigned char **payload) {
+	const unsigned char *ip, *udp;
+	unsigned int etherType = 0;
+	long offset, ipHeaderLength, udpLength;
+
+	switch (linkType) {
+		case PCAP_LINKTYPE_ETHERNET:
+			if (length < 14) return -1;
+			etherType = lofar_udp_pcap_be16(&(frame[12]));
+			offset = 14;
+			// Skip 802.1Q / 802.1ad VLAN tags
+			while ((etherType == 0x8100 || etherType == 0x88a8) && length >= offset + 4) {
+				etherType = lofar_udp_pcap_be16(&(frame[offset + 2]));
+				offset += 4;
+			}
+			break;
+
+		case PCAP_LINKTYPE_LINUX_SLL:
+			if (length < 16) return -1;
+			etherType = lofar_udp_pcap_be16(&(frame[14]));
+			offset = 16;
+			break;
+
+		case PCAP_LINKTYPE_LINUX_SLL2:
+			if (length < 20) return -1;
+			etherType = lofar_udp_pcap_be16(&(frame[0]));
+			offset = 20;
+			break;
+
+		// The loopback family is in either byte order, use the IP version instead
+		case PCAP_LINKTYPE_NULL:
+		case PCAP_LINKTYPE_LOOP:
+			offset = 4;
+			break;
+
+		case PCAP_LINKTYPE_RAW:
+		case PCAP_LINKTYPE_IPV4:
+		case PCAP_LINKTYPE_IPV6:
+			offset = 0;
+			break;
+
+		default:
+			return -1;
+	}
+
+	if (length < offset + 1) return -1;
+	ip = &(frame[offset]);
+	if (etherType == 0) etherType = ((ip[0] >> 4) == 4) ? 0x0800 : (((ip[0] >> 4) == 6) ? 0x86DD : 0);
+
+	if (etherType == 0x0800) {
+		if (length < offset + 20 || (ip[0] >> 4) != 4) return -1;
+		ipHeaderLength = (ip[0] & 0x0F) * 4;
+		if (ip[9] != 17) return -1;
+		// More fragments flag or a fragment offset
+		if (lofar_udp_pcap_be16(&(ip[6])) & 0x3FFF) return -2;
+	} else if (etherType == 0x86DD) {
+		if (length < offset + 40 || (ip[0] >> 4) != 6) return -1;
+		ipHeaderLength = 40;
+		// Fragment extension header
+		if (ip[6] == 44) return -2;
+		if (ip[6] != 17) return -1;
+	} else {
+		return -1;
+	}
+
+	if (length < offset + ipHeaderLength + 8) return -3;
+	udp = &(ip[ipHeaderLength]);
+	if (udpPort > 0 && lofar_udp_pcap_be16(&(udp[2])) != (unsigned int) udpPort) return -1;
+
+	udpLength = lofar_udp_pcap_be16(&(udp[4]));
+	if (udpLength <= 8) return -1;
+	if (length < offset + ipHeaderLength + udpLength) return -3;
+
+	*payload = &(udp[8]);
+	return udpLength - 8;
+}
+
+
+/**
+ * @brief      Check that a UDP payload holds a CEP packet, using the same
+ *             sanity checks as the reader applies to the first header of
+ *             each port
+ *
+ * @param[in]  packet  The UDP payload
+ * @param[in]  length  The payload length
+ *
+ * @return     >0: The packet length described by the CEP header, -1: Not a
+ *             CEP packet
+ */
+static long lofar_udp_pcap_cep_length(const unsigned char *packet, const long length) {
+	lofar_source_bytes source;
+	unsigned int timestamp, sequence;
+
+	if (length < UDPHDRLEN) return -1;
+
+	memcpy(&source, &(packet[1]), sizeof(source));
+	memcpy(&timestamp, &(packet[8]), sizeof(timestamp));
+	memcpy(&sequence, &(packet[12]), sizeof(sequence));
+
+	if (packet[0] < UDPCURVER || packet[6] == 0 || packet[6] > UDPMAXBEAM || packet[7] != UDPNTIMESLICE) return -1;
+	if (timestamp < LFREPOCH || sequence > RSPMAXSEQ) return -1;
+	if (source.padding0 != 0 || source.errorBit != 0 || source.bitMode == 3 || source.padding1 > 1) return -1;
+
+	// Bit mode 0, 1, 2: 16, 8, 4 bit samples
+	return UDPHDRLEN + (long) packet[6] * UDPNTIMESLICE * UDPNPOL * (16 >> source.bitMode) / 8;
+}
+
+
+/**
+ * @brief      Move to the payload of the next wanted UDP datagram. Datagrams
+ *             that are not CEP packets, or that differ in length from the
+ *             first CEP packet, are skipped so that they cannot shift the
+ *             packet stream.
+ *
+ * @param      pcap  The lofar_udp_pcap
+ *
+ * @return     0: Success, -1: End of the capture
+ */
+static int lofar_udp_pcap_next_payload(lofar_udp_pcap *pcap) {
+	const unsigned char *frame;
+	long frameLength, payloadLength, cepLength;
+	int linkType;
+
+	while (lofar_udp_pcap_next_frame(pcap, &linkType, &frame, &frameLength) == 0) {
+		payloadLength = lofar_udp_pcap_udp_payload(linkType, frame, frameLength, pcap->udpPort, &(pcap->payload));
+
+		if (payloadLength > 0) {
+			cepLength = lofar_udp_pcap_cep_length(pcap->payload, payloadLength);
+			if (cepLength != payloadLength || (pcap->packetLength > 0 && payloadLength != pcap->packetLength)) {
+				if (!pcap->rejected++) fprintf(stderr, "WARNING: Skipping UDP datagrams in the capture that are not CEP packets of the expected length (first at offset %ld, %ld bytes).\n", (long) (pcap->payload - pcap->data), payloadLength);
+				continue;
+			}
+
+			pcap->packetLength = payloadLength;
+			pcap->prefixRemaining = pcap->headerOffset;
+			pcap->payloadRemaining = payloadLength;
+			return 0;
+		} else if (payloadLength == -2) {
+			if (!pcap->fragmented++) fprintf(stderr, "WARNING: Skipping fragmented IP datagrams in the capture, they are not reassembled.\n");
+		} else if (payloadLength == -3) {
+			if (!pcap->truncated++) fprintf(stderr, "WARNING: Skipping datagrams truncated by the capture's snap length.\n");
+		}
+	}
+
+	return -1;
+}
+
+
+/**
+ * @brief      Read the next nchars bytes of UDP payloads from the capture.
+ *             Payloads are copied directly from the memory mapping, so the
+ *             headers are stripped without an intermediate buffer. Each
+ *             payload is preceded by headerOffset zeroed bytes.
+ *
+ * @param      pcap         The lofar_udp_pcap
+ * @param      targetArray  The storage array
+ * @param[in]  nchars       The number of chars (bytes) to read in
+ *
+ * @return     long: bytes read
+ */
+long lofar_udp_pcap_read(lofar_udp_pcap *pcap, char *targetArray, const long nchars) {
+	long dataRead = 0, length, consumed;
+	const long pageSize = sysconf(_SC_PAGESIZE);
+
+	while (dataRead < nchars) {
+		if (pcap->prefixRemaining == 0 && pcap->payloadRemaining == 0 && lofar_udp_pcap_next_payload(pcap) != 0) break;
+
+		if (pcap->prefixRemaining > 0) {
+			length = pcap->prefixRemaining < (nchars - dataRead) ? pcap->prefixRemaining : (nchars - dataRead);
+			memset(&(targetArray[dataRead]), 0, length);
+			pcap->prefixRemaining -= length;
+			dataRead += length;
+			continue;
+		}
+
+		length = pcap->payloadRemaining < (nchars - dataRead) ? pcap->payloadRemaining : (nchars - dataRead);
+		memcpy(&(targetArray[dataRead]), pcap->payload, length);
+		pcap->payload += length;
+		pcap->payloadRemaining -= length;
+		dataRead += length;
+	}
+
+	// Drop the pages we have finished with, so that large captures are not kept resident
+	consumed = pcap->payloadRemaining > 0 ? (long) (pcap->payload - pcap->data) : pcap->offset;
+	consumed -= consumed % pageSize;
+	if (consumed - pcap->released > PCAP_RELEASE_BYTES) {
+		madvise((void*) &(pcap->data[pcap->released]), consumed - pcap->released, MADV_DONTNEED);
+		pcap->released = consumed;
+	}
+
+	return dataRead;
+}
+
+
+/**
+ * @brief      Read the first nchars bytes of UDP payloads from a capture,
+ *             without moving the position of the input file
+ *
+ * @param      inputFile    The input capture
+ * @param[in]  udpPort       The UDP destination port to keep (0: any)
+ * @param[in]  headerOffset  The number of bytes to insert before each CEP
+ *                           packet
+ * @param      targetArray   The storage array
+ * @param[in]  nchars        The number of chars (bytes) to read in
+ *
+ * @return     long: bytes read, -1 on error
+ */
+long lofar_udp_pcap_peek(FILE *inputFile, const int udpPort, const int headerOffset, char *targetArray, const long nchars) {
+	long dataRead;
+
+	lofar_udp_pcap *pcap = lofar_udp_pcap_open(inputFile, udpPort, headerOffset);
+	if (pcap == NULL) return -1;
+
+	dataRead = lofar_udp_pcap_read(pcap, targetArray, nchars);
+	lofar_udp_pcap_close(pcap);
+
+	return dataRead;
+}
+
+
+/**
+ * @brief      Unmap a capture
+ *
+ * @param      pcap  The lofar_udp_pcap
+ */
+void lofar_udp_pcap_close(lofar_udp_pcap *pcap) {
+	if (pcap == NULL) return;
+
+	if (pcap->fragmented || pcap->truncated || pcap->rejected) {
+		fprintf(stderr, "WARNING: %ld fragmented, %ld truncated and %ld non-CEP datagrams were skipped in the capture.\n", pcap->fragmented, pcap->truncated, pcap->rejected);
+	}
+
+	munmap((void*) pcap->data, pcap->size);
+	free(pcap);
+}
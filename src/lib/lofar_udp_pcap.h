@@ -0,0 +1,103 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef __LOFAR_UDP_PCAP_STRUCTS
+#define __LOFAR_UDP_PCAP_STRUCTS
+
+// Capture file magic numbers (as read on a little endian host)
+#define PCAP_MAGIC_USEC 0xa1b2c3d4
+#define PCAP_MAGIC_NSEC 0xa1b23c4d
+#define PCAPNG_SHB_TYPE 0x0a0d0d0a
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1a2b3c4d
+
+// Classic pcap header and record header lengths
+#define PCAP_GLOBAL_HDR_LEN 24
+#define PCAP_RECORD_HDR_LEN 16
+
+// pcapng block types we need
+#define PCAPNG_IDB_TYPE 0x00000001
+#define PCAPNG_SPB_TYPE 0x00000003
+#define PCAPNG_EPB_TYPE 0x00000006
+
+// Maximum number of interfaces tracked per pcapng section
+#define PCAP_MAX_INTERFACES 16
+
+// Consumed pages of the capture are released after this many bytes
+#define PCAP_RELEASE_BYTES (64 * 1024 * 1024)
+
+// Supported link layers (see https://www.tcpdump.org/linktypes.html)
+typedef enum lofar_udp_pcap_linktype {
+	PCAP_LINKTYPE_NULL = 0,
+	PCAP_LINKTYPE_ETHERNET = 1,
+	PCAP_LINKTYPE_RAW = 101,
+	PCAP_LINKTYPE_LOOP = 108,
+	PCAP_LINKTYPE_LINUX_SLL = 113,
+	PCAP_LINKTYPE_IPV4 = 228,
+	PCAP_LINKTYPE_IPV6 = 229,
+	PCAP_LINKTYPE_LINUX_SLL2 = 276
+} lofar_udp_pcap_linktype;
+
+
+// Memory mapped pcap / pcapng capture, walked one UDP datagram at a time
+typedef struct lofar_udp_pcap {
+	const unsigned char *data;
+	long size;
+	long offset;
+	long released;
+
+	// Capture format, and link layer of each interface (classic pcap files have a single interface)
+	int pcapng;
+	int swapped;
+	int numInterfaces;
+	int linkTypes[PCAP_MAX_INTERFACES];
+
+	// UDP destination port to keep (0: keep every UDP datagram)
+	int udpPort;
+
+	// Bytes inserted before each CEP packet to match the reader's header offset
+	int headerOffset;
+
+	// CEP packet length, set by the first valid packet; datagrams of any other length are skipped
+	long packetLength;
+
+	// Unread prefix and payload of the current datagram
+	long prefixRemaining;
+	const unsigned char *payload;
+	long payloadRemaining;
+
+	// Datagrams that could not be used
+	long fragmented;
+	long truncated;
+	long rejected;
+
+} lofar_udp_pcap;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_PCAP_H
+#define __LOFAR_UDP_PCAP_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_pcap_detect(const void *header, const long length);
+lofar_udp_pcap* lofar_udp_pcap_open(FILE *inputFile, const int udpPort, const int headerOffset);
+int lofar_udp_pcap_extend(lofar_udp_pcap *pcap, FILE *inputFile);
+long lofar_udp_pcap_read(lofar_udp_pcap *pcap, char *targetArray, const long nchars);
+long lofar_udp_pcap_peek(FILE *inputFile, const int udpPort, const int headerOffset, char *targetArray, const long nchars);
+void lofar_udp_pcap_close(lofar_udp_pcap *pcap);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
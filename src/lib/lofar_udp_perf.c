@@ -0,0 +1,156 @@
+#include "lofar_udp_perf.h"
+
+// Event type / config for each lofar_udp_perf_counter
+static const struct {
+	const char *name;
+	unsigned int type;
+	unsigned long config;
+} perfEvents[PERF_NUM_COUNTERS] = {
+	{ "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ "llc_references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+	{ "llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ "task_clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }
+};
+
+
+/**
+ * @brief      Open the hardware counters for the calling process
+ *
+ *             Counters are inherited by threads created after this call, so
+ *             it must be called before the first OpenMP parallel region (or
+ *             the thread pool will not be counted). Only user space is
+ *             counted, so this works with the default perf_event_paranoid
+ *             level of 2 and needs no extra tooling or privileges. The
+ *             counts are process-wide, see lofar_udp_perf_counters.
+ *
+ * @return     lofar_udp_perf ptr, or NULL if no counters could be opened
+ */
+lofar_udp_perf* lofar_udp_perf_setup() {
+	struct perf_event_attr attr;
+	int opened = 0;
+
+	lofar_udp_perf *perf = calloc(1, sizeof(lofar_udp_perf));
+	if (perf == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for performance counters, exiting.\n");
+		return NULL;
+	}
+
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perfEvents[counter].type;
+		attr.config = perfEvents[counter].config;
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		// Events are opened individually (inherited counters cannot be read as a group), so scale for multiplexing
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		perf->fd[counter] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (perf->fd[counter] < 0) {
+			fprintf(stderr, "WARNING: Unable to open the %s performance counter (errno %d: %s), it will not be reported.\n", perfEvents[counter].name, errno, strerror(errno));
+			continue;
+		}
+		opened++;
+	}
+
+	if (!opened) {
+		free(perf);
+		return NULL;
+	}
+
+	return perf;
+}
+
+
+/**
+ * @brief      Read the current value of each counter
+ *
+ * @param[in]  perf      The lofar_udp_perf (may be NULL)
+ * @param[out] counters  The counter values, -1 for unavailable counters
+ *
+ * @return     0: Success, -1: Counters unavailable
+ */
+int lofar_udp_perf_read(const lofar_udp_perf *perf, lofar_udp_perf_counters *counters) {
+	unsigned long values[3];
+
+	lofar_udp_perf_reset(perf, counters);
+	if (perf == NULL) return -1;
+
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		if (perf->fd[counter] < 0) continue;
+
+		if (read(perf->fd[counter], values, sizeof(values)) != sizeof(values)) {
+			counters->count[counter] = -1;
+			continue;
+		}
+
+		// values: count, time enabled, time running
+		if (values[2] > 0 && values[2] < values[1]) {
+			counters->count[counter] = (long) ((double) values[0] * (double) values[1] / (double) values[2]);
+		} else {
+			counters->count[counter] = (long) values[0];
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Zero the counters that are available, mark the others as
+ *             unavailable (-1)
+ *
+ * @param[in]  perf      The lofar_udp_perf (NULL marks all as unavailable)
+ * @param[out] counters  The counters to reset
+ */
+void lofar_udp_perf_reset(const lofar_udp_perf *perf, lofar_udp_perf_counters *counters) {
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		counters->count[counter] = (perf != NULL && perf->fd[counter] >= 0) ? 0 : -1;
+	}
+}
+
+
+/**
+ * @brief      Add the difference between two readings to a running total
+ *
+ * @param      total  The running total
+ * @param[in]  start  The reading before the stage
+ * @param[in]  end    The reading after the stage
+ */
+void lofar_udp_perf_accumulate(lofar_udp_perf_counters *total, const lofar_udp_perf_counters *start, const lofar_udp_perf_counters *end) {
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		if (total->count[counter] < 0 || start->count[counter] < 0 || end->count[counter] < 0) continue;
+		total->count[counter] += end->count[counter] - start->count[counter];
+	}
+}
+
+
+/**
+ * @brief      Get the name of a counter
+ *
+ * @param[in]  counter  The lofar_udp_perf_counter
+ *
+ * @return     The name, or "unknown"
+ */
+const char* lofar_udp_perf_name(const int counter) {
+	if (counter < 0 || counter >= PERF_NUM_COUNTERS) return "unknown";
+	return perfEvents[counter].name;
+}
+
+
+/**
+ * @brief      Close the counters
+ *
+ * @param      perf  The lofar_udp_perf
+ */
+void lofar_udp_perf_cleanup(lofar_udp_perf *perf) {
+	if (perf == NULL) return;
+
+	for (int counter = 0; counter < PERF_NUM_COUNTERS; counter++) {
+		if (perf->fd[counter] >= 0) close(perf->fd[counter]);
+	}
+
+	free(perf);
+}
@@ -0,0 +1,62 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifndef __LOFAR_UDP_PERF_STRUCTS
+#define __LOFAR_UDP_PERF_STRUCTS
+
+// Bytes moved from memory on each last level cache miss, used to estimate memory bandwidth
+#define PERF_CACHE_LINE 64
+
+// Counters opened by lofar_udp_perf_setup
+typedef enum lofar_udp_perf_counter {
+	PERF_CYCLES = 0,
+	PERF_INSTRUCTIONS = 1,
+	PERF_LLC_REFERENCES = 2,
+	PERF_LLC_MISSES = 3,
+	PERF_TASK_CLOCK = 4,
+	PERF_NUM_COUNTERS = 5
+} lofar_udp_perf_counter;
+
+// Counter totals; values are -1 for counters that could not be opened (eg. in VMs without a virtual PMU). The task
+// 	clock is the CPU time summed over all threads, in nanoseconds.
+// The counters cover the whole process, so a difference between two readings also counts every other thread that was
+// 	running in between (eg. an attached writer and its zstd compression workers), not only the stage being measured.
+typedef struct lofar_udp_perf_counters {
+	long count[PERF_NUM_COUNTERS];
+} lofar_udp_perf_counters;
+
+// Open counter file descriptors (-1 when unavailable)
+typedef struct lofar_udp_perf {
+	int fd[PERF_NUM_COUNTERS];
+} lofar_udp_perf;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_PERF_H
+#define __LOFAR_UDP_PERF_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+lofar_udp_perf* lofar_udp_perf_setup(void);
+int lofar_udp_perf_read(const lofar_udp_perf *perf, lofar_udp_perf_counters *counters);
+void lofar_udp_perf_reset(const lofar_udp_perf *perf, lofar_udp_perf_counters *counters);
+void lofar_udp_perf_accumulate(lofar_udp_perf_counters *total, const lofar_udp_perf_counters *start, const lofar_udp_perf_counters *end);
+const char* lofar_udp_perf_name(const int counter);
+void lofar_udp_perf_cleanup(lofar_udp_perf *perf);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
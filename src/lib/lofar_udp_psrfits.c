@@ -0,0 +1,592 @@
+#include "lofar_udp_psrfits.h"
+
+#include <float.h>
+#include <math.h>
+
+
+// PSRFITS default: 8-bit, 2048 sample subints, unknown source
+const lofar_udp_psrfits_config lofar_udp_psrfits_config_default = {
+	.nbits = 8,
+	.samplesPerSubint = 2048,
+	.fch1 = SIGPROC_UNSET_DOUBLE,
+	.foff = SIGPROC_UNSET_DOUBLE,
+	.sourceName = "UNKNOWN",
+	.ra = "00:00:00.0000",
+	.dec = "+00:00:00.0000",
+	.observer = "UNKNOWN",
+	.projectID = "UNKNOWN"
+};
+
+
+/**
+ * @brief      Write a buffer to a file descriptor, handling partial writes
+ *
+ * @param[in]  fd      The file descriptor
+ * @param[in]  buffer  The buffer
+ * @param[in]  length  The buffer length
+ *
+ * @return     0: Success, 1: Failure
+ */
+static int psrfits_write_all(const int fd, const char *buffer, long length) {
+	ssize_t written;
+
+	while (length > 0) {
+		written = write(fd, buffer, length);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "ERROR: Failed to write PSRFITS data (errno %d: %s).\n", errno, strerror(errno));
+			return 1;
+		}
+		buffer += written;
+		length -= written;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Format an 80 character FITS header card
+ *
+ * @param      card           The output card (FITS_CARD_LENGTH + 1 bytes)
+ * @param[in]  key            The keyword
+ * @param[in]  value          The formatted value (NULL for keyword-only cards)
+ * @param[in]  leftJustified  Strings are left justified, numbers are right
+ *                            justified to column 30
+ * @param[in]  comment        The comment
+ */
+static void psrfits_format_card(char *card, const char *key, const char *value, const int leftJustified, const char *comment) {
+	int length;
+
+	if (value == NULL) {
+		length = snprintf(card, FITS_CARD_LENGTH + 1, "%-8.8s", key);
+	} else if (leftJustified) {
+		length = snprintf(card, FITS_CARD_LENGTH + 1, "%-8.8s= %-20s / %s", key, value, comment);
+	} else {
+		length = snprintf(card, FITS_CARD_LENGTH + 1, "%-8.8s= %20s / %s", key, value, comment);
+	}
+
+	if (length < FITS_CARD_LENGTH) memset(&(card[length]), ' ', FITS_CARD_LENGTH - length);
+}
+
+
+/**
+ * @brief      Append a card to the header buffer
+ *
+ * @param      file           The lofar_udp_psrfits_file
+ * @param[in]  key            The keyword
+ * @param[in]  value          The formatted value (NULL for keyword-only cards)
+ * @param[in]  leftJustified  Left justify the value
+ * @param[in]  comment        The comment
+ *
+ * @return     0: Success, 1: Header is full
+ */
+static int psrfits_card(lofar_udp_psrfits_file *file, const char *key, const char *value, const int leftJustified, const char *comment) {
+	char card[FITS_CARD_LENGTH + 1];
+
+	if (file->headerLength + FITS_CARD_LENGTH > PSRFITS_MAX_HDR_LENGTH) return 1;
+
+	psrfits_format_card(card, key, value, leftJustified, comment);
+	memcpy(&(file->header[file->headerLength]), card, FITS_CARD_LENGTH);
+	file->headerLength += FITS_CARD_LENGTH;
+
+	return 0;
+}
+
+static int psrfits_card_str(lofar_udp_psrfits_file *file, const char *key, const char *value, const char *comment) {
+	char formatted[72];
+	snprintf(formatted, sizeof(formatted), "'%-8.66s'", value);
+	return psrfits_card(file, key, formatted, 1, comment);
+}
+
+static int psrfits_card_int(lofar_udp_psrfits_file *file, const char *key, const long value, const char *comment) {
+	char formatted[32];
+	snprintf(formatted, sizeof(formatted), "%ld", value);
+	return psrfits_card(file, key, formatted, 0, comment);
+}
+
+static int psrfits_card_double(lofar_udp_psrfits_file *file, const char *key, const double value, const char *comment) {
+	char formatted[32];
+	snprintf(formatted, sizeof(formatted), "%.15E", value);
+	return psrfits_card(file, key, formatted, 0, comment);
+}
+
+static int psrfits_card_bool(lofar_udp_psrfits_file *file, const char *key, const int value, const char *comment) {
+	return psrfits_card(file, key, value ? "T" : "F", 0, comment);
+}
+
+
+/**
+ * @brief      Close the current HDU header with an END card, padding it with
+ *             spaces to a full FITS block
+ *
+ * @param      file  The lofar_udp_psrfits_file
+ *
+ * @return     0: Success, 1: Header is full
+ */
+static int psrfits_end_header(lofar_udp_psrfits_file *file) {
+	long padding;
+
+	if (psrfits_card(file, "END", NULL, 0, "") > 0) return 1;
+
+	padding = (FITS_BLOCK_LENGTH - file->headerLength % FITS_BLOCK_LENGTH) % FITS_BLOCK_LENGTH;
+	if (file->headerLength + padding > PSRFITS_MAX_HDR_LENGTH) return 1;
+	memset(&(file->header[file->headerLength]), ' ', padding);
+	file->headerLength += padding;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Store a float / double in big-endian order, as FITS requires
+ */
+static inline void psrfits_store_float(char *dest, const float value) {
+	unsigned int raw;
+	memcpy(&raw, &value, sizeof(float));
+	raw = __builtin_bswap32(raw);
+	memcpy(dest, &raw, sizeof(float));
+}
+
+static inline void psrfits_store_double(char *dest, const double value) {
+	unsigned long raw;
+	memcpy(&raw, &value, sizeof(double));
+	raw = __builtin_bswap64(raw);
+	memcpy(dest, &raw, sizeof(double));
+}
+
+
+/**
+ * @brief      Convert a SIGPROC sexagesimal value (e.g. 123456.7 for
+ *             12:34:56.7) to a string
+ *
+ * @param      dest      The output string
+ * @param[in]  value     The SIGPROC value
+ * @param[in]  withSign  Always include a sign (declinations)
+ */
+static void psrfits_sexagesimal(char *dest, double value, const int withSign) {
+	const char sign = (value < 0) ? '-' : '+';
+	int major, minor;
+
+	value = fabs(value);
+	major = (int) (value / 10000.0);
+	minor = (int) ((value - major * 10000.0) / 100.0);
+	value -= major * 10000.0 + minor * 100.0;
+
+	if (withSign) {
+		sprintf(dest, "%c%02d:%02d:%07.4f", sign, major, minor, value);
+	} else {
+		sprintf(dest, "%02d:%02d:%07.4f", major, minor, value);
+	}
+}
+
+
+/**
+ * @brief      Fill in the observation description of a PSRFITS configuration
+ *             from a SIGPROC header (e.g. one parsed from mockHeader-style
+ *             arguments)
+ *
+ * @param      config  The lofar_udp_psrfits_config
+ * @param[in]  header  The sigproc_hdr
+ *
+ * @return     0: Success
+ */
+int lofar_udp_psrfits_config_from_sigproc(lofar_udp_psrfits_config *config, const sigproc_hdr *header) {
+	if (header->fch1 != SIGPROC_UNSET_DOUBLE) config->fch1 = header->fch1;
+	if (header->foff != SIGPROC_UNSET_DOUBLE) config->foff = header->foff;
+	if (strlen(header->source_name)) strcpy(config->sourceName, header->source_name);
+	if (header->src_raj != SIGPROC_UNSET_DOUBLE) psrfits_sexagesimal(config->ra, header->src_raj, 0);
+	if (header->src_dej != SIGPROC_UNSET_DOUBLE) psrfits_sexagesimal(config->dec, header->src_dej, 1);
+
+	return 0;
+}
+
+
+/**
+ * @brief      Render the primary and SUBINT headers
+ *
+ * @param      file    The lofar_udp_psrfits_file
+ * @param[in]  meta    The lofar_udp_meta
+ * @param[in]  config  The lofar_udp_psrfits_config
+ * @param[in]  tbin    The sampling time
+ *
+ * @return     0: Success, >0: Header is full
+ */
+static int psrfits_render_header(lofar_udp_psrfits_file *file, const lofar_udp_meta *meta, const lofar_udp_psrfits_config *config, const double tbin) {
+	char stationCode[16] = "", dateStr[64], tdim[64], tform[32];
+	const char *polTypes[] = { "AA+BB", "Q", "U", "V" };
+	const double startTime = lofar_get_packet_time(meta->inputData[0]);
+	const long startIMJD = (long) (startTime / 86400.0) + 40587;
+	const double startSecs = startTime - (double) (startIMJD - 40587) * 86400.0;
+	const long dataBytes = (long) file->nsblk * file->nchan * file->nbits / 8;
+	const time_t startSeconds = (time_t) startTime;
+	struct tm *startTm = gmtime(&startSeconds);
+	int polType = 0, returnVal = 0;
+
+	lofar_get_station_name(meta->stationID, stationCode);
+
+	// Stokes vector modes write one component per output
+	if (meta->processingMode / 10 == 11) polType = 1;
+	else if (meta->processingMode / 10 == 12) polType = 2;
+	else if (meta->processingMode / 10 == 13) polType = 3;
+	else if (meta->processingMode / 10 == 15) polType = file->outp;
+	else if (meta->processingMode / 10 == 16) polType = file->outp * 3;
+
+	strftime(dateStr, sizeof(dateStr), "%Y-%m-%dT%H:%M:%S", startTm);
+	sprintf(&(dateStr[strlen(dateStr)]), ".%03d", (int) ((startTime - (double) startSeconds) * 1000));
+
+	// Primary HDU
+	returnVal += psrfits_card_bool(file, "SIMPLE", 1, "File conforms to FITS standard");
+	returnVal += psrfits_card_int(file, "BITPIX", 8, "Number of bits per data byte");
+	returnVal += psrfits_card_int(file, "NAXIS", 0, "Number of data axes");
+	returnVal += psrfits_card_bool(file, "EXTEND", 1, "File may contain extensions");
+	returnVal += psrfits_card_str(file, "HDRVER", "6.1", "Header version");
+	returnVal += psrfits_card_str(file, "FITSTYPE", "PSRFITS", "FITS definition for pulsar data files");
+	returnVal += psrfits_card_str(file, "DATE", dateStr, "File creation date (start of observation)");
+	returnVal += psrfits_card_str(file, "OBSERVER", config->observer, "Observer name(s)");
+	returnVal += psrfits_card_str(file, "PROJID", config->projectID, "Project name");
+	returnVal += psrfits_card_str(file, "TELESCOP", "LOFAR", "Telescope name");
+	returnVal += psrfits_card_str(file, "FRONTEND", stationCode, "Station");
+	returnVal += psrfits_card_str(file, "BACKEND", "LOFAR-UDP", "Backend ID");
+	returnVal += psrfits_card_int(file, "NRCVR", 2, "Number of receiver polarisation channels");
+	returnVal += psrfits_card_str(file, "FD_POLN", "LIN", "LIN or CIRC");
+	returnVal += psrfits_card_int(file, "BE_PHASE", 0, "0/+1/-1 BE cross-phase");
+	returnVal += psrfits_card_str(file, "OBS_MODE", "SEARCH", "(PSR, CAL, SEARCH)");
+	returnVal += psrfits_card_str(file, "DATE-OBS", dateStr, "Date of observation (YYYY-MM-DDThh:mm:ss UTC)");
+	returnVal += psrfits_card_double(file, "OBSFREQ", config->fch1 + config->foff * (file->nchan - 1) / 2.0, "[MHz] Centre frequency for observation");
+	returnVal += psrfits_card_double(file, "OBSBW", config->foff * file->nchan, "[MHz] Bandwidth for observation");
+	returnVal += psrfits_card_int(file, "OBSNCHAN", file->nchan, "Number of frequency channels (original)");
+	returnVal += psrfits_card_str(file, "SRC_NAME", config->sourceName, "Source or scan ID");
+	returnVal += psrfits_card_str(file, "COORD_MD", "J2000", "Coordinate mode (J2000, GALACTIC, ECLIPTIC)");
+	returnVal += psrfits_card_double(file, "EQUINOX", 2000.0, "Equinox of coords (e.g. 2000.0)");
+	returnVal += psrfits_card_str(file, "RA", config->ra, "Right ascension (hh:mm:ss.ssss)");
+	returnVal += psrfits_card_str(file, "DEC", config->dec, "Declination (-dd:mm:ss.sss)");
+	returnVal += psrfits_card_str(file, "STT_CRD1", config->ra, "Start coord 1 (hh:mm:ss.sss or ddd.ddd)");
+	returnVal += psrfits_card_str(file, "STT_CRD2", config->dec, "Start coord 2 (-dd:mm:ss.sss or -dd.ddd)");
+	returnVal += psrfits_card_str(file, "TRK_MODE", "TRACK", "Track mode (TRACK, SCANGC, SCANLAT)");
+	returnVal += psrfits_card_int(file, "STT_IMJD", startIMJD, "Start MJD (UTC days) (J - long integer)");
+	returnVal += psrfits_card_int(file, "STT_SMJD", (long) startSecs, "[s] Start time (sec past UTC 00h) (J)");
+	returnVal += psrfits_card_double(file, "STT_OFFS", startSecs - (long) startSecs, "[s] Start time offset (D)");
+	returnVal += psrfits_end_header(file);
+
+	// SUBINT binary table
+	returnVal += psrfits_card_str(file, "XTENSION", "BINTABLE", "FITS binary table");
+	returnVal += psrfits_card_int(file, "BITPIX", 8, "Binary data");
+	returnVal += psrfits_card_int(file, "NAXIS", 2, "2-dimensional binary table");
+	returnVal += psrfits_card_int(file, "NAXIS1", file->rowLength, "Width of table in bytes");
+	file->naxis2Offset = file->headerLength;
+	returnVal += psrfits_card_int(file, "NAXIS2", 0, "Number of rows in table (NSUBINT)");
+	returnVal += psrfits_card_int(file, "PCOUNT", 0, "Size of special data area");
+	returnVal += psrfits_card_int(file, "GCOUNT", 1, "One data group (required keyword)");
+	returnVal += psrfits_card_int(file, "TFIELDS", 7, "Number of fields per row");
+
+	returnVal += psrfits_card_str(file, "TTYPE1", "TSUBINT", "Length of subintegration");
+	returnVal += psrfits_card_str(file, "TFORM1", "1D", "Double");
+	returnVal += psrfits_card_str(file, "TUNIT1", "s", "Units of field");
+	returnVal += psrfits_card_str(file, "TTYPE2", "OFFS_SUB", "Offset from Start of subint centre");
+	returnVal += psrfits_card_str(file, "TFORM2", "1D", "Double");
+	returnVal += psrfits_card_str(file, "TUNIT2", "s", "Units of field");
+
+	sprintf(tform, "%dD", file->nchan);
+	returnVal += psrfits_card_str(file, "TTYPE3", "DAT_FREQ", "[MHz] Centre frequency for each channel");
+	returnVal += psrfits_card_str(file, "TFORM3", tform, "NCHAN doubles");
+	returnVal += psrfits_card_str(file, "TUNIT3", "MHz", "Units of field");
+	sprintf(tform, "%dE", file->nchan);
+	returnVal += psrfits_card_str(file, "TTYPE4", "DAT_WTS", "Weights for each channel");
+	returnVal += psrfits_card_str(file, "TFORM4", tform, "NCHAN floats");
+	returnVal += psrfits_card_str(file, "TTYPE5", "DAT_OFFS", "Data offset for each channel");
+	returnVal += psrfits_card_str(file, "TFORM5", tform, "NCHAN*NPOL floats");
+	returnVal += psrfits_card_str(file, "TTYPE6", "DAT_SCL", "Data scale factor for each channel");
+	returnVal += psrfits_card_str(file, "TFORM6", tform, "NCHAN*NPOL floats");
+
+	sprintf(tform, "%ldB", dataBytes);
+	sprintf(tdim, "(%d,1,%d)", file->nchan, file->nsblk * file->nbits / 8);
+	returnVal += psrfits_card_str(file, "TTYPE7", "DATA", "Subint data table");
+	returnVal += psrfits_card_str(file, "TFORM7", tform, "NBITS*NCHAN*NPOL*NSBLK/8 bytes");
+	returnVal += psrfits_card_str(file, "TDIM7", tdim, "Dimensions (NCHAN,NPOL,NSBLK*NBITS/8)");
+	returnVal += psrfits_card_str(file, "TUNIT7", "Jy", "Units of subint data");
+
+	returnVal += psrfits_card_str(file, "EXTNAME", "SUBINT", "Name of the table");
+	returnVal += psrfits_card_str(file, "INT_TYPE", "TIME", "Time axis (TIME, BINPHSPERI, BINLNGASC, etc)");
+	returnVal += psrfits_card_str(file, "INT_UNIT", "SEC", "Unit of time axis (SEC, PHS (0-1), DEG)");
+	returnVal += psrfits_card_str(file, "SCALE", "FluxDen", "Intensity units (FluxDen/RefFlux/Jansky)");
+	returnVal += psrfits_card_int(file, "NPOL", 1, "Nr of polarisations");
+	returnVal += psrfits_card_str(file, "POL_TYPE", polTypes[polType], "Polarisation identifier");
+	returnVal += psrfits_card_double(file, "TBIN", tbin, "[s] Time per bin or sample");
+	returnVal += psrfits_card_int(file, "NBIN", 1, "Nr of bins (PSR/CAL mode; else 1)");
+	returnVal += psrfits_card_int(file, "NBITS", file->nbits, "Nr of bits/datum (SEARCH mode data, else 1)");
+	returnVal += psrfits_card_int(file, "ZERO_OFF", 0, "Zero offset for SEARCH-mode data");
+	returnVal += psrfits_card_int(file, "NSUBOFFS", 0, "Subint offset (Contiguous SEARCH-mode files)");
+	returnVal += psrfits_card_int(file, "NCHAN", file->nchan, "Number of channels/sub-bands in this file");
+	returnVal += psrfits_card_double(file, "CHAN_BW", config->foff, "[MHz] Channel/sub-band width");
+	returnVal += psrfits_card_int(file, "NCHNOFFS", 0, "Channel/sub-band offset for split files");
+	returnVal += psrfits_card_int(file, "NSBLK", file->nsblk, "Samples/row (SEARCH mode, else 1)");
+	returnVal += psrfits_end_header(file);
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Free a PSRFITS file struct
+ *
+ * @param      file  The lofar_udp_psrfits_file
+ */
+static void psrfits_free(lofar_udp_psrfits_file *file) {
+	if (file->fd >= 0) close(file->fd);
+	free(file->row);
+	free(file->carry);
+	free(file->chanMin);
+	free(file->chanMax);
+	free(file->chanScale);
+	free(file->chanOffset);
+	free(file);
+}
+
+
+/**
+ * @brief      Create a PSRFITS search-mode file for a Stokes output of the
+ *             reader
+ *
+ * @param[in]  path    The output path (replaced if it exists)
+ * @param[in]  meta    The lofar_udp_meta, after the first step or reuse
+ * @param[in]  outp    The output index
+ * @param[in]  config  The lofar_udp_psrfits_config
+ *
+ * @return     lofar_udp_psrfits_file ptr, or NULL on error
+ */
+lofar_udp_psrfits_file* lofar_udp_psrfits_open(const char *path, const lofar_udp_meta *meta, const int outp, const lofar_udp_psrfits_config *config) {
+	lofar_udp_psrfits_config workingConfig = *config;
+	lofar_udp_psrfits_file *file;
+	double tbin;
+
+	if (meta->processingMode < 100) {
+		fprintf(stderr, "ERROR: PSRFITS outputs require a Stokes processing mode (>= 100, %d requested), exiting.\n", meta->processingMode);
+		return NULL;
+	}
+
+	if (config->nbits != 8 && config->nbits != 4) {
+		fprintf(stderr, "ERROR: PSRFITS outputs support 8 or 4 bit samples (%d requested), exiting.\n", config->nbits);
+		return NULL;
+	}
+
+	if (config->samplesPerSubint < 2 || config->samplesPerSubint % 2 != 0) {
+		fprintf(stderr, "ERROR: PSRFITS subints must contain an even number of samples (%d requested), exiting.\n", config->samplesPerSubint);
+		return NULL;
+	}
+
+	if (workingConfig.fch1 == SIGPROC_UNSET_DOUBLE || workingConfig.foff == SIGPROC_UNSET_DOUBLE) {
+		fprintf(stderr, "WARNING: Channel frequencies were not provided for PSRFITS output %d, channel indices will be used. Continuing...\n", outp);
+		workingConfig.fch1 = meta->totalProcBeamlets - 1;
+		workingConfig.foff = -1.0;
+	}
+
+	file = calloc(1, sizeof(lofar_udp_psrfits_file));
+	if (file == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for PSRFITS file struct, exiting.\n");
+		return NULL;
+	}
+
+	file->fd = -1;
+	file->outp = outp;
+	file->nbits = config->nbits;
+	file->nchan = meta->totalProcBeamlets;
+	file->nsblk = config->samplesPerSubint;
+
+	tbin = meta->clockBit ? clock200MHzSample : clock160MHzSample;
+	if (meta->processingMode > 100) tbin *= 1 << (meta->processingMode % 10);
+	file->subintLength = tbin * file->nsblk;
+
+	// TSUBINT, OFFS_SUB, DAT_FREQ, DAT_WTS, DAT_OFFS, DAT_SCL, DATA
+	file->dataOffset = 2 * sizeof(double) + file->nchan * (sizeof(double) + 3 * sizeof(float));
+	file->rowLength = file->dataOffset + (long) file->nsblk * file->nchan * file->nbits / 8;
+
+	file->row = calloc(file->rowLength, sizeof(char));
+	file->carry = calloc((long) file->nsblk * file->nchan, sizeof(float));
+	file->chanMin = calloc(file->nchan, sizeof(float));
+	file->chanMax = calloc(file->nchan, sizeof(float));
+	file->chanScale = calloc(file->nchan, sizeof(float));
+	file->chanOffset = calloc(file->nchan, sizeof(float));
+	if (file->row == NULL || file->carry == NULL || file->chanMin == NULL || file->chanMax == NULL || file->chanScale == NULL || file->chanOffset == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate PSRFITS buffers for output %d, exiting.\n", outp);
+		psrfits_free(file);
+		return NULL;
+	}
+
+	// The frequencies and weights are constant for every row
+	psrfits_store_double(&(file->row[0]), file->subintLength);
+	for (int chan = 0; chan < file->nchan; chan++) {
+		psrfits_store_double(&(file->row[2 * sizeof(double) + chan * sizeof(double)]), workingConfig.fch1 + chan * workingConfig.foff);
+		psrfits_store_float(&(file->row[2 * sizeof(double) + file->nchan * sizeof(double) + chan * sizeof(float)]), 1.0f);
+	}
+
+	if (psrfits_render_header(file, meta, &workingConfig, tbin) > 0) {
+		fprintf(stderr, "ERROR: PSRFITS header for output %d exceeded %d bytes, exiting.\n", outp, PSRFITS_MAX_HDR_LENGTH);
+		psrfits_free(file);
+		return NULL;
+	}
+
+	file->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file->fd < 0) {
+		fprintf(stderr, "ERROR: Unable to create PSRFITS output at %s (errno %d: %s), exiting.\n", path, errno, strerror(errno));
+		psrfits_free(file);
+		return NULL;
+	}
+
+	if (psrfits_write_all(file->fd, file->header, file->headerLength) > 0) {
+		psrfits_free(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+
+/**
+ * @brief      Quantise a subint with per-channel scales and offsets, and write
+ *             it out as a row of the SUBINT table
+ *
+ * @param      file     The lofar_udp_psrfits_file
+ * @param[in]  samples  nsblk samples of nchan floats
+ *
+ * @return     0: Success, 1: Failure
+ */
+static int psrfits_write_subint(lofar_udp_psrfits_file *file, const float *samples) {
+	const int nchan = file->nchan;
+	const float levels = (float) ((1 << file->nbits) - 1);
+	float *chanMin = file->chanMin, *chanMax = file->chanMax, *chanScale = file->chanScale, *chanOffset = file->chanOffset;
+	unsigned char *data = (unsigned char*) &(file->row[file->dataOffset]);
+	char *offsets = &(file->row[2 * sizeof(double) + nchan * (sizeof(double) + sizeof(float))]);
+	char *scales = &(offsets[nchan * sizeof(float)]);
+
+	// Per-channel range, scanned in sample order to stay on contiguous memory
+	for (int chan = 0; chan < nchan; chan++) {
+		chanMin[chan] = FLT_MAX;
+		chanMax[chan] = -FLT_MAX;
+	}
+	for (int sample = 0; sample < file->nsblk; sample++) {
+		const float *sampleData = &(samples[(long) sample * nchan]);
+		#pragma omp simd
+		for (int chan = 0; chan < nchan; chan++) {
+			chanMin[chan] = sampleData[chan] < chanMin[chan] ? sampleData[chan] : chanMin[chan];
+			chanMax[chan] = sampleData[chan] > chanMax[chan] ? sampleData[chan] : chanMax[chan];
+		}
+	}
+
+	// data = (value - DAT_OFFS) / DAT_SCL
+	for (int chan = 0; chan < nchan; chan++) {
+		chanOffset[chan] = chanMin[chan];
+		chanScale[chan] = (chanMax[chan] > chanMin[chan]) ? (chanMax[chan] - chanMin[chan]) / levels : 1.0f;
+		psrfits_store_float(&(offsets[chan * sizeof(float)]), chanOffset[chan]);
+		psrfits_store_float(&(scales[chan * sizeof(float)]), chanScale[chan]);
+		chanScale[chan] = 1.0f / chanScale[chan];
+	}
+
+	if (file->nbits == 8) {
+		for (int sample = 0; sample < file->nsblk; sample++) {
+			const float *sampleData = &(samples[(long) sample * nchan]);
+			unsigned char *sampleOut = &(data[(long) sample * nchan]);
+			#pragma omp simd
+			for (int chan = 0; chan < nchan; chan++) {
+				const float value = (sampleData[chan] - chanOffset[chan]) * chanScale[chan] + 0.5f;
+				sampleOut[chan] = (unsigned char) (value < 0.0f ? 0.0f : (value > levels ? levels : value));
+			}
+		}
+	} else {
+		// 4-bit samples are packed in pairs, with the first sample in the high nibble
+		const long totalSamples = (long) file->nsblk * nchan;
+		for (long idx = 0; idx < totalSamples; idx += 2) {
+			unsigned char packed = 0;
+			for (int nibble = 0; nibble < 2; nibble++) {
+				const int chan = (idx + nibble) % nchan;
+				const float value = (samples[idx + nibble] - chanOffset[chan]) * chanScale[chan] + 0.5f;
+				packed = (packed << 4) | ((unsigned char) (value < 0.0f ? 0.0f : (value > levels ? levels : value)) & 0x0f);
+			}
+			data[idx / 2] = packed;
+		}
+	}
+
+	psrfits_store_double(&(file->row[sizeof(double)]), (file->numSubints + 0.5) * file->subintLength);
+	if (psrfits_write_all(file->fd, file->row, file->rowLength) > 0) return 1;
+	file->numSubints++;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Append a gulp of Stokes data to the file, as many subints as it
+ *             fills
+ *
+ * @param      file        The lofar_udp_psrfits_file
+ * @param[in]  data        The gulp (samples of nchan floats)
+ * @param[in]  dataLength  The gulp length in bytes
+ *
+ * @return     0: Success, 1: Failure
+ */
+int lofar_udp_psrfits_write(lofar_udp_psrfits_file *file, const char *data, const long dataLength) {
+	const long sampleLength = file->nchan * sizeof(float);
+	const float *samples = (const float*) data;
+	long remaining = dataLength / sampleLength, toCopy;
+
+	// Top up a partially filled subint first
+	if (file->carrySamples > 0) {
+		toCopy = (file->nsblk - file->carrySamples < remaining) ? file->nsblk - file->carrySamples : remaining;
+		memcpy(&(file->carry[file->carrySamples * file->nchan]), samples, toCopy * sampleLength);
+		file->carrySamples += toCopy;
+		samples += toCopy * file->nchan;
+		remaining -= toCopy;
+
+		if (file->carrySamples == file->nsblk) {
+			if (psrfits_write_subint(file, file->carry) > 0) return 1;
+			file->carrySamples = 0;
+		}
+	}
+
+	// Quantise full subints straight from the output buffer
+	while (remaining >= file->nsblk) {
+		if (psrfits_write_subint(file, samples) > 0) return 1;
+		samples += (long) file->nsblk * file->nchan;
+		remaining -= file->nsblk;
+	}
+
+	if (remaining > 0) {
+		memcpy(file->carry, samples, remaining * sampleLength);
+		file->carrySamples = remaining;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Write out any partial subint (zero padded), pad the table to a
+ *             full FITS block, update the row count and close the file
+ *
+ * @param      file  The lofar_udp_psrfits_file
+ *
+ * @return     0: Success, 1: Failure
+ */
+int lofar_udp_psrfits_close(lofar_udp_psrfits_file *file) {
+	char padding[FITS_BLOCK_LENGTH] = { 0 }, card[FITS_CARD_LENGTH + 1], rowCount[32];
+	int returnVal = 0;
+
+	if (file == NULL) return 0;
+
+	if (file->carrySamples > 0) {
+		memset(&(file->carry[file->carrySamples * file->nchan]), 0, (file->nsblk - file->carrySamples) * file->nchan * sizeof(float));
+		returnVal += psrfits_write_subint(file, file->carry);
+	}
+
+	returnVal += psrfits_write_all(file->fd, padding, (FITS_BLOCK_LENGTH - (file->numSubints * file->rowLength) % FITS_BLOCK_LENGTH) % FITS_BLOCK_LENGTH);
+
+	snprintf(rowCount, sizeof(rowCount), "%ld", file->numSubints);
+	psrfits_format_card(card, "NAXIS2", rowCount, 0, "Number of rows in table (NSUBINT)");
+	if (pwrite(file->fd, card, FITS_CARD_LENGTH, file->naxis2Offset) != FITS_CARD_LENGTH) {
+		fprintf(stderr, "ERROR: Failed to update the PSRFITS row count for output %d (errno %d: %s).\n", file->outp, errno, strerror(errno));
+		returnVal += 1;
+	}
+
+	psrfits_free(file);
+	return returnVal > 0;
+}
@@ -0,0 +1,102 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+#include "lofar_udp_sigproc.h"
+
+#ifndef __LOFAR_UDP_PSRFITS_STRUCTS
+#define __LOFAR_UDP_PSRFITS_STRUCTS
+
+// FITS constants
+#define FITS_CARD_LENGTH 80
+#define FITS_BLOCK_LENGTH 2880
+#define PSRFITS_MAX_HDR_LENGTH (FITS_BLOCK_LENGTH * 4)
+
+// PSRFITS search-mode configuration
+typedef struct lofar_udp_psrfits_config {
+	// Output bits per sample (8 or 4)
+	int nbits;
+
+	// Samples per subint (NSBLK)
+	int samplesPerSubint;
+
+	// Frequency of the first channel, channel width (MHz)
+	double fch1;
+	double foff;
+
+	// Observation description
+	char sourceName[SIGPROC_MAX_STR_LENGTH + 1];
+	char ra[32];
+	char dec[32];
+	char observer[32];
+	char projectID[32];
+
+} lofar_udp_psrfits_config;
+extern const lofar_udp_psrfits_config lofar_udp_psrfits_config_default;
+
+
+// PSRFITS search-mode output file
+//
+// Each gulp is cut into subints of samplesPerSubint samples. Samples that do
+// not fill a subint are carried over to the next gulp; the final partial
+// subint is zero padded on close.
+typedef struct lofar_udp_psrfits_file {
+	int fd;
+	int outp;
+	int nbits;
+	int nchan;
+	int nsblk;
+
+	// Header state, NAXIS2 is patched in place on close
+	char header[PSRFITS_MAX_HDR_LENGTH];
+	long headerLength;
+	long naxis2Offset;
+	long numSubints;
+	double subintLength;
+
+	// Row layout
+	long rowLength;
+	long dataOffset;
+	char *row;
+
+	// Carried samples that did not fill a subint
+	float *carry;
+	long carrySamples;
+
+	// Quantisation workspace
+	float *chanMin;
+	float *chanMax;
+	float *chanScale;
+	float *chanOffset;
+
+} lofar_udp_psrfits_file;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_PSRFITS_H
+#define __LOFAR_UDP_PSRFITS_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_psrfits_config_from_sigproc(lofar_udp_psrfits_config *config, const sigproc_hdr *header);
+lofar_udp_psrfits_file* lofar_udp_psrfits_open(const char *path, const lofar_udp_meta *meta, const int outp, const lofar_udp_psrfits_config *config);
+int lofar_udp_psrfits_write(lofar_udp_psrfits_file *file, const char *data, const long dataLength);
+int lofar_udp_psrfits_close(lofar_udp_psrfits_file *file);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -1,6 +1,9 @@
+// mremap
+#define _GNU_SOURCE
 #include "lofar_udp_misc.h"
 #include "lofar_udp_reader.h"
 #include "lofar_udp_backends.hpp"
+#include "lofar_udp_vdif.h"
 
 
 // Define a set of default structs
@@ -31,14 +34,22 @@ lofar_udp_config lofar_udp_config_default = {
 	.beamletLimits = { 0, 0 },
 	.calibrateData = 0,
 	.calibrationConfiguration = &lofar_udp_calibration_default,
-	.ompThreads = OMP_THREADS
+	.ompThreads = OMP_THREADS,
+	.readThreads = 0,
+	.timeMajorOverlap = 0,
+	.followTimeout = 0,
+	.headerOffset = UDPHDROFF,
+	.perfCounters = 0
 };
 
 
 // Reader / meta with NULL-initialised values to help the cleanup function
 lofar_udp_reader lofar_udp_reader_default = {
 	.dstream = { NULL },
-	.ompThreads = OMP_THREADS
+	.ompThreads = OMP_THREADS,
+	.readThreads = OMP_THREADS,
+	.pcap = { NULL },
+	.perf = NULL
 };
 
 
@@ -49,7 +60,14 @@ lofar_udp_meta lofar_udp_meta_default = {
 	.inputDataReady = 0,
 	.outputDataReady = 0,
 	.jonesMatrices = NULL,
-	.calibrationStep = 0
+	.calibrationStep = 0,
+	.timeMajorOverlap = 0,
+	.overlapSource = { NULL },
+	.overlapSourceSamples = 0,
+	.vdifChannels = 0,
+	.vdifScales = NULL,
+	.allowPassthrough = 0,
+	.passthroughReady = 0
 };
 
 /**
@@ -57,12 +75,13 @@ lofar_udp_meta lofar_udp_meta_default = {
  *             ports
  *
  * @param      meta           The lofar_udp_meta to initialise
- * @param[in]  header         The header data to process
+ * @param[in]  header         The header data to process (meta->headerOffset
+ *                            bytes, then the CEP header)
  * @param[in]  beamletLimits  The upper/lower beamlets limits
  *
  * @return     0: Success, 1: Fatal error
  */
-int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDPHDROFF + UDPHDRLEN], const int beamletLimits[2]) {
+int lofar_udp_parse_headers_ext(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDPHDROFFMAX + UDPHDRLEN], const int beamletLimits[2]) {
 
 	lofar_source_bytes *source;
 
@@ -76,32 +95,32 @@ int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDP
 	for (int port = 0; port < meta->numPorts; port++) {
 		VERBOSE( if(meta->VERBOSE) printf("Port %d/%d\n", port, meta->numPorts - 1););
 		// Data integrity checks
-		if ((unsigned char) header[port][UDPHDROFF + 0] < UDPCURVER) {
+		if ((unsigned char) header[port][meta->headerOffset + 0] < UDPCURVER) {
 			fprintf(stderr, "Input header on port %d appears malformed (RSP Version less than 3), exiting.\n", port);
 			return 1;
 		}
 
-		if (*((unsigned int *) &(header[port][UDPHDROFF + 8])) <  LFREPOCH) {
+		if (*((unsigned int *) &(header[port][meta->headerOffset + 8])) <  LFREPOCH) {
 			fprintf(stderr, "Input header on port %d appears malformed (data timestamp before 2008), exiting.\n", port);
 			return 1;
 		}
 
-		if (*((unsigned int *) &(header[port][UDPHDROFF + 12])) > RSPMAXSEQ) {
-			fprintf(stderr, "Input header on port %d appears malformed (sequence higher than 200MHz clock maximum, %d), exiting.\n", port, *((unsigned int *) &(header[port][UDPHDROFF + 12])));
+		if (*((unsigned int *) &(header[port][meta->headerOffset + 12])) > RSPMAXSEQ) {
+			fprintf(stderr, "Input header on port %d appears malformed (sequence higher than 200MHz clock maximum, %d), exiting.\n", port, *((unsigned int *) &(header[port][meta->headerOffset + 12])));
 			return 1;
 		}
 
-		if ((unsigned char) header[port][UDPHDROFF + 6] > UDPMAXBEAM) {
-			fprintf(stderr, "Input header on port %d appears malformed (more than %d beamlets on a port, %d), exiting.\n", port, UDPMAXBEAM, header[port][UDPHDROFF + 6]);
+		if ((unsigned char) header[port][meta->headerOffset + 6] > UDPMAXBEAM) {
+			fprintf(stderr, "Input header on port %d appears malformed (more than %d beamlets on a port, %d), exiting.\n", port, UDPMAXBEAM, header[port][meta->headerOffset + 6]);
 			return 1;
 		}
 
-		if ((unsigned char) header[port][UDPHDROFF + 7] != UDPNTIMESLICE) {
-			fprintf(stderr, "Input header on port %d appears malformed (time slices are %d, not UDPNTIMESLICE), exiting.\n", port, header[port][UDPHDROFF + 7]);
+		if ((unsigned char) header[port][meta->headerOffset + 7] != UDPNTIMESLICE) {
+			fprintf(stderr, "Input header on port %d appears malformed (time slices are %d, not UDPNTIMESLICE), exiting.\n", port, header[port][meta->headerOffset + 7]);
 			return 1;
 		}
 
-		source = (lofar_source_bytes*) &(header[port][UDPHDROFF + 1]);
+		source = (lofar_source_bytes*) &(header[port][meta->headerOffset + 1]);
 		if (source->padding0 != 0) {
 			fprintf(stderr, "Input header on port %d appears malformed (padding bit (0) is set), exiting.\n", port);
 			return 1;
@@ -127,11 +146,11 @@ int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDP
 
 		// Extract the station ID
 		// Divide by 32 to convert from (my current guess based on SE607 / IE613 codes) RSP IDs to station codes
-		meta->stationID = *((short*) &(header[port][UDPHDROFF + 4])) / 32;
+		meta->stationID = *((short*) &(header[port][meta->headerOffset + 4])) / 32;
 
 		// Determine the number of beamlets on the port
-		VERBOSE(printf("port %d, bitMode %d, beamlets %d (%u)\n", port, source->bitMode, (int) ((unsigned char) header[port][UDPHDROFF + 6]), (unsigned char) header[port][UDPHDROFF + 6]););
-		meta->portRawBeamlets[port] = (int) ((unsigned char) header[port][UDPHDROFF + 6]);
+		VERBOSE(printf("port %d, bitMode %d, beamlets %d (%u)\n", port, source->bitMode, (int) ((unsigned char) header[port][meta->headerOffset + 6]), (unsigned char) header[port][meta->headerOffset + 6]););
+		meta->portRawBeamlets[port] = (int) ((unsigned char) header[port][meta->headerOffset + 6]);
 
 		// Assume we are processing all beamlets by default
 		meta->upperBeamlets[port] = meta->portRawBeamlets[port];
@@ -199,7 +218,7 @@ int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDP
 		// 4-bit: half the size per sample
 		// 16-bit: 2x the size per sample
 		bitMul = 1 - 0.5 * (meta->inputBitMode == 4) + 1 * (meta->inputBitMode == 16); // 4bit = 0.5x, 16bit = 2x
-		meta->portPacketLength[port] = (int) ((UDPHDRLEN) + (meta->portRawBeamlets[port] * bitMul * UDPNTIMESLICE * UDPNPOL));
+		meta->portPacketLength[port] = (int) (meta->headerOffset + (UDPHDRLEN) + (meta->portRawBeamlets[port] * bitMul * UDPNTIMESLICE * UDPNPOL));
 		
 	}
 
@@ -207,6 +226,29 @@ int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDP
 }
 
 
+/**
+ * @brief      Old API access, for packets without any bytes before the CEP
+ *             header (meta->headerOffset is set to 0, see
+ *             lofar_udp_parse_headers_ext)
+ *
+ * @param      meta           The lofar_udp_meta to initialise
+ * @param[in]  header         The CEP header of each port
+ * @param[in]  beamletLimits  The upper/lower beamlets limits
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDPHDRLEN], const int beamletLimits[2]) {
+	char offsetHeader[MAX_NUM_PORTS][UDPHDROFFMAX + UDPHDRLEN];
+
+	meta->headerOffset = 0;
+	for (int port = 0; port < meta->numPorts; port++) {
+		memcpy(&(offsetHeader[port][0]), header[port], UDPHDRLEN);
+	}
+
+	return lofar_udp_parse_headers_ext(meta, offsetHeader, beamletLimits);
+}
+
+
 //TODO:
 /*
 int lofar_udp_skip_to_packet_meta(lofar_udp_reader *reader, long currentPacket, long targetPacket) {
@@ -412,13 +454,18 @@ int lofar_udp_skip_to_packet(lofar_udp_reader *reader) {
  * @param      inputFiles        The input files to process
  * @param      meta              The lofar_udp_meta struct to initialise
  * @param[in]  readerType  		 Set the input data type
+ * @param      calibration       The calibration configuration
+ * @param      fileChains        Further files to read on each port once the
+ *                               previous one is exhausted (may be NULL)
+ * @param[in]  fileChainLengths  The number of further files on each port
+ *                               (may be NULL)
+ * @param      pushback          Bytes already read from each streamed input,
+ *                               owned by the reader from here (may be NULL)
  *
  * @return     lofar_udp_reader ptr, or NULL on error
  */
-lofar_udp_reader* lofar_udp_file_reader_setup(FILE **inputFiles, lofar_udp_meta *meta, const int readerType, lofar_udp_calibration *calibration) {
-	int returnVal, bufferSize, tmpFd;
-	void *tmpPtr;
-	long fileSize;
+lofar_udp_reader* lofar_udp_file_reader_setup_ext(FILE **inputFiles, lofar_udp_meta *meta, const int readerType, lofar_udp_calibration *calibration, FILE **fileChains[], const int fileChainLengths[], lofar_udp_pushback *pushback) {
+	int returnVal, bufferSize;
 	static lofar_udp_reader reader;
 	reader = lofar_udp_reader_default;
 
@@ -427,41 +474,37 @@ lofar_udp_reader* lofar_udp_file_reader_setup(FILE **inputFiles, lofar_udp_meta
 	reader.packetsPerIteration = meta->packetsPerIteration;
 	reader.meta = meta;
 	reader.calibration = calibration;
+	lofar_udp_perf_reset(NULL, &(reader.stats.portReadCounters));
+	lofar_udp_perf_reset(NULL, &(reader.stats.kernelCounters));
 
 	for (int port = 0; port < meta->numPorts; port++) {
 		reader.fileRef[port] = inputFiles[port];
+		reader.followFd[port] = -1;
+		reader.fileChain[port] = fileChains != NULL ? fileChains[port] : NULL;
+		reader.fileChainLength[port] = (fileChains != NULL && fileChainLengths != NULL) ? fileChainLengths[port] : 0;
+		reader.fileChainIndex[port] = 0;
+		reader.streaming[port] = lofar_udp_input_streamed(inputFiles[port]);
+		reader.streamBuffer[port] = NULL;
+		reader.pushback[port] = pushback != NULL ? pushback[port] : (lofar_udp_pushback) { NULL, 0, 0 };
+		reader.inputConsumed[port] = 0;
+
+		// Watch the input for appended data (reads on a stream already block until data arrives)
+		if (meta->followTimeout > 0 && !reader.streaming[port] && lofar_udp_reader_follow_setup(&reader, port) > 0) {
+			return NULL;
+		}
 
-		if (readerType == ZSTDCOMPRESSED) {
+		if (readerType == PCAP && (reader.pcap[port] = lofar_udp_pcap_open(inputFiles[port], meta->pcapPorts[port], meta->headerOffset)) == NULL) {
+			return NULL;
+		}
 
-			// Get the FILE*'s file descriptor (needed for mmap)'
-			tmpFd = fileno(inputFiles[port]);
-			// Find the file size (needed for mmap)
-			fileSize = fd_file_size(tmpFd);
-			// Ensure there wasn't an error
-			if (fileSize < 0) {
-				return NULL;
-			}
+		if (readerType == ZSTDCOMPRESSED) {
 
 			// Setup the decompression stream
 			reader.dstream[port] = ZSTD_createDStream();
 			ZSTD_initDStream(reader.dstream[port]);
 
-			tmpPtr = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, tmpFd, 0);
-
 			// Setup the compressed data buffer/struct
-			reader.readingTracker[port].size = fileSize;
-			reader.readingTracker[port].pos = 0;
-			reader.readingTracker[port].src = tmpPtr;
-
-			if (tmpPtr == MAP_FAILED) {
-				fprintf(stderr, "ERROR: Failed to create memory mapping for file on port %d. Errno: %d. Exiting.\n", port, errno);
-				return NULL;
-			}
-
-			returnVal = madvise(tmpPtr, fileSize, MADV_SEQUENTIAL);
-
-			if (returnVal == -1) {
-				fprintf(stderr, "ERROR: Failed to advise the kernel on mmap read stratgy on port %d. Errno: %d. Exiting.\n", port, errno);
+			if (lofar_udp_reader_map_file(&reader, port) > 0) {
 				return NULL;
 			}
 
@@ -471,7 +514,8 @@ lofar_udp_reader* lofar_udp_file_reader_setup(FILE **inputFiles, lofar_udp_meta
 			bufferSize += bufferSize % ZSTD_DStreamOutSize();
 			reader.decompressionTracker[port].size = bufferSize;
 			reader.decompressionTracker[port].pos = 0; // Initialisation for our step-by-step reader
-			reader.decompressionTracker[port].dst = reader.meta->inputData[port];
+			// Packets are stored with inputData pointing at the first CEP header, so any per-packet header offset lands before it
+			reader.decompressionTracker[port].dst = reader.meta->inputData[port] - meta->headerOffset;
 		}
 	}
 
@@ -531,14 +575,15 @@ int lofar_udp_file_reader_reuse(lofar_udp_reader *reader, const long startingPac
 	// THIS SEEMS VERY WRONG -- VERIFY, NOT EVEN CHECKING FOR IF READER IS COMPRESSED....
 	// If we only had a partial read during the last iteration, finish filling the buffer
 	if (reader->packetsPerIteration != reader->meta->packetsPerIteration) {
-		#pragma omp parallel for
+		#pragma omp parallel for num_threads(reader->readThreads)
 		for (int port = 0; port < reader->meta->numPorts; port++) {
 			lofar_udp_reader_nchars(reader, port, &(reader->meta->inputData[port][reader->decompressionTracker[port].pos]), reader->packetsPerIteration * reader->meta->portPacketLength[port] - reader->decompressionTracker[port].pos, reader->decompressionTracker[port].pos);
 		}
 	}
 
-	// Reset old variables
+	// Reset old variables, the new event does not continue the previous gulp
 	reader->meta->packetsPerIteration = reader->packetsPerIteration;
+	for (int out = 0; out < reader->meta->numOutputs; out++) reader->meta->overlapSource[out] = NULL;
 	reader->meta->packetsRead = 0;
 	reader->meta->packetsReadMax = startingPacket - reader->meta->lastPacket + 2 * reader->packetsPerIteration;
 	reader->meta->lastPacket = startingPacket;
@@ -669,6 +714,13 @@ int lofar_udp_setup_processing(lofar_udp_meta *meta) {
 		case 160 ... 164:
 			break;
 
+		case 40 ... 42:
+			if (meta->calibrateData) {
+				fprintf(stderr, "WARNING: VDIF modes (40-42) cannot be calibrated, disabling calibration and continuing.\n");
+				meta->calibrateData = 0;
+			}
+			break;
+
 		default:
 			fprintf(stderr, "Unknown processing mode %d, exiting...\n", meta->processingMode);
 			return 1;
@@ -719,6 +771,15 @@ int lofar_udp_setup_processing(lofar_udp_meta *meta) {
 			meta->numOutputs = 2;
 			break;
 
+		// VDIF frames, sized once the output bit mode is known
+		case 40:
+		case 41:
+		case 42:
+			meta->numOutputs = 1;
+			meta->outputBitMode = lofar_udp_vdif_bits(meta->processingMode);
+			meta->vdifChannels = lofar_udp_vdif_channels(meta);
+			break;
+
 		// Base Stokes Methods
 		case 100:
 		case 110:
@@ -798,8 +859,11 @@ int lofar_udp_setup_processing(lofar_udp_meta *meta) {
 
 	if (equalIO) {
 		for (int port = 0; port < meta->numPorts; port++) {
-			meta->packetOutputLength[port] = hdrOffset + meta->portPacketLength[port];
+			meta->packetOutputLength[port] = hdrOffset + meta->portPacketLength[port] - meta->headerOffset;
 		}
+	} else if (meta->processingMode >= 40 && meta->processingMode <= 42) {
+		// One frame per port and polarisation for each input packet
+		meta->packetOutputLength[0] = meta->numPorts * VDIF_THREADS_PER_PORT * lofar_udp_vdif_frame_length(meta);
 	} else {
 		// Calculate the number of output char-sized elements
 		workingData = (meta->numPorts * (hdrOffset + UDPHDRLEN)) + meta->totalProcBeamlets * UDPNPOL * ((float) meta->inputBitMode / 8.0) * UDPNTIMESLICE;
@@ -818,6 +882,22 @@ int lofar_udp_setup_processing(lofar_udp_meta *meta) {
 
 
 
+/**
+ * @brief      Old API access, for inputs without chained files or pushback
+ *             (see lofar_udp_file_reader_setup_ext)
+ *
+ * @param      inputFiles   The input files to process
+ * @param      meta         The lofar_udp_meta struct to initialise
+ * @param[in]  readerType   Set the input data type
+ * @param      calibration  The calibration configuration
+ *
+ * @return     lofar_udp_reader ptr, or NULL on error
+ */
+lofar_udp_reader* lofar_udp_file_reader_setup(FILE **inputFiles, lofar_udp_meta *meta, const int readerType, lofar_udp_calibration *calibration) {
+	return lofar_udp_file_reader_setup_ext(inputFiles, meta, readerType, calibration, NULL, NULL, NULL);
+}
+
+
 /**
  * @brief      Old API access
  *
@@ -888,12 +968,23 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 			return NULL;
 		}
 	}
+	if (config->timeMajorOverlap != 0) {
+		if (config->processingMode < 30 || config->processingMode > 32) {
+			fprintf(stderr, "ERROR: Overlapping outputs are only supported by the time-major modes (30-32, %d requested), exiting.\n", config->processingMode);
+			return NULL;
+		}
+
+		if (config->timeMajorOverlap < 0 || config->timeMajorOverlap >= config->packetsPerIteration * UDPNTIMESLICE) {
+			fprintf(stderr, "ERROR: Overlap of %d samples must be positive and shorter than a gulp (%ld samples), exiting.\n", config->timeMajorOverlap, config->packetsPerIteration * UDPNTIMESLICE);
+			return NULL;
+		}
+	}
 
 	// Setup the metadata struct and a few variables we'll need
 	static lofar_udp_meta meta;
 	meta = lofar_udp_meta_default;
-	char inputHeaders[MAX_NUM_PORTS][UDPHDRLEN + UDPHDROFF];
-	int readlen, bufferSize;
+	char inputHeaders[MAX_NUM_PORTS][UDPHDROFFMAX + UDPHDRLEN];
+	int readlen = 0, bufferSize;
 	long localMaxPackets = config->packetsReadMax;
 
 	// Reset the maximum packets to LONG_MAX if set to an unreasonable value
@@ -907,28 +998,70 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 	meta.packetsReadMax = localMaxPackets;
 	meta.lastPacket = config->startingPacket;
 	meta.calibrateData = config->calibrateData;
+	meta.timeMajorOverlap = config->timeMajorOverlap;
+	meta.followTimeout = config->followTimeout;
+	meta.headerOffset = config->headerOffset;
 	
+	if (config->headerOffset < 0 || config->headerOffset > UDPHDROFFMAX) {
+		fprintf(stderr, "ERROR: Per-packet header offset must be between 0 and %d bytes (got %d), exiting.\n", UDPHDROFFMAX, config->headerOffset);
+		return NULL;
+	}
+
 	VERBOSE(meta.VERBOSE = config->verbose);
 	#ifndef ALLOW_VERBOSE
 	if (config->verbose) fprintf(stderr, "Warning: verbosity was disabled at compile time, but you requested it. Continuing...\n");
 	#endif
 
 
+	// Streamed inputs cannot be seeked back after reading their headers; keep the bytes read for the reader,
+	// 	and detect whether the stream is compressed, as pipes have no file name to go on
+	static lofar_udp_pushback pushback[MAX_NUM_PORTS];
+	int streamedType = -1, portType;
+	for (int port = 0; port < meta.numPorts; port++) {
+		pushback[port] = (lofar_udp_pushback) { NULL, 0, 0 };
+		if (!lofar_udp_input_streamed(config->inputFiles[port])) continue;
+
+		if (config->readerType == PCAP) {
+			fprintf(stderr, "ERROR: pcap captures cannot be streamed (port %d), exiting.\n", port);
+			return NULL;
+		}
+
+		readlen = lofar_udp_stream_peek_header(config->inputFiles[port], &(inputHeaders[port][0]), meta.headerOffset + UDPHDRLEN, &(pushback[port]), &portType);
+		if (readlen < meta.headerOffset + UDPHDRLEN) {
+			fprintf(stderr, "Unable to read header on port %d, exiting.\n", port);
+			return NULL;
+		}
+
+		if (streamedType != -1 && portType != streamedType) {
+			fprintf(stderr, "ERROR: Streamed inputs mix compressed and uncompressed data (port %d), exiting.\n", port);
+			return NULL;
+		}
+		streamedType = portType;
+	}
+
+	if (streamedType != -1 && streamedType != config->readerType) {
+		VERBOSE(if (meta.VERBOSE) printf("Streamed input detected as reader type %d (requested %d)\n", streamedType, config->readerType));
+		config->readerType = streamedType;
+	}
+
 	// Scan in the first header on each port
 	for (int port = 0; port < meta.numPorts; port++) {
+		if (pushback[port].data != NULL) continue;
 		
 		if (config->readerType == ZSTDCOMPRESSED)  {
-			readlen = fread_temp_ZSTD(&(inputHeaders[port][0]), sizeof(char), UDPHDRLEN + UDPHDROFF, config->inputFiles[port], 1);
+			readlen = fread_temp_ZSTD(&(inputHeaders[port][0]), sizeof(char), meta.headerOffset + UDPHDRLEN, config->inputFiles[port], 1);
 		} else if (config->readerType == NORMAL) {
-			readlen = fread(&(inputHeaders[port]), sizeof(char), UDPHDRLEN + UDPHDROFF, config->inputFiles[port]);
-			fseek(config->inputFiles[port], -UDPHDRLEN - UDPHDROFF, SEEK_CUR);
+			readlen = fread(&(inputHeaders[port]), sizeof(char), meta.headerOffset + UDPHDRLEN, config->inputFiles[port]);
+			fseek(config->inputFiles[port], -readlen, SEEK_CUR);
+		} else if (config->readerType == PCAP) {
+			readlen = lofar_udp_pcap_peek(config->inputFiles[port], config->pcapPorts[port], meta.headerOffset, &(inputHeaders[port][0]), meta.headerOffset + UDPHDRLEN);
 		} else if (config->readerType == DADA) {
 
 		} else {
 			fprintf(stderr, "ERROR: Unknown reader type %d. Exiting\n", config->readerType);
 		}
 
-		if (readlen < UDPHDRLEN) {
+		if (readlen < meta.headerOffset + UDPHDRLEN) {
 			fprintf(stderr, "Unable to read header on port %d, exiting.\n", port);
 			return NULL;
 		}
@@ -943,7 +1076,7 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 	while (updateBeamlets != -1) {
 		VERBOSE(if (meta.VERBOSE) printf("Handle headers: %d\n", updateBeamlets););
 		// Standard setup
-		if (lofar_udp_parse_headers(&meta, inputHeaders, beamletLimits) > 0) {
+		if (lofar_udp_parse_headers_ext(&meta, inputHeaders, beamletLimits) > 0) {
 			fprintf(stderr, "Unable to setup meadata using given headers; exiting.\n");
 			return NULL;
 
@@ -983,12 +1116,19 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 				for (int port = lowerPort; port <= upperPort; port++) {
 					config->inputFiles[port - lowerPort] = config->inputFiles[port];
 					// GCC 10 has a warning abot this line. Why?
-					memcpy(&(inputHeaders[port - lowerPort][0]), &(inputHeaders[port][0]), UDPHDRLEN);
+					memcpy(&(inputHeaders[port - lowerPort][0]), &(inputHeaders[port][0]), meta.headerOffset + UDPHDRLEN);
 				}
+				memmove(&(config->inputFileChains[0]), &(config->inputFileChains[lowerPort]), (upperPort + 1 - lowerPort) * sizeof(FILE**));
+				memmove(&(config->inputFileChainLengths[0]), &(config->inputFileChainLengths[lowerPort]), (upperPort + 1 - lowerPort) * sizeof(int));
+				memmove(&(config->pcapPorts[0]), &(config->pcapPorts[lowerPort]), (upperPort + 1 - lowerPort) * sizeof(int));
+				for (int port = 0; port < lowerPort; port++) free(pushback[port].data);
+				memmove(&(pushback[0]), &(pushback[lowerPort]), (upperPort + 1 - lowerPort) * sizeof(lofar_udp_pushback));
 
 				// Close unneeded files
 				for (int port = upperPort + 1; port < config->numPorts; port++) {
 					fclose(config->inputFiles[port]);
+					for (int file = 0; file < config->inputFileChainLengths[port]; file++) fclose(config->inputFileChains[port][file]);
+					free(pushback[port].data);
 				}
 
 				// Update beamlet limits to be relative to the new ports
@@ -1021,6 +1161,9 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 		return NULL;
 	}
 
+	// After any ports were dropped
+	memcpy(meta.pcapPorts, config->pcapPorts, MAX_NUM_PORTS * sizeof(int));
+
 
 	// Allocate the memory needed to store the raw / reprocessed data, initlaise the variables that are stored on a per-port basis.
 	for (int port = 0; port < meta.numPorts; port++) {
@@ -1034,11 +1177,13 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 		meta.inputDataOffset[port] = 0;
 		meta.portLastDroppedPackets[port] = 0;
 		meta.portTotalDroppedPackets[port] = 0;
+		meta.portTotalPaddedPackets[port] = 0;
+		meta.portTotalOutOfOrderPackets[port] = 0;
 	}
 
 	for (int out = 0; out < meta.numOutputs; out++) {
-		meta.outputData[out] = calloc(meta.packetOutputLength[out] * meta.packetsPerIteration, sizeof(char));
-		VERBOSE(if(meta.VERBOSE) printf("calloc at %p for %ld bytes\n", meta.outputData[out], meta.packetOutputLength[out] * meta.packetsPerIteration););
+		meta.outputData[out] = calloc(meta.packetOutputLength[out] * meta.packetsPerIteration + lofar_udp_time_major_overlap_length(&meta, out), sizeof(char));
+		VERBOSE(if(meta.VERBOSE) printf("calloc at %p for %ld bytes\n", meta.outputData[out], meta.packetOutputLength[out] * meta.packetsPerIteration + lofar_udp_time_major_overlap_length(&meta, out)););
 	}
 
 
@@ -1055,10 +1200,25 @@ lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *conf
 	}});
 
 
+	// Open the hardware counters before the reader's first parallel region, so that they are inherited by the OpenMP threads
+	// 	(if the process already ran a parallel region, eg. autotuning trials, the existing thread pool is not counted)
+	lofar_udp_perf *perf = NULL;
+	if (config->perfCounters && (perf = lofar_udp_perf_setup()) == NULL) {
+		fprintf(stderr, "WARNING: No performance counters are available, continuing without them.\n");
+	}
+
 	// Form a reader using the given metadata and input files, setup OMP threads
 	omp_set_num_threads(config->ompThreads);
-	lofar_udp_reader *reader = lofar_udp_file_reader_setup(config->inputFiles, &meta, config->readerType, config->calibrationConfiguration);
+	lofar_udp_reader *reader = lofar_udp_file_reader_setup_ext(config->inputFiles, &meta, config->readerType, config->calibrationConfiguration, config->inputFileChains, config->inputFileChainLengths, pushback);
+	if (reader == NULL) {
+		lofar_udp_perf_cleanup(perf);
+		return NULL;
+	}
 	reader->ompThreads = config->ompThreads;
+	reader->readThreads = config->readThreads > 0 ? config->readThreads : config->ompThreads;
+	reader->perf = perf;
+	lofar_udp_perf_reset(perf, &(reader->stats.portReadCounters));
+	lofar_udp_perf_reset(perf, &(reader->stats.kernelCounters));
 
 	return reader;
 }
@@ -1103,11 +1263,26 @@ int lofar_udp_reader_cleanup_f(lofar_udp_reader *reader, const int closeFiles) {
 			reader->meta->inputData[i] = NULL;
 		}
 
-		// Close the input file
+		if (reader->followFd[i] >= 0) {
+			close(reader->followFd[i]);
+			reader->followFd[i] = -1;
+		}
+
+		if (reader->pushback[i].data != NULL) {
+			free(reader->pushback[i].data);
+			reader->pushback[i] = (lofar_udp_pushback) { NULL, 0, 0 };
+		}
+
+		// Close the input file, and any files of its chain that were not reached
 		if (reader->fileRef[i] != NULL && closeFiles && reader->readerType != DADA) {
 			VERBOSE(if(reader->meta->VERBOSE) printf("On port: %d closing file\n", i))
 			fclose(reader->fileRef[i]);
 			reader->fileRef[i] = NULL;
+
+			for (int file = reader->fileChainIndex[i]; file < reader->fileChainLength[i]; file++) {
+				if (reader->fileChain[i][file] != NULL) fclose(reader->fileChain[i][file]);
+				reader->fileChain[i][file] = NULL;
+			}
 		}
 
 		if (reader->readerType == ZSTDCOMPRESSED) {
@@ -1116,10 +1291,19 @@ int lofar_udp_reader_cleanup_f(lofar_udp_reader *reader, const int closeFiles) {
 				VERBOSE(if(reader->meta->VERBOSE) printf("Freeing decompression buffers and ZSTD stream on port %d\n", i););
 				ZSTD_freeDStream(reader->dstream[i]);
 				void *tmpPtr = (void* ) reader->readingTracker[i].src;
-				munmap(tmpPtr, reader->readingTracker[i].size);
+				if (!reader->streaming[i] && reader->readingTracker[i].size > 0) munmap(tmpPtr, reader->readingTracker[i].size);
 				reader->dstream[i] = NULL;
 			}
 
+			if (reader->streamBuffer[i] != NULL) {
+				free(reader->streamBuffer[i]);
+				reader->streamBuffer[i] = NULL;
+			}
+
+		} else if (reader->readerType == PCAP) {
+			lofar_udp_pcap_close(reader->pcap[i]);
+			reader->pcap[i] = NULL;
+
 		} else if (reader->readerType == DADA) {
 			// To be implemented
 		}
@@ -1133,6 +1317,14 @@ int lofar_udp_reader_cleanup_f(lofar_udp_reader *reader, const int closeFiles) {
 		free(reader->meta->jonesMatrices);	
 	}
 
+	if (reader->meta->vdifScales != NULL) {
+		free(reader->meta->vdifScales);
+		reader->meta->vdifScales = NULL;
+	}
+
+	lofar_udp_perf_cleanup(reader->perf);
+	reader->perf = NULL;
+
 	return 0;
 }
 
@@ -1243,7 +1435,7 @@ int lofar_udp_reader_calibration(lofar_udp_reader *reader) {
 		// Allocate numTimesamples * numBeamlets * (4 pmatrix elements) * (2 complex values per element)
 		reader->meta->jonesMatrices = malloc(numTimesamples * sizeof(float*));
 		for (int timeIdx = 0; timeIdx < numTimesamples; timeIdx += 1) {
-			reader->meta->jonesMatrices[timeIdx] = calloc(numBeamlets * 8, sizeof(float));
+			reader->meta->jonesMatrices[timeIdx] = calloc(numBeamlets * JONESMATSIZE, sizeof(float));
 		}
 	// If we returned more time samples than last time, reallocate the array
 	} else if (numTimesamples > reader->calibration->calibrationStepsGenerated) {
@@ -1256,7 +1448,7 @@ int lofar_udp_reader_calibration(lofar_udp_reader *reader) {
 		// Reallocate the data
 		reader->meta->jonesMatrices = malloc(numTimesamples * sizeof(float*));
 		for (int timeIdx = 0; timeIdx < numTimesamples; timeIdx += 1) {
-			reader->meta->jonesMatrices[timeIdx] = calloc(numBeamlets * 8, sizeof(float));
+			reader->meta->jonesMatrices[timeIdx] = calloc(numBeamlets * JONESMATSIZE, sizeof(float));
 		}
 	// If less time samples, free the remaining steps and re-use the array
 	} else if (numTimesamples < reader->calibration->calibrationStepsGenerated) {
@@ -1329,7 +1521,9 @@ int lofar_udp_reader_calibration(lofar_udp_reader *reader) {
  *
  * @param      reader       The lofar_udp_reader struct to process
  * @param[in]  port         The port (file) to read data from
- * @param      targetArray  The storage array
+ * @param      targetArray  The storage array, at the CEP header of the first
+ *                          packet (meta->headerOffset bytes are read in
+ *                          before it)
  * @param[in]  nchars       The number of chars (bytes) to read in
  * @param[in]  knownOffset  The compressed reader's known offset
  *
@@ -1339,10 +1533,21 @@ long lofar_udp_reader_nchars(lofar_udp_reader *reader, const int port, char *tar
 	// Return if we have nothing to do
 	if (nchars < 0) return -1;
 
+	// The target is the CEP header of the first packet, read in the per-packet header offset before it
+	targetArray -= reader->meta->headerOffset;
+
 	if (reader->readerType == NORMAL) {
 		// Decompressed file: Read and return the data as needed
 		VERBOSE(if (reader->meta->VERBOSE) printf("reader_nchars: Entering read request: %d, %ld\n", port, nchars));
-		return fread(targetArray, sizeof(char), nchars, reader->fileRef[port]);
+		long dataRead = lofar_udp_pushback_read(&(reader->pushback[port]), targetArray, nchars);
+		dataRead += fread(&(targetArray[dataRead]), sizeof(char), nchars - dataRead, reader->fileRef[port]);
+
+		// Fill the rest of the request from the next file in the chain, or wait for it to be appended to a followed file
+		while (dataRead < nchars && lofar_udp_reader_continue_input(reader, port) == 0) {
+			dataRead += fread(&(targetArray[dataRead]), sizeof(char), nchars - dataRead, reader->fileRef[port]);
+		}
+
+		return dataRead;
 
 	} else if (reader->readerType == ZSTDCOMPRESSED) {
 		// Compressed file: Perform streaming decompression on a zstandard compressed file
@@ -1358,37 +1563,51 @@ long lofar_udp_reader_nchars(lofar_udp_reader *reader, const int port, char *tar
 		VERBOSE(if (reader->meta->VERBOSE) printf("reader_nchars: start of read loop, %ld, %ld, %ld, %ld\n", reader->readingTracker[port].pos, reader->readingTracker[port].size, reader->decompressionTracker[port].pos, dataRead););
 
 		// Loop across while decompressing the data (zstd decompressed in frame iterations, so it may take a few iterations)
-		while (reader->readingTracker[port].pos < reader->readingTracker[port].size) {
-			previousDecompressionPos = reader->decompressionTracker[port].pos;
-			// zstd streaming decompression + check for errors
-			returnVal = ZSTD_decompressStream(reader->dstream[port], &(reader->decompressionTracker[port]), &(reader->readingTracker[port]));
-			if (ZSTD_isError(returnVal)) {
-				fprintf(stderr, "ZSTD encountered an error decompressing a frame (code %d, %s), exiting data read early.\n", returnVal, ZSTD_getErrorName(returnVal));
-				return dataRead;
-			}
+		// At the end of each file, continue the stream with the next file of the chain, or extend the mapping of a followed file
+		do {
+			while (reader->readingTracker[port].pos < reader->readingTracker[port].size) {
+				previousDecompressionPos = reader->decompressionTracker[port].pos;
+				// zstd streaming decompression + check for errors
+				returnVal = ZSTD_decompressStream(reader->dstream[port], &(reader->decompressionTracker[port]), &(reader->readingTracker[port]));
+				if (ZSTD_isError(returnVal)) {
+					fprintf(stderr, "ZSTD encountered an error decompressing a frame (code %d, %s), exiting data read early.\n", returnVal, ZSTD_getErrorName(returnVal));
+					return dataRead;
+				}
 
-			// Determine how much data we just added to the buffer
-			byteDelta = ((long) reader->decompressionTracker[port].pos - (long) previousDecompressionPos);
+				// Determine how much data we just added to the buffer
+				byteDelta = ((long) reader->decompressionTracker[port].pos - (long) previousDecompressionPos);
 
-			// Update the total data read + check if we have reached our goal
-			dataRead += byteDelta;
-			VERBOSE(if (dataRead >= nchars) {
-				if (reader->meta->VERBOSE) printf("Reader terminating: %ld read, %ld requested, %ld\n", dataRead, nchars, nchars - dataRead);
-			});
-			
-			if (dataRead >= nchars) {
-				return dataRead;
-			}
+				// Update the total data read + check if we have reached our goal
+				dataRead += byteDelta;
+				VERBOSE(if (dataRead >= nchars) {
+					if (reader->meta->VERBOSE) printf("Reader terminating: %ld read, %ld requested, %ld\n", dataRead, nchars, nchars - dataRead);
+				});
+				
+				if (dataRead >= nchars) {
+					return dataRead;
+				}
 
-			if (reader->decompressionTracker[port].pos == reader->decompressionTracker[port].size) {
-				fprintf(stderr, "Failed to read %ld/%ld chars on port %d before filling the buffer. Attempting to continue...\n", dataRead, nchars, port);
-				return dataRead;
+				if (reader->decompressionTracker[port].pos == reader->decompressionTracker[port].size) {
+					fprintf(stderr, "Failed to read %ld/%ld chars on port %d before filling the buffer. Attempting to continue...\n", dataRead, nchars, port);
+					return dataRead;
+				}
 			}
-		}
+		} while (lofar_udp_reader_continue_input(reader, port) == 0);
 
 		// EOF: return everything we read
 		return  dataRead;
 
+	} else if (reader->readerType == PCAP) {
+		// Capture: copy the UDP payloads on the port out of the capture
+		VERBOSE(if (reader->meta->VERBOSE) printf("reader_nchars: Entering read request (pcap): %d, %ld\n", port, nchars));
+		long dataRead = lofar_udp_pcap_read(reader->pcap[port], targetArray, nchars);
+
+		while (dataRead < nchars && lofar_udp_reader_continue_input(reader, port) == 0) {
+			dataRead += lofar_udp_pcap_read(reader->pcap[port], &(targetArray[dataRead]), nchars - dataRead);
+		}
+
+		return dataRead;
+
 	} else if (reader->readerType == DADA) {
 		// Get data from the PSRDADA buffer
 
@@ -1402,6 +1621,300 @@ long lofar_udp_reader_nchars(lofar_udp_reader *reader, const int port, char *tar
 }
 
 
+/**
+ * @brief      Memory map the current compressed input file on a port for the
+ *             decompression stream, or setup a buffer for a streamed input
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_reader_map_file(lofar_udp_reader *reader, const int port) {
+	void *tmpPtr = NULL;
+
+	// Streams cannot be mapped, decompress them from a buffer that is refilled as it is consumed
+	if ((reader->streaming[port] = lofar_udp_input_streamed(reader->fileRef[port]))) {
+		if (reader->streamBuffer[port] == NULL && (reader->streamBuffer[port] = malloc(ZSTD_DStreamInSize())) == NULL) {
+			fprintf(stderr, "ERROR: Unable to allocate a stream buffer on port %d, exiting.\n", port);
+			return 1;
+		}
+
+		reader->readingTracker[port].size = 0;
+		reader->readingTracker[port].pos = 0;
+		reader->readingTracker[port].src = reader->streamBuffer[port];
+		return 0;
+	}
+
+	// Find the file size (needed for mmap)
+	long fileSize = fd_file_size(fileno(reader->fileRef[port]));
+	if (fileSize < 0) {
+		return 1;
+	}
+
+	// Empty files cannot be mapped, leave them to be extended by follow mode or skipped by the file chain
+	if (fileSize > 0) {
+		tmpPtr = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileno(reader->fileRef[port]), 0);
+		if (tmpPtr == MAP_FAILED) {
+			fprintf(stderr, "ERROR: Failed to create memory mapping for file on port %d. Errno: %d. Exiting.\n", port, errno);
+			return 1;
+		}
+
+		if (madvise(tmpPtr, fileSize, MADV_SEQUENTIAL) == -1) {
+			fprintf(stderr, "ERROR: Failed to advise the kernel on mmap read stratgy on port %d. Errno: %d. Exiting.\n", port, errno);
+			return 1;
+		}
+	}
+
+	reader->readingTracker[port].size = fileSize;
+	reader->readingTracker[port].pos = 0;
+	reader->readingTracker[port].src = tmpPtr;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Start watching the current input file on a port for appended
+ *             data. We only have the FILE*, so it is watched through /proc.
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_reader_follow_setup(lofar_udp_reader *reader, const int port) {
+	char fdPath[64];
+
+	if (reader->followFd[port] >= 0) close(reader->followFd[port]);
+
+	sprintf(fdPath, "/proc/self/fd/%d", fileno(reader->fileRef[port]));
+	if ((reader->followFd[port] = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0 || inotify_add_watch(reader->followFd[port], fdPath, IN_MODIFY) < 0) {
+		fprintf(stderr, "ERROR: Unable to watch the input on port %d for new data (errno %d: %s), exiting.\n", port, errno, strerror(errno));
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Move a port on to the next file in its chain, closing the
+ *             exhausted file. The zstd stream and any partial packet already
+ *             read are carried over, so the files are read as one stream.
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port
+ *
+ * @return     0: Success, -1: No files remain, 1: Fatal error
+ */
+int lofar_udp_reader_next_file(lofar_udp_reader *reader, const int port) {
+	if (reader->fileChainIndex[port] >= reader->fileChainLength[port]) return -1;
+
+	reader->inputConsumed[port] = lofar_udp_reader_input_position(reader, port);
+	if (reader->readerType == ZSTDCOMPRESSED && !reader->streaming[port] && reader->readingTracker[port].size > 0) {
+		munmap((void*) reader->readingTracker[port].src, reader->readingTracker[port].size);
+	} else if (reader->readerType == PCAP) {
+		lofar_udp_pcap_close(reader->pcap[port]);
+		reader->pcap[port] = NULL;
+	}
+	fclose(reader->fileRef[port]);
+
+	reader->fileRef[port] = reader->fileChain[port][reader->fileChainIndex[port]];
+	reader->fileChain[port][reader->fileChainIndex[port]] = NULL;
+	reader->fileChainIndex[port] += 1;
+	VERBOSE(if (reader->meta->VERBOSE) printf("reader_next_file: Port %d moving on to file %d/%d\n", port, reader->fileChainIndex[port] + 1, reader->fileChainLength[port] + 1));
+
+	if (reader->readerType == ZSTDCOMPRESSED) {
+		if (lofar_udp_reader_map_file(reader, port) > 0) return 1;
+	} else if (reader->readerType == PCAP) {
+		if ((reader->pcap[port] = lofar_udp_pcap_open(reader->fileRef[port], reader->meta->pcapPorts[port], reader->meta->headerOffset)) == NULL) return 1;
+	} else {
+		reader->streaming[port] = lofar_udp_input_streamed(reader->fileRef[port]);
+	}
+
+	if (reader->followFd[port] >= 0 && lofar_udp_reader_follow_setup(reader, port) > 0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      On reaching the end of the current file on a port, continue
+ *             with the next file of its chain or, once the chain has been
+ *             read, wait for a followed file to grow. Compressed streams are
+ *             refilled until they reach EOF first.
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port
+ *
+ * @return     0: More data may be available, -1: End of the input, 1: Fatal
+ *             error
+ */
+int lofar_udp_reader_continue_input(lofar_udp_reader *reader, const int port) {
+	int returnVal;
+
+	if (reader->readerType == ZSTDCOMPRESSED && reader->streaming[port] && lofar_udp_reader_stream_refill(reader, port) == 0) {
+		return 0;
+	}
+
+	if (reader->fileChainIndex[port] < reader->fileChainLength[port]) {
+		return lofar_udp_reader_next_file(reader, port);
+	}
+
+	if (reader->followFd[port] >= 0) {
+		if (reader->readerType == ZSTDCOMPRESSED) {
+			return lofar_udp_reader_follow_remap(reader, port);
+		}
+
+		if (reader->readerType == PCAP) {
+			if ((returnVal = lofar_udp_reader_follow_wait(reader, port, reader->pcap[port]->size)) == 0) {
+				return lofar_udp_pcap_extend(reader->pcap[port], reader->fileRef[port]);
+			}
+			return returnVal;
+		}
+
+		if ((returnVal = lofar_udp_reader_follow_wait(reader, port, ftell(reader->fileRef[port]))) == 0) {
+			clearerr(reader->fileRef[port]);
+		}
+		return returnVal;
+	}
+
+	return -1;
+}
+
+
+/**
+ * @brief      Wait for a followed input to grow beyond the data we have
+ *             already seen, for up to meta->followTimeout seconds in total.
+ *             Signals and modifications that do not add data do not restart
+ *             the timeout.
+ *
+ * @param      reader     The lofar_udp_reader
+ * @param[in]  port       The port to wait on
+ * @param[in]  knownSize  The size of the input we have already read / mapped
+ *
+ * @return     0: The input grew, -1: Timed out, 1: Fatal error
+ */
+int lofar_udp_reader_follow_wait(lofar_udp_reader *reader, const int port, const long knownSize) {
+	char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct pollfd watch = { .fd = reader->followFd[port], .events = POLLIN };
+	struct timespec now;
+	long deadline, remaining, fileSize;
+	int returnVal;
+
+	VERBOSE(if (reader->meta->VERBOSE) printf("reader_follow: Waiting up to %ds for data on port %d\n", reader->meta->followTimeout, port));
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	deadline = now.tv_sec * 1000 + now.tv_nsec / 1000000 + reader->meta->followTimeout * 1000L;
+
+	while (1) {
+		// The input may have grown before the watch was checked
+		if ((fileSize = fd_file_size(fileno(reader->fileRef[port]))) < 0) return 1;
+		if (fileSize > knownSize) return 0;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		remaining = deadline - (now.tv_sec * 1000 + now.tv_nsec / 1000000);
+		if (remaining <= 0) {
+			fprintf(stderr, "No new data on port %d after %d seconds, treating it as the end of the input.\n", port, reader->meta->followTimeout);
+			return -1;
+		}
+
+		returnVal = poll(&watch, 1, (int) remaining);
+		if (returnVal < 0 && errno != EINTR) {
+			fprintf(stderr, "ERROR: Failed to wait for new data on port %d (errno %d: %s), exiting.\n", port, errno, strerror(errno));
+			return 1;
+		}
+
+		// We only need to know the file changed, drain the queued events and check its size again
+		if (returnVal > 0) while (read(reader->followFd[port], events, sizeof(events)) > 0);
+	}
+}
+
+
+/**
+ * @brief      Wait for a followed compressed input to grow, then extend its
+ *             memory mapping. The decompression stream is left untouched, so
+ *             it resumes from where the previous data ended (even mid-frame).
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port to wait on
+ *
+ * @return     0: The input grew, -1: Timed out, 1: Fatal error
+ */
+int lofar_udp_reader_follow_remap(lofar_udp_reader *reader, const int port) {
+	long fileSize;
+	void *tmpPtr;
+	int returnVal;
+
+	if ((returnVal = lofar_udp_reader_follow_wait(reader, port, (long) reader->readingTracker[port].size)) != 0) return returnVal;
+	if ((fileSize = fd_file_size(fileno(reader->fileRef[port]))) < 0) return 1;
+
+	if (reader->readingTracker[port].size > 0) {
+		tmpPtr = mremap((void*) reader->readingTracker[port].src, reader->readingTracker[port].size, fileSize, MREMAP_MAYMOVE);
+	} else {
+		tmpPtr = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileno(reader->fileRef[port]), 0);
+	}
+	if (tmpPtr == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Failed to extend memory mapping for file on port %d. Errno: %d. Exiting.\n", port, errno);
+		return 1;
+	}
+
+	madvise(tmpPtr, fileSize, MADV_SEQUENTIAL);
+	reader->readingTracker[port].src = tmpPtr;
+	reader->readingTracker[port].size = fileSize;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Refill the compressed data buffer of a streamed input, from the
+ *             bytes read while parsing its header, then from the stream
+ *
+ * @param      reader  The lofar_udp_reader
+ * @param[in]  port    The port to refill
+ *
+ * @return     0: Success, -1: End of the stream
+ */
+int lofar_udp_reader_stream_refill(lofar_udp_reader *reader, const int port) {
+	const long bufferSize = ZSTD_DStreamInSize();
+	long length;
+
+	reader->inputConsumed[port] += reader->readingTracker[port].size;
+
+	length = lofar_udp_pushback_read(&(reader->pushback[port]), reader->streamBuffer[port], bufferSize);
+	if (length == 0) {
+		length = fread(reader->streamBuffer[port], sizeof(char), bufferSize, reader->fileRef[port]);
+	}
+
+	reader->readingTracker[port].src = reader->streamBuffer[port];
+	reader->readingTracker[port].size = length;
+	reader->readingTracker[port].pos = 0;
+
+	return length > 0 ? 0 : -1;
+}
+
+
+/**
+ * @brief      Get the number of compressed (or capture) bytes consumed on a
+ *             port, across the files of its chain and the refills of a stream
+ *
+ * @param[in]  reader  The lofar_udp_reader
+ * @param[in]  port    The port
+ *
+ * @return     Compressed bytes consumed
+ */
+long lofar_udp_reader_input_position(const lofar_udp_reader *reader, const int port) {
+	if (reader->readerType == PCAP) {
+		return reader->inputConsumed[port] + (reader->pcap[port] != NULL ? reader->pcap[port]->offset : 0);
+	}
+
+	return reader->inputConsumed[port] + (long) reader->readingTracker[port].pos;
+}
+
+
 /**
  * @brief      Attempt to fill the reader->meta->inputData buffers with new
  *             data. Performs a shift on the last N packets of a given port if
@@ -1416,10 +1929,17 @@ long lofar_udp_reader_nchars(lofar_udp_reader *reader, const int port, char *tar
 int lofar_udp_reader_read_step(lofar_udp_reader *reader) {
 	int returnVal = 0;
 	int checkReturnValue = 0;
+	long inputPosition = 0, bytesDecompressed = 0;
+	struct timespec tick, tock, tickShift, tockShift, tickPorts, tockPorts;
+	lofar_udp_perf_counters perfStart, perfEnd;
+
+	CLICK(tick);
+	TRACE_BEGIN("read_step", -1);
 
 	// Make sure we have work to perform
 	if (reader->meta->packetsPerIteration == 0) {
 		fprintf(stderr, "Last packets per iteration was 0, there is no work to perform, exiting...\n");
+		TRACE_END("read_step", -1);
 		return 1;
 	}
 
@@ -1427,7 +1947,23 @@ int lofar_udp_reader_read_step(lofar_udp_reader *reader) {
 	reader->meta->packetsPerIteration = reader->packetsPerIteration;
 
 	// If packets were dropped, shift the remaining packets back to the start of the array
-	if ((checkReturnValue = lofar_udp_shift_remainder_packets(reader, reader->meta->portLastDroppedPackets, 1)) > 0) return 1;
+	CLICK(tickShift);
+	TRACE_BEGIN("shift", -1);
+	reader->stats.lastBytesShifted = reader->stats.bytesShifted;
+	checkReturnValue = lofar_udp_shift_remainder_packets(reader, reader->meta->portLastDroppedPackets, 1);
+	reader->stats.lastBytesShifted = reader->stats.bytesShifted - reader->stats.lastBytesShifted;
+	TRACE_END("shift", -1);
+	if (checkReturnValue > 0) {
+		TRACE_END("read_step", -1);
+		return 1;
+	}
+	CLICK(tockShift);
+	lofar_udp_stage_stats_record(&(reader->stats.shift), TICKTOCK(tickShift, tockShift));
+
+	// Compressed inputs and captures are tracked by their position in the input, rather than the data extracted
+	if (reader->readerType == ZSTDCOMPRESSED || reader->readerType == PCAP) {
+		for (int port = 0; port < reader->meta->numPorts; port++) inputPosition -= lofar_udp_reader_input_position(reader, port);
+	}
 
 	// Ensure we aren't passed the read length cap
 	if (reader->meta->packetsRead >= (reader->meta->packetsReadMax - reader->meta->packetsPerIteration)) {
@@ -1439,13 +1975,18 @@ int lofar_udp_reader_read_step(lofar_udp_reader *reader) {
 	//else if (checkReturnValue < 0) if(lofar_udp_realign_data(reader) > 0) return 1;
 	
 	// Read in the required new data
-	#pragma omp parallel for shared(returnVal)
+	if (reader->perf != NULL) lofar_udp_perf_read(reader->perf, &perfStart);
+	CLICK(tickPorts);
+	#pragma omp parallel for num_threads(reader->readThreads) shared(returnVal) reduction(+: bytesDecompressed)
 	for (int port = 0; port < reader->meta->numPorts; port++) {
 		long charsToRead, charsRead, packetPerIter;
 		
 		// Determine how much data is needed and read-in to the offset after any leftover packets
 		charsToRead = (reader->meta->packetsPerIteration - reader->meta->portLastDroppedPackets[port]) * reader->meta->portPacketLength[port];
+		TRACE_BEGIN("read_port", port);
 		charsRead = lofar_udp_reader_nchars(reader, port, &(reader->meta->inputData[port][reader->meta->inputDataOffset[port]]), charsToRead, reader->meta->inputDataOffset[port]);
+		TRACE_END("read_port", port);
+		if (charsRead > 0) bytesDecompressed += charsRead;
 
 		// Raise a warning if we received less data than requested (EOF/file error)
 		if (charsRead < charsToRead) {
@@ -1472,12 +2013,171 @@ int lofar_udp_reader_read_step(lofar_udp_reader *reader) {
 		}
 	}
 
+	CLICK(tockPorts);
+	if (reader->perf != NULL) {
+		lofar_udp_perf_read(reader->perf, &perfEnd);
+		lofar_udp_perf_accumulate(&(reader->stats.portReadCounters), &perfStart, &perfEnd);
+	}
+
 	// Mark the input data are ready to be processed
 	reader->meta->inputDataReady = 1;
+
+	if (reader->readerType == ZSTDCOMPRESSED || reader->readerType == PCAP) {
+		for (int port = 0; port < reader->meta->numPorts; port++) inputPosition += lofar_udp_reader_input_position(reader, port);
+	} else {
+		inputPosition = bytesDecompressed;
+	}
+	reader->stats.gulpsRead += 1;
+	reader->stats.lastBytesRead = inputPosition;
+	reader->stats.bytesRead += inputPosition;
+	reader->stats.lastBytesDecompressed = bytesDecompressed;
+	reader->stats.bytesDecompressed += bytesDecompressed;
+	lofar_udp_stage_stats_record(&(reader->stats.portRead), TICKTOCK(tickPorts, tockPorts));
+
+	CLICK(tock);
+	TRACE_END("read_step", -1);
+	lofar_udp_stage_stats_record(&(reader->stats.readStep), TICKTOCK(tick, tock));
 	return returnVal;
 }
 
 
+/**
+ * @brief      Add a timed call to a stage's instrumentation counters
+ *
+ * @param      stage    The lofar_udp_stage_stats
+ * @param[in]  seconds  The time spent in the stage
+ */
+void lofar_udp_stage_stats_record(lofar_udp_stage_stats *stage, const double seconds) {
+	stage->calls += 1;
+	stage->lastTime = seconds;
+	stage->totalTime += seconds;
+}
+
+
+/**
+ * @brief      Take a copy of the reader's instrumentation counters, including
+ *             the per-port packet counters. Must be called from the thread
+ *             driving the reader (eg. between steps).
+ *
+ * @param[in]  reader  The lofar_udp_reader
+ * @param      stats   The output lofar_udp_reader_stats
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_reader_get_stats(const lofar_udp_reader *reader, lofar_udp_reader_stats *stats) {
+	if (reader == NULL || stats == NULL) {
+		fprintf(stderr, "ERROR: A reader and stats struct must be provided to get the reader's stats, exiting.\n");
+		return 1;
+	}
+
+	*stats = reader->stats;
+	for (int port = 0; port < MAX_NUM_PORTS; port++) {
+		if (port < reader->meta->numPorts) {
+			stats->portPacketsDropped[port] = reader->meta->portTotalPaddedPackets[port];
+			stats->portPacketsReplayed[port] = reader->meta->replayDroppedPackets ? reader->meta->portTotalPaddedPackets[port] : 0;
+			stats->portPacketsOutOfOrder[port] = reader->meta->portTotalOutOfOrderPackets[port];
+		} else {
+			stats->portPacketsDropped[port] = 0;
+			stats->portPacketsReplayed[port] = 0;
+			stats->portPacketsOutOfOrder[port] = 0;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Get the number of bytes added to an output by the time-major
+ *             overlap
+ *
+ * @param[in]  meta  The lofar_udp_meta
+ * @param[in]  out   The output index
+ *
+ * @return     The overlap length in bytes (0 when disabled)
+ */
+long lofar_udp_time_major_overlap_length(const lofar_udp_meta *meta, const int out) {
+	return (long) meta->timeMajorOverlap * (meta->packetOutputLength[out] / UDPNTIMESLICE);
+}
+
+
+/**
+ * @brief      Copy the final overlap samples of each channel from the previous
+ *             gulp's output to the start of each channel in the current
+ *             output buffers, so they are not recomputed. The previous gulp may
+ *             be in the same buffer, or the other set of a writer's buffers.
+ *
+ * @param      meta  The lofar_udp_meta
+ *
+ * @return     0: Success, -1: The previous gulp could not provide the overlap,
+ *             it has been zeroed instead
+ */
+int lofar_udp_reader_carry_overlap(lofar_udp_meta *meta) {
+	const long overlap = meta->timeMajorOverlap;
+	const long currentStride = meta->packetsPerIteration * UDPNTIMESLICE + overlap;
+	const long previousStride = meta->overlapSourceSamples + overlap;
+	int returnVal = 0;
+
+	for (int out = 0; out < meta->numOutputs; out++) {
+		const long sampleLength = meta->packetOutputLength[out] / UDPNTIMESLICE / meta->totalProcBeamlets;
+		const int numChannels = meta->totalProcBeamlets;
+
+		// Channels are handled in ascending order, so an in-place copy never overwrites a later channel's tail
+		for (int chan = 0; chan < numChannels; chan++) {
+			char *dest = &(meta->outputData[out][chan * currentStride * sampleLength]);
+			if (meta->overlapSource[out] == NULL || meta->overlapSourceSamples < overlap) {
+				memset(dest, 0, overlap * sampleLength);
+				returnVal = -1;
+			} else {
+				memmove(dest, &(meta->overlapSource[out][(chan * previousStride + meta->overlapSourceSamples) * sampleLength]), overlap * sampleLength);
+			}
+		}
+	}
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Check whether the gulp in the input buffers can be passed
+ *             through without running the copy kernels (modes 0/1): every
+ *             packet on every port must be the next expected packet. If so,
+ *             perform the bookkeeping the processing loop would have done and
+ *             mark the gulp with passthroughReady.
+ *
+ * @param      meta  The lofar_udp_meta
+ *
+ * @return     1: The gulp was passed through, 0: The kernels must be run
+ */
+int lofar_udp_reader_passthrough(lofar_udp_meta *meta) {
+	meta->passthroughReady = 0;
+
+	if (!meta->allowPassthrough || meta->processingMode > 1) {
+		return 0;
+	}
+
+	for (int port = 0; port < meta->numPorts; port++) {
+		for (long packet = 0; packet < meta->packetsPerIteration; packet++) {
+			if (lofar_get_packet_number(&(meta->inputData[port][packet * meta->portPacketLength[port]])) != meta->lastPacket + 1 + packet) {
+				VERBOSE(if (meta->VERBOSE) printf("Passthrough: packet %ld on port %d is not sequential, running the kernels.\n", packet, port));
+				return 0;
+			}
+		}
+	}
+
+	for (int port = 0; port < meta->numPorts; port++) {
+		meta->portLastDroppedPackets[port] = 0;
+	}
+	meta->lastPacket += meta->packetsPerIteration;
+	meta->inputDataReady = 0;
+	meta->outputDataReady = 1;
+	meta->calibrationStep += 1;
+	meta->passthroughReady = 1;
+
+	return 1;
+}
+
+
 /**
  * @brief      Perform a read/process step, without any timing.
  *
@@ -1489,16 +2189,21 @@ int lofar_udp_reader_read_step(lofar_udp_reader *reader) {
  *             errors
  */
 int lofar_udp_reader_step_timed(lofar_udp_reader *reader, double timing[2]) {
-	int readReturnVal = 0, stepReturnVal = 0;
-	struct timespec tick0, tick1, tock0, tock1;
+	int readReturnVal = 0, stepReturnVal = 0, passthrough;
+	struct timespec tick0, tick1, tock0, tock1, tickStage, tockStage;
+	lofar_udp_perf_counters perfStart, perfEnd;
 	const int time = !(timing[0] == -1.0);
 
 
 	if (reader->meta->calibrateData && reader->meta->calibrationStep >= reader->calibration->calibrationStepsGenerated) {
 		VERBOSE(printf("Calibration buffer has run out, generating new Jones matrices.\n"));
-		if ((readReturnVal > lofar_udp_reader_calibration(reader))) {
-			return readReturnVal;
-		}
+		CLICK(tickStage);
+		TRACE_BEGIN("calibration", reader->meta->calibrationStep);
+		readReturnVal = lofar_udp_reader_calibration(reader);
+		TRACE_END("calibration", reader->meta->calibrationStep);
+		if (readReturnVal > 0) return readReturnVal;
+		CLICK(tockStage);
+		lofar_udp_stage_stats_record(&(reader->stats.calibration), TICKTOCK(tickStage, tockStage));
 	}
 
 	// Start the reader clock
@@ -1513,6 +2218,7 @@ int lofar_udp_reader_step_timed(lofar_udp_reader *reader, double timing[2]) {
 
 		if (reader->readerType == ZSTDCOMPRESSED) {
 			for (int i = 0; i < reader->meta->numPorts; i++) {
+				if (reader->streaming[i]) continue;
 				if (madvise(((void*) reader->readingTracker[i].src), reader->readingTracker[i].pos, MADV_DONTNEED) < 0) {
 					fprintf(stderr, "ERROR: Failed to apply MADV_DONTNEED after read operation on port %d (errno %d: %s).\n", i, errno, strerror(errno));
 				}
@@ -1532,9 +2238,41 @@ int lofar_udp_reader_step_timed(lofar_udp_reader *reader, double timing[2]) {
 	// Make sure there is a new input data set before running
 	// On the setup iteration, the output data is marked as ready to prevent this occurring until the first read step is called
 	if (reader->meta->outputDataReady != 1 && reader->meta->packetsPerIteration > 0) {
-		if ((stepReturnVal = lofar_udp_cpp_loop_interface(reader->meta)) > 0) {
-			return stepReturnVal;
+		CLICK(tickStage);
+		passthrough = lofar_udp_reader_passthrough(reader->meta);
+		CLICK(tockStage);
+		if (reader->meta->allowPassthrough) lofar_udp_stage_stats_record(&(reader->stats.headers), TICKTOCK(tickStage, tockStage));
+
+		if (passthrough) {
+			lofar_udp_stage_stats_record(&(reader->stats.passthrough), 0.0);
+		} else {
+			CLICK(tickStage);
+			TRACE_BEGIN("kernel", reader->meta->processingMode);
+			if (reader->perf != NULL) lofar_udp_perf_read(reader->perf, &perfStart);
+			if (reader->meta->timeMajorOverlap > 0) lofar_udp_reader_carry_overlap(reader->meta);
+			if (reader->meta->vdifChannels > 0 && reader->meta->vdifScales == NULL) {
+				if ((stepReturnVal = lofar_udp_vdif_setup(reader->meta)) > 0) {
+					goto kernel_cleanup;
+				}
+			}
+			if ((stepReturnVal = lofar_udp_cpp_loop_interface(reader->meta)) > 0) {
+				goto kernel_cleanup;
+			}
+			if (reader->perf != NULL) {
+				lofar_udp_perf_read(reader->perf, &perfEnd);
+				lofar_udp_perf_accumulate(&(reader->stats.kernelCounters), &perfStart, &perfEnd);
+			}
+
+kernel_cleanup:
+			// Close the span on every path, so that failed gulps do not leave it open in the trace
+			TRACE_END("kernel", reader->meta->processingMode);
+			if (stepReturnVal > 0) return stepReturnVal;
+			CLICK(tockStage);
+			lofar_udp_stage_stats_record(&(reader->stats.kernel), TICKTOCK(tickStage, tockStage));
 		}
+		reader->stats.gulpsProcessed += 1;
+		for (int out = 0; out < reader->meta->numOutputs; out++) reader->meta->overlapSource[out] = reader->meta->outputData[out];
+		reader->meta->overlapSourceSamples = reader->meta->packetsPerIteration * UDPNTIMESLICE;
 		reader->meta->packetsRead += reader->meta->packetsPerIteration;
 		reader->meta->inputDataReady = 0;
 	}
@@ -1579,11 +2317,16 @@ int lofar_udp_reader_step(lofar_udp_reader *reader) {
  */
 int lofar_udp_get_first_packet_alignment(lofar_udp_reader *reader) {
 
-	// Align the data to the same packet on each port
-	int returnVal = lofar_udp_get_first_packet_alignment_meta(reader);
-	int shiftPackets[MAX_NUM_PORTS], returnLen;
+	struct timespec tick, tock;
+	int returnVal, shiftPackets[MAX_NUM_PORTS], returnLen;
 	long nchars;
 
+	// Align the data to the same packet on each port
+	CLICK(tick);
+	returnVal = lofar_udp_get_first_packet_alignment_meta(reader);
+	CLICK(tock);
+	lofar_udp_stage_stats_record(&(reader->stats.headers), TICKTOCK(tick, tock));
+
 	VERBOSE(if (reader->meta->VERBOSE) printf("first_pkt_align: returnVal %d\n", returnVal));
 	
 	// Update the data status if we haven't had a majour error
@@ -1659,6 +2402,8 @@ int lofar_udp_get_first_packet_alignment_meta(lofar_udp_reader *reader) {
 			// Initialise/Reset the dropped packet counters
 			meta->portLastDroppedPackets[port] = 0;
 			meta->portTotalDroppedPackets[port] = 0;
+			meta->portTotalPaddedPackets[port] = 0;
+			meta->portTotalOutOfOrderPackets[port] = 0;
 			maxIndex[port] = meta->packetsPerIteration * meta->portPacketLength[port];
 			portStartingPacket[port] = lofar_get_packet_number(meta->inputData[port]);
 
@@ -1933,6 +2678,7 @@ int lofar_udp_shift_remainder_packets(lofar_udp_reader *reader, const int shiftP
 
 			// Mmemove the data as needed (memcpy can't act on the same array)
 			memmove(&(inputData[destOffset]), &(inputData[sourceOffset]), byteShift);
+			reader->stats.bytesShifted += byteShift;
 
 			// Reset the 0-valued buffer to wipe any time/sequence data remaining
 			if (!meta->replayDroppedPackets) {
@@ -1962,4 +2708,107 @@ long fd_file_size(int fd) {
 	}
 
 	return stat_s.st_size;
-}
\ No newline at end of file
+}
+
+
+/**
+ * @brief      Check if an input is a stream (pipe, socket, terminal) that
+ *             cannot be seeked or memory mapped
+ *
+ * @param      inputFile  The input file
+ *
+ * @return     1: Streamed, 0: Seekable
+ */
+int lofar_udp_input_streamed(FILE *inputFile) {
+	return lseek(fileno(inputFile), 0, SEEK_CUR) < 0 && errno == ESPIPE;
+}
+
+
+/**
+ * @brief      Read the first header from a streamed input, keeping every byte
+ *             read in a pushback buffer for the reader. Compressed streams
+ *             are detected from the zstd frame magic number.
+ *
+ * @param      inputFile     The input file
+ * @param[out] header        The header buffer
+ * @param[in]  headerLength  The header length
+ * @param[out] pushback      The bytes read from the input
+ * @param[out] readerType    The detected reader type
+ *
+ * @return     int: header bytes read (less than headerLength on error)
+ */
+int lofar_udp_stream_peek_header(FILE *inputFile, char *header, const int headerLength, lofar_udp_pushback *pushback, int *readerType) {
+	const size_t chunkSize = ZSTD_DStreamInSize();
+	size_t returnVal, capacity = chunkSize;
+	unsigned int magic;
+	long readlen;
+	char *tmpPtr;
+
+	*pushback = (lofar_udp_pushback) { malloc(capacity), 0, 0 };
+	if (pushback->data == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate a pushback buffer, exiting.\n");
+		return 0;
+	}
+
+	pushback->length = fread(pushback->data, sizeof(char), headerLength, inputFile);
+	if (pushback->length < (long) sizeof(magic)) return 0;
+
+	memcpy(&magic, pushback->data, sizeof(magic));
+	if (magic != ZSTD_MAGICNUMBER) {
+		*readerType = NORMAL;
+		memcpy(header, pushback->data, pushback->length);
+		return pushback->length;
+	}
+
+	// Decompress until we have a header, reading further blocks into the pushback buffer as needed
+	*readerType = ZSTDCOMPRESSED;
+	ZSTD_DStream *dstreamTmp = ZSTD_createDStream();
+	ZSTD_initDStream(dstreamTmp);
+	ZSTD_inBuffer input = { pushback->data, pushback->length, 0 };
+	ZSTD_outBuffer output = { header, headerLength, 0 };
+
+	while (output.pos < output.size) {
+		if (input.pos == input.size) {
+			if (pushback->length + chunkSize > capacity) {
+				capacity += chunkSize;
+				if ((tmpPtr = realloc(pushback->data, capacity)) == NULL) break;
+				pushback->data = tmpPtr;
+			}
+
+			if ((readlen = fread(&(pushback->data[pushback->length]), sizeof(char), chunkSize, inputFile)) <= 0) break;
+			pushback->length += readlen;
+			input.src = pushback->data;
+			input.size = pushback->length;
+		}
+
+		returnVal = ZSTD_decompressStream(dstreamTmp, &output, &input);
+		if (ZSTD_isError(returnVal)) {
+			fprintf(stderr, "ZSTD encountered an error while peeking at a stream header (%zu, %s), exiting.\n", returnVal, ZSTD_getErrorName(returnVal));
+			break;
+		}
+	}
+
+	ZSTD_freeDStream(dstreamTmp);
+	return output.pos;
+}
+
+
+/**
+ * @brief      Copy up to nchars unread bytes from a pushback buffer
+ *
+ * @param      pushback     The pushback buffer
+ * @param      targetArray  The storage array
+ * @param[in]  nchars       The maximum number of bytes to copy
+ *
+ * @return     long: bytes copied
+ */
+long lofar_udp_pushback_read(lofar_udp_pushback *pushback, char *targetArray, const long nchars) {
+	long length = pushback->length - pushback->pos;
+	if (length > nchars) length = nchars;
+	if (length <= 0) return 0;
+
+	memcpy(targetArray, &(pushback->data[pushback->pos]), length);
+	pushback->pos += length;
+
+	return length;
+}
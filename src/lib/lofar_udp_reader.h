@@ -10,6 +10,8 @@
 #include <errno.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/inotify.h>
+#include <poll.h>
 
 // Calibration extra requirements
 #include <sys/types.h>
@@ -22,6 +24,9 @@ extern char **environ;
 
 
 #include "lofar_udp_general.h"
+#include "lofar_udp_trace.h"
+#include "lofar_udp_perf.h"
+#include "lofar_udp_pcap.h"
 
 #ifndef __LOFAR_UDP_READER_STRUCTS
 #define __LOFAR_UDP_READER_STRUCTS
@@ -30,7 +35,8 @@ typedef enum {
 	NORMAL,
 	ZSTDCOMPRESSED,
 	DADA,
-	BITSHFLCOMPRESSED
+	BITSHFLCOMPRESSED,
+	PCAP
 } reader_t;
 
 typedef struct lofar_udp_calibration {
@@ -95,16 +101,46 @@ typedef struct lofar_udp_meta {
 	int outputBitMode;
 	int packetOutputLength[MAX_OUTPUT_DIMS];
 
+	// Time-major overlap: samples of the previous gulp repeated at the start of each channel (modes 30-32)
+	int timeMajorOverlap;
+	char *overlapSource[MAX_OUTPUT_DIMS];
+	long overlapSourceSamples;
+
+	// VDIF output (modes 40-42): padded channels per frame, reference epoch, station code and quantiser scales per beamlet/polarisation
+	int vdifChannels;
+	int vdifEpoch;
+	long vdifEpochStart;
+	unsigned int vdifStationCode;
+	float *vdifScales;
+
+	// Passthrough (modes 0/1): set by a consumer that can write straight from inputData (eg. lofar_udp_writer). Clean
+	// 	gulps then skip the kernels, outputData is not updated and passthroughReady is set until the next step.
+	int allowPassthrough;
+	int passthroughReady;
+
 
 	// Track the number of ports to process and the packet loss on each
 	int numPorts;
 	int portLastDroppedPackets[MAX_NUM_PORTS];
 	int portTotalDroppedPackets[MAX_NUM_PORTS];
 
+	// Packets padded (missing from the input) and discarded for arriving out of order on each port, cumulative
+	long portTotalPaddedPackets[MAX_NUM_PORTS];
+	long portTotalOutOfOrderPackets[MAX_NUM_PORTS];
+
 	// Configuration: replay last packet or copy a 0 packed file, set the processing mode and it's related processing function
 	int replayDroppedPackets;
 	int processingMode;
 
+	// Seconds to wait for the inputs to grow on EOF (0: EOF ends the data)
+	int followTimeout;
+
+	// Bytes before the CEP header of each packet; inputData[port] points to the first CEP header
+	int headerOffset;
+
+	// UDP destination port read from each pcap input (0: any)
+	int pcapPorts[MAX_NUM_PORTS];
+
 	// Overall runtime information
 	long packetsPerIteration;
 	long packetsRead;
@@ -124,6 +160,77 @@ typedef struct lofar_udp_meta {
 extern lofar_udp_meta lofar_udp_meta_default;
 
 
+// Instrumentation: time spent in a stage, cumulative and for the most recent call
+typedef struct lofar_udp_stage_stats {
+	long calls;
+	double totalTime;
+	double lastTime;
+} lofar_udp_stage_stats;
+
+
+// Reader instrumentation, updated by the thread driving the reader; see lofar_udp_reader_get_stats
+typedef struct lofar_udp_reader_stats {
+	// Gulps read from the inputs and processed
+	long gulpsRead;
+	long gulpsProcessed;
+
+	// Bytes consumed from the input files (compressed for zstd inputs), placed in the input buffers and moved by
+	// 	remainder shifts, in total and for the most recent gulp
+	long bytesRead;
+	long lastBytesRead;
+	long bytesDecompressed;
+	long lastBytesDecompressed;
+	long bytesShifted;
+	long lastBytesShifted;
+
+	// lofar_udp_reader_read_step, wall time
+	lofar_udp_stage_stats readStep;
+
+	// Reading (and decompressing, for compressed inputs) the new data on every port, wall time of the parallel region
+	lofar_udp_stage_stats portRead;
+
+	// lofar_udp_shift_remainder_packets
+	lofar_udp_stage_stats shift;
+
+	// Header scans outside of the kernels (first packet alignment, passthrough checks)
+	lofar_udp_stage_stats headers;
+
+	// Processing kernel for meta->processingMode (including any time-major overlap carry), and gulps passed through
+	lofar_udp_stage_stats kernel;
+	lofar_udp_stage_stats passthrough;
+
+	// Waiting for dreamBeam to generate Jones matrices
+	lofar_udp_stage_stats calibration;
+
+	// Set by an attached lofar_udp_writer: time spent writing gulps, bytes written and time spent waiting for the
+	// 	previous gulp's write to finish before the buffers could be reused
+	lofar_udp_stage_stats write;
+	long bytesWritten;
+	lofar_udp_stage_stats writeWait;
+
+	// Hardware counters accumulated over the port read and kernel stages, when enabled with
+	// 	lofar_udp_config.perfCounters; counters that are disabled or unavailable are -1. These are process-wide
+	// 	readings, so they include any threads running alongside the stage, such as an attached writer's.
+	lofar_udp_perf_counters portReadCounters;
+	lofar_udp_perf_counters kernelCounters;
+
+	// Per-port packet counters, copied from the meta struct by lofar_udp_reader_get_stats
+	long portPacketsDropped[MAX_NUM_PORTS];
+	long portPacketsReplayed[MAX_NUM_PORTS];
+	long portPacketsOutOfOrder[MAX_NUM_PORTS];
+
+} lofar_udp_reader_stats;
+
+
+// Bytes read ahead from a streamed (non-seekable) input while scanning its header, which
+// 	cannot be seeked back over, so they are handed to the reader and consumed first
+typedef struct lofar_udp_pushback {
+	char *data;
+	long length;
+	long pos;
+} lofar_udp_pushback;
+
+
 // File data + decompression struct
 typedef struct lofar_udp_reader {
 	FILE *fileRef[MAX_NUM_PORTS];
@@ -132,14 +239,41 @@ typedef struct lofar_udp_reader {
 
 	int ompThreads;
 
+	// Threads used to read / decompress the ports
+	int readThreads;
+
 	// Setup ZSTD requirements
 	ZSTD_DStream *dstream[MAX_NUM_PORTS];
 	ZSTD_inBuffer readingTracker[MAX_NUM_PORTS];
 	ZSTD_outBuffer decompressionTracker[MAX_NUM_PORTS];
 
+	// Follow mode: an inotify instance watching each input file (-1 when disabled)
+	int followFd[MAX_NUM_PORTS];
+
+	// Further files on each port, read in order once the current file is exhausted
+	FILE **fileChain[MAX_NUM_PORTS];
+	int fileChainLength[MAX_NUM_PORTS];
+	int fileChainIndex[MAX_NUM_PORTS];
+
+	// Streamed (non-seekable) inputs: compressed data are decompressed from a buffer refilled
+	// 	by fread rather than from a memory mapping
+	int streaming[MAX_NUM_PORTS];
+	char *streamBuffer[MAX_NUM_PORTS];
+	lofar_udp_pushback pushback[MAX_NUM_PORTS];
+
+	// Compressed / capture bytes consumed before the current mapping / stream buffer on each port
+	long inputConsumed[MAX_NUM_PORTS];
+
+	// pcap / pcapng captures being read on each port
+	lofar_udp_pcap *pcap[MAX_NUM_PORTS];
+
 	// Cache the constant length for the arrays malloc'd by the reader, will be used to reset meta
 	long packetsPerIteration;
 
+	// Instrumentation counters, and the hardware counters backing them (NULL when disabled)
+	lofar_udp_reader_stats stats;
+	lofar_udp_perf *perf;
+
 	// Metadata / data struct
 	lofar_udp_meta *meta;
 
@@ -154,6 +288,11 @@ typedef struct lofar_udp_config {
 	// Points to input files, compressed or uncompressed
 	FILE **inputFiles;
 
+	// Further files for each port (eg. the hourly files of a long observation), read in order
+	// 	as if they were appended to the input file; the reader closes each file once it is exhausted
+	FILE **inputFileChains[MAX_NUM_PORTS];
+	int inputFileChainLengths[MAX_NUM_PORTS];
+
 	// Number of ports of raw data being provided in inputFIles
 	int numPorts;
 
@@ -191,6 +330,29 @@ typedef struct lofar_udp_config {
 	// Number of OMP threads to use while processing
 	int ompThreads;
 
+	// Number of OMP threads to use while reading / decompressing the ports (0: use ompThreads)
+	int readThreads;
+
+	// Number of samples from the end of the previous gulp to repeat at the
+	// start of each channel in time-major modes (30-32), eg. GUPPI RAW OVERLAP
+	int timeMajorOverlap;
+
+	// Follow inputs that are still being written: on EOF, wait up to this many seconds for
+	// 	more data to be appended before treating it as the end of the data (0 disables)
+	int followTimeout;
+
+	// Number of bytes each packet is prefixed with before its CEP header (eg. a timestamp or sequence
+	// 	number added by the recorder), these are skipped by the reader and kernels (default: UDPHDROFF)
+	int headerOffset;
+
+	// pcap / pcapng inputs (readerType PCAP): UDP destination port to take each port's
+	// 	packets from, so that several ports can be read from one capture (0: every UDP packet)
+	int pcapPorts[MAX_NUM_PORTS];
+
+	// Count cycles, instructions and last level cache misses in the port read and kernel stages with
+	// 	perf_event_open, see lofar_udp_reader_stats
+	int perfCounters;
+
 } lofar_udp_config;
 extern lofar_udp_config lofar_udp_config_default;
 #endif
@@ -211,10 +373,12 @@ extern "C" {
 lofar_udp_reader* lofar_udp_meta_file_reader_setup(FILE **inputFiles, const int numPorts, const int replayDroppedPackets, const int processingMode, const int verbose, const long packetsPerIteration, const long startingPacket, const long packetsReadMax, const int compressedReader);
 lofar_udp_reader* lofar_udp_meta_file_reader_setup_struct(lofar_udp_config *config);
 lofar_udp_reader* lofar_udp_file_reader_setup(FILE **inputFiles, lofar_udp_meta *meta, const int compressedReader, lofar_udp_calibration *calibration);
+lofar_udp_reader* lofar_udp_file_reader_setup_ext(FILE **inputFiles, lofar_udp_meta *meta, const int compressedReader, lofar_udp_calibration *calibration, FILE **fileChains[], const int fileChainLengths[], lofar_udp_pushback *pushback);
 int lofar_udp_file_reader_reuse(lofar_udp_reader *reader, const long startingPacket, const long packetsReadMax);
 
 // Initialisation helpers
 int lofar_udp_parse_headers(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDPHDRLEN], const int beamletLimits[2]);
+int lofar_udp_parse_headers_ext(lofar_udp_meta *meta, char header[MAX_NUM_PORTS][UDPHDROFFMAX + UDPHDRLEN], const int beamletLimits[2]);
 int lofar_udp_setup_processing(lofar_udp_meta *meta);
 int lofar_udp_get_first_packet_alignment(lofar_udp_reader *reader);
 int lofar_udp_get_first_packet_alignment_meta(lofar_udp_reader *reader);
@@ -223,8 +387,23 @@ int lofar_udp_get_first_packet_alignment_meta(lofar_udp_reader *reader);
 int lofar_udp_reader_step(lofar_udp_reader *reader);
 int lofar_udp_reader_step_timed(lofar_udp_reader *reader, double timing[2]);
 int lofar_udp_reader_read_step(lofar_udp_reader *reader);
+int lofar_udp_reader_carry_overlap(lofar_udp_meta *meta);
+int lofar_udp_reader_passthrough(lofar_udp_meta *meta);
+long lofar_udp_time_major_overlap_length(const lofar_udp_meta *meta, const int out);
 int lofar_udp_shift_remainder_packets(lofar_udp_reader *reader, const int shiftPackets[], const int handlePadding);
 long lofar_udp_reader_nchars(lofar_udp_reader *reader, const int port, char *targetArray, const long nchars, const long knownOffset);
+int lofar_udp_reader_map_file(lofar_udp_reader *reader, const int port);
+int lofar_udp_reader_next_file(lofar_udp_reader *reader, const int port);
+int lofar_udp_reader_continue_input(lofar_udp_reader *reader, const int port);
+int lofar_udp_reader_follow_setup(lofar_udp_reader *reader, const int port);
+int lofar_udp_reader_follow_wait(lofar_udp_reader *reader, const int port, const long knownSize);
+int lofar_udp_reader_follow_remap(lofar_udp_reader *reader, const int port);
+int lofar_udp_reader_stream_refill(lofar_udp_reader *reader, const int port);
+long lofar_udp_reader_input_position(const lofar_udp_reader *reader, const int port);
+
+// Instrumentation
+int lofar_udp_reader_get_stats(const lofar_udp_reader *reader, lofar_udp_reader_stats *stats);
+void lofar_udp_stage_stats_record(lofar_udp_stage_stats *stage, const double seconds);
 //int lofar_udp_realign_data(lofar_udp_reader *reader);
 
 
@@ -236,6 +415,9 @@ int lofar_udp_reader_cleanup_f(lofar_udp_reader *reader, const int closeFiles);
 // Maybe move these to misc?
 int fread_temp_ZSTD(void *outbuf, const size_t size, int num, FILE* inputFile, const int resetSeek);
 long fd_file_size(int fd);
+int lofar_udp_input_streamed(FILE *inputFile);
+int lofar_udp_stream_peek_header(FILE *inputFile, char *header, const int headerLength, lofar_udp_pushback *pushback, int *readerType);
+long lofar_udp_pushback_read(lofar_udp_pushback *pushback, char *targetArray, const long nchars);
 
 #ifdef __cplusplus
 }
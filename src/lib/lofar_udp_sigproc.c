@@ -0,0 +1,270 @@
+#include "lofar_udp_sigproc.h"
+
+
+// Header default: nothing is written until it is set
+const sigproc_hdr sigproc_hdr_default = {
+	.source_name = "",
+	.rawdatafile = "",
+
+	.telescope_id = -1,
+	.machine_id = -1,
+	.data_type = 1,
+	.nchans = -1,
+	.nbits = -1,
+	.nifs = 1,
+	.nbeams = -1,
+	.ibeam = -1,
+	.barycentric = -1,
+	.pulsarcentric = -1,
+
+	.tstart = SIGPROC_UNSET_DOUBLE,
+	.tsamp = SIGPROC_UNSET_DOUBLE,
+	.fch1 = SIGPROC_UNSET_DOUBLE,
+	.foff = SIGPROC_UNSET_DOUBLE,
+	.src_raj = SIGPROC_UNSET_DOUBLE,
+	.src_dej = SIGPROC_UNSET_DOUBLE,
+	.az_start = SIGPROC_UNSET_DOUBLE,
+	.za_start = SIGPROC_UNSET_DOUBLE,
+	.refdm = SIGPROC_UNSET_DOUBLE,
+	.period = SIGPROC_UNSET_DOUBLE
+};
+
+
+// mockHeader-style flags and the attributes they modify
+typedef enum sigproc_arg_t { SIGPROC_STR, SIGPROC_INT, SIGPROC_DOUBLE } sigproc_arg_t;
+
+typedef struct sigproc_arg {
+	const char *flag;
+	sigproc_arg_t type;
+	size_t offset;
+} sigproc_arg;
+
+static const sigproc_arg sigprocArgs[] = {
+	{ "-source", SIGPROC_STR, offsetof(sigproc_hdr, source_name) },
+	{ "-rawfile", SIGPROC_STR, offsetof(sigproc_hdr, rawdatafile) },
+
+	{ "-tel", SIGPROC_INT, offsetof(sigproc_hdr, telescope_id) },
+	{ "-mach", SIGPROC_INT, offsetof(sigproc_hdr, machine_id) },
+	{ "-type", SIGPROC_INT, offsetof(sigproc_hdr, data_type) },
+	{ "-nchans", SIGPROC_INT, offsetof(sigproc_hdr, nchans) },
+	{ "-nbits", SIGPROC_INT, offsetof(sigproc_hdr, nbits) },
+	{ "-nifs", SIGPROC_INT, offsetof(sigproc_hdr, nifs) },
+	{ "-nbeams", SIGPROC_INT, offsetof(sigproc_hdr, nbeams) },
+	{ "-ibeam", SIGPROC_INT, offsetof(sigproc_hdr, ibeam) },
+	{ "-bary", SIGPROC_INT, offsetof(sigproc_hdr, barycentric) },
+	{ "-pulsarcentric", SIGPROC_INT, offsetof(sigproc_hdr, pulsarcentric) },
+
+	{ "-tstart", SIGPROC_DOUBLE, offsetof(sigproc_hdr, tstart) },
+	{ "-tsamp", SIGPROC_DOUBLE, offsetof(sigproc_hdr, tsamp) },
+	{ "-fch1", SIGPROC_DOUBLE, offsetof(sigproc_hdr, fch1) },
+	{ "-fo", SIGPROC_DOUBLE, offsetof(sigproc_hdr, foff) },
+	{ "-ra", SIGPROC_DOUBLE, offsetof(sigproc_hdr, src_raj) },
+	{ "-dec", SIGPROC_DOUBLE, offsetof(sigproc_hdr, src_dej) },
+	{ "-az", SIGPROC_DOUBLE, offsetof(sigproc_hdr, az_start) },
+	{ "-za", SIGPROC_DOUBLE, offsetof(sigproc_hdr, za_start) },
+	{ "-dm", SIGPROC_DOUBLE, offsetof(sigproc_hdr, refdm) },
+	{ "-period", SIGPROC_DOUBLE, offsetof(sigproc_hdr, period) }
+};
+static const int sigprocArgsCount = sizeof(sigprocArgs) / sizeof(sigproc_arg);
+
+
+/**
+ * @brief      Fill in the attributes of a header that can be determined from
+ *             the reader: start time, channel count, bit mode and sampling time
+ *
+ * @param      header  The sigproc_hdr
+ * @param[in]  meta    The lofar_udp_meta of the reader, after a step or
+ *                     reuse
+ *
+ * @return     0: Success, <0: The processing mode may not produce SIGPROC
+ *             compatible data
+ */
+int lofar_udp_sigproc_setup(sigproc_hdr *header, const lofar_udp_meta *meta) {
+	header->tstart = lofar_get_packet_time_mjd(meta->inputData[0]);
+	header->nchans = meta->totalProcBeamlets;
+	header->nbits = meta->outputBitMode;
+
+	header->tsamp = clock160MHzSample * (1 - meta->clockBit) + clock200MHzSample * meta->clockBit;
+	if (meta->processingMode > 100) {
+		header->tsamp *= 1 << (meta->processingMode % 10);
+	}
+
+	// Only the Stokes modes produce a single, channel-major stream per output
+	if (meta->processingMode < 99 || meta->processingMode > 199) {
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Modify a header from a string of mockHeader-style arguments, e.g.
+ *             "-fch1 150 -fo -0.19 -tel 1916 -source Sun"
+ *
+ * @param      header  The sigproc_hdr
+ * @param[in]  args    The arguments
+ *
+ * @return     0: Success, 1: Unknown or malformed argument
+ */
+int lofar_udp_sigproc_parse_args(sigproc_hdr *header, const char *args) {
+	char workingArgs[2048], *flag, *value, *endPtr, *savePtr = NULL;
+	int idx;
+
+	if (strlen(args) >= 2048) {
+		fprintf(stderr, "ERROR: SIGPROC header arguments are too long (%ld characters), exiting.\n", (long) strlen(args));
+		return 1;
+	}
+	strcpy(workingArgs, args);
+
+	flag = strtok_r(workingArgs, " \t\n", &savePtr);
+	while (flag != NULL) {
+		for (idx = 0; idx < sigprocArgsCount; idx++) {
+			if (strcmp(flag, sigprocArgs[idx].flag) == 0) break;
+		}
+
+		if (idx == sigprocArgsCount) {
+			fprintf(stderr, "ERROR: Unknown SIGPROC header argument '%s', exiting.\n", flag);
+			return 1;
+		}
+
+		value = strtok_r(NULL, " \t\n", &savePtr);
+		if (value == NULL) {
+			fprintf(stderr, "ERROR: SIGPROC header argument '%s' requires a value, exiting.\n", flag);
+			return 1;
+		}
+
+		switch (sigprocArgs[idx].type) {
+			case SIGPROC_STR:
+				if (strlen(value) > SIGPROC_MAX_STR_LENGTH) {
+					fprintf(stderr, "ERROR: Value for SIGPROC header argument '%s' is too long (%s), exiting.\n", flag, value);
+					return 1;
+				}
+				strcpy(((char*) header) + sigprocArgs[idx].offset, value);
+				break;
+
+			case SIGPROC_INT:
+				*((int*) (((char*) header) + sigprocArgs[idx].offset)) = (int) strtol(value, &endPtr, 10);
+				if (*endPtr != '\0') {
+					fprintf(stderr, "ERROR: Value for SIGPROC header argument '%s' is not an integer (%s), exiting.\n", flag, value);
+					return 1;
+				}
+				break;
+
+			case SIGPROC_DOUBLE:
+				*((double*) (((char*) header) + sigprocArgs[idx].offset)) = strtod(value, &endPtr);
+				if (*endPtr != '\0') {
+					fprintf(stderr, "ERROR: Value for SIGPROC header argument '%s' is not a number (%s), exiting.\n", flag, value);
+					return 1;
+				}
+				break;
+		}
+
+		flag = strtok_r(NULL, " \t\n", &savePtr);
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Append a length-prefixed string to a header buffer
+ *
+ * @param      buffer        The output buffer
+ * @param[in]  offset        The current offset into the buffer
+ * @param[in]  bufferLength  The buffer length
+ * @param[in]  str           The string
+ *
+ * @return     New offset, or -1 if the buffer is too small
+ */
+static long sigproc_write_str(char *buffer, const long offset, const long bufferLength, const char *str) {
+	const int length = strlen(str);
+
+	if (offset < 0 || offset + (long) sizeof(int) + length > bufferLength) return -1;
+
+	memcpy(&(buffer[offset]), &length, sizeof(int));
+	memcpy(&(buffer[offset + sizeof(int)]), str, length);
+
+	return offset + sizeof(int) + length;
+}
+
+
+/**
+ * @brief      Append a keyword and its value to a header buffer
+ *
+ * @param      buffer        The output buffer
+ * @param[in]  offset        The current offset into the buffer
+ * @param[in]  bufferLength  The buffer length
+ * @param[in]  key           The keyword
+ * @param[in]  value         The value
+ * @param[in]  valueLength   The value length
+ *
+ * @return     New offset, or -1 if the buffer is too small
+ */
+static long sigproc_write_key(char *buffer, long offset, const long bufferLength, const char *key, const void *value, const long valueLength) {
+	offset = sigproc_write_str(buffer, offset, bufferLength, key);
+
+	if (offset < 0 || offset + valueLength > bufferLength) return -1;
+	memcpy(&(buffer[offset]), value, valueLength);
+
+	return offset + valueLength;
+}
+
+
+/**
+ * @brief      Render a SIGPROC header into a memory buffer
+ *
+ * @param[in]  header        The sigproc_hdr
+ * @param      buffer        The output buffer
+ * @param[in]  bufferLength  The output buffer length
+ *
+ * @return     The header length, or -1 if the buffer is too small
+ */
+long lofar_udp_sigproc_write_header(const sigproc_hdr *header, char *buffer, const long bufferLength) {
+	long offset = sigproc_write_str(buffer, 0, bufferLength, "HEADER_START");
+
+	// Strings are written as a second length-prefixed string
+	if (strlen(header->source_name)) {
+		offset = sigproc_write_str(buffer, offset, bufferLength, "source_name");
+		offset = sigproc_write_str(buffer, offset, bufferLength, header->source_name);
+	}
+	if (strlen(header->rawdatafile)) {
+		offset = sigproc_write_str(buffer, offset, bufferLength, "rawdatafile");
+		offset = sigproc_write_str(buffer, offset, bufferLength, header->rawdatafile);
+	}
+
+	#define SIGPROC_INT_KEY(key) if (header->key >= 0) offset = sigproc_write_key(buffer, offset, bufferLength, #key, &(header->key), sizeof(int));
+	#define SIGPROC_DOUBLE_KEY(key) if (header->key != SIGPROC_UNSET_DOUBLE) offset = sigproc_write_key(buffer, offset, bufferLength, #key, &(header->key), sizeof(double));
+
+	SIGPROC_INT_KEY(telescope_id);
+	SIGPROC_INT_KEY(machine_id);
+	SIGPROC_INT_KEY(data_type);
+	SIGPROC_DOUBLE_KEY(fch1);
+	SIGPROC_DOUBLE_KEY(foff);
+	SIGPROC_INT_KEY(nchans);
+	SIGPROC_INT_KEY(nbits);
+	SIGPROC_INT_KEY(nifs);
+	SIGPROC_INT_KEY(nbeams);
+	SIGPROC_INT_KEY(ibeam);
+	SIGPROC_DOUBLE_KEY(tstart);
+	SIGPROC_DOUBLE_KEY(tsamp);
+	SIGPROC_DOUBLE_KEY(src_raj);
+	SIGPROC_DOUBLE_KEY(src_dej);
+	SIGPROC_DOUBLE_KEY(az_start);
+	SIGPROC_DOUBLE_KEY(za_start);
+	SIGPROC_DOUBLE_KEY(refdm);
+	SIGPROC_DOUBLE_KEY(period);
+	SIGPROC_INT_KEY(barycentric);
+	SIGPROC_INT_KEY(pulsarcentric);
+
+	#undef SIGPROC_INT_KEY
+	#undef SIGPROC_DOUBLE_KEY
+
+	offset = sigproc_write_str(buffer, offset, bufferLength, "HEADER_END");
+
+	if (offset < 0) {
+		fprintf(stderr, "ERROR: SIGPROC header does not fit in a %ld byte buffer.\n", bufferLength);
+	}
+
+	return offset;
+}
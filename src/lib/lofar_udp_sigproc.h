@@ -0,0 +1,79 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+
+#ifndef __LOFAR_UDP_SIGPROC_STRUCTS
+#define __LOFAR_UDP_SIGPROC_STRUCTS
+
+// Upper limit on the size of a rendered header
+#define SIGPROC_MAX_HDR_LENGTH 4096
+
+// Upper limit on the length of string attributes
+#define SIGPROC_MAX_STR_LENGTH 80
+
+// Sentinel for unset floating point attributes (NaN checks are removed by -Ofast)
+#define SIGPROC_UNSET_DOUBLE -1e300
+
+// SIGPROC filterbank header
+//
+// Integer attributes are only written if they are >= 0, floating point
+// attributes if they are not SIGPROC_UNSET_DOUBLE, and strings if they are
+// not empty.
+typedef struct sigproc_hdr {
+	// String attributes
+	char source_name[SIGPROC_MAX_STR_LENGTH + 1];
+	char rawdatafile[SIGPROC_MAX_STR_LENGTH + 1];
+
+	// Integer attributes
+	int telescope_id;
+	int machine_id;
+	int data_type;
+	int nchans;
+	int nbits;
+	int nifs;
+	int nbeams;
+	int ibeam;
+	int barycentric;
+	int pulsarcentric;
+
+	// Floating point attributes
+	double tstart;
+	double tsamp;
+	double fch1;
+	double foff;
+	double src_raj;
+	double src_dej;
+	double az_start;
+	double za_start;
+	double refdm;
+	double period;
+
+} sigproc_hdr;
+extern const sigproc_hdr sigproc_hdr_default;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_SIGPROC_H
+#define __LOFAR_UDP_SIGPROC_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_sigproc_setup(sigproc_hdr *header, const lofar_udp_meta *meta);
+int lofar_udp_sigproc_parse_args(sigproc_hdr *header, const char *args);
+long lofar_udp_sigproc_write_header(const sigproc_hdr *header, char *buffer, const long bufferLength);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
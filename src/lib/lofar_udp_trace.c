@@ -0,0 +1,120 @@
+#include "lofar_udp_trace.h"
+
+#ifdef ALLOW_TRACE
+
+// Rings registered by each thread that has recorded an event, never free'd
+static lofar_udp_trace_ring *traceRings[TRACE_MAX_THREADS];
+static int traceRingCount = 0;
+
+// Each thread's ring, allocated on its first event, and whether the thread could not be given one
+static __thread lofar_udp_trace_ring *localRing = NULL;
+static __thread int localRingFull = 0;
+
+
+/**
+ * @brief      Allocate and register the calling thread's trace ring
+ *
+ * @return     lofar_udp_trace_ring ptr, or NULL if the thread cannot be traced
+ */
+static lofar_udp_trace_ring* lofar_udp_trace_register() {
+	lofar_udp_trace_ring *ring;
+	int index;
+
+	if (localRingFull) return NULL;
+
+	index = __atomic_fetch_add(&traceRingCount, 1, __ATOMIC_ACQ_REL);
+	if (index >= TRACE_MAX_THREADS) {
+		fprintf(stderr, "WARNING: More than %d threads have recorded trace events, thread %ld will not be traced.\n", TRACE_MAX_THREADS, (long) syscall(SYS_gettid));
+		localRingFull = 1;
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(lofar_udp_trace_ring));
+	if (ring == NULL) {
+		fprintf(stderr, "WARNING: Unable to allocate memory for a trace ring, thread %ld will not be traced.\n", (long) syscall(SYS_gettid));
+		localRingFull = 1;
+		return NULL;
+	}
+	ring->tid = (int) syscall(SYS_gettid);
+
+	__atomic_store_n(&(traceRings[index]), ring, __ATOMIC_RELEASE);
+	localRing = ring;
+	return ring;
+}
+
+
+/**
+ * @brief      Record a begin or end event on the calling thread's ring
+ *
+ * @param[in]  name   The event name (must be a string literal, it is not copied)
+ * @param[in]  phase  'B' for a begin event, 'E' for an end event
+ * @param[in]  arg    Port / output / stage index attached to the event, or -1
+ */
+void lofar_udp_trace_record(const char *name, const char phase, const int arg) {
+	lofar_udp_trace_ring *ring = localRing;
+	struct timespec now;
+
+	if (ring == NULL && (ring = lofar_udp_trace_register()) == NULL) return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	lofar_udp_trace_event *event = &(ring->events[ring->head % TRACE_RING_EVENTS]);
+	event->name = name;
+	event->timestamp = now.tv_sec * 1000000000L + now.tv_nsec;
+	event->arg = arg;
+	event->phase = phase;
+
+	// Publish the event to the dump
+	__atomic_store_n(&(ring->head), ring->head + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief      Write every thread's recorded events to a Chrome trace JSON file
+ *             (viewable in chrome://tracing or ui.perfetto.dev). Call this
+ *             while the traced threads are idle, events recorded during the
+ *             dump may be partially overwritten.
+ *
+ * @param[in]  path  The output file path
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_trace_dump(const char *path) {
+	const int pid = (int) getpid();
+	int numRings = __atomic_load_n(&traceRingCount, __ATOMIC_ACQUIRE), first = 1;
+	FILE *output;
+
+	if (numRings > TRACE_MAX_THREADS) numRings = TRACE_MAX_THREADS;
+
+	if ((output = fopen(path, "w")) == NULL) {
+		fprintf(stderr, "ERROR: Unable to open trace output at %s, exiting.\n", path);
+		return 1;
+	}
+
+	fprintf(output, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for (int index = 0; index < numRings; index++) {
+		const lofar_udp_trace_ring *ring = __atomic_load_n(&(traceRings[index]), __ATOMIC_ACQUIRE);
+		if (ring == NULL) continue;
+
+		const long head = __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE);
+		const long start = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+
+		fprintf(output, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"thread %d (%ld events lost)\"}}", first ? "" : ",\n", pid, ring->tid, index, start);
+		first = 0;
+
+		for (long idx = start; idx < head; idx++) {
+			const lofar_udp_trace_event *event = &(ring->events[idx % TRACE_RING_EVENTS]);
+			fprintf(output, ",\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3lf, \"pid\": %d, \"tid\": %d, \"args\": {\"id\": %d}}", event->name, event->phase, (double) event->timestamp / 1e3, pid, ring->tid, event->arg);
+		}
+	}
+	fprintf(output, "\n]}\n");
+
+	if (fclose(output) != 0) {
+		fprintf(stderr, "ERROR: Failed to close trace output at %s, exiting.\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+#endif
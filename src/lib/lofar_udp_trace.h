@@ -0,0 +1,77 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifndef __LOFAR_UDP_TRACE_STRUCTS
+#define __LOFAR_UDP_TRACE_STRUCTS
+
+// Number of events each thread's ring holds before it wraps and overwrites its oldest events
+#define TRACE_RING_EVENTS (1 << 16)
+
+// Maximum number of threads that can record events, threads beyond this are not traced
+#define TRACE_MAX_THREADS 256
+
+// The raw loop spawns a task per packet, only one task in every TRACE_TASK_STRIDE is traced
+#define TRACE_TASK_STRIDE 1024
+
+// A single begin ('B') or end ('E') event, name must be a string literal
+typedef struct lofar_udp_trace_event {
+	const char *name;
+	long timestamp;
+	int arg;
+	char phase;
+} lofar_udp_trace_event;
+
+// Per-thread event ring
+//
+// Only the owning thread writes to the ring; it fills events[head % TRACE_RING_EVENTS]
+// and then increments head, so no locks are needed to record an event.
+typedef struct lofar_udp_trace_ring {
+	int tid;
+	long head;
+	lofar_udp_trace_event events[TRACE_RING_EVENTS];
+} lofar_udp_trace_ring;
+#endif
+
+
+
+// Tracing macros (enable from makefile, -DALLOW_TRACE), compile to nothing otherwise
+#ifndef __LOFAR_UDP_TRACE_MACRO
+#define __LOFAR_UDP_TRACE_MACRO
+
+#ifdef ALLOW_TRACE
+#define TRACE(MSG) MSG;
+#define TRACE_BEGIN(NAME, ARG) lofar_udp_trace_record(NAME, 'B', ARG);
+#define TRACE_END(NAME, ARG) lofar_udp_trace_record(NAME, 'E', ARG);
+#else
+#define TRACE(MSG) while(0) {};
+#define TRACE_BEGIN(NAME, ARG) while(0) {};
+#define TRACE_END(NAME, ARG) while(0) {};
+#endif
+
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_TRACE_H
+#define __LOFAR_UDP_TRACE_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ALLOW_TRACE
+void lofar_udp_trace_record(const char *name, const char phase, const int arg);
+int lofar_udp_trace_dump(const char *path);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,517 @@
+#include "lofar_udp_tuning.h"
+
+// Default autotuner configuration, candidate lists are generated at run time
+lofar_udp_tuning_config lofar_udp_tuning_config_default = {
+	.numPacketCandidates = 0,
+	.packetCandidates = { 0 },
+	.numThreadCandidates = 0,
+	.threadCandidates = { 0 },
+	.numReadThreadCandidates = 0,
+	.readThreadCandidates = { 0 },
+	.trialGulps = 4,
+	.verbose = 0
+};
+
+
+/**
+ * @brief      Run the reader over a few gulps of the real input with a
+ *             candidate configuration, then rewind the inputs
+ *
+ * @param[in]  config       The reader configuration being tuned
+ * @param[in]  positions    The position of each input file to rewind to
+ * @param[in]  packets      The candidate packets per iteration
+ * @param[in]  threads      The candidate number of kernel threads
+ * @param[in]  readThreads  The candidate number of read threads
+ * @param[in]  gulps        The number of gulps to time
+ * @param[out] rate         Input packets processed per second
+ *
+ * @return     0: Success, -1: Not enough input data for (gulps + 1) full
+ *             gulps, 1: Fatal error
+ */
+static int lofar_udp_tuning_trial(const lofar_udp_config *config, const long positions[], const long packets, const int threads, const int readThreads, const int gulps, double *rate) {
+	lofar_udp_config trial = *config;
+	lofar_udp_reader *reader;
+	struct timespec tick, tock;
+	int returnVal = 0;
+
+	// Processing without calibration (which would spawn dreamBeam for every trial) or any optional instrumentation
+	trial.packetsPerIteration = packets;
+	trial.packetsReadMax = packets * (gulps + 1);
+	trial.ompThreads = threads;
+	trial.readThreads = readThreads;
+	trial.calibrateData = 0;
+	trial.perfCounters = 0;
+	trial.followTimeout = 0;
+	for (int port = 0; port < MAX_NUM_PORTS; port++) trial.inputFileChainLengths[port] = 0;
+	trial.verbose = 0;
+
+	for (int port = 0; port < config->numPorts; port++) {
+		if (fseek(config->inputFiles[port], positions[port], SEEK_SET) != 0) {
+			fprintf(stderr, "ERROR: Unable to rewind input on port %d for tuning (errno %d: %s), exiting.\n", port, errno, strerror(errno));
+			return 1;
+		}
+	}
+
+	if ((reader = lofar_udp_meta_file_reader_setup_struct(&trial)) == NULL) {
+		fprintf(stderr, "ERROR: Unable to set up a reader for a tuning trial (%ld packets, %d threads), exiting.\n", packets, threads);
+		return 1;
+	}
+
+	// The first gulp was read during setup, process it untimed so each timed step performs a full read and process
+	if (lofar_udp_reader_step(reader) > 0) {
+		lofar_udp_reader_cleanup_f(reader, 0);
+		return 1;
+	}
+
+	// The reader shortens the gulp when it reaches the end of the input, a short gulp would time less work than the
+	// 	candidate asks for, so the candidate cannot be timed on this input
+	if (reader->meta->packetsPerIteration < packets) returnVal = -1;
+	CLICK(tick);
+	for (int gulp = 0; gulp < gulps && returnVal == 0; gulp++) {
+		if (lofar_udp_reader_step(reader) > 0) returnVal = 1;
+		else if (reader->meta->packetsPerIteration < packets) returnVal = -1;
+	}
+	CLICK(tock);
+
+	lofar_udp_reader_cleanup_f(reader, 0);
+
+	if (returnVal == 0) *rate = (double) packets * gulps * config->numPorts / (TICKTOCK(tick, tock));
+	return returnVal;
+}
+
+
+/**
+ * @brief      Fill a list of candidates with powers of 2 up to (and including)
+ *             a maximum
+ *
+ * @param[out] candidates  The candidates
+ * @param[in]  maximum     The maximum value
+ *
+ * @return     The number of candidates
+ */
+static int lofar_udp_tuning_powers(int candidates[TUNING_MAX_CANDIDATES], const int maximum) {
+	int count = 0;
+
+	for (int value = 1; value < maximum && count < TUNING_MAX_CANDIDATES - 1; value *= 2) candidates[count++] = value;
+	candidates[count++] = maximum;
+
+	return count;
+}
+
+
+/**
+ * @brief      Print the result of a tuning trial, if requested
+ *
+ * @param[in]  tuning       The autotuner configuration
+ * @param[in]  packets      The trial's packets per iteration
+ * @param[in]  threads      The trial's number of kernel threads
+ * @param[in]  readThreads  The trial's number of read threads
+ * @param[in]  returnVal    The trial's return value
+ * @param[in]  rate         The trial's input packets processed per second
+ */
+static void lofar_udp_tuning_report(const lofar_udp_tuning_config *tuning, const long packets, const int threads, const int readThreads, const int returnVal, const double rate) {
+	if (!tuning->verbose) return;
+
+	if (returnVal < 0) printf("Tuning:\t%ld packets, %d threads, %d read threads:\tnot enough input data, skipped\n", packets, threads, readThreads);
+	else printf("Tuning:\t%ld packets, %d threads, %d read threads:\t%.0lf packets/s\n", packets, threads, readThreads, rate);
+}
+
+
+/**
+ * @brief      Find the fastest gulp size, kernel thread count and read thread
+ *             count for a reader configuration by timing short trials on its
+ *             inputs. Parameters are tuned one at a time (gulp size, then
+ *             kernel threads, then read threads), holding the others at their
+ *             best value so far. Candidates that need more input than is
+ *             available are skipped. The input files are returned to their
+ *             current position, so they must be seekable.
+ *
+ * @param[in]  config  The reader configuration, with the input files opened
+ * @param[in]  tuning  The autotuner configuration
+ * @param[out] result  The fastest configuration
+ *
+ * @return     0: Success, -1: The input is too short to time any candidate
+ *             (result holds the given configuration), 1: Fatal error
+ */
+int lofar_udp_tuning_run(const lofar_udp_config *config, const lofar_udp_tuning_config *tuning, lofar_udp_tuning_result *result) {
+	lofar_udp_tuning_config candidates = *tuning;
+	long positions[MAX_NUM_PORTS];
+	double rate;
+	int returnVal;
+
+	if (config->inputFiles == NULL || config->numPorts < 1 || config->numPorts > MAX_NUM_PORTS || tuning->trialGulps < 1) {
+		fprintf(stderr, "ERROR: Invalid reader or tuning configuration provided to the autotuner, exiting.\n");
+		return 1;
+	}
+
+	for (int port = 0; port < config->numPorts; port++) {
+		if ((positions[port] = ftell(config->inputFiles[port])) < 0) {
+			fprintf(stderr, "ERROR: Input on port %d is not seekable, it cannot be autotuned (errno %d: %s), exiting.\n", port, errno, strerror(errno));
+			return 1;
+		}
+	}
+
+	// Generate any candidate lists that were not provided
+	if (candidates.numPacketCandidates < 1) {
+		for (long packets = 4096; packets <= 65536; packets *= 2) candidates.packetCandidates[candidates.numPacketCandidates++] = packets;
+	}
+	if (candidates.numThreadCandidates < 1) {
+		candidates.numThreadCandidates = lofar_udp_tuning_powers(candidates.threadCandidates, OMP_THREADS);
+	}
+	if (candidates.numReadThreadCandidates < 1) {
+		candidates.numReadThreadCandidates = lofar_udp_tuning_powers(candidates.readThreadCandidates, config->numPorts);
+	}
+
+	for (int idx = 0; idx < candidates.numThreadCandidates; idx++) {
+		// The 4-bit kernels allocate a workspace per thread, up to the compile time limit
+		if (candidates.threadCandidates[idx] < 1 || candidates.threadCandidates[idx] > OMP_THREADS) {
+			fprintf(stderr, "ERROR: Thread counts must be between 1 and %d (%d requested), exiting.\n", OMP_THREADS, candidates.threadCandidates[idx]);
+			return 1;
+		}
+	}
+
+	// Start from the given configuration
+	result->packetsPerIteration = config->packetsPerIteration;
+	result->ompThreads = config->ompThreads;
+	result->readThreads = config->readThreads > 0 ? config->readThreads : config->ompThreads;
+	result->packetsPerSecond = -1.0;
+
+	// Warm the page cache so the first candidate is not penalised for a cold read
+	if (lofar_udp_tuning_trial(config, positions, candidates.packetCandidates[0], result->ompThreads, result->readThreads, tuning->trialGulps, &rate) > 0) {
+		return 1;
+	}
+
+	// Gulp size
+	for (int idx = 0; idx < candidates.numPacketCandidates; idx++) {
+		if (candidates.packetCandidates[idx] < 1 || (config->packetsReadMax > 0 && candidates.packetCandidates[idx] > config->packetsReadMax)) continue;
+
+		if ((returnVal = lofar_udp_tuning_trial(config, positions, candidates.packetCandidates[idx], result->ompThreads, result->readThreads, tuning->trialGulps, &rate)) > 0) return 1;
+		lofar_udp_tuning_report(tuning, candidates.packetCandidates[idx], result->ompThreads, result->readThreads, returnVal, rate);
+		if (returnVal < 0) continue;
+		if (rate > result->packetsPerSecond) {
+			result->packetsPerSecond = rate;
+			result->packetsPerIteration = candidates.packetCandidates[idx];
+		}
+	}
+
+	// Kernel threads, skipping the count already timed while tuning the gulp size
+	const int measuredThreads = result->ompThreads;
+	for (int idx = 0; idx < candidates.numThreadCandidates; idx++) {
+		if (candidates.threadCandidates[idx] == measuredThreads) continue;
+
+		if ((returnVal = lofar_udp_tuning_trial(config, positions, result->packetsPerIteration, candidates.threadCandidates[idx], result->readThreads, tuning->trialGulps, &rate)) > 0) return 1;
+		lofar_udp_tuning_report(tuning, result->packetsPerIteration, candidates.threadCandidates[idx], result->readThreads, returnVal, rate);
+		if (returnVal < 0) continue;
+		if (rate > result->packetsPerSecond) {
+			result->packetsPerSecond = rate;
+			result->ompThreads = candidates.threadCandidates[idx];
+		}
+	}
+
+	// Read threads
+	const int measuredReadThreads = result->readThreads;
+	for (int idx = 0; idx < candidates.numReadThreadCandidates; idx++) {
+		if (candidates.readThreadCandidates[idx] < 1 || candidates.readThreadCandidates[idx] == measuredReadThreads) continue;
+
+		if ((returnVal = lofar_udp_tuning_trial(config, positions, result->packetsPerIteration, result->ompThreads, candidates.readThreadCandidates[idx], tuning->trialGulps, &rate)) > 0) return 1;
+		lofar_udp_tuning_report(tuning, result->packetsPerIteration, result->ompThreads, candidates.readThreadCandidates[idx], returnVal, rate);
+		if (returnVal < 0) continue;
+		if (rate > result->packetsPerSecond) {
+			result->packetsPerSecond = rate;
+			result->readThreads = candidates.readThreadCandidates[idx];
+		}
+	}
+
+	// Leave the inputs where we found them
+	for (int port = 0; port < config->numPorts; port++) {
+		if (fseek(config->inputFiles[port], positions[port], SEEK_SET) != 0) {
+			fprintf(stderr, "ERROR: Unable to rewind input on port %d after tuning (errno %d: %s), exiting.\n", port, errno, strerror(errno));
+			return 1;
+		}
+	}
+
+	// No candidate could be timed, leave the configuration as it was given
+	if (result->packetsPerSecond < 0) return -1;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Apply a tuning result to a reader configuration
+ *
+ * @param      config  The reader configuration
+ * @param[in]  result  The tuning result
+ */
+void lofar_udp_tuning_apply(lofar_udp_config *config, const lofar_udp_tuning_result *result) {
+	config->packetsPerIteration = result->packetsPerIteration;
+	config->ompThreads = result->ompThreads;
+	config->readThreads = result->readThreads;
+}
+
+
+/**
+ * @brief      Build the key a configuration is stored under in a tuning cache
+ *
+ * @param[in]  config  The reader configuration
+ * @param[out] key     The key buffer
+ * @param[in]  length  The key buffer length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_tuning_key(const lofar_udp_config *config, char *key, const int length) {
+	char host[256] = "";
+
+	if (gethostname(host, sizeof(host) - 1) != 0) {
+		fprintf(stderr, "ERROR: Unable to determine the host name for the tuning cache (errno %d: %s), exiting.\n", errno, strerror(errno));
+		return 1;
+	}
+
+	snprintf(key, length, "%s\t%d\t%d\t%d\t", host, config->processingMode, config->numPorts, config->readerType);
+	return 0;
+}
+
+
+/**
+ * @brief      Load a stored tuning result for this host, processing mode,
+ *             number of ports and input type
+ *
+ * @param[in]  path    The tuning cache file
+ * @param[in]  config  The reader configuration
+ * @param[out] result  The stored tuning result
+ *
+ * @return     0: Success, -1: No result stored, 1: Fatal error
+ */
+int lofar_udp_tuning_load(const char *path, const lofar_udp_config *config, lofar_udp_tuning_result *result) {
+	char key[TUNING_MAX_LINE], line[TUNING_MAX_LINE];
+	FILE *cache;
+	int returnVal = -1;
+
+	if (lofar_udp_tuning_key(config, key, TUNING_MAX_LINE)) return 1;
+
+	if ((cache = fopen(path, "r")) == NULL) {
+		return errno == ENOENT ? -1 : 1;
+	}
+
+	while (fgets(line, TUNING_MAX_LINE, cache) != NULL) {
+		if (strncmp(line, key, strlen(key)) != 0) continue;
+
+		if (sscanf(line + strlen(key), "%ld\t%d\t%d\t%lf", &(result->packetsPerIteration), &(result->ompThreads), &(result->readThreads), &(result->packetsPerSecond)) != 4) {
+			fprintf(stderr, "ERROR: Malformed entry in tuning cache %s, exiting.\n", path);
+			returnVal = 1;
+			break;
+		}
+		returnVal = 0;
+	}
+
+	fclose(cache);
+	return returnVal;
+}
+
+
+/**
+ * @brief      Store a tuning result for this host, processing mode, number of
+ *             ports and input type, replacing any previous result
+ *
+ * @param[in]  path    The tuning cache file
+ * @param[in]  config  The reader configuration
+ * @param[in]  result  The tuning result
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_tuning_save(const char *path, const lofar_udp_config *config, const lofar_udp_tuning_result *result) {
+	char key[TUNING_MAX_LINE], line[TUNING_MAX_LINE], *contents = NULL;
+	size_t contentsLength = 0;
+	FILE *cache, *previous;
+
+	if (lofar_udp_tuning_key(config, key, TUNING_MAX_LINE)) return 1;
+
+	// Keep every other entry from the existing cache
+	if ((cache = open_memstream(&contents, &contentsLength)) == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for the tuning cache, exiting.\n");
+		return 1;
+	}
+	if ((previous = fopen(path, "r")) != NULL) {
+		while (fgets(line, TUNING_MAX_LINE, previous) != NULL) {
+			if (line[0] != '#' && strncmp(line, key, strlen(key)) != 0) fputs(line, cache);
+		}
+		fclose(previous);
+	}
+	fclose(cache);
+
+	if ((cache = fopen(path, "w")) == NULL) {
+		fprintf(stderr, "ERROR: Unable to open tuning cache at %s (errno %d: %s), exiting.\n", path, errno, strerror(errno));
+		free(contents);
+		return 1;
+	}
+
+	fprintf(cache, "# host\tmode\tports\treaderType\tpacketsPerIteration\tompThreads\treadThreads\tpackets/s\n");
+	fwrite(contents, sizeof(char), contentsLength, cache);
+	fprintf(cache, "%s%ld\t%d\t%d\t%.0lf\n", key, result->packetsPerIteration, result->ompThreads, result->readThreads, result->packetsPerSecond);
+	free(contents);
+
+	if (fclose(cache) != 0) {
+		fprintf(stderr, "ERROR: Failed to write tuning cache at %s, exiting.\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Estimate the memory that can be allocated without swapping: the
+ *             kernel's MemAvailable, limited by the remaining cgroup (v2)
+ *             memory allowance if one is set
+ *
+ * @return     Available bytes, or <0 on error
+ */
+long lofar_udp_tuning_available_memory() {
+	char line[TUNING_MAX_LINE];
+	long available = -1, limit, current;
+	FILE *input;
+
+	if ((input = fopen("/proc/meminfo", "r")) != NULL) {
+		while (fgets(line, TUNING_MAX_LINE, input) != NULL) {
+			if (sscanf(line, "MemAvailable: %ld kB", &available) == 1) {
+				available *= 1024;
+				break;
+			}
+		}
+		fclose(input);
+	}
+
+	// Fall back to the free pages on older kernels
+	if (available < 0) {
+		available = sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+	}
+
+	// Batch systems often limit jobs to a fraction of the node, "max" is unlimited and will not be parsed
+	if ((input = fopen("/sys/fs/cgroup/memory.max", "r")) != NULL) {
+		if (fscanf(input, "%ld", &limit) == 1) {
+			fclose(input);
+			if ((input = fopen("/sys/fs/cgroup/memory.current", "r")) != NULL) {
+				if (fscanf(input, "%ld", &current) == 1 && limit - current < available) {
+					available = limit - current > 0 ? limit - current : 0;
+				}
+			}
+		}
+		if (input != NULL) fclose(input);
+	}
+
+	return available;
+}
+
+
+/**
+ * @brief      Calculate the bytes the reader (and optionally an attached
+ *             writer) allocate for their data buffers
+ *
+ * @param[in]  meta                 A lofar_udp_meta with the packet and output
+ *                                  lengths set up
+ * @param[in]  readerType           The input reader_t
+ * @param[in]  writerConfig         The writer configuration, or NULL if no
+ *                                  writer will be attached
+ * @param[in]  packetsPerIteration  The gulp size
+ *
+ * @return     The footprint in bytes
+ */
+long lofar_udp_tuning_footprint(const lofar_udp_meta *meta, const int readerType, const lofar_udp_writer_config *writerConfig, const long packetsPerIteration) {
+	long bytes = 0;
+
+	// Input buffers, as allocated by lofar_udp_meta_file_reader_setup_struct
+	for (int port = 0; port < meta->numPorts; port++) {
+		bytes += meta->portPacketLength[port] * (packetsPerIteration + 2);
+		if (readerType == ZSTDCOMPRESSED) bytes += (meta->portPacketLength[port] * packetsPerIteration) % ZSTD_DStreamOutSize();
+	}
+
+	// Output buffers, and the writer's second set
+	for (int out = 0; out < meta->numOutputs; out++) {
+		bytes += (meta->packetOutputLength[out] * packetsPerIteration + lofar_udp_time_major_overlap_length(meta, out)) * (1 + (writerConfig != NULL));
+	}
+
+	// The writer's compression staging buffer (libzstd's own compression state is not included)
+	if (writerConfig != NULL && writerConfig->compressionLevel) {
+		bytes += ZSTD_CStreamOutSize() * WRITER_ZSTD_STAGING_BLOCKS;
+	}
+
+	return bytes;
+}
+
+
+/**
+ * @brief      Plan the largest gulp that fits within a memory budget. The
+ *             first header on each port is parsed (and the inputs rewound) to
+ *             determine the packet and output sizes of the processing mode,
+ *             then the gulp is rounded down to a multiple of
+ *             TUNING_PACKET_ALIGNMENT packets and capped at the configured
+ *             packetsPerIteration. Beamlet limits are not applied, so the
+ *             footprint is an upper bound when they are set.
+ *
+ * @param[in]  config        The reader configuration, with the input files
+ *                           opened (streamed inputs are not supported)
+ * @param[in]  writerConfig  The writer configuration, or NULL if no writer
+ *                           will be attached
+ * @param[in]  budget        The memory budget in bytes
+ * @param[out] plan          The memory plan
+ *
+ * @return     0: Success, -1: Even the smallest gulp exceeds the budget
+ *             (planned for 2 packets), 1: Fatal error
+ */
+int lofar_udp_tuning_plan_memory(const lofar_udp_config *config, const lofar_udp_writer_config *writerConfig, const long budget, lofar_udp_memory_plan *plan) {
+	char inputHeaders[MAX_NUM_PORTS][UDPHDROFFMAX + UDPHDRLEN];
+	const int beamletLimits[2] = { 0, 0 };
+	lofar_udp_meta meta = lofar_udp_meta_default;
+	long packets;
+	int readlen = 0;
+
+	if (config->inputFiles == NULL || config->numPorts < 1 || config->numPorts > MAX_NUM_PORTS || config->packetsPerIteration < 2 || config->headerOffset < 0 || config->headerOffset > UDPHDROFFMAX) {
+		fprintf(stderr, "ERROR: Invalid reader configuration provided to the memory planner, exiting.\n");
+		return 1;
+	}
+	meta.headerOffset = config->headerOffset;
+
+	// Scan in the first header on each port, in the same way as the reader
+	for (int port = 0; port < config->numPorts; port++) {
+		if (lofar_udp_input_streamed(config->inputFiles[port])) {
+			fprintf(stderr, "ERROR: The memory planner cannot rewind the streamed input on port %d, exiting.\n", port);
+			return 1;
+		}
+
+		if (config->readerType == ZSTDCOMPRESSED)  {
+			readlen = fread_temp_ZSTD(&(inputHeaders[port][0]), sizeof(char), meta.headerOffset + UDPHDRLEN, config->inputFiles[port], 1);
+		} else if (config->readerType == NORMAL) {
+			readlen = fread(&(inputHeaders[port]), sizeof(char), meta.headerOffset + UDPHDRLEN, config->inputFiles[port]);
+			fseek(config->inputFiles[port], -readlen, SEEK_CUR);
+		} else if (config->readerType == PCAP) {
+			readlen = lofar_udp_pcap_peek(config->inputFiles[port], config->pcapPorts[port], meta.headerOffset, &(inputHeaders[port][0]), meta.headerOffset + UDPHDRLEN);
+		}
+
+		if (readlen < meta.headerOffset + UDPHDRLEN) {
+			fprintf(stderr, "ERROR: Unable to read header on port %d to plan memory usage, exiting.\n", port);
+			return 1;
+		}
+	}
+
+	meta.numPorts = config->numPorts;
+	meta.processingMode = config->processingMode;
+	meta.calibrateData = config->calibrateData;
+	meta.timeMajorOverlap = config->timeMajorOverlap;
+	if (lofar_udp_parse_headers_ext(&meta, inputHeaders, beamletLimits) > 0 || lofar_udp_setup_processing(&meta) > 0) {
+		fprintf(stderr, "ERROR: Unable to determine packet sizes to plan memory usage, exiting.\n");
+		return 1;
+	}
+
+	// The footprint is linear in the gulp size, aside from the zstd padding (under one block per port)
+	plan->fixedBytes = lofar_udp_tuning_footprint(&meta, NORMAL, writerConfig, 0) + (config->readerType == ZSTDCOMPRESSED) * meta.numPorts * (long) ZSTD_DStreamOutSize();
+	plan->bytesPerPacket = lofar_udp_tuning_footprint(&meta, NORMAL, writerConfig, 1) - lofar_udp_tuning_footprint(&meta, NORMAL, writerConfig, 0);
+
+	packets = (budget - plan->fixedBytes) / plan->bytesPerPacket;
+	if (packets > TUNING_PACKET_ALIGNMENT) packets -= packets % TUNING_PACKET_ALIGNMENT;
+	if (packets > config->packetsPerIteration) packets = config->packetsPerIteration;
+
+	plan->packetsPerIteration = packets < 2 ? 2 : packets;
+	plan->peakBytes = lofar_udp_tuning_footprint(&meta, config->readerType, writerConfig, plan->packetsPerIteration);
+
+	return packets < 2 ? -1 : 0;
+}
@@ -0,0 +1,107 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_writer.h"
+
+#ifndef __LOFAR_UDP_TUNING_STRUCTS
+#define __LOFAR_UDP_TUNING_STRUCTS
+
+// Maximum number of candidates for each tuned parameter
+#define TUNING_MAX_CANDIDATES 16
+
+// Maximum line length in a tuning cache file
+#define TUNING_MAX_LINE 1024
+
+// Planned gulps are rounded down to a multiple of this many packets, so that
+// 	each port's reads remain a whole number of pages
+#define TUNING_PACKET_ALIGNMENT 1024
+
+// Default share of the available memory the CLI plans gulps against
+#define TUNING_MEMORY_FRACTION 0.8
+
+// Autotuner configuration struct
+//
+// Candidate lists with a count of 0 are generated from the reader configuration:
+// 	gulps of 4096 to 65536 packets, kernel threads of 1, 2, 4, ... OMP_THREADS and
+// 	read threads of 1, 2, 4, ... numPorts.
+typedef struct lofar_udp_tuning_config {
+	int numPacketCandidates;
+	long packetCandidates[TUNING_MAX_CANDIDATES];
+
+	int numThreadCandidates;
+	int threadCandidates[TUNING_MAX_CANDIDATES];
+
+	int numReadThreadCandidates;
+	int readThreadCandidates[TUNING_MAX_CANDIDATES];
+
+	// Number of gulps timed in each trial
+	int trialGulps;
+
+	// Print the result of each trial
+	int verbose;
+
+} lofar_udp_tuning_config;
+extern lofar_udp_tuning_config lofar_udp_tuning_config_default;
+
+
+// Autotuner result struct
+typedef struct lofar_udp_tuning_result {
+	long packetsPerIteration;
+	int ompThreads;
+	int readThreads;
+
+	// Input packets (summed over ports) read and processed per second
+	double packetsPerSecond;
+
+} lofar_udp_tuning_result;
+
+
+// Memory plan struct
+//
+// The reader and writer allocate fixedBytes + bytesPerPacket * packetsPerIteration
+// 	(plus under one zstd block per port for compressed inputs).
+typedef struct lofar_udp_memory_plan {
+	// Largest gulp that fits in the budget, capped at the configured packetsPerIteration
+	long packetsPerIteration;
+
+	// Predicted peak footprint of the reader and writer buffers at that gulp size
+	long peakBytes;
+
+	// Footprint model
+	long bytesPerPacket;
+	long fixedBytes;
+
+} lofar_udp_memory_plan;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_TUNING_H
+#define __LOFAR_UDP_TUNING_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_tuning_run(const lofar_udp_config *config, const lofar_udp_tuning_config *tuning, lofar_udp_tuning_result *result);
+void lofar_udp_tuning_apply(lofar_udp_config *config, const lofar_udp_tuning_result *result);
+int lofar_udp_tuning_load(const char *path, const lofar_udp_config *config, lofar_udp_tuning_result *result);
+int lofar_udp_tuning_save(const char *path, const lofar_udp_config *config, const lofar_udp_tuning_result *result);
+
+long lofar_udp_tuning_available_memory();
+long lofar_udp_tuning_footprint(const lofar_udp_meta *meta, const int readerType, const lofar_udp_writer_config *writerConfig, const long packetsPerIteration);
+int lofar_udp_tuning_plan_memory(const lofar_udp_config *config, const lofar_udp_writer_config *writerConfig, const long budget, lofar_udp_memory_plan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,183 @@
+#include "lofar_udp_vdif.h"
+
+
+/**
+ * @brief      Get the number of bits per output component for a VDIF
+ *             processing mode
+ *
+ * @param[in]  processingMode  The processing mode
+ *
+ * @return     2, 4 or 8 bits, -1 if the mode is not a VDIF mode
+ */
+int lofar_udp_vdif_bits(const int processingMode) {
+	switch (processingMode) {
+		case 40:
+			return 2;
+		case 41:
+			return 4;
+		case 42:
+			return 8;
+		default:
+			return -1;
+	}
+}
+
+
+/**
+ * @brief      Get the number of channels in each VDIF frame. VDIF requires a
+ *             power of 2, so the largest port is rounded up and the unused
+ *             channels are padded.
+ *
+ * @param[in]  meta  The lofar_udp_meta
+ *
+ * @return     The number of channels per frame
+ */
+int lofar_udp_vdif_channels(const lofar_udp_meta *meta) {
+	int maxBeamlets = 1, channels = 1;
+
+	for (int port = 0; port < meta->numPorts; port++) {
+		if ((meta->upperBeamlets[port] - meta->baseBeamlets[port]) > maxBeamlets) {
+			maxBeamlets = meta->upperBeamlets[port] - meta->baseBeamlets[port];
+		}
+	}
+
+	while (channels < maxBeamlets) channels <<= 1;
+
+	return channels;
+}
+
+
+/**
+ * @brief      Get the length of a single VDIF frame (header and payload), each
+ *             frame holds one packet's worth of samples for one port and
+ *             polarisation
+ *
+ * @param[in]  meta  The lofar_udp_meta, after vdifChannels has been set
+ *
+ * @return     The frame length in bytes
+ */
+long lofar_udp_vdif_frame_length(const lofar_udp_meta *meta) {
+	return VDIF_HEADER_LENGTH + (long) UDPNTIMESLICE * meta->vdifChannels * 2 * lofar_udp_vdif_bits(meta->processingMode) / 8;
+}
+
+
+/**
+ * @brief      Get an input sample from a packet's payload
+ *
+ * @param[in]  payload  The payload
+ * @param[in]  idx      The sample index (as if 4-bit data were unpacked to
+ *                      chars)
+ * @param[in]  bitMode  The input bit mode
+ *
+ * @return     The sample
+ */
+static inline float vdif_input_sample(const char *payload, const long idx, const int bitMode) {
+	switch (bitMode) {
+		case 4:
+			// Matches bitmodeConversion: high nibble first
+			if (idx % 2) {
+				return (float) ((signed char) (payload[idx / 2] << 4) >> 4);
+			}
+			return (float) ((signed char) payload[idx / 2] >> 4);
+
+		case 16:
+			return (float) ((const signed short*) payload)[idx];
+
+		default:
+			return (float) ((const signed char*) payload)[idx];
+	}
+}
+
+
+/**
+ * @brief      Determine the VDIF reference epoch, station code and per-beamlet,
+ *             per-polarisation quantiser scales from the gulp currently in the
+ *             input buffers. Called before the first gulp is processed; the
+ *             scales are then fixed for the lifetime of the reader.
+ *
+ * @param      meta  The lofar_udp_meta
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_vdif_setup(lofar_udp_meta *meta) {
+	const int bits = lofar_udp_vdif_bits(meta->processingMode);
+	char stationCode[16] = "";
+	struct tm epochTm;
+	time_t packetTime;
+
+	if (bits < 0) {
+		fprintf(stderr, "ERROR: Processing mode %d is not a VDIF mode, exiting.\n", meta->processingMode);
+		return 1;
+	}
+
+	// Reference epochs are 6 month periods since 2000-01-01
+	packetTime = (time_t) lofar_get_packet_time(meta->inputData[0]);
+	gmtime_r(&packetTime, &epochTm);
+	meta->vdifEpoch = 2 * (epochTm.tm_year - 100) + (epochTm.tm_mon >= 6);
+	epochTm.tm_mon = (epochTm.tm_mon >= 6) ? 6 : 0;
+	epochTm.tm_mday = 1;
+	epochTm.tm_hour = 0;
+	epochTm.tm_min = 0;
+	epochTm.tm_sec = 0;
+	meta->vdifEpochStart = (long) timegm(&epochTm);
+
+	// International stations use their 2-character country code, other stations their numeric ID
+	if (lofar_get_station_name(meta->stationID, stationCode) == 0 && strncmp(stationCode, "CS", 2) != 0 && strncmp(stationCode, "RS", 2) != 0 && strlen(stationCode) >= 2) {
+		meta->vdifStationCode = ((unsigned int) stationCode[0] << 8) | (unsigned int) stationCode[1];
+	} else {
+		meta->vdifStationCode = (unsigned int) meta->stationID & 0xFFFF;
+	}
+
+	// Estimate the RMS of each beamlet and polarisation
+	double *sumSq = calloc(meta->totalProcBeamlets * VDIF_THREADS_PER_PORT, sizeof(double));
+	if (meta->vdifScales == NULL) {
+		meta->vdifScales = calloc(meta->totalProcBeamlets * VDIF_THREADS_PER_PORT, sizeof(float));
+	}
+	if (sumSq == NULL || meta->vdifScales == NULL) {
+		fprintf(stderr, "ERROR: Failed to allocate VDIF quantisation workspace, exiting.\n");
+		free(sumSq);
+		return 1;
+	}
+
+	#pragma omp parallel for
+	for (int port = 0; port < meta->numPorts; port++) {
+		for (long packet = 0; packet < meta->packetsPerIteration; packet++) {
+			const char *payload = &(meta->inputData[port][packet * meta->portPacketLength[port] + UDPHDRLEN]);
+
+			for (int beamlet = meta->baseBeamlets[port]; beamlet < meta->upperBeamlets[port]; beamlet++) {
+				double *beamletSumSq = &(sumSq[(beamlet - meta->baseBeamlets[port] + meta->portCumulativeBeamlets[port]) * VDIF_THREADS_PER_PORT]);
+
+				for (int ts = 0; ts < UDPNTIMESLICE; ts++) {
+					const long idx = ((long) beamlet * UDPNTIMESLICE + ts) * UDPNPOL;
+					for (int comp = 0; comp < UDPNPOL; comp++) {
+						const float sample = vdif_input_sample(payload, idx + comp, meta->inputBitMode);
+						beamletSumSq[comp / 2] += sample * sample;
+					}
+				}
+			}
+		}
+	}
+
+	// 2 (complex) components per polarisation contribute to each sum
+	const double samplesPerSum = (double) meta->packetsPerIteration * UDPNTIMESLICE * 2;
+	for (int idx = 0; idx < meta->totalProcBeamlets * VDIF_THREADS_PER_PORT; idx++) {
+		const double sigma = sqrt(sumSq[idx] / samplesPerSum);
+
+		if (sigma <= 0.0) {
+			meta->vdifScales[idx] = 1.0f;
+		} else if (bits == 2) {
+			meta->vdifScales[idx] = (float) (1.0 / (VDIF_2BIT_THRESHOLD * sigma));
+		} else if (meta->inputBitMode <= bits) {
+			// Input already fits, pass it through
+			meta->vdifScales[idx] = 1.0f;
+		} else {
+			meta->vdifScales[idx] = (float) ((1 << bits) / (VDIF_UNIFORM_RANGE * sigma));
+		}
+	}
+
+	free(sumSq);
+
+	VERBOSE(if (meta->VERBOSE) printf("VDIF: epoch %d (%ld), station 0x%04x, %d channels per frame, %d bits\n", meta->vdifEpoch, meta->vdifEpochStart, meta->vdifStationCode, meta->vdifChannels, bits););
+
+	return 0;
+}
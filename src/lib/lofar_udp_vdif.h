@@ -0,0 +1,53 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_misc.h"
+
+#ifndef __LOFAR_UDP_VDIF_CONSTANTS
+#define __LOFAR_UDP_VDIF_CONSTANTS
+
+// Non-legacy VDIF frame header
+#define VDIF_HEADER_LENGTH 32
+#define VDIF_HEADER_WORDS 8
+
+// Each port is split into a VDIF thread per polarisation (X: 0, Y: 1)
+#define VDIF_THREADS_PER_PORT 2
+
+// Optimal 2-bit threshold for Gaussian noise, in units of sigma
+#define VDIF_2BIT_THRESHOLD 0.9816
+
+// Span of the uniform 4/8-bit quantisers, in units of sigma
+#define VDIF_UNIFORM_RANGE 8.0
+
+// Header bit fields
+#define VDIF_INVALID_BIT (1u << 31)
+#define VDIF_COMPLEX_BIT (1u << 31)
+
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_VDIF_H
+#define __LOFAR_UDP_VDIF_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lofar_udp_vdif_bits(const int processingMode);
+int lofar_udp_vdif_channels(const lofar_udp_meta *meta);
+long lofar_udp_vdif_frame_length(const lofar_udp_meta *meta);
+int lofar_udp_vdif_setup(lofar_udp_meta *meta);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
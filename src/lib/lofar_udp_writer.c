@@ -0,0 +1,1473 @@
+// vmsplice, F_SETPIPE_SZ
+#define _GNU_SOURCE
+#include "lofar_udp_writer.h"
+
+
+// Writer configuration default: uncompressed outputs
+lofar_udp_writer_config lofar_udp_writer_config_default = {
+	.compressionLevel = 0,
+	.compressionWorkers = 4,
+	.pipeCopy = 0,
+	.passthrough = 0
+};
+
+
+/**
+ * @brief      Describe the remaining header prefix and data buffer of a write
+ *
+ * @param      iov           The output iovec array (2 elements)
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The remaining header length
+ * @param[in]  data          The data buffer
+ * @param[in]  dataLength    The remaining data length
+ *
+ * @return     The number of iovec elements used
+ */
+static int lofar_udp_writer_build_iov(struct iovec iov[2], const char *header, const long headerLength, const char *data, const long dataLength) {
+	int iovcnt = 0;
+
+	if (headerLength > 0) {
+		iov[iovcnt].iov_base = (void*) header;
+		iov[iovcnt].iov_len = headerLength;
+		iovcnt++;
+	}
+	if (dataLength > 0) {
+		iov[iovcnt].iov_base = (void*) data;
+		iov[iovcnt].iov_len = dataLength;
+		iovcnt++;
+	}
+
+	return iovcnt;
+}
+
+
+/**
+ * @brief      Write an iovec array to a file descriptor, handling partial
+ *             writes. If splice is set, the data is vmsplice'd instead, falling
+ *             back to writev (and clearing splice) if the fd does not support
+ *             it.
+ *
+ * @param[in]  fd      The output file descriptor
+ * @param      splice  Use vmsplice (may be NULL to always use writev)
+ * @param      iov     The iovec array (modified as data is written)
+ * @param[in]  iovcnt  The number of iovec elements
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_iov(const int fd, int *splice, struct iovec *iov, int iovcnt) {
+	ssize_t written;
+
+	while (iovcnt > 0) {
+		if (splice != NULL && *splice) {
+			written = vmsplice(fd, iov, iovcnt, 0);
+		} else {
+			written = writev(fd, iov, iovcnt);
+		}
+
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			if (splice != NULL && *splice && (errno == EINVAL || errno == ENOSYS)) {
+				VERBOSE(printf("Writer: vmsplice is not supported on fd %d, falling back to writev.\n", fd));
+				*splice = 0;
+				continue;
+			}
+			fprintf(stderr, "ERROR: Writer failed to write to fd %d (errno %d: %s).\n", fd, errno, strerror(errno));
+			return 1;
+		}
+
+		// Skip the elements that were completely written, then trim the partially written element
+		while (iovcnt > 0 && (size_t) written >= iov->iov_len) {
+			written -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char*) iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Write a buffer and an optional header prefix to a file
+ *             descriptor, handling partial writes
+ *
+ * @param[in]  fd            The output file descriptor
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The header length
+ * @param[in]  data          The data buffer
+ * @param[in]  dataLength    The data length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_fd(const int fd, const char *header, long headerLength, const char *data, long dataLength) {
+	struct iovec iov[2];
+	const int iovcnt = lofar_udp_writer_build_iov(iov, header, headerLength, data, dataLength);
+
+	return lofar_udp_writer_write_iov(fd, NULL, iov, iovcnt);
+}
+
+
+/**
+ * @brief      Wait for the consumer of a pipe to read everything we have
+ *             vmsplice'd into it. The pipe holds references to our pages
+ *             rather than copies, so they must not change until then. This
+ *             assumes the consumer copies the data out (see
+ *             lofar_udp_writer_sink_pipe).
+ *
+ * @param      sink  The lofar_udp_sink
+ *
+ * @return     0: Success, 1: The consumer closed the pipe
+ */
+static int lofar_udp_writer_pipe_drain(const lofar_udp_sink *sink) {
+	struct pollfd pipeState = { .fd = sink->fd, .events = POLLOUT };
+	struct timespec drainWait = { 0, 10000 };
+	int pending;
+
+	while (ioctl(sink->fd, FIONREAD, &pending) == 0 && pending > 0) {
+		// Block while the pipe is full
+		if (poll(&pipeState, 1, -1) < 0 && errno != EINTR) {
+			fprintf(stderr, "ERROR: Failed to wait on pipe fd %d (errno %d: %s).\n", sink->fd, errno, strerror(errno));
+			return 1;
+		}
+
+		if (pipeState.revents & POLLERR) {
+			fprintf(stderr, "ERROR: The consumer of fd %d closed the pipe with %d bytes unread.\n", sink->fd, pending);
+			return 1;
+		}
+
+		// Pipes only signal that they have space, not that they are empty; back off (up to 1ms) while the rest drains
+		nanosleep(&drainWait, NULL);
+		if (drainWait.tv_nsec < 1000000) drainWait.tv_nsec *= 2;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Move a buffer and an optional header prefix into a pipe with
+ *             vmsplice, falling back to writev when the fd does not support it.
+ *             Waits for the pipe to drain before returning, after which the
+ *             writer's buffers can be reused.
+ *
+ * @param      sink          The lofar_udp_sink (splice is cleared on fallback)
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The header length
+ * @param[in]  data          The data buffer
+ * @param[in]  dataLength    The data length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_pipe(lofar_udp_sink *sink, const char *header, long headerLength, const char *data, long dataLength) {
+	struct iovec iov[2];
+	const int iovcnt = lofar_udp_writer_build_iov(iov, header, headerLength, data, dataLength);
+
+	if (!sink->splice) return lofar_udp_writer_write_iov(sink->fd, NULL, iov, iovcnt);
+
+	if (lofar_udp_writer_write_iov(sink->fd, &(sink->splice), iov, iovcnt) > 0) return 1;
+
+	return sink->splice ? lofar_udp_writer_pipe_drain(sink) : 0;
+}
+
+
+/**
+ * @brief      Write an optional header prefix followed by a fixed length
+ *             segment of each of a series of equally spaced packets to a file
+ *             or pipe sink, without gathering them into a contiguous buffer
+ *             first
+ *
+ * @param      sink          The lofar_udp_sink
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The header length
+ * @param[in]  data          The first segment
+ * @param[in]  packets       The number of segments
+ * @param[in]  stride        The distance between the starts of segments
+ * @param[in]  length        The length of each segment
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_strided(lofar_udp_sink *sink, const char *header, const long headerLength, const char *data, const long packets, const long stride, const long length) {
+	struct iovec iov[WRITER_IOV_BATCH];
+	int *splice = (sink->type == SINK_FILE) ? NULL : &(sink->splice);
+	long packet = 0;
+	int iovcnt = lofar_udp_writer_build_iov(iov, header, headerLength, NULL, 0);
+
+	while (packet < packets || iovcnt > 0) {
+		for (; iovcnt < WRITER_IOV_BATCH && packet < packets; iovcnt++, packet++) {
+			iov[iovcnt].iov_base = (void*) &(data[packet * stride]);
+			iov[iovcnt].iov_len = length;
+		}
+
+		if (lofar_udp_writer_write_iov(sink->fd, splice, iov, iovcnt) > 0) return 1;
+		iovcnt = 0;
+	}
+
+	return (splice != NULL && *splice) ? lofar_udp_writer_pipe_drain(sink) : 0;
+}
+
+
+/**
+ * @brief      Record a compressed frame in an output's seek table
+ *
+ * @param      writer              The lofar_udp_writer
+ * @param[in]  out                 The output index
+ * @param[in]  compressedLength    The frame's compressed length
+ * @param[in]  decompressedLength  The frame's decompressed length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_seek_table_add(lofar_udp_writer *writer, const int out, const long compressedLength, const long decompressedLength) {
+	// The seekable format stores 32-bit sizes, gulps that do not fit cannot be indexed
+	if (compressedLength > UINT32_MAX || decompressedLength > UINT32_MAX) {
+		writer->seekOverflow[out] = 1;
+		return 0;
+	}
+
+	if (writer->seekFrames[out] == writer->seekCapacity[out]) {
+		const long capacity = writer->seekCapacity[out] ? 2 * writer->seekCapacity[out] : 1024;
+		unsigned int *seekTable = realloc(writer->seekTable[out], 2 * capacity * sizeof(unsigned int));
+		if (seekTable == NULL) {
+			fprintf(stderr, "ERROR: Unable to allocate memory for the seek table of output %d, exiting.\n", out);
+			return 1;
+		}
+		writer->seekTable[out] = seekTable;
+		writer->seekCapacity[out] = capacity;
+	}
+
+	writer->seekTable[out][2 * writer->seekFrames[out]] = (unsigned int) compressedLength;
+	writer->seekTable[out][2 * writer->seekFrames[out] + 1] = (unsigned int) decompressedLength;
+	writer->seekFrames[out]++;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Store a 32-bit value in little endian order
+ *
+ * @param      buffer  The destination
+ * @param[in]  value   The value
+ */
+static void lofar_udp_writer_put_le32(unsigned char *buffer, const unsigned int value) {
+	for (int byte = 0; byte < 4; byte++) buffer[byte] = (unsigned char) (value >> (8 * byte));
+}
+
+
+/**
+ * @brief      Append the zstd seekable format seek table for the frames written
+ *             to an output since its sink was attached (or last finalised), so
+ *             that readers can locate and decompress any gulp on its own
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  out     The output index
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_seek_table_write(lofar_udp_writer *writer, const int out) {
+	const long frames = writer->seekFrames[out];
+	const long tableLength = 8 + 8 * frames + WRITER_ZSTD_SEEK_FOOTER_LENGTH;
+	unsigned char *table;
+	int returnVal = 0;
+
+	writer->seekFrames[out] = 0;
+	if (frames == 0) return 0;
+
+	if (writer->seekOverflow[out] || tableLength - 8 > UINT32_MAX) {
+		fprintf(stderr, "WARNING: Output %d contains gulps too large for a zstd seek table, it can only be decompressed as a stream.\n", out);
+		writer->seekOverflow[out] = 0;
+		return 0;
+	}
+
+	table = malloc(tableLength);
+	if (table == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for the seek table of output %d, exiting.\n", out);
+		return 1;
+	}
+
+	// Skippable frame header, one (compressed, decompressed) entry per frame without checksums, then the footer
+	lofar_udp_writer_put_le32(table, WRITER_ZSTD_SKIPPABLE_MAGIC);
+	lofar_udp_writer_put_le32(table + 4, (unsigned int) (tableLength - 8));
+	for (long frame = 0; frame < 2 * frames; frame++) {
+		lofar_udp_writer_put_le32(table + 8 + 4 * frame, writer->seekTable[out][frame]);
+	}
+	lofar_udp_writer_put_le32(table + tableLength - 9, (unsigned int) frames);
+	table[tableLength - 5] = 0;
+	lofar_udp_writer_put_le32(table + tableLength - 4, WRITER_ZSTD_SEEKABLE_MAGIC);
+
+	if (lofar_udp_writer_write_fd(writer->sinks[out].fd, NULL, 0, (char*) table, tableLength) > 0) returnVal = 1;
+	else writer->bytesCompressed += tableLength;
+
+	free(table);
+	return returnVal;
+}
+
+
+/**
+ * @brief      Compress a header prefix and data buffer into a single zstd
+ *             frame and write it to a file descriptor
+ *
+ * @param      writer        The lofar_udp_writer
+ * @param[in]  fd            The output file descriptor
+ * @param[in]  out           The output index
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The header length
+ * @param[in]  data          The data buffer
+ * @param[in]  dataLength    The data length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_compressed(lofar_udp_writer *writer, const int fd, const int out, const char *header, const long headerLength, const char *data, const long dataLength) {
+	ZSTD_CCtx *cctx = writer->cctx[out];
+	ZSTD_inBuffer input;
+	ZSTD_outBuffer output = { writer->compressionBuffer, writer->compressionBufferSize, 0 };
+	long frameLength = 0;
+	size_t remaining;
+
+	// Record the frame's content size, and its place in the seek table, so that each gulp can be located and decompressed on its own
+	ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+	ZSTD_CCtx_setPledgedSrcSize(cctx, headerLength + dataLength);
+
+	for (int part = 0; part < 2; part++) {
+		const ZSTD_EndDirective mode = part ? ZSTD_e_end : ZSTD_e_continue;
+		input.src = part ? data : header;
+		input.size = part ? dataLength : headerLength;
+		input.pos = 0;
+
+		if (input.size == 0 && mode == ZSTD_e_continue) continue;
+
+		do {
+			remaining = ZSTD_compressStream2(cctx, &output, &input, mode);
+			if (ZSTD_isError(remaining)) {
+				fprintf(stderr, "ERROR: zstd failed to compress output %d (%s).\n", out, ZSTD_getErrorName(remaining));
+				return 1;
+			}
+
+			// Write out the staging buffer once it is full, or once the frame is complete
+			if (output.pos == output.size || (mode == ZSTD_e_end && remaining == 0)) {
+				if (lofar_udp_writer_write_fd(fd, NULL, 0, writer->compressionBuffer, output.pos) > 0) return 1;
+				writer->bytesCompressed += output.pos;
+				frameLength += output.pos;
+				output.pos = 0;
+			}
+		} while (mode == ZSTD_e_end ? remaining != 0 : input.pos != input.size);
+	}
+
+	return lofar_udp_writer_seek_table_add(writer, out, frameLength, headerLength + dataLength);
+}
+
+
+/**
+ * @brief      Create a shared memory ring for an output
+ *
+ * @param[in]  name        The shm_open name (e.g. "/lofar_udp_0")
+ * @param[in]  output      The output index
+ * @param[in]  numSlots    The number of slots in the ring
+ * @param[in]  slotLength  The maximum length of a gulp (header + data)
+ * @param[in]  overwrite   Overwrite unreleased slots rather than waiting for
+ *                         the consumer
+ *
+ * @return     lofar_udp_shm_ring ptr, or NULL on error
+ */
+static lofar_udp_shm_ring* lofar_udp_shm_ring_create(const char *name, const int output, const int numSlots, long slotLength, const int overwrite) {
+	lofar_udp_shm_ring *ring;
+	const long pageSize = sysconf(_SC_PAGESIZE);
+
+	if (numSlots < 2 || numSlots > WRITER_SHM_MAX_SLOTS) {
+		fprintf(stderr, "ERROR: Shared memory rings require between 2 and %d slots (%d requested), exiting.\n", WRITER_SHM_MAX_SLOTS, numSlots);
+		return NULL;
+	}
+
+	if (strlen(name) >= 255) {
+		fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", name);
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(lofar_udp_shm_ring));
+	if (ring == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for shared memory ring, exiting.\n");
+		return NULL;
+	}
+
+	// Page align each slot so that consumers can map / DMA them cleanly
+	slotLength = ((slotLength + pageSize - 1) / pageSize) * pageSize;
+	strcpy(ring->name, name);
+	ring->owner = 1;
+	ring->overwrite = overwrite;
+	ring->mappingLength = pageSize * ((sizeof(lofar_udp_shm_ring_header) + pageSize - 1) / pageSize) + slotLength * numSlots;
+
+	ring->fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+	if (ring->fd < 0) {
+		fprintf(stderr, "ERROR: Unable to open shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		free(ring);
+		return NULL;
+	}
+
+	if (ftruncate(ring->fd, ring->mappingLength) != 0) {
+		fprintf(stderr, "ERROR: Unable to resize shared memory at %s to %ld bytes (errno %d: %s), exiting.\n", name, (long) ring->mappingLength, errno, strerror(errno));
+		close(ring->fd);
+		shm_unlink(name);
+		free(ring);
+		return NULL;
+	}
+
+	ring->header = mmap(NULL, ring->mappingLength, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (ring->header == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Unable to map shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		close(ring->fd);
+		shm_unlink(name);
+		free(ring);
+		return NULL;
+	}
+
+	ring->header->output = output;
+	ring->header->numSlots = numSlots;
+	ring->header->slotLength = slotLength;
+	ring->header->dataOffset = ring->mappingLength - slotLength * numSlots;
+	ring->slots = ((char*) ring->header) + ring->header->dataOffset;
+	for (int slot = 0; slot < numSlots; slot++) ring->header->slotSequence[slot] = -1;
+
+	// Publish the magic last, consumers use it to determine the ring is ready
+	ring->header->version = WRITER_SHM_VERSION;
+	__atomic_store_n(&(ring->header->magic), WRITER_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return ring;
+}
+
+
+/**
+ * @brief      Get the CLOCK_MONOTONIC time in seconds, shared by every process
+ *             on the host
+ *
+ * @return     long: seconds
+ */
+static long lofar_udp_shm_ring_clock(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (long) now.tv_sec;
+}
+
+
+/**
+ * @brief      Wait for the consumer of a shared memory ring to release a
+ *             slot. Fails if the consumer's process has exited, or if it has
+ *             neither released a slot nor polled the ring for
+ *             WRITER_SHM_TIMEOUT seconds.
+ *
+ * @param      ring        The lofar_udp_shm_ring
+ * @param[in]  writeCount  The gulp we are waiting to write
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_shm_ring_wait(lofar_udp_shm_ring *ring, const long writeCount) {
+	lofar_udp_shm_ring_header *ringHeader = ring->header;
+	long lastActivity = lofar_udp_shm_ring_clock(), heartbeat;
+	int pid;
+
+	while (writeCount - __atomic_load_n(&(ringHeader->readCount), __ATOMIC_ACQUIRE) >= ringHeader->numSlots) {
+		pid = __atomic_load_n(&(ringHeader->consumerPid), __ATOMIC_ACQUIRE);
+		if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+			fprintf(stderr, "ERROR: The consumer of shared memory ring %s (PID %d) has exited, exiting.\n", ring->name, pid);
+			ring->consumerLost = 1;
+			return 1;
+		}
+
+		heartbeat = __atomic_load_n(&(ringHeader->consumerHeartbeat), __ATOMIC_ACQUIRE);
+		if (heartbeat > lastActivity) lastActivity = heartbeat;
+		if (lofar_udp_shm_ring_clock() - lastActivity > WRITER_SHM_TIMEOUT) {
+			fprintf(stderr, "ERROR: The consumer of shared memory ring %s has not released a slot in %d seconds, exiting.\n", ring->name, WRITER_SHM_TIMEOUT);
+			ring->consumerLost = 1;
+			return 1;
+		}
+
+		usleep(100);
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Copy a gulp into the next slot of a shared memory ring and
+ *             publish it
+ *
+ * @param      ring          The lofar_udp_shm_ring
+ * @param[in]  header        The header prefix (may be NULL)
+ * @param[in]  headerLength  The header length
+ * @param[in]  data          The data buffer
+ * @param[in]  dataLength    The data length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_shm_ring_write(lofar_udp_shm_ring *ring, const char *header, const long headerLength, const char *data, const long dataLength) {
+	lofar_udp_shm_ring_header *ringHeader = ring->header;
+	const long writeCount = ringHeader->writeCount;
+	const int slot = writeCount % ringHeader->numSlots;
+	char *slotPtr = ring->slots + slot * ringHeader->slotLength;
+
+	if (headerLength + dataLength > ringHeader->slotLength) {
+		fprintf(stderr, "ERROR: Gulp of %ld bytes does not fit in a shared memory slot (%ld bytes), exiting.\n", headerLength + dataLength, ringHeader->slotLength);
+		return 1;
+	}
+
+	if (ring->consumerLost) return 1;
+
+	// Wait for the consumer to release the slot, unless we are allowed to overwrite it
+	if (!ring->overwrite && lofar_udp_shm_ring_wait(ring, writeCount) > 0) {
+		return 1;
+	}
+
+	// Invalidate the slot while it is being modified, so that lagging consumers can detect an overwrite
+	__atomic_store_n(&(ringHeader->slotSequence[slot]), -1, __ATOMIC_RELEASE);
+	if (headerLength > 0) memcpy(slotPtr, header, headerLength);
+	memcpy(slotPtr + headerLength, data, dataLength);
+	ringHeader->slotHeaderLength[slot] = headerLength;
+	ringHeader->slotDataLength[slot] = dataLength;
+	__atomic_store_n(&(ringHeader->slotSequence[slot]), writeCount, __ATOMIC_RELEASE);
+	__atomic_store_n(&(ringHeader->writeCount), writeCount + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+/**
+ * @brief      Unmap a shared memory ring, and remove it if we created it
+ *
+ * @param      ring  The lofar_udp_shm_ring
+ */
+void lofar_udp_shm_ring_detach(lofar_udp_shm_ring *ring) {
+	if (ring == NULL) return;
+
+	munmap(ring->header, ring->mappingLength);
+	close(ring->fd);
+
+	// Attached consumers keep their mapping until they detach
+	if (ring->owner) shm_unlink(ring->name);
+
+	free(ring);
+}
+
+
+/**
+ * @brief      Attach to a shared memory ring created by a writer
+ *
+ * @param[in]  name  The shm_open name of the ring
+ *
+ * @return     lofar_udp_shm_ring ptr, or NULL on error
+ */
+lofar_udp_shm_ring* lofar_udp_shm_ring_attach(const char *name) {
+	struct stat st;
+	lofar_udp_shm_ring *ring;
+
+	if (strlen(name) >= 255) {
+		fprintf(stderr, "ERROR: Shared memory name %s is too long, exiting.\n", name);
+		return NULL;
+	}
+
+	ring = calloc(1, sizeof(lofar_udp_shm_ring));
+	if (ring == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for shared memory ring, exiting.\n");
+		return NULL;
+	}
+	strcpy(ring->name, name);
+
+	ring->fd = shm_open(name, O_RDWR, 0);
+	if (ring->fd < 0 || fstat(ring->fd, &st) != 0 || st.st_size < (off_t) sizeof(lofar_udp_shm_ring_header)) {
+		fprintf(stderr, "ERROR: Unable to open shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		if (ring->fd >= 0) close(ring->fd);
+		free(ring);
+		return NULL;
+	}
+
+	ring->mappingLength = st.st_size;
+	ring->header = mmap(NULL, ring->mappingLength, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+	if (ring->header == MAP_FAILED) {
+		fprintf(stderr, "ERROR: Unable to map shared memory at %s (errno %d: %s), exiting.\n", name, errno, strerror(errno));
+		close(ring->fd);
+		free(ring);
+		return NULL;
+	}
+
+	if (__atomic_load_n(&(ring->header->magic), __ATOMIC_ACQUIRE) != WRITER_SHM_MAGIC || ring->header->version != WRITER_SHM_VERSION) {
+		fprintf(stderr, "ERROR: Shared memory at %s is not a lofar_udp ring (or is from an incompatible version), exiting.\n", name);
+		lofar_udp_shm_ring_detach(ring);
+		return NULL;
+	}
+
+	ring->slots = ((char*) ring->header) + ring->header->dataOffset;
+	ring->readCount = __atomic_load_n(&(ring->header->readCount), __ATOMIC_ACQUIRE);
+
+	// Let the writer check that we are still alive while it waits on us
+	__atomic_store_n(&(ring->header->consumerHeartbeat), lofar_udp_shm_ring_clock(), __ATOMIC_RELEASE);
+	__atomic_store_n(&(ring->header->consumerPid), (int) getpid(), __ATOMIC_RELEASE);
+
+	return ring;
+}
+
+
+/**
+ * @brief      Get pointers to the oldest unreleased gulp in a shared memory
+ *             ring. The data is read in place, and remains valid until
+ *             lofar_udp_shm_ring_release is called.
+ *
+ * @param      ring          The lofar_udp_shm_ring
+ * @param[out] header        The header prefix
+ * @param[out] headerLength  The header length
+ * @param[out] data          The data buffer
+ * @param[out] dataLength    The data length
+ *
+ * @return     0: Success, -1: No data available, -2: Data was overwritten
+ *             before we could read it, position was advanced to the oldest
+ *             available gulp
+ */
+int lofar_udp_shm_ring_next(lofar_udp_shm_ring *ring, const char **header, long *headerLength, const char **data, long *dataLength) {
+	lofar_udp_shm_ring_header *ringHeader = ring->header;
+	const long writeCount = __atomic_load_n(&(ringHeader->writeCount), __ATOMIC_ACQUIRE);
+	int slot;
+
+	__atomic_store_n(&(ringHeader->consumerHeartbeat), lofar_udp_shm_ring_clock(), __ATOMIC_RELEASE);
+	if (ring->readCount >= writeCount) return -1;
+
+	if (writeCount - ring->readCount > ringHeader->numSlots) {
+		ring->readCount = writeCount - ringHeader->numSlots;
+		__atomic_store_n(&(ringHeader->readCount), ring->readCount, __ATOMIC_RELEASE);
+		return -2;
+	}
+
+	slot = ring->readCount % ringHeader->numSlots;
+	*headerLength = ringHeader->slotHeaderLength[slot];
+	*dataLength = ringHeader->slotDataLength[slot];
+	*header = ring->slots + slot * ringHeader->slotLength;
+	*data = *header + *headerLength;
+
+	return 0;
+}
+
+
+/**
+ * @brief      Release the gulp returned by lofar_udp_shm_ring_next back to the
+ *             writer
+ *
+ * @param      ring  The lofar_udp_shm_ring
+ *
+ * @return     0: Success, -2: The gulp was overwritten while it was being read
+ */
+int lofar_udp_shm_ring_release(lofar_udp_shm_ring *ring) {
+	lofar_udp_shm_ring_header *ringHeader = ring->header;
+	const int slot = ring->readCount % ringHeader->numSlots;
+	const int returnVal = (__atomic_load_n(&(ringHeader->slotSequence[slot]), __ATOMIC_ACQUIRE) == ring->readCount) ? 0 : -2;
+
+	ring->readCount++;
+	__atomic_store_n(&(ringHeader->readCount), ring->readCount, __ATOMIC_RELEASE);
+	__atomic_store_n(&(ringHeader->consumerHeartbeat), lofar_udp_shm_ring_clock(), __ATOMIC_RELEASE);
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Write a gulp for an output to its sink, prefixed by the pending
+ *             header
+ *
+ * @param      writer      The lofar_udp_writer
+ * @param[in]  out         The output index
+ * @param[in]  data        The gulp
+ * @param[in]  dataLength  The gulp length
+ *
+ * @return     0: Success, >0: Fatal error
+ */
+static int lofar_udp_writer_sink_write(lofar_udp_writer *writer, const int out, const char *data, const long dataLength) {
+	lofar_udp_sink *sink = &(writer->sinks[out]);
+
+	switch (sink->type) {
+		case SINK_FILE:
+		case SINK_FIFO:
+		case SINK_PIPE:
+			if (writer->compressionLevel) {
+				return lofar_udp_writer_write_compressed(writer, sink->fd, out, writer->headerBuffer, writer->headerLength, data, dataLength);
+			}
+			if (sink->type != SINK_FILE) {
+				return lofar_udp_writer_write_pipe(sink, writer->headerBuffer, writer->headerLength, data, dataLength);
+			}
+			return lofar_udp_writer_write_fd(sink->fd, writer->headerBuffer, writer->headerLength, data, dataLength);
+
+		case SINK_SHM:
+			return lofar_udp_shm_ring_write(sink->ring, writer->headerBuffer, writer->headerLength, data, dataLength);
+
+		case SINK_CALLBACK:
+			return sink->callback(out, writer->headerBuffer, writer->headerLength, data, dataLength, sink->userData);
+
+		// Header prefixes are not written to HDF5 outputs, the observation is described by the dataset attributes
+		case SINK_HDF5:
+			return lofar_udp_hdf5_write(sink->hdf5, data, dataLength);
+
+		// PSRFITS outputs carry their own FITS headers
+		case SINK_PSRFITS:
+			return lofar_udp_psrfits_write(sink->psrfits, data, dataLength);
+
+		default:
+			fprintf(stderr, "ERROR: Output %d does not have a sink attached.\n", out);
+			return 1;
+	}
+}
+
+
+/**
+ * @brief      Release any resources the writer holds for an output's sink
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  out     The output index
+ *
+ * @return     0: Success, 1: The seek table could not be written
+ */
+static int lofar_udp_writer_sink_close(lofar_udp_writer *writer, const int out) {
+	lofar_udp_sink *sink = &(writer->sinks[out]);
+	int returnVal = 0;
+
+	switch (sink->type) {
+		// Files may already have been closed by the caller, their seek tables are written by lofar_udp_writer_finalise
+		case SINK_FILE:
+			writer->seekFrames[out] = 0;
+			writer->seekOverflow[out] = 0;
+			break;
+
+		case SINK_FIFO:
+			returnVal = lofar_udp_writer_seek_table_write(writer, out);
+			close(sink->fd);
+			break;
+
+		case SINK_PIPE:
+			returnVal = lofar_udp_writer_seek_table_write(writer, out);
+			break;
+
+		case SINK_SHM:
+			lofar_udp_shm_ring_detach(sink->ring);
+			break;
+
+		case SINK_HDF5:
+			lofar_udp_hdf5_close(sink->hdf5);
+			break;
+
+		case SINK_PSRFITS:
+			lofar_udp_psrfits_close(sink->psrfits);
+			break;
+
+		default:
+			break;
+	}
+
+	*sink = (lofar_udp_sink) { .type = SINK_NONE, .fd = -1 };
+	return returnVal;
+}
+
+
+/**
+ * @brief      Writer thread main loop: wait for a gulp to be submitted, write
+ *             it to each output, signal completion
+ *
+ * @param      writerPtr  The lofar_udp_writer
+ *
+ * @return     NULL
+ */
+static void* lofar_udp_writer_thread(void *writerPtr) {
+	lofar_udp_writer *writer = (lofar_udp_writer*) writerPtr;
+	struct timespec tick, tock;
+	int returnVal;
+
+	pthread_mutex_lock(&(writer->mutex));
+	while (1) {
+		while (!writer->writePending && !writer->shutdown) {
+			pthread_cond_wait(&(writer->cond), &(writer->mutex));
+		}
+
+		if (!writer->writePending && writer->shutdown) break;
+		pthread_mutex_unlock(&(writer->mutex));
+
+		CLICK(tick);
+		returnVal = 0;
+		for (int out = 0; out < writer->numOutputs; out++) {
+			VERBOSE(printf("Writer: writing %ld bytes to output %d...\n", writer->writeLength[out], out));
+			TRACE_BEGIN("write", out);
+			returnVal += lofar_udp_writer_sink_write(writer, out, writer->outputBuffers[writer->writeBuffer][out], writer->writeLength[out]);
+			TRACE_END("write", out);
+		}
+		CLICK(tock);
+
+		pthread_mutex_lock(&(writer->mutex));
+		writer->writesCompleted += 1;
+		writer->lastWriteTime = TICKTOCK(tick, tock);
+		writer->totalWriteTime += writer->lastWriteTime;
+		for (int out = 0; out < writer->numOutputs; out++) writer->bytesWritten += writer->writeLength[out] + writer->headerLength;
+		if (returnVal) writer->writeError = 1;
+		writer->writePending = 0;
+		pthread_cond_broadcast(&(writer->cond));
+	}
+	pthread_mutex_unlock(&(writer->mutex));
+
+	return NULL;
+}
+
+
+/**
+ * @brief      Let the reader pass clean gulps in modes 0/1 through to the
+ *             writer (see lofar_udp_writer_config.passthrough), only while every
+ *             output is written to a file, named pipe or file descriptor sink
+ *
+ * @param      writer  The lofar_udp_writer
+ */
+static void lofar_udp_writer_passthrough_update(lofar_udp_writer *writer) {
+	int allowed = writer->passthrough && writer->reader->meta->processingMode <= 1;
+
+	for (int out = 0; out < writer->numOutputs; out++) {
+		const lofar_udp_sink_type type = writer->sinks[out].type;
+		if (type != SINK_FILE && type != SINK_FIFO && type != SINK_PIPE) allowed = 0;
+	}
+
+	writer->reader->meta->allowPassthrough = allowed;
+}
+
+
+/**
+ * @brief      Attach an asynchronous writer to a reader, using the default
+ *             (uncompressed) configuration
+ *
+ * @param      reader       The lofar_udp_reader to attach to
+ * @param      outputFiles  The output files, one per reader output (may be
+ *                          NULL, see lofar_udp_writer_sink_*)
+ *
+ * @return     lofar_udp_writer ptr, or NULL on error
+ */
+lofar_udp_writer* lofar_udp_writer_setup(lofar_udp_reader *reader, FILE **outputFiles) {
+	return lofar_udp_writer_setup_struct(reader, outputFiles, &lofar_udp_writer_config_default);
+}
+
+
+/**
+ * @brief      Free the compression state of a writer
+ *
+ * @param      writer  The lofar_udp_writer
+ */
+static void lofar_udp_writer_free_compression(lofar_udp_writer *writer) {
+	for (int out = 0; out < writer->numOutputs; out++) {
+		if (writer->cctx[out] != NULL) {
+			ZSTD_freeCCtx(writer->cctx[out]);
+			writer->cctx[out] = NULL;
+		}
+	}
+
+	if (writer->compressionBuffer != NULL) {
+		free(writer->compressionBuffer);
+		writer->compressionBuffer = NULL;
+	}
+}
+
+
+/**
+ * @brief      Attach an asynchronous writer to a reader. A second set of output
+ *             buffers is allocated, and a writer thread is started to flush
+ *             submitted gulps while the next gulp is processed.
+ *
+ * @param      reader       The lofar_udp_reader to attach to
+ * @param      outputFiles  The output files, one per reader output (may be
+ *                          NULL, see lofar_udp_writer_sink_*)
+ * @param[in]  config       The writer configuration
+ *
+ * @return     lofar_udp_writer ptr, or NULL on error
+ */
+lofar_udp_writer* lofar_udp_writer_setup_struct(lofar_udp_reader *reader, FILE **outputFiles, const lofar_udp_writer_config *config) {
+	size_t returnVal;
+	lofar_udp_writer *writer = calloc(1, sizeof(lofar_udp_writer));
+	if (writer == NULL) {
+		fprintf(stderr, "ERROR: Unable to allocate memory for writer struct, exiting.\n");
+		return NULL;
+	}
+
+	writer->reader = reader;
+	writer->numOutputs = reader->meta->numOutputs;
+	writer->processingBuffer = 0;
+
+	for (int out = 0; out < writer->numOutputs; out++) {
+		writer->sinks[out] = (lofar_udp_sink) { .type = SINK_NONE, .fd = -1 };
+
+		// The reader's buffers are the first set, allocate a matching second set
+		writer->bufferLength[out] = reader->meta->packetOutputLength[out] * reader->packetsPerIteration + lofar_udp_time_major_overlap_length(reader->meta, out);
+		writer->outputBuffers[0][out] = reader->meta->outputData[out];
+		writer->outputBuffers[1][out] = calloc(writer->bufferLength[out], sizeof(char));
+		VERBOSE(printf("Writer: calloc at %p for %ld bytes\n", writer->outputBuffers[1][out], writer->bufferLength[out]));
+
+		if (writer->outputBuffers[1][out] == NULL) {
+			fprintf(stderr, "ERROR: Unable to allocate second output buffer for output %d, exiting.\n", out);
+			for (int i = 0; i < out; i++) free(writer->outputBuffers[1][i]);
+			free(writer);
+			return NULL;
+		}
+	}
+
+	// Setup a compression context per output, with multithreaded compression if libzstd supports it
+	writer->pipeCopy = config->pipeCopy;
+	writer->passthrough = config->passthrough;
+	writer->compressionLevel = config->compressionLevel;
+	if (writer->compressionLevel) {
+		if (writer->compressionLevel < ZSTD_minCLevel() || writer->compressionLevel > ZSTD_maxCLevel()) {
+			fprintf(stderr, "ERROR: zstd compression level %d is outside of the supported range (%d to %d), exiting.\n", writer->compressionLevel, ZSTD_minCLevel(), ZSTD_maxCLevel());
+			for (int out = 0; out < writer->numOutputs; out++) free(writer->outputBuffers[1][out]);
+			free(writer);
+			return NULL;
+		}
+
+		// Stage compressed data in a few multiples of zstd's recommended block size to limit write calls
+		writer->compressionBufferSize = ZSTD_CStreamOutSize() * WRITER_ZSTD_STAGING_BLOCKS;
+		writer->compressionBuffer = calloc(writer->compressionBufferSize, sizeof(char));
+
+		for (int out = 0; out < writer->numOutputs; out++) {
+			writer->cctx[out] = ZSTD_createCCtx();
+			if (writer->cctx[out] == NULL || writer->compressionBuffer == NULL) {
+				fprintf(stderr, "ERROR: Unable to allocate compression state for output %d, exiting.\n", out);
+				lofar_udp_writer_free_compression(writer);
+				for (int i = 0; i < writer->numOutputs; i++) free(writer->outputBuffers[1][i]);
+				free(writer);
+				return NULL;
+			}
+
+			ZSTD_CCtx_setParameter(writer->cctx[out], ZSTD_c_compressionLevel, writer->compressionLevel);
+			ZSTD_CCtx_setParameter(writer->cctx[out], ZSTD_c_checksumFlag, 1);
+			if (config->compressionWorkers > 1) {
+				returnVal = ZSTD_CCtx_setParameter(writer->cctx[out], ZSTD_c_nbWorkers, config->compressionWorkers);
+				if (ZSTD_isError(returnVal) && out == 0) {
+					fprintf(stderr, "WARNING: Unable to use %d zstd workers (%s), compressing on the writer thread. Continuing...\n", config->compressionWorkers, ZSTD_getErrorName(returnVal));
+				}
+			}
+		}
+	}
+
+	pthread_mutex_init(&(writer->mutex), NULL);
+	pthread_cond_init(&(writer->cond), NULL);
+
+	if (outputFiles != NULL && lofar_udp_writer_update_files(writer, outputFiles) > 0) {
+		pthread_mutex_destroy(&(writer->mutex));
+		pthread_cond_destroy(&(writer->cond));
+		lofar_udp_writer_free_compression(writer);
+		for (int out = 0; out < writer->numOutputs; out++) free(writer->outputBuffers[1][out]);
+		free(writer);
+		return NULL;
+	}
+
+	if (pthread_create(&(writer->thread), NULL, lofar_udp_writer_thread, writer) != 0) {
+		fprintf(stderr, "ERROR: Unable to start writer thread (errno %d: %s), exiting.\n", errno, strerror(errno));
+		pthread_mutex_destroy(&(writer->mutex));
+		pthread_cond_destroy(&(writer->cond));
+		lofar_udp_writer_free_compression(writer);
+		for (int out = 0; out < writer->numOutputs; out++) free(writer->outputBuffers[1][out]);
+		free(writer);
+		return NULL;
+	}
+
+	lofar_udp_writer_passthrough_update(writer);
+
+	return writer;
+}
+
+
+/**
+ * @brief      Wait for any pending write to complete
+ *
+ * @param      writer  The lofar_udp_writer
+ *
+ * @return     0: Success, 1: A write failed
+ */
+int lofar_udp_writer_flush(lofar_udp_writer *writer) {
+	lofar_udp_reader_stats *stats = &(writer->reader->stats);
+	struct timespec tick, tock;
+	int returnVal;
+
+	CLICK(tick);
+	TRACE_BEGIN("write_wait", -1);
+	pthread_mutex_lock(&(writer->mutex));
+	while (writer->writePending) {
+		pthread_cond_wait(&(writer->cond), &(writer->mutex));
+	}
+	returnVal = writer->writeError;
+
+	// The writer thread is idle, publish its statistics on the reader
+	stats->write.calls = writer->writesCompleted;
+	stats->write.lastTime = writer->lastWriteTime;
+	stats->write.totalTime = writer->totalWriteTime;
+	stats->bytesWritten = writer->bytesWritten;
+	pthread_mutex_unlock(&(writer->mutex));
+	TRACE_END("write_wait", -1);
+	CLICK(tock);
+	lofar_udp_stage_stats_record(&(stats->writeWait), TICKTOCK(tick, tock));
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Change the output files of a writer (e.g. for a new event), after
+ *             flushing any pending write to the previous files
+ *
+ * @param      writer       The lofar_udp_writer
+ * @param      outputFiles  The new output files, one per reader output
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_update_files(lofar_udp_writer *writer, FILE **outputFiles) {
+	for (int out = 0; out < writer->numOutputs; out++) {
+		if (lofar_udp_writer_sink_file(writer, out, outputFiles[out]) > 0) return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Flush any pending write, then append the zstd seek tables to
+ *             compressed output files. Compressed files must be finalised
+ *             before the caller closes them to be seekable; named pipes and
+ *             pipes are finalised when they are replaced or the writer is
+ *             cleaned up, as a table mid-stream would break their indexing.
+ *
+ * @param      writer  The lofar_udp_writer
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_finalise(lofar_udp_writer *writer) {
+	if (lofar_udp_writer_flush(writer) > 0) return 1;
+
+	for (int out = 0; out < writer->numOutputs; out++) {
+		if (writer->sinks[out].type == SINK_FILE && lofar_udp_writer_seek_table_write(writer, out) > 0) return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * @brief      Check an output index and flush any pending write, before a sink
+ *             is replaced
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  outp    The output index
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_sink_prepare(lofar_udp_writer *writer, const int outp) {
+	if (outp < 0 || outp >= writer->numOutputs) {
+		fprintf(stderr, "ERROR: Output %d is out of range for the writer (%d outputs), exiting.\n", outp, writer->numOutputs);
+		return 1;
+	}
+
+	if (lofar_udp_writer_flush(writer) > 0) return 1;
+
+	return lofar_udp_writer_sink_close(writer, outp);
+}
+
+
+/**
+ * @brief      Write an output to an open file. The file remains owned by the
+ *             caller.
+ *
+ * @param      writer      The lofar_udp_writer
+ * @param[in]  outp        The output index
+ * @param      outputFile  The output file
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_file(lofar_udp_writer *writer, const int outp, FILE *outputFile) {
+	int fd;
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	// Anything the caller has fprintf'd (e.g. headers) must land before our data
+	fflush(outputFile);
+	fd = fileno(outputFile);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Unable to get file descriptor for output %d, exiting.\n", outp);
+		return 1;
+	}
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_FILE, .fd = fd };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Check whether a file descriptor is a pipe, and if so, try to
+ *             enlarge it so that each vmsplice call can move more of a gulp
+ *
+ * @param[in]  fd    The file descriptor
+ *
+ * @return     1: The descriptor is a pipe, 0: It is not
+ */
+static int lofar_udp_writer_pipe_prepare(const int fd) {
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode)) return 0;
+
+	// Not fatal, the default pipe size works, it just takes more calls
+	if (fcntl(fd, F_SETPIPE_SZ, WRITER_PIPE_SIZE) < 0) {
+		VERBOSE(printf("Writer: unable to resize pipe on fd %d (errno %d: %s), continuing.\n", fd, errno, strerror(errno)));
+	}
+
+	return 1;
+}
+
+
+/**
+ * @brief      Write an output to a named pipe, creating it if it does not
+ *             exist. Blocks until a consumer opens the other end.
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  outp    The output index
+ * @param[in]  path    The path to the named pipe
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_fifo(lofar_udp_writer *writer, const int outp, const char *path) {
+	struct stat st;
+	int fd;
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	if (stat(path, &st) != 0) {
+		if (mkfifo(path, 0644) != 0) {
+			fprintf(stderr, "ERROR: Unable to create named pipe at %s (errno %d: %s), exiting.\n", path, errno, strerror(errno));
+			return 1;
+		}
+	} else if (!S_ISFIFO(st.st_mode)) {
+		fprintf(stderr, "ERROR: %s exists and is not a named pipe, exiting.\n", path);
+		return 1;
+	}
+
+	VERBOSE(printf("Writer: waiting for a consumer to open %s...\n", path));
+	fd = open(path, O_WRONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Unable to open named pipe at %s (errno %d: %s), exiting.\n", path, errno, strerror(errno));
+		return 1;
+	}
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_FIFO, .fd = fd, .splice = lofar_udp_writer_pipe_prepare(fd) && !writer->pipeCopy };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Write an output to an open file descriptor, such as stdout. If
+ *             the descriptor is a pipe, gulps are vmsplice'd into it rather
+ *             than copied, so the consumer must read() the data out rather
+ *             than splice it onwards, unless the writer was configured with
+ *             pipeCopy. The descriptor remains owned by the caller.
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  outp    The output index
+ * @param[in]  fd      The output file descriptor
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_pipe(lofar_udp_writer *writer, const int outp, const int fd) {
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: Invalid file descriptor %d for output %d, exiting.\n", fd, outp);
+		return 1;
+	}
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_PIPE, .fd = fd, .splice = lofar_udp_writer_pipe_prepare(fd) && !writer->pipeCopy };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Write an output to a shared memory ring, which consumers can
+ *             read in place through lofar_udp_shm_ring_attach/next/release
+ *
+ * @param      writer     The lofar_udp_writer
+ * @param[in]  outp       The output index
+ * @param[in]  name       The shm_open name (e.g. "/lofar_udp_0")
+ * @param[in]  numSlots   The number of gulps held by the ring
+ * @param[in]  overwrite  0: wait for the consumer to release slots, 1:
+ *                        overwrite the oldest slot instead
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_shm(lofar_udp_writer *writer, const int outp, const char *name, const int numSlots, const int overwrite) {
+	lofar_udp_shm_ring *ring;
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	ring = lofar_udp_shm_ring_create(name, outp, numSlots, WRITER_MAX_HDR_LENGTH + writer->bufferLength[outp], overwrite);
+	if (ring == NULL) return 1;
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_SHM, .fd = -1, .ring = ring };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Hand an output to a user callback on the writer thread, without
+ *             copying it
+ *
+ * @param      writer    The lofar_udp_writer
+ * @param[in]  outp      The output index
+ * @param[in]  callback  The callback
+ * @param      userData  Pointer passed through to the callback
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_callback(lofar_udp_writer *writer, const int outp, lofar_udp_sink_callback callback, void *userData) {
+	if (callback == NULL) {
+		fprintf(stderr, "ERROR: A callback was not provided for output %d, exiting.\n", outp);
+		return 1;
+	}
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_CALLBACK, .fd = -1, .callback = callback, .userData = userData };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Write an output to an HDF5 file, with one chunk per gulp. Chunks
+ *             are deflated in parallel before being passed to HDF5.
+ *
+ * @param      writer              The lofar_udp_writer
+ * @param[in]  outp                The output index
+ * @param[in]  path                The output file path (replaced if it exists)
+ * @param[in]  compressionLevel    The deflate level (0 disables compression)
+ * @param[in]  compressionThreads  The number of threads used to compress
+ *                                 each chunk
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_hdf5(lofar_udp_writer *writer, const int outp, const char *path, const int compressionLevel, const int compressionThreads) {
+	lofar_udp_hdf5_file *file;
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	file = lofar_udp_hdf5_open(path, writer->reader->meta, outp, writer->bufferLength[outp], compressionLevel, compressionThreads);
+	if (file == NULL) return 1;
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_HDF5, .fd = -1, .hdf5 = file };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Write a Stokes output to a PSRFITS search-mode file. Each subint
+ *             is quantised with per-channel scales and offsets on the writer
+ *             thread, overlapping the processing of the next gulp.
+ *
+ * @param      writer  The lofar_udp_writer
+ * @param[in]  outp    The output index
+ * @param[in]  path    The output file path (replaced if it exists)
+ * @param[in]  config  The lofar_udp_psrfits_config
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_sink_psrfits(lofar_udp_writer *writer, const int outp, const char *path, const lofar_udp_psrfits_config *config) {
+	lofar_udp_psrfits_file *file;
+
+	if (lofar_udp_writer_sink_prepare(writer, outp) > 0) return 1;
+
+	file = lofar_udp_psrfits_open(path, writer->reader->meta, outp, config);
+	if (file == NULL) return 1;
+
+	writer->sinks[outp] = (lofar_udp_sink) { .type = SINK_PSRFITS, .fd = -1, .psrfits = file };
+	lofar_udp_writer_passthrough_update(writer);
+	return 0;
+}
+
+
+/**
+ * @brief      Submit the current gulp in meta->outputData to be written, and
+ *             swap the reader onto the other set of output buffers
+ *
+ * @param      writer          The lofar_udp_writer
+ * @param[in]  packetsToWrite  The number of packets to write on each output
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_submit(lofar_udp_writer *writer, const long packetsToWrite) {
+	return lofar_udp_writer_submit_prefixed(writer, packetsToWrite, NULL, 0);
+}
+
+
+/**
+ * @brief      Write a gulp that the reader passed through (modes 0/1 without
+ *             packet loss) straight from the reader's input buffers. The input
+ *             buffers are refilled on the next step, so this is performed
+ *             synchronously, after any pending write has completed.
+ *
+ *             Mode 0 outputs are a contiguous range of the input. Mode 1
+ *             outputs are written to file and pipe sinks as a series of
+ *             payloads, other sinks receive a gathered copy.
+ *
+ * @param      writer          The lofar_udp_writer
+ * @param[in]  packetsToWrite  The number of packets to write on each output
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+static int lofar_udp_writer_write_passthrough(lofar_udp_writer *writer, const long packetsToWrite) {
+	lofar_udp_meta *meta = writer->reader->meta;
+	struct timespec tick, tock;
+	int returnVal = 0;
+
+	CLICK(tick);
+	for (int out = 0; out < writer->numOutputs && !returnVal; out++) {
+		lofar_udp_sink *sink = &(writer->sinks[out]);
+		const long stride = meta->portPacketLength[out];
+		const long length = meta->packetOutputLength[out];
+		// Outputs are the end of each packet, excluding any per-packet header offset
+		const char *input = &(meta->inputData[out][stride - length - meta->headerOffset]);
+
+		VERBOSE(printf("Writer: passing through %ld bytes to output %d...\n", packetsToWrite * length, out));
+		TRACE_BEGIN("write_passthrough", out);
+		if (length == stride) {
+			returnVal = lofar_udp_writer_sink_write(writer, out, input, packetsToWrite * length);
+		} else if (!writer->compressionLevel && (sink->type == SINK_FILE || sink->type == SINK_FIFO || sink->type == SINK_PIPE)) {
+			returnVal = lofar_udp_writer_write_strided(sink, writer->headerBuffer, writer->headerLength, input, packetsToWrite, stride, length);
+		} else {
+			char *gathered = writer->outputBuffers[writer->processingBuffer][out];
+			for (long packet = 0; packet < packetsToWrite; packet++) {
+				memcpy(&(gathered[packet * length]), &(input[packet * stride]), length);
+			}
+			returnVal = lofar_udp_writer_sink_write(writer, out, gathered, packetsToWrite * length);
+		}
+		TRACE_END("write_passthrough", out);
+	}
+	CLICK(tock);
+
+	pthread_mutex_lock(&(writer->mutex));
+	writer->writesCompleted += 1;
+	writer->lastWriteTime = TICKTOCK(tick, tock);
+	writer->totalWriteTime += writer->lastWriteTime;
+	for (int out = 0; out < writer->numOutputs; out++) writer->bytesWritten += packetsToWrite * meta->packetOutputLength[out] + writer->headerLength;
+	if (returnVal) writer->writeError = 1;
+	pthread_mutex_unlock(&(writer->mutex));
+
+	return returnVal;
+}
+
+
+/**
+ * @brief      Submit the current gulp in meta->outputData to be written,
+ *             prefixing each output with a header, and swap the reader onto
+ *             the other set of output buffers. Gulps the reader passed through
+ *             are written from its input buffers before returning.
+ *
+ * @param      writer          The lofar_udp_writer
+ * @param[in]  packetsToWrite  The number of packets to write on each output
+ * @param[in]  header          The header to write before the data (copied, may
+ *                             be NULL)
+ * @param[in]  headerLength    The header length
+ *
+ * @return     0: Success, 1: Fatal error
+ */
+int lofar_udp_writer_submit_prefixed(lofar_udp_writer *writer, const long packetsToWrite, const char *header, const long headerLength) {
+	lofar_udp_meta *meta = writer->reader->meta;
+
+	if (headerLength > WRITER_MAX_HDR_LENGTH) {
+		fprintf(stderr, "ERROR: Header of length %ld is longer than the writer supports (%d), exiting.\n", headerLength, WRITER_MAX_HDR_LENGTH);
+		return 1;
+	}
+
+	for (int out = 0; out < writer->numOutputs; out++) {
+		if (writer->sinks[out].type == SINK_NONE) {
+			fprintf(stderr, "ERROR: Output %d does not have a sink attached, exiting.\n", out);
+			return 1;
+		}
+	}
+
+	// Wait for gulp N-1 to finish; it owns the buffers we are about to hand to the kernels
+	if (lofar_udp_writer_flush(writer) > 0) {
+		fprintf(stderr, "ERROR: A previous write failed, exiting.\n");
+		return 1;
+	}
+
+	// Passed through gulps are still in the reader's input buffers
+	if (meta->passthroughReady) {
+		writer->headerLength = 0;
+		if (header != NULL && headerLength > 0) {
+			memcpy(writer->headerBuffer, header, headerLength);
+			writer->headerLength = headerLength;
+		}
+
+		if (lofar_udp_writer_write_passthrough(writer, packetsToWrite) > 0) {
+			fprintf(stderr, "ERROR: Failed to write a passed through gulp, exiting.\n");
+			return 1;
+		}
+		return 0;
+	}
+
+	pthread_mutex_lock(&(writer->mutex));
+	writer->writeBuffer = writer->processingBuffer;
+	for (int out = 0; out < writer->numOutputs; out++) {
+		writer->writeLength[out] = packetsToWrite * meta->packetOutputLength[out] + lofar_udp_time_major_overlap_length(meta, out);
+	}
+	writer->headerLength = 0;
+	if (header != NULL && headerLength > 0) {
+		memcpy(writer->headerBuffer, header, headerLength);
+		writer->headerLength = headerLength;
+	}
+
+	// Point the kernels at the other set of buffers
+	writer->processingBuffer = 1 - writer->processingBuffer;
+	for (int out = 0; out < writer->numOutputs; out++) {
+		meta->outputData[out] = writer->outputBuffers[writer->processingBuffer][out];
+	}
+
+	writer->writePending = 1;
+	pthread_cond_broadcast(&(writer->cond));
+	pthread_mutex_unlock(&(writer->mutex));
+
+	return 0;
+}
+
+
+/**
+ * @brief      Flush any pending writes, stop the writer thread, return the
+ *             reader's original output buffers and free the writer. Output
+ *             files are not closed (or finalised, see lofar_udp_writer_finalise),
+ *             named pipes and shared memory rings are.
+ *
+ * @param      writer  The lofar_udp_writer
+ *
+ * @return     0: Success, 1: A write failed
+ */
+int lofar_udp_writer_cleanup(lofar_udp_writer *writer) {
+	int returnVal = lofar_udp_writer_flush(writer);
+
+	pthread_mutex_lock(&(writer->mutex));
+	writer->shutdown = 1;
+	pthread_cond_broadcast(&(writer->cond));
+	pthread_mutex_unlock(&(writer->mutex));
+	pthread_join(writer->thread, NULL);
+
+	pthread_mutex_destroy(&(writer->mutex));
+	pthread_cond_destroy(&(writer->cond));
+
+	// The reader needs to run the kernels again if it is used without a writer
+	writer->reader->meta->allowPassthrough = 0;
+
+	// Hand the reader back the buffers it allocated, so that the reader cleanup frees the right pointers
+	for (int out = 0; out < writer->numOutputs; out++) {
+		writer->reader->meta->outputData[out] = writer->outputBuffers[0][out];
+		free(writer->outputBuffers[1][out]);
+		if (lofar_udp_writer_sink_close(writer, out) > 0) returnVal = 1;
+		free(writer->seekTable[out]);
+	}
+
+	lofar_udp_writer_free_compression(writer);
+	free(writer);
+	return returnVal;
+}
@@ -0,0 +1,266 @@
+// Standard required includes
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zstd.h>
+
+#include "lofar_udp_general.h"
+#include "lofar_udp_reader.h"
+#include "lofar_udp_hdf5.h"
+#include "lofar_udp_psrfits.h"
+
+#ifndef __LOFAR_UDP_WRITER_STRUCTS
+#define __LOFAR_UDP_WRITER_STRUCTS
+
+// Maximum length of a header that can be prefixed to each output on a write
+#define WRITER_MAX_HDR_LENGTH 8192
+
+// Shared memory ring constants
+#define WRITER_SHM_MAGIC 0x4c4f4655
+#define WRITER_SHM_VERSION 2
+#define WRITER_SHM_MAX_SLOTS 64
+
+// Seconds a writer waits on a full ring without any sign of life from its consumer before failing
+#define WRITER_SHM_TIMEOUT 60
+
+// Requested capacity of pipes we write to (Linux caps unprivileged requests at /proc/sys/fs/pipe-max-size, 1MB by default)
+#define WRITER_PIPE_SIZE (1024 * 1024)
+
+// Maximum number of segments handed to a single writev / vmsplice call (Linux's UIO_MAXIOV)
+#define WRITER_IOV_BATCH 1024
+
+// Compressed data are staged in this many of zstd's recommended output blocks (ZSTD_CStreamOutSize) to limit write calls
+#define WRITER_ZSTD_STAGING_BLOCKS 32
+
+// zstd seekable format constants (skippable frame magic, seek table footer magic and length)
+#define WRITER_ZSTD_SKIPPABLE_MAGIC 0x184D2A5E
+#define WRITER_ZSTD_SEEKABLE_MAGIC 0x8F92EAB1
+#define WRITER_ZSTD_SEEK_FOOTER_LENGTH 9
+
+// Output sink types
+typedef enum lofar_udp_sink_type {
+	SINK_NONE = 0,
+	SINK_FILE = 1,
+	SINK_FIFO = 2,
+	SINK_SHM = 3,
+	SINK_CALLBACK = 4,
+	SINK_HDF5 = 5,
+	SINK_PSRFITS = 6,
+	SINK_PIPE = 7
+} lofar_udp_sink_type;
+
+// Callback sink: called on the writer thread with pointers into the writer's
+// buffers. They remain valid until the callback returns; return 0 on success,
+// >0 to flag a fatal error.
+typedef int (*lofar_udp_sink_callback)(const int outp, const char *header, const long headerLength, const char *data, const long dataLength, void *userData);
+
+// Shared memory ring header, placed at the start of the mapping
+//
+// The writer fills slot (writeCount % numSlots) and then increments
+// writeCount; consumers read slots up to writeCount, then increment readCount
+// to release them. Counters must be accessed atomically.
+//
+// Consumers record their PID on attach and a CLOCK_MONOTONIC heartbeat on
+// every next / release call, so that a writer waiting on a full ring can give
+// up once its consumer has exited or stopped polling.
+typedef struct lofar_udp_shm_ring_header {
+	int magic;
+	int version;
+	int output;
+	int numSlots;
+	long slotLength;
+	long dataOffset;
+
+	long writeCount;
+	long readCount;
+
+	int consumerPid;
+	long consumerHeartbeat;
+
+	long slotHeaderLength[WRITER_SHM_MAX_SLOTS];
+	long slotDataLength[WRITER_SHM_MAX_SLOTS];
+	long slotSequence[WRITER_SHM_MAX_SLOTS];
+} lofar_udp_shm_ring_header;
+
+// Shared memory ring handle, for both the writer and consumers
+typedef struct lofar_udp_shm_ring {
+	char name[256];
+	int fd;
+	int owner;
+	int overwrite;
+	size_t mappingLength;
+	lofar_udp_shm_ring_header *header;
+	char *slots;
+
+	// Consumer position
+	long readCount;
+
+	// Writer: the consumer was lost, further writes fail immediately
+	int consumerLost;
+} lofar_udp_shm_ring;
+
+// Output sink struct
+typedef struct lofar_udp_sink {
+	lofar_udp_sink_type type;
+
+	// SINK_FILE / SINK_FIFO / SINK_PIPE (FIFOs are opened and closed by the writer, pipes are owned by the caller)
+	int fd;
+
+	// SINK_FIFO / SINK_PIPE: the fd is a pipe, so data can be vmsplice'd rather than copied
+	int splice;
+
+	// SINK_SHM
+	lofar_udp_shm_ring *ring;
+
+	// SINK_CALLBACK
+	lofar_udp_sink_callback callback;
+	void *userData;
+
+	// SINK_HDF5
+	lofar_udp_hdf5_file *hdf5;
+
+	// SINK_PSRFITS
+	lofar_udp_psrfits_file *psrfits;
+} lofar_udp_sink;
+
+
+// Writer configuration struct
+typedef struct lofar_udp_writer_config {
+	// zstd compression level for the outputs, 0 disables compression
+	int compressionLevel;
+
+	// Number of zstd worker threads used to compress each output
+	int compressionWorkers;
+
+	// Copy gulps into pipe sinks with writev rather than vmsplice'ing them, for consumers that
+	// 	splice the data onwards instead of reading it (see lofar_udp_writer_sink_pipe)
+	int pipeCopy;
+
+	// Write gulps in modes 0/1 without packet loss straight from the reader's input buffers, skipping the kernels.
+	// 	Only applies while every output has a file, named pipe or file descriptor sink, and meta->outputData is not
+	// 	updated for those gulps, so leave this disabled if anything else reads outputData
+	int passthrough;
+
+} lofar_udp_writer_config;
+extern lofar_udp_writer_config lofar_udp_writer_config_default;
+
+
+// Asynchronous writer struct
+//
+// The writer owns a second set of output buffers. On each submission the
+// buffers that the kernels have just filled are handed to a writer thread,
+// and meta->outputData is pointed at the other set, so that gulp N is being
+// written while gulp N+1 is being processed.
+typedef struct lofar_udp_writer {
+	// Reader we are attached to
+	lofar_udp_reader *reader;
+
+	// Output sinks (FILE*s remain owned by the caller)
+	int numOutputs;
+	lofar_udp_sink sinks[MAX_OUTPUT_DIMS];
+
+	// Ping-pong output buffers, [0] are the buffers allocated by the reader
+	char *outputBuffers[2][MAX_OUTPUT_DIMS];
+	long bufferLength[MAX_OUTPUT_DIMS];
+	int processingBuffer;
+
+	// Work handed to the writer thread
+	int writeBuffer;
+	long writeLength[MAX_OUTPUT_DIMS];
+	char headerBuffer[WRITER_MAX_HDR_LENGTH];
+	long headerLength;
+
+	// Copy into pipe sinks rather than vmsplice'ing
+	int pipeCopy;
+
+	// Passthrough was requested, see lofar_udp_writer_config
+	int passthrough;
+
+	// Compression state for file and FIFO sinks, each gulp is written as an independent zstd frame
+	int compressionLevel;
+	ZSTD_CCtx *cctx[MAX_OUTPUT_DIMS];
+	char *compressionBuffer;
+	size_t compressionBufferSize;
+
+	// zstd seekable format seek table for each output, (compressed, decompressed) size pairs for each frame
+	unsigned int *seekTable[MAX_OUTPUT_DIMS];
+	long seekFrames[MAX_OUTPUT_DIMS];
+	long seekCapacity[MAX_OUTPUT_DIMS];
+	int seekOverflow[MAX_OUTPUT_DIMS];
+
+	// Thread state, guarded by the mutex
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int writePending;
+	int writeError;
+	int shutdown;
+
+	// Statistics for the last and all completed writes (copied to the reader's stats on each flush)
+	long writesCompleted;
+	double lastWriteTime;
+	double totalWriteTime;
+	long bytesWritten;
+	long bytesCompressed;
+
+} lofar_udp_writer;
+#endif
+
+
+
+// Function Prototypes
+#ifndef __LOFAR_UDP_WRITER_H
+#define __LOFAR_UDP_WRITER_H
+
+// Allow C++ imports too
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writer struct initialisation / cleanup
+lofar_udp_writer* lofar_udp_writer_setup(lofar_udp_reader *reader, FILE **outputFiles);
+lofar_udp_writer* lofar_udp_writer_setup_struct(lofar_udp_reader *reader, FILE **outputFiles, const lofar_udp_writer_config *config);
+int lofar_udp_writer_update_files(lofar_udp_writer *writer, FILE **outputFiles);
+// Compressed file outputs are only seekable once finalised, call this before closing them
+int lofar_udp_writer_finalise(lofar_udp_writer *writer);
+int lofar_udp_writer_cleanup(lofar_udp_writer *writer);
+
+// Output sink registration
+int lofar_udp_writer_sink_file(lofar_udp_writer *writer, const int outp, FILE *outputFile);
+int lofar_udp_writer_sink_fifo(lofar_udp_writer *writer, const int outp, const char *path);
+// Pipes (and FIFOs) are filled with vmsplice: the pipe references the writer's buffers until the consumer
+// 	read()s the data out. Consumers that splice() or tee() it onwards keep those references after the pipe is
+// 	drained, and will see the buffers being reused; set lofar_udp_writer_config.pipeCopy for them.
+int lofar_udp_writer_sink_pipe(lofar_udp_writer *writer, const int outp, const int fd);
+int lofar_udp_writer_sink_shm(lofar_udp_writer *writer, const int outp, const char *name, const int numSlots, const int overwrite);
+int lofar_udp_writer_sink_callback(lofar_udp_writer *writer, const int outp, lofar_udp_sink_callback callback, void *userData);
+int lofar_udp_writer_sink_hdf5(lofar_udp_writer *writer, const int outp, const char *path, const int compressionLevel, const int compressionThreads);
+int lofar_udp_writer_sink_psrfits(lofar_udp_writer *writer, const int outp, const char *path, const lofar_udp_psrfits_config *config);
+
+// Shared memory ring consumer interface
+lofar_udp_shm_ring* lofar_udp_shm_ring_attach(const char *name);
+int lofar_udp_shm_ring_next(lofar_udp_shm_ring *ring, const char **header, long *headerLength, const char **data, long *dataLength);
+int lofar_udp_shm_ring_release(lofar_udp_shm_ring *ring);
+void lofar_udp_shm_ring_detach(lofar_udp_shm_ring *ring);
+
+// Gulp submission
+int lofar_udp_writer_submit(lofar_udp_writer *writer, const long packetsToWrite);
+int lofar_udp_writer_submit_prefixed(lofar_udp_writer *writer, const long packetsToWrite, const char *header, const long headerLength);
+int lofar_udp_writer_flush(lofar_udp_writer *writer);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
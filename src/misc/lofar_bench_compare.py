@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import shlex
+import subprocess
+import sys
+
+# Columns of the benchmark outputs before 'seconds' describe the configuration, 'seconds' is the compared metric
+metricColumn = 'seconds'
+
+
+def runBenchmark(name, command, samples):
+	"""
+	Run a benchmark executable several times, collecting one timing sample per
+	configuration from each run.
+	"""
+	results = {}
+	for sample in range(samples):
+		print(f"Running {name} benchmark ({sample + 1}/{samples}): {' '.join(command)}", file = sys.stderr)
+		output = subprocess.run(command, check = True, stdout = subprocess.PIPE, universal_newlines = True).stdout
+		parseOutput(name, output, results)
+
+	return results
+
+
+def parseOutput(name, output, results):
+	"""
+	Parse the tab separated output of a benchmark into the results dictionary,
+	keyed by the benchmark name and every configuration column.
+	"""
+	columns = None
+	for line in output.splitlines():
+		if line.startswith('#'):
+			columns = line.strip('# ').split('\t')
+			continue
+
+		if not line.strip():
+			continue
+
+		if columns is None or metricColumn not in columns:
+			raise RuntimeError(f"Unable to find the column headers in the output of the {name} benchmark.")
+
+		values = line.split('\t')
+		params = dict(zip(columns[:columns.index(metricColumn)], values))
+		key = name + '/' + ','.join(f"{column}={value}" for column, value in params.items())
+
+		entry = results.setdefault(key, {'benchmark': name, 'params': params, 'metric': metricColumn, 'samples': []})
+		entry['samples'].append(float(values[columns.index(metricColumn)]))
+
+
+def betaContinuedFraction(a, b, x):
+	"""
+	Continued fraction for the regularised incomplete beta function (modified
+	Lentz's method).
+	"""
+	tiny = 1e-300
+	c, d = 1., 1. - (a + b) * x / (a + 1.)
+	d = 1. / (d if abs(d) > tiny else tiny)
+	result = d
+
+	for m in range(1, 300):
+		for numerator in (m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)), -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1))):
+			d = 1. + numerator * d
+			d = 1. / (d if abs(d) > tiny else tiny)
+			c = 1. + numerator / c
+			c = c if abs(c) > tiny else tiny
+			result *= d * c
+
+		if abs(d * c - 1.) < 1e-12:
+			break
+
+	return result
+
+
+def incompleteBeta(a, b, x):
+	"""
+	Regularised incomplete beta function I_x(a, b).
+	"""
+	if x <= 0.:
+		return 0.
+	if x >= 1.:
+		return 1.
+
+	logFront = math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) + a * math.log(x) + b * math.log(1. - x)
+	if x < (a + 1.) / (a + b + 2.):
+		return math.exp(logFront) * betaContinuedFraction(a, b, x) / a
+	return 1. - math.exp(logFront) * betaContinuedFraction(b, a, 1. - x) / b
+
+
+def welchTest(current, baseline):
+	"""
+	One-sided Welch's t-test for the current samples having a larger mean than
+	the baseline samples.
+
+	Returns the t statistic, degrees of freedom and p-value.
+	"""
+	n1, n2 = len(current), len(baseline)
+	if n1 < 2 or n2 < 2:
+		return None, None, None
+
+	mean1, mean2 = sum(current) / n1, sum(baseline) / n2
+	var1 = sum((val - mean1) ** 2 for val in current) / (n1 - 1)
+	var2 = sum((val - mean2) ** 2 for val in baseline) / (n2 - 1)
+	se2 = var1 / n1 + var2 / n2
+
+	if se2 == 0.:
+		return (math.inf if mean1 > mean2 else 0.), n1 + n2 - 2, (0. if mean1 > mean2 else 1.)
+
+	t = (mean1 - mean2) / math.sqrt(se2)
+	dof = se2 ** 2 / ((var1 / n1) ** 2 / (n1 - 1) + (var2 / n2) ** 2 / (n2 - 1))
+
+	# P(T > t) for a Student's t distribution with dof degrees of freedom
+	tail = 0.5 * incompleteBeta(dof / 2., 0.5, dof / (dof + t * t))
+	return t, dof, (tail if t > 0 else 1. - tail)
+
+
+def compareResults(current, baseline, alpha, threshold):
+	"""
+	Compare every configuration present in both result sets, flagging those
+	that are both significantly and meaningfully slower.
+
+	Returns the number of flagged regressions.
+	"""
+	regressions = 0
+	print("# key\tbaseline\tcurrent\tchange\tp\tstatus")
+
+	for key in sorted(current['results']):
+		if key not in baseline['results']:
+			print(f"{key}\t-\t-\t-\t-\tnew")
+			continue
+
+		currentSamples = current['results'][key]['samples']
+		baselineSamples = baseline['results'][key]['samples']
+		currentMean = sum(currentSamples) / len(currentSamples)
+		baselineMean = sum(baselineSamples) / len(baselineSamples)
+		change = (currentMean - baselineMean) / baselineMean if baselineMean > 0. else 0.
+
+		__, __, slowerP = welchTest(currentSamples, baselineSamples)
+		__, __, fasterP = welchTest(baselineSamples, currentSamples)
+
+		if slowerP is None:
+			status = 'insufficient samples'
+		elif slowerP < alpha and change > threshold:
+			status = 'REGRESSION'
+			regressions += 1
+		elif fasterP < alpha and -change > threshold:
+			status = 'improvement'
+		else:
+			status = 'ok'
+
+		pString = f"{min(slowerP, fasterP):.2e}" if slowerP is not None else '-'
+		print(f"{key}\t{baselineMean:.6f}\t{currentMean:.6f}\t{100. * change:+.1f}%\t{pString}\t{status}")
+
+	for key in sorted(set(baseline['results']) - set(current['results'])):
+		print(f"{key}\t-\t-\t-\t-\tmissing")
+
+	return regressions
+
+
+if __name__ == '__main__':
+	parser = argparse.ArgumentParser(description = "Run the kernel and reader benchmarks, store the results as JSON and compare them against a baseline.")
+
+	parser.add_argument('-k', dest = 'kernels', default = './lofar_bench_kernels', help = "Kernel benchmark executable, '' to skip (default: ./lofar_bench_kernels)")
+	parser.add_argument('-K', dest = 'kernel_args', default = '-r 3', help = "Arguments for the kernel benchmark, pass as -K='<args>' (default: '-r 3')")
+	parser.add_argument('-r', dest = 'reader', default = './lofar_bench_reader', help = "Reader benchmark executable, '' to skip (default: ./lofar_bench_reader)")
+	parser.add_argument('-R', dest = 'reader_args', default = '-r 1', help = "Arguments for the reader benchmark, pass as -R='<args>' (default: '-r 1')")
+	parser.add_argument('-n', dest = 'samples', default = 5, type = int, help = "Number of runs of each benchmark, each provides one sample per configuration (default: 5)")
+
+	parser.add_argument('-i', dest = 'input', default = None, help = "Load results from a previous run instead of running the benchmarks")
+	parser.add_argument('-o', dest = 'output', default = None, help = "Write the results to this JSON file (eg. to store a new baseline)")
+	parser.add_argument('-b', dest = 'baseline', default = None, help = "Baseline JSON file to compare the results against")
+	parser.add_argument('-p', dest = 'alpha', default = 0.01, type = float, help = "Significance level of the one-sided Welch's t-test (default: 0.01)")
+	parser.add_argument('-t', dest = 'threshold', default = 0.05, type = float, help = "Minimum fractional slowdown to flag as a regression (default: 0.05)")
+
+	args = parser.parse_args()
+
+	assert(args.samples > 1)
+	assert(0. < args.alpha < 1.)
+	assert(args.threshold >= 0.)
+
+	if args.input:
+		with open(args.input, 'r') as ref:
+			current = json.load(ref)
+	else:
+		current = {
+			'metadata': {
+				'date': datetime.datetime.now(datetime.timezone.utc).isoformat(),
+				'host': platform.node(),
+				'machine': platform.machine(),
+				'cpus': os.cpu_count(),
+				'samples': args.samples
+			},
+			'results': {}
+		}
+
+		for name, executable, extraArgs in (('kernels', args.kernels, args.kernel_args), ('reader', args.reader, args.reader_args)):
+			if executable:
+				command = [executable] + shlex.split(extraArgs)
+				current['metadata'][name] = ' '.join(command)
+				current['results'].update(runBenchmark(name, command, args.samples))
+
+	if args.output:
+		assert(args.output != args.baseline)
+		with open(args.output, 'w') as ref:
+			json.dump(current, ref, indent = '\t', sort_keys = True)
+		print(f"Results written to {args.output}", file = sys.stderr)
+
+	if args.baseline:
+		with open(args.baseline, 'r') as ref:
+			baseline = json.load(ref)
+
+		regressions = compareResults(current, baseline, args.alpha, args.threshold)
+		if regressions:
+			print(f"{regressions} configuration(s) are significantly slower than the baseline.", file = sys.stderr)
+			sys.exit(1)